@@ -250,7 +250,7 @@ int main(int argc, char *argv[]) {
     // Retrieve material 'm' data en masse for the first vector vf. On
     // the other hand, use the operator() to retrieve data for the
     // second vector vfalt
-    std::vector<double>& vfmat = vf.get_matdata(m);
+    Jali::StateArray<double>& vfmat = vf.get_matdata(m);
 
     // We need the indices of cells in the material
     std::vector<int> const& matcells = mystate->material_cells(m);
@@ -55,6 +55,8 @@
  *
  */
 
+#include <algorithm>
+
 #include "BoxRegion.hh"
 #include "errors.hh"
 
@@ -132,6 +134,33 @@ BoxRegion::inside(const Point& p) const
   return result;
 }
 
+// -------------------------------------------------------------
+// BoxRegion::inside -- batched test with the same tolerance as
+// between_, one coordinate direction at a time
+// -------------------------------------------------------------
+void
+BoxRegion::inside(const double *xyz, const std::size_t n,
+                  const unsigned int dim, std::uint8_t *mask) const
+{
+  if (dim != p0_.dim()) {
+    std::stringstream tempstr;
+    tempstr << "\nMismatch in corner dimension of BoxRegion \"" << Region::name() << "\" and query point.\n Perhaps the region is improperly defined?\n";
+    Errors::Message mesg(tempstr.str());
+    Exceptions::Jali_throw(mesg);
+  }
+
+  double tol = 1.0e-08;
+  std::fill(mask, mask+n, 1);
+  for (int d = 0; d < dim; ++d) {
+    double lo = std::min(p0_[d], p1_[d]) - tol;
+    double hi = std::max(p0_[d], p1_[d]) + tol;
+    for (std::size_t i = 0; i < n; ++i) {
+      double x = xyz[dim*i+d];
+      mask[i] &= (x >= lo) & (x <= hi);
+    }
+  }
+}
+
 // -------------------------------------------------------------
 // BoxRegion::is_degenerate (also indicate in how many dimensions)
 // -------------------------------------------------------------
@@ -100,6 +100,10 @@ public:
   /// Is the the specified point inside this region
   bool inside(const Point& p) const;
 
+  /// Batched inside test, one coordinate direction at a time
+  void inside(const double *xyz, const std::size_t n,
+              const unsigned int dim, std::uint8_t *mask) const;
+
   /// corners
   inline
   void corners(Point *lo_corner, Point *hi_corner) const
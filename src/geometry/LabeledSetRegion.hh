@@ -109,6 +109,7 @@ public:
 
   /// Is the the specified point inside this region
   bool inside(const Point& p) const;
+  using Region::inside;
 
   inline std::string entity_str() const { return entity_str_; }
 
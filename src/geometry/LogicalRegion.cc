@@ -56,8 +56,12 @@
  *
  */
 
+#include <algorithm>
+#include <sstream>
+
 #include "LogicalRegion.hh"
 #include "errors.hh"
+#include "GeometricModel.hh"
 
 namespace JaliGeometry {
 
@@ -127,4 +131,51 @@ LogicalRegion::inside(const Point& p) const
   return false;
 }
 
+// -------------------------------------------------------------
+// LogicalRegion::inside -- batched test composing the masks of the
+// component regions
+// -------------------------------------------------------------
+void
+LogicalRegion::inside(const double *xyz, const std::size_t n,
+                      const unsigned int dim, std::uint8_t *mask,
+                      GeometricModel const& gm) const
+{
+  std::vector<std::uint8_t> component_mask(n);
+  for (int r = 0; r < region_names_.size(); ++r) {
+    RegionPtr rgn = gm.FindRegion(region_names_[r]);
+    if (rgn == NULL) {
+      std::stringstream tempstr;
+      tempstr << "Geometric model has no region named " << region_names_[r];
+      Errors::Message mesg(tempstr.str());
+      Exceptions::Jali_throw(mesg);
+    }
+
+    std::uint8_t *m = (r == 0) ? mask : component_mask.data();
+    if (rgn->type() == Region_type::LOGICAL)
+      ((LogicalRegionPtr) rgn)->inside(xyz, n, dim, m, gm);
+    else
+      rgn->inside(xyz, n, dim, m);
+    if (r == 0) continue;
+
+    // The masks are 0 or 1 so bitwise operations combine them
+
+    if (operation_ == Bool_type::INTERSECT) {
+      for (std::size_t i = 0; i < n; ++i)
+        mask[i] &= m[i];
+    } else if (operation_ == Bool_type::SUBTRACT) {
+      for (std::size_t i = 0; i < n; ++i)
+        mask[i] &= m[i] ^ 1;
+    } else {  // UNION and COMPLEMENT (of the union)
+      for (std::size_t i = 0; i < n; ++i)
+        mask[i] |= m[i];
+    }
+  }
+
+  if (region_names_.empty())
+    std::fill(mask, mask+n, 0);
+  if (operation_ == Bool_type::COMPLEMENT)
+    for (std::size_t i = 0; i < n; ++i)
+      mask[i] ^= 1;
+}
+
 } // namespace JaliGeometry
@@ -67,6 +67,8 @@
 
 namespace JaliGeometry {
 
+class GeometricModel;
+
 // -------------------------------------------------------------
 //  class LogicalRegion
 // -------------------------------------------------------------
@@ -111,6 +113,14 @@ class LogicalRegion : public Region {
 
   /// Is the the specified point inside this region
   bool inside(const Point& p) const;
+  using Region::inside;
+
+  /// Batched inside test combining the masks of the component
+  /// regions with bitwise operations. The components (which may be
+  /// logical regions themselves) are looked up in the geometric model
+  void inside(const double *xyz, const std::size_t n,
+              const unsigned int dim, std::uint8_t *mask,
+              GeometricModel const& gm) const;
 
   inline std::vector<std::string> const &component_regions() const
   { return region_names_; }
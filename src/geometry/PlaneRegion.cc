@@ -128,4 +128,32 @@ PlaneRegion::inside(const Point& p) const
   return result;
 }
 
+// -------------------------------------------------------------
+// PlaneRegion::inside -- batched test
+// -------------------------------------------------------------
+void
+PlaneRegion::inside(const double *xyz, const std::size_t n,
+                    const unsigned int dim, std::uint8_t *mask) const
+{
+  if (dim != p_.dim()) {
+    std::stringstream tempstr;
+    tempstr << "\nMismatch in point dimension of PlaneRegion \"" << Region::name() << "\" and query point.\n Perhaps the region is improperly defined?\n";
+
+    Errors::Message mesg(tempstr.str());
+    Exceptions::Jali_throw(mesg);
+  }
+
+  double d(0.0);
+  for (int k = 0; k < dim; ++k)
+    d += n_[k]*p_[k];
+
+  for (std::size_t i = 0; i < n; ++i) {
+    double res(0.0);
+    for (int k = 0; k < dim; ++k)
+      res += n_[k]*xyz[dim*i+k];
+    res -= d;
+    mask[i] = (fabs(res) <= 1.0e-12);
+  }
+}
+
 } // namespace JaliGeometry
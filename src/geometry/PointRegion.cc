@@ -55,6 +55,8 @@
  *
  */
 
+#include <algorithm>
+
 #include "PointRegion.hh"
 #include "errors.hh"
 
@@ -111,4 +113,24 @@ PointRegion::inside(const Point& p) const
   return result;
 }
 
+// -------------------------------------------------------------
+// PointRegion::inside -- batched test
+// -------------------------------------------------------------
+void
+PointRegion::inside(const double *xyz, const std::size_t n,
+                    const unsigned int dim, std::uint8_t *mask) const
+{
+  if (dim != p_.dim()) {
+    std::stringstream tempstr;
+    tempstr << "\nMismatch in dimension of PointRegion \"" << Region::name() << "\" and query point.\n Perhaps the region is improperly defined?\n";
+    Errors::Message mesg(tempstr.str());
+    Exceptions::Jali_throw(mesg);
+  }
+
+  std::fill(mask, mask+n, 1);
+  for (int k = 0; k < dim; ++k)
+    for (std::size_t i = 0; i < n; ++i)
+      mask[i] &= (fabs(xyz[dim*i+k]-p_[k]) < 1e-12);
+}
+
 } // namespace JaliGeometry
@@ -93,6 +93,10 @@ public:
 
   bool inside(const Point& p) const;
 
+  /// Batched inside test
+  void inside(const double *xyz, const std::size_t n,
+              const unsigned int dim, std::uint8_t *mask) const;
+
 protected:
 
   const Point p_;              /* point */
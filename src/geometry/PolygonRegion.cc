@@ -314,4 +314,35 @@ PolygonRegion::inside(const Point& p) const
 }
 
 
+// -------------------------------------------------------------
+// PolygonRegion::inside -- batched test
+// -------------------------------------------------------------
+void
+PolygonRegion::inside(const double *xyz, const std::size_t n,
+                      const unsigned int dim, std::uint8_t *mask) const
+{
+  /* First check which points are on the infinite line/plane */
+
+  double d(0.0);
+  for (int k = 0; k < dim; ++k)
+    d += normal_[k]*points_[0][k];
+
+  for (std::size_t i = 0; i < n; ++i) {
+    double res(0.0);
+    for (int k = 0; k < dim; ++k)
+      res += normal_[k]*xyz[dim*i+k];
+    res -= d;
+    mask[i] = (fabs(res) <= 1.0e-12);
+  }
+
+  /* Then check if those are in the segment or polygon */
+
+  Point p(dim);
+  for (std::size_t i = 0; i < n; ++i) {
+    if (!mask[i]) continue;
+    p.set(dim, xyz + dim*i);
+    mask[i] = inside(p);
+  }
+}
+
 } // namespace JaliGeometry
@@ -101,6 +101,12 @@ public:
   /// Is the the specified point inside this region
   bool inside(const Point& p) const;
 
+  /// Batched inside test - the points are first tested against the
+  /// plane of the polygon together and only those on it are tested
+  /// against the polygon one by one
+  void inside(const double *xyz, const std::size_t n,
+              const unsigned int dim, std::uint8_t *mask) const;
+
 protected:
 
   const unsigned int num_points_;    /* Number of points defining polygon */
@@ -92,6 +92,20 @@ Region::~Region(void)
   // empty
 }
 
+// -------------------------------------------------------------
+// Region::inside -- batched test, one point at a time
+// -------------------------------------------------------------
+void
+Region::inside(const double *xyz, const std::size_t n,
+               const unsigned int dim, std::uint8_t *mask) const
+{
+  Point p(dim);
+  for (std::size_t i = 0; i < n; i++) {
+    p.set(dim, xyz + dim*i);
+    mask[i] = inside(p);
+  }
+}
+
 // Get the extents of the Region
 
 // void Region::extents(Point *pmin, Point *pmax) const
@@ -59,6 +59,8 @@
 #ifndef _Region_hh_
 #define _Region_hh_
 
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 
 #include "Point.hh"
@@ -168,6 +170,13 @@ public:
   /// Does being on the boundary count as inside or not?
   virtual bool inside(const Point& p) const = 0;
 
+  /// Batched version of the inside test for n points of dimension
+  /// dim stored one after the other in xyz - mask[i] is set to 1 if
+  /// point i is inside and to 0 if not. The default makes the single
+  /// point test on each point
+  virtual void inside(const double *xyz, const std::size_t n,
+                      const unsigned int dim, std::uint8_t *mask) const;
+
 
   /// Get the extents of the Region
   /// void extents(Point *pmin, Point *pmax) const;
@@ -0,0 +1,192 @@
+/*
+ Copyright (c) 2019, Triad National Security, LLC
+ All rights reserved.
+
+ Copyright 2019. Triad National Security, LLC. This software was
+ produced under U.S. Government contract 89233218CNA000001 for Los
+ Alamos National Laboratory (LANL), which is operated by Triad
+ National Security, LLC for the U.S. Department of Energy. 
+ All rights in the program are reserved by Triad National Security,
+ LLC, and the U.S. Department of Energy/National Nuclear Security
+ Administration. The Government is granted for itself and others acting
+ on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+ in this material to reproduce, prepare derivative works, distribute
+ copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+
+ 
+ This is open source software distributed under the 3-clause BSD license.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of Triad National Security, LLC, Los Alamos
+    National Laboratory, LANL, the U.S. Government, nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ 
+ THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+ BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#include <UnitTest++.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "../BoxRegion.hh"
+#include "../PlaneRegion.hh"
+#include "../PointRegion.hh"
+#include "../PolygonRegion.hh"
+#include "../LogicalRegion.hh"
+#include "../GeometricModel.hh"
+
+#include "mpi.h"
+
+
+// Points of a lattice on [0, 1]^dim - many of them on the boundaries
+// of the regions below
+
+std::vector<double> lattice_points(int dim, int nx) {
+  std::vector<double> xyz;
+  int n = (dim == 2) ? nx*nx : nx*nx*nx;
+  for (int i = 0; i < n; i++) {
+    int k = i;
+    for (int d = 0; d < dim; d++) {
+      xyz.push_back(static_cast<double>(k % nx)/(nx-1));
+      k /= nx;
+    }
+  }
+  return xyz;
+}
+
+// The batched test has to agree with the single point one
+
+void check_batched(JaliGeometry::RegionPtr region, int dim,
+                   std::vector<double> const& xyz) {
+  int n = xyz.size()/dim;
+  std::vector<std::uint8_t> mask(n, 7);
+  region->inside(xyz.data(), n, dim, mask.data());
+  int ninside = 0;
+  for (int i = 0; i < n; i++) {
+    JaliGeometry::Point p(dim);
+    p.set(dim, &xyz[dim*i]);
+    CHECK_EQUAL(region->inside(p) ? 1 : 0, mask[i]);
+    ninside += mask[i];
+  }
+  CHECK(ninside > 0);
+}
+
+
+TEST(Batched_Inside)
+{
+  std::vector<double> xyz3 = lattice_points(3, 11);
+  std::vector<double> xyz2 = lattice_points(2, 11);
+
+  JaliGeometry::BoxRegion box3("box3", 1,
+                               JaliGeometry::Point(0.7, 0.2, 0.3),
+                               JaliGeometry::Point(0.1, 0.8, 0.6));
+  check_batched(&box3, 3, xyz3);
+
+  JaliGeometry::BoxRegion box2("box2", 2, JaliGeometry::Point(0.3, 0.0),
+                               JaliGeometry::Point(0.6, 0.4));
+  check_batched(&box2, 2, xyz2);
+
+  JaliGeometry::PlaneRegion plane("plane", 3,
+                                  JaliGeometry::Point(0.5, 0.5, 0.5),
+                                  JaliGeometry::Point(1.0, 1.0, 0.0));
+  check_batched(&plane, 3, xyz3);
+
+  JaliGeometry::PointRegion point("point", 4,
+                                  JaliGeometry::Point(0.4, 0.6));
+  check_batched(&point, 2, xyz2);
+
+  std::vector<JaliGeometry::Point> quad = {
+    JaliGeometry::Point(0.2, 0.2, 0.5), JaliGeometry::Point(0.8, 0.2, 0.5),
+    JaliGeometry::Point(0.8, 0.6, 0.5), JaliGeometry::Point(0.2, 0.6, 0.5)};
+  JaliGeometry::PolygonRegion polygon("polygon", 5, 4, quad);
+  check_batched(&polygon, 3, xyz3);
+
+  std::vector<JaliGeometry::Point> segment = {
+    JaliGeometry::Point(0.1, 0.1), JaliGeometry::Point(0.7, 0.7)};
+  JaliGeometry::PolygonRegion diagonal("diagonal", 6, 2, segment);
+  check_batched(&diagonal, 2, xyz2);
+
+  // Points of the wrong dimension
+
+  std::vector<std::uint8_t> mask(xyz2.size()/2);
+  CHECK_THROW(box3.inside(xyz2.data(), mask.size(), 2, mask.data()),
+              Errors::Message);
+}
+
+
+TEST(Batched_Inside_Logical)
+{
+  JaliGeometry::BoxRegion left("left", 1, JaliGeometry::Point(0.0, 0.0),
+                               JaliGeometry::Point(0.5, 1.0));
+  JaliGeometry::BoxRegion lower("lower", 2, JaliGeometry::Point(0.0, 0.0),
+                                JaliGeometry::Point(1.0, 0.3));
+  JaliGeometry::PointRegion point("point", 3, JaliGeometry::Point(0.9, 0.9));
+  JaliGeometry::LogicalRegion both("both", 4, "Intersect",
+                                   {"left", "lower"});
+  JaliGeometry::LogicalRegion either("either", 5, "Union",
+                                     {"left", "lower", "point"});
+  JaliGeometry::LogicalRegion upper_left("upper_left", 6, "Subtract",
+                                         {"left", "lower"});
+  JaliGeometry::LogicalRegion outside("outside", 7, "Complement",
+                                      {"either"});
+  std::vector<JaliGeometry::RegionPtr> regions = {
+    &left, &lower, &point, &both, &either, &upper_left, &outside};
+  JaliGeometry::GeometricModel gm(2, regions);
+
+  std::vector<double> xyz = lattice_points(2, 11);
+  int n = xyz.size()/2;
+  std::vector<std::uint8_t> mask(n);
+  std::vector<int> counts;
+  for (auto const& region : {&both, &either, &upper_left, &outside}) {
+    region->inside(xyz.data(), n, 2, mask.data(), gm);
+    int count = 0;
+    for (int i = 0; i < n; i++) {
+      JaliGeometry::Point p(2);
+      p.set(2, &xyz[2*i]);
+      bool in_left = left.inside(p), in_lower = lower.inside(p);
+      bool in_either = in_left || in_lower || point.inside(p);
+      bool expected =
+          (region == &both) ? (in_left && in_lower) :
+          (region == &either) ? in_either :
+          (region == &upper_left) ? (in_left && !in_lower) :
+          !in_either;
+      CHECK_EQUAL(expected ? 1 : 0, mask[i]);
+      count += mask[i];
+    }
+    counts.push_back(count);
+  }
+
+  // 6x4 lattice points in both, 6x11 + 5x4 + 1 in either, 6x7 in the
+  // upper left and the rest outside
+
+  CHECK_EQUAL(24, counts[0]);
+  CHECK_EQUAL(87, counts[1]);
+  CHECK_EQUAL(42, counts[2]);
+  CHECK_EQUAL(121-87, counts[3]);
+
+  // Without the geometric model the components are unknown
+
+  CHECK_THROW(both.inside(xyz.data(), n, 2, mask.data()), Errors::Message);
+}
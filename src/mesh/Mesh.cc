@@ -57,8 +57,19 @@
 #endif
 
 #include <cmath>
+#include <algorithm>
 #include <vector>
 #include <cassert>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <functional>
+#include <utility>
+#include <cstdint>
+#include <limits>
+#include <exception>
+#include <mutex>
 
 #include "Geometry.hh"
 #include "errors.hh"
@@ -70,6 +81,7 @@
 #include "LogicalRegion.hh"
 #include "MeshTile.hh"
 #include "MeshSet.hh"
+#include "MeshExchange.hh"
 
 namespace Jali {
 
@@ -110,6 +122,99 @@ void Mesh::cache_type_info() const {
   type_info_cached = true;
 }
 
+// Split owned cells, faces and nodes into interior entities (which
+// do not need any ghost data to be updated) and boundary entities
+// (which do). Owned cells within num_ghost_layers_distmesh_ node
+// connected layers of a parallel ghost cell are boundary cells. Owned
+// faces and nodes are boundary entities if any cell connected to them
+// is a boundary or ghost cell. Requires type info to be cached
+
+void Mesh::cache_interior_boundary_info() const {
+  assert(type_info_cached);
+
+  int nlayers = std::max(num_ghost_layers_distmesh_, 1);
+
+  cell_owned_interior_.assign(num_cells(), false);
+  for (auto const& c : cells<Entity_type::PARALLEL_OWNED>())
+    cell_owned_interior_[c] = true;
+
+  // March out from the parallel ghost cells one node connected layer
+  // at a time, marking the owned cells reached as boundary cells
+
+  std::vector<Entity_ID> front = cells<Entity_type::PARALLEL_GHOST>();
+  for (int i = 0; i < nlayers && !front.empty(); ++i) {
+    std::vector<Entity_ID> next_front;
+    for (auto const& c : front) {
+      Entity_ID_List nbrs;
+      cell_get_node_adj_cells(c, Entity_type::PARALLEL_OWNED, &nbrs);
+      for (auto const& cnbr : nbrs) {
+        if (cell_owned_interior_[cnbr]) {
+          cell_owned_interior_[cnbr] = false;
+          next_front.push_back(cnbr);
+        }
+      }
+    }
+    front.swap(next_front);
+  }
+
+  cellids_owned_interior_.clear();
+  cellids_owned_boundary_.clear();
+  for (auto const& c : cells<Entity_type::PARALLEL_OWNED>()) {
+    if (cell_owned_interior_[c])
+      cellids_owned_interior_.push_back(c);
+    else
+      cellids_owned_boundary_.push_back(c);
+  }
+
+  // An owned face is interior only if all its cells are interior
+
+  faceids_owned_interior_.clear();
+  faceids_owned_boundary_.clear();
+  if (faces_requested) {
+    face_owned_interior_.assign(num_faces(), false);
+    for (auto const& f : faces<Entity_type::PARALLEL_OWNED>()) {
+      Entity_ID_List fcells;
+      face_get_cells(f, Entity_type::ALL, &fcells);
+      bool interior = true;
+      for (auto const& c : fcells)
+        if (cell_type[c] != Entity_type::BOUNDARY_GHOST &&
+            !cell_owned_interior_[c]) {
+          interior = false;
+          break;
+        }
+      face_owned_interior_[f] = interior;
+      if (interior)
+        faceids_owned_interior_.push_back(f);
+      else
+        faceids_owned_boundary_.push_back(f);
+    }
+  }
+
+  // Same for owned nodes
+
+  node_owned_interior_.assign(num_nodes(), false);
+  nodeids_owned_interior_.clear();
+  nodeids_owned_boundary_.clear();
+  for (auto const& n : nodes<Entity_type::PARALLEL_OWNED>()) {
+    Entity_ID_List ncells;
+    node_get_cells(n, Entity_type::ALL, &ncells);
+    bool interior = true;
+    for (auto const& c : ncells)
+      if (cell_type[c] != Entity_type::BOUNDARY_GHOST &&
+          !cell_owned_interior_[c]) {
+        interior = false;
+        break;
+      }
+    node_owned_interior_[n] = interior;
+    if (interior)
+      nodeids_owned_interior_.push_back(n);
+    else
+      nodeids_owned_boundary_.push_back(n);
+  }
+
+  interior_boundary_info_cached = true;
+}
+
 // Gather and cache cell to face connectivity info.
 //
 // Method is declared constant because it is not modifying the mesh
@@ -559,6 +664,12 @@ void Mesh::update_geometric_quantities() {
   compute_cell_geometric_quantities();
   if (sides_requested || wedges_requested) compute_side_geometric_quantities();
   if (corners_requested) compute_corner_geometric_quantities();
+
+  // The topology is unchanged so the spatial indices only need refitting
+  if (cell_bvh_) cell_bvh_->refit(cell_bounding_boxes());
+  if (node_bvh_) node_bvh_->refit(node_bounding_boxes());
+
+  geometry_version_++;
 }
 
 
@@ -571,6 +682,9 @@ void Mesh::cache_extra_variables() {
     cache_face2cell_info();
   }
 
+  // Needs type info and face to cell info
+  cache_interior_boundary_info();
+
   if (edges_requested) {
     cache_face2edge_info();
     cache_cell2edge_info();
@@ -593,6 +707,469 @@ void Mesh::cache_extra_variables() {
 }
 
 
+// Persistent caches of derived entities
+//
+// The sidecar file has a fixed size header (magic string, version,
+// endianness check, mesh fingerprint, dimension and a mask of the
+// parts present) followed by the cached arrays of each part in a
+// fixed order. Each array is written as a 64-bit count followed by
+// its data. Lists of lists are written in compressed row storage.
+//
+// Only sides, wedges and corners and their geometry are stored - the
+// geometry of cells, faces and edges is computed at construction
+// anyway. The file is written under a temporary name and renamed
+// into place so that an interrupted write never leaves a file that
+// looks valid.
+
+namespace {
+
+const char derived_cache_magic[8] = {'J', 'A', 'L', 'I', 'D', 'R', 'V', 'C'};
+const uint32_t derived_cache_version = 2;
+const uint32_t derived_cache_endian_check = 0x01020304;
+
+// Parts of the derived data stored in the file
+
+enum DerivedCachePart {
+  SIDE_TOPOLOGY = 1, WEDGE_TOPOLOGY = 2, CORNER_TOPOLOGY = 4,
+  SIDE_GEOMETRY = 8, CORNER_GEOMETRY = 16
+};
+constexpr int NUM_DERIVED_CACHE_PARTS = 5;
+
+struct DerivedCacheHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t endian;
+  uint64_t fingerprint;
+  int32_t space_dim;
+  int32_t parts;
+};
+
+// 64-bit FNV-1a hash
+
+class FNV1aHash {
+ public:
+  void add(void const *data, std::size_t nbytes) {
+    unsigned char const *bytes = static_cast<unsigned char const *>(data);
+    for (std::size_t i = 0; i < nbytes; i++) {
+      hash_ ^= bytes[i];
+      hash_ *= 1099511628211ULL;
+    }
+  }
+  template <class T>
+  void add(std::vector<T> const& v) {
+    uint64_t n = v.size();
+    add(&n, sizeof(n));
+    if (n) add(v.data(), n*sizeof(T));
+  }
+  uint64_t value() const { return hash_; }
+ private:
+  uint64_t hash_ = 14695981039346656037ULL;
+};
+
+class DerivedCacheWriter {
+ public:
+  DerivedCacheWriter(std::ostream& os, int dim) : os_(os), dim_(dim) {}
+
+  template <class T>
+  void operator()(std::vector<T> const& v) {
+    uint64_t n = v.size();
+    os_.write(reinterpret_cast<char const *>(&n), sizeof(n));
+    os_.write(reinterpret_cast<char const *>(v.data()), n*sizeof(T));
+  }
+  void operator()(std::vector<bool> const& v) {
+    (*this)(std::vector<uint8_t>(v.begin(), v.end()));
+  }
+  void operator()(std::vector<JaliGeometry::Point> const& v) {
+    std::vector<double> xyz(v.size()*dim_);
+    for (int i = 0; i < static_cast<int>(v.size()); i++)
+      for (int d = 0; d < dim_; d++)
+        xyz[i*dim_+d] = v[i][d];
+    (*this)(xyz);
+  }
+  void operator()(std::vector<std::vector<Entity_ID>> const& v) {
+    std::vector<Entity_ID> offset(1, 0), ids;
+    for (auto const& list : v) {
+      ids.insert(ids.end(), list.begin(), list.end());
+      offset.push_back(ids.size());
+    }
+    (*this)(offset);
+    (*this)(ids);
+  }
+
+ private:
+  std::ostream& os_;
+  int dim_;
+};
+
+// Reads arrays until the first short or inconsistent one, after
+// which it reads nothing more and ok() is false. Counts are checked
+// against the bytes left in the file before anything is allocated
+
+class DerivedCacheReader {
+ public:
+  DerivedCacheReader(std::istream& is, int dim, int64_t filesize)
+      : is_(is), dim_(dim), filesize_(filesize) {}
+
+  bool ok() const { return ok_; }
+
+  template <class T>
+  void operator()(std::vector<T>& v) {
+    uint64_t n = 0;
+    if (!ok_ || !is_.read(reinterpret_cast<char *>(&n), sizeof(n))) {
+      ok_ = false;
+      return;
+    }
+    int64_t left = filesize_ - static_cast<int64_t>(is_.tellg());
+    if (n > static_cast<uint64_t>(left)/sizeof(T)) {
+      ok_ = false;
+      return;
+    }
+    v.resize(n);
+    if (!is_.read(reinterpret_cast<char *>(v.data()), n*sizeof(T)))
+      ok_ = false;
+  }
+  void operator()(std::vector<bool>& v) {
+    std::vector<uint8_t> bytes;
+    (*this)(bytes);
+    v.assign(bytes.begin(), bytes.end());
+  }
+  void operator()(std::vector<JaliGeometry::Point>& v) {
+    std::vector<double> xyz;
+    (*this)(xyz);
+    if (xyz.size() % dim_) ok_ = false;
+    if (!ok_) return;
+    v.resize(xyz.size()/dim_);
+    for (int i = 0; i < static_cast<int>(v.size()); i++)
+      v[i].set(dim_, &(xyz[i*dim_]));
+  }
+  void operator()(std::vector<std::vector<Entity_ID>>& v) {
+    std::vector<Entity_ID> offset, ids;
+    (*this)(offset);
+    (*this)(ids);
+    if (offset.empty() || offset[0] != 0 ||
+        offset.back() > static_cast<Entity_ID>(ids.size()))
+      ok_ = false;
+    for (int i = 1; ok_ && i < static_cast<int>(offset.size()); i++)
+      if (offset[i] < offset[i-1]) ok_ = false;
+    if (!ok_) return;
+    v.resize(offset.size()-1);
+    for (int i = 0; i < static_cast<int>(v.size()); i++)
+      v[i].assign(ids.begin() + offset[i], ids.begin() + offset[i+1]);
+  }
+
+ private:
+  std::istream& is_;
+  int dim_;
+  int64_t filesize_;
+  bool ok_ = true;
+};
+
+// Skips the arrays of a part already in the mesh
+
+class DerivedCacheSkipper {
+ public:
+  explicit DerivedCacheSkipper(DerivedCacheReader *reader) :
+      reader_(reader) {}
+
+  template <class T>
+  void operator()(T const&) {
+    T discard;
+    (*reader_)(discard);
+  }
+
+ private:
+  DerivedCacheReader *reader_;
+};
+
+// Empties the arrays of a part that could not be read
+
+struct DerivedCacheClearer {
+  template <class T>
+  void operator()(std::vector<T>& v) { std::vector<T>().swap(v); }
+};
+
+}  // namespace
+
+
+// Visit the cached arrays of the requested parts in file order
+
+template <class IO>
+void Mesh::derived_cache_fields(IO *io, int parts) const {
+  if (parts & SIDE_TOPOLOGY) {
+    (*io)(sideids_owned_);
+    (*io)(sideids_ghost_);
+    (*io)(sideids_boundary_ghost_);
+    (*io)(sideids_all_);
+    (*io)(side_cell_id);
+    (*io)(side_face_id);
+    (*io)(side_edge_id);
+    (*io)(side_edge_use);
+    (*io)(side_node_ids);
+    (*io)(side_opp_side_id);
+    (*io)(cell_side_ids);
+  }
+  if (parts & WEDGE_TOPOLOGY) {
+    (*io)(wedgeids_owned_);
+    (*io)(wedgeids_ghost_);
+    (*io)(wedgeids_boundary_ghost_);
+    (*io)(wedgeids_all_);
+    (*io)(wedge_corner_id);
+  }
+  if (parts & CORNER_TOPOLOGY) {
+    (*io)(cornerids_owned_);
+    (*io)(cornerids_ghost_);
+    (*io)(cornerids_boundary_ghost_);
+    (*io)(cornerids_all_);
+    (*io)(cell_corner_ids);
+    (*io)(node_corner_ids);
+    (*io)(corner_wedge_ids);
+  }
+  if (parts & SIDE_GEOMETRY) {
+    (*io)(side_volumes);
+    (*io)(side_outward_facet_normal);
+    (*io)(side_mid_facet_normal);
+  }
+  if (parts & CORNER_GEOMETRY)
+    (*io)(corner_volumes);
+}
+
+
+// Fingerprint of the mesh partition on this rank
+
+uint64_t Mesh::fingerprint() const {
+  FNV1aHash hash;
+
+  int32_t info[4] = {static_cast<int32_t>(space_dim_),
+                     static_cast<int32_t>(manifold_dim_),
+                     static_cast<int32_t>(geomtype),
+                     static_cast<int32_t>(mesh_type_)};
+  hash.add(info, sizeof(info));
+
+  hash.add(nodeids_owned_);
+  hash.add(nodeids_ghost_);
+  hash.add(edgeids_owned_);
+  hash.add(edgeids_ghost_);
+  hash.add(faceids_owned_);
+  hash.add(faceids_ghost_);
+  hash.add(cellids_owned_);
+  hash.add(cellids_ghost_);
+  hash.add(cellids_boundary_ghost_);
+
+  // Adjacencies are hashed through the queries rather than the
+  // caches, which some frameworks do not fill
+
+  Entity_ID_List ids;
+  std::vector<dir_t> dirs;
+  for (auto const& c : cells()) {
+    cell_get_nodes(c, &ids);
+    hash.add(ids);
+    if (faces_requested) {
+      cell_get_faces_and_dirs(c, &ids, &dirs);
+      hash.add(ids);
+      hash.add(dirs);
+    }
+  }
+  if (faces_requested) {
+    for (auto const& f : faces()) {
+      face_get_nodes(f, &ids);
+      hash.add(ids);
+      if (edges_requested) {
+        face_get_edges_and_dirs(f, &ids, &dirs, true);
+        hash.add(ids);
+        hash.add(dirs);
+      }
+    }
+  }
+  if (edges_requested) {
+    ids.resize(2*num_edges());
+    for (auto const& e : edges())
+      edge_get_nodes(e, &(ids[2*e]), &(ids[2*e+1]));
+    hash.add(ids);
+  }
+
+  JaliGeometry::Point xyz;
+  for (auto const& n : nodes()) {
+    node_get_coordinates(n, &xyz);
+    hash.add(&(xyz[0]), space_dim_*sizeof(double));
+  }
+
+  return hash.value();
+}
+
+
+// Write derived entities and their geometric quantities to a sidecar
+// file
+
+void Mesh::write_derived_cache(std::string const& filename) const {
+  int parts = 0;
+  if (side_info_cached) parts |= SIDE_TOPOLOGY;
+  if (wedge_info_cached) parts |= WEDGE_TOPOLOGY;
+  if (corner_info_cached) parts |= CORNER_TOPOLOGY;
+  if (side_geometry_precomputed) parts |= SIDE_GEOMETRY;
+  if (corner_geometry_precomputed) parts |= CORNER_GEOMETRY;
+
+  DerivedCacheHeader hdr;
+  std::memset(&hdr, 0, sizeof(hdr));
+  std::memcpy(hdr.magic, derived_cache_magic, sizeof(derived_cache_magic));
+  hdr.version = derived_cache_version;
+  hdr.endian = derived_cache_endian_check;
+  hdr.fingerprint = fingerprint();
+  hdr.space_dim = space_dim_;
+  hdr.parts = parts;
+
+  std::string tmpfile = filename + ".tmp";
+  std::ofstream file(tmpfile, std::ios::binary | std::ios::trunc);
+  if (!file) {
+    Errors::Message mesg("Cannot open derived entity cache file " + tmpfile +
+                         " for writing");
+    Exceptions::Jali_throw(mesg);
+  }
+  file.write(reinterpret_cast<char const *>(&hdr), sizeof(hdr));
+
+  DerivedCacheWriter writer(file, space_dim_);
+  derived_cache_fields(&writer, parts);
+  file.close();
+
+  if (!file || std::rename(tmpfile.c_str(), filename.c_str()) != 0) {
+    std::remove(tmpfile.c_str());
+    Errors::Message mesg("Error writing derived entity cache file " +
+                         filename);
+    Exceptions::Jali_throw(mesg);
+  }
+}
+
+
+// Read derived entities and their geometric quantities from a sidecar
+// file
+
+bool Mesh::read_derived_cache(std::string const& filename,
+                              bool request_sides, bool request_wedges,
+                              bool request_corners) {
+  if (request_corners) request_wedges = true;
+  if (request_wedges) request_sides = true;
+
+  int needed = 0;
+  if (request_sides) needed |= SIDE_TOPOLOGY | SIDE_GEOMETRY;
+  if (request_wedges) needed |= WEDGE_TOPOLOGY;
+  if (request_corners) needed |= CORNER_TOPOLOGY | CORNER_GEOMETRY;
+
+  if (request_sides && !(faces_requested && edges_requested))
+    return false;
+
+  std::ifstream file(filename, std::ios::binary | std::ios::ate);
+  if (!file) return false;
+  int64_t filesize = file.tellg();
+  file.seekg(0);
+
+  DerivedCacheHeader hdr;
+  if (!file.read(reinterpret_cast<char *>(&hdr), sizeof(hdr)))
+    return false;
+  if (std::memcmp(hdr.magic, derived_cache_magic,
+                  sizeof(derived_cache_magic)) != 0 ||
+      hdr.version != derived_cache_version ||
+      hdr.endian != derived_cache_endian_check ||
+      hdr.space_dim != static_cast<int>(space_dim_) ||
+      (hdr.parts & needed) != needed ||
+      hdr.fingerprint != fingerprint())
+    return false;
+
+  // Parts already in the mesh are skipped rather than overwritten so
+  // that a bad file leaves them intact; parts read before a short or
+  // corrupt array are emptied again
+
+  int have = 0;
+  if (side_info_cached) have |= SIDE_TOPOLOGY;
+  if (wedge_info_cached) have |= WEDGE_TOPOLOGY;
+  if (corner_info_cached) have |= CORNER_TOPOLOGY;
+  if (side_geometry_precomputed) have |= SIDE_GEOMETRY;
+  if (corner_geometry_precomputed) have |= CORNER_GEOMETRY;
+
+  DerivedCacheReader reader(file, space_dim_, filesize);
+  DerivedCacheSkipper skipper(&reader);
+  int parts = 0;
+  for (int k = 0; k < NUM_DERIVED_CACHE_PARTS; k++) {
+    int part = hdr.parts & (1 << k);
+    if (!part) continue;
+    if (have & part) {
+      derived_cache_fields(&skipper, part);
+    } else {
+      derived_cache_fields(&reader, part);
+      parts |= part;
+    }
+  }
+  if (!reader.ok()) {
+    DerivedCacheClearer clearer;
+    derived_cache_fields(&clearer, parts);
+    return false;
+  }
+
+  sides_requested = sides_requested || request_sides;
+  wedges_requested = wedges_requested || request_wedges;
+  corners_requested = corners_requested || request_corners;
+  side_info_cached = side_info_cached || (parts & SIDE_TOPOLOGY);
+  wedge_info_cached = wedge_info_cached || (parts & WEDGE_TOPOLOGY);
+  corner_info_cached = corner_info_cached || (parts & CORNER_TOPOLOGY);
+  if (parts & SIDE_GEOMETRY) side_geometry_precomputed = true;
+  if (parts & CORNER_GEOMETRY) corner_geometry_precomputed = true;
+
+  return true;
+}
+
+
+// Build derived entities after construction, going through a sidecar
+// cache file if one is given
+
+bool Mesh::cache_derived_entities(bool request_sides, bool request_wedges,
+                                  bool request_corners,
+                                  std::string const& cachefile) {
+  if (request_corners) request_wedges = true;
+  if (request_wedges) request_sides = true;
+
+  if (request_sides && !(faces_requested && edges_requested)) {
+    Errors::Message mesg("Mesh::cache_derived_entities - sides, wedges and"
+                         " corners need faces and edges to be requested when"
+                         " the mesh is constructed");
+    Exceptions::Jali_throw(mesg);
+  }
+
+  // Each rank has its own file
+
+  std::string rankfile = cachefile;
+  int nprocs, rank;
+  MPI_Comm_size(comm, &nprocs);
+  MPI_Comm_rank(comm, &rank);
+  if (nprocs > 1) {
+    std::stringstream name;
+    name << cachefile << "." << nprocs << "." << rank;
+    rankfile = name.str();
+  }
+
+  if (!cachefile.empty() &&
+      read_derived_cache(rankfile, request_sides, request_wedges,
+                         request_corners))
+    return true;
+
+  // Build them from scratch in the same order as cache_extra_variables
+
+  sides_requested = sides_requested || request_sides;
+  wedges_requested = wedges_requested || request_wedges;
+  corners_requested = corners_requested || request_corners;
+
+  if (sides_requested && !side_info_cached) cache_side_info();
+  if (wedges_requested && !wedge_info_cached) cache_wedge_info();
+  if (corners_requested && !corner_info_cached) cache_corner_info();
+
+  if (sides_requested && !side_geometry_precomputed)
+    compute_side_geometric_quantities();
+  if (corners_requested && !corner_geometry_precomputed)
+    compute_corner_geometric_quantities();
+
+  if (!cachefile.empty())
+    write_derived_cache(rankfile);
+  return false;
+}
+
+
 // Partition the mesh on this compute node into submeshes or tiles
 
 void Mesh::build_tiles() {
@@ -643,17 +1220,21 @@ Entity_ID Mesh::entity_get_parent(const Entity_kind kind,
 }
 
 
+// The adjacency queries below return the cached adjacencies if the
+// framework has cached them and otherwise get them from the
+// framework directly (for frameworks like Mesh_structured that
+// compute them on the fly and do not cache them)
+
 unsigned int Mesh::cell_get_num_faces(const Entity_ID cellid) const {
 #if JALI_CACHE_VARS != 0
 
   //
   // Cached version - turn off for profiling or to save memory
   //
-  assert(cell2face_info_cached);
+  if (cell2face_info_cached)
+    return cell_face_ids[cellid].size();
 
-  return cell_face_ids[cellid].size();
-
-#else
+#endif
 
   // Non-cached version
 
@@ -663,9 +1244,6 @@ unsigned int Mesh::cell_get_num_faces(const Entity_ID cellid) const {
   cell_get_faces_and_dirs_internal(cellid, &cfaceids, &cfacedirs, false);
 
   return cfaceids.size();
-
-#endif
-
 }
 
 
@@ -678,11 +1256,7 @@ void Mesh::cell_get_faces_and_dirs(const Entity_ID cellid,
   //
   // Cached version - turn off for profiling or to save memory
   //
-  assert(cell2face_info_cached);
-
-  if (ordered) {
-    cell_get_faces_and_dirs_internal(cellid, faceids, face_dirs, ordered);
-  } else {
+  if (cell2face_info_cached && !ordered) {
     Entity_ID_List &cfaceids = cell_face_ids[cellid];
 
     *faceids = cfaceids;  // copy operation
@@ -691,18 +1265,16 @@ void Mesh::cell_get_faces_and_dirs(const Entity_ID cellid,
       std::vector<dir_t> &cfacedirs = cell_face_dirs[cellid];
       *face_dirs = cfacedirs;  // copy operation
     }
+    return;
   }
 
-#else
+#endif
 
   //
   // Non-cached version
   //
 
   cell_get_faces_and_dirs_internal(cellid, faceids, face_dirs, ordered);
-
-#endif
-
 }
 
 
@@ -717,39 +1289,39 @@ void Mesh::face_get_cells(const Entity_ID faceid, const Entity_type ptype,
   // Cached version - turn off for profiling or to save memory
   //
 
-  assert(face2cell_info_cached);
-
-
-  cellids->clear();
+  if (face2cell_info_cached) {
+    cellids->clear();
 
-  switch (ptype) {
-    case Entity_type::ALL: {
-      for (int i = 0; i < 2; i++) {
-        Entity_ID c = face_cell_ids[faceid][i];
-        if (c != -1) cellids->push_back(c);
+    switch (ptype) {
+      case Entity_type::ALL: {
+        for (int i = 0; i < 2; i++) {
+          Entity_ID c = face_cell_ids[faceid][i];
+          if (c != -1) cellids->push_back(c);
+        }
+        break;
       }
-      break;
-    }
-    case Entity_type::PARALLEL_OWNED: {
-      for (int i = 0; i < 2; i++) {
-        Entity_ID c = face_cell_ids[faceid][i];
-        if (c != -1 && cell_type[c] == Entity_type::PARALLEL_OWNED)
-          cellids->push_back(c);
+      case Entity_type::PARALLEL_OWNED: {
+        for (int i = 0; i < 2; i++) {
+          Entity_ID c = face_cell_ids[faceid][i];
+          if (c != -1 && cell_type[c] == Entity_type::PARALLEL_OWNED)
+            cellids->push_back(c);
+        }
+        break;
       }
-      break;
-    }
-    case Entity_type::PARALLEL_GHOST: {
-      for (int i = 0; i < 2; i++) {
-        Entity_ID c = face_cell_ids[faceid][i];
-        if (c != -1 && cell_type[c] == Entity_type::PARALLEL_GHOST)
-          cellids->push_back(c);
+      case Entity_type::PARALLEL_GHOST: {
+        for (int i = 0; i < 2; i++) {
+          Entity_ID c = face_cell_ids[faceid][i];
+          if (c != -1 && cell_type[c] == Entity_type::PARALLEL_GHOST)
+            cellids->push_back(c);
+        }
+        break;
       }
-      break;
+      default: {}
     }
-    default: {}      
+    return;
   }
 
-#else
+#endif
 
   //
   // Non-cached version
@@ -781,8 +1353,117 @@ void Mesh::face_get_cells(const Entity_ID faceid, const Entity_type ptype,
     }
     default: {}
   }
+}
+
+
+// Batch adjacencies - the generic versions go through the per-entity
+// queries but reuse one temporary list and append straight into the
+// CRS arrays
+
+void Mesh::cells_get_nodes(Entity_ID_List const& cellids,
+                           std::vector<int> *offsets,
+                           Entity_ID_List *nodeids) const {
+  offsets->resize(cellids.size()+1);
+  nodeids->clear();
+
+  Entity_ID_List cnodes;
+  (*offsets)[0] = 0;
+  for (int i = 0; i < cellids.size(); i++) {
+    cell_get_nodes(cellids[i], &cnodes);
+    nodeids->insert(nodeids->end(), cnodes.begin(), cnodes.end());
+    (*offsets)[i+1] = nodeids->size();
+  }
+}
+
+
+void Mesh::cells_get_faces_and_dirs(Entity_ID_List const& cellids,
+                                    std::vector<int> *offsets,
+                                    Entity_ID_List *faceids,
+                                    std::vector<dir_t> *facedirs) const {
+  offsets->resize(cellids.size()+1);
+  faceids->clear();
+  if (facedirs) facedirs->clear();
+
+  (*offsets)[0] = 0;
+
+#if JALI_CACHE_VARS != 0
+
+  if (cell2face_info_cached) {
+    for (int i = 0; i < cellids.size(); i++) {
+      Entity_ID_List const& cfaces = cell_face_ids[cellids[i]];
+      faceids->insert(faceids->end(), cfaces.begin(), cfaces.end());
+      if (facedirs) {
+        std::vector<dir_t> const& cfdirs = cell_face_dirs[cellids[i]];
+        facedirs->insert(facedirs->end(), cfdirs.begin(), cfdirs.end());
+      }
+      (*offsets)[i+1] = faceids->size();
+    }
+    return;
+  }
 
 #endif
+
+  Entity_ID_List cfaces;
+  std::vector<dir_t> cfdirs;
+  for (int i = 0; i < cellids.size(); i++) {
+    cell_get_faces_and_dirs_internal(cellids[i], &cfaces,
+                                     facedirs ? &cfdirs : NULL, false);
+    faceids->insert(faceids->end(), cfaces.begin(), cfaces.end());
+    if (facedirs)
+      facedirs->insert(facedirs->end(), cfdirs.begin(), cfdirs.end());
+    (*offsets)[i+1] = faceids->size();
+  }
+}
+
+
+void Mesh::faces_get_nodes(Entity_ID_List const& faceids,
+                           std::vector<int> *offsets,
+                           Entity_ID_List *nodeids) const {
+  offsets->resize(faceids.size()+1);
+  nodeids->clear();
+
+  Entity_ID_List fnodes;
+  (*offsets)[0] = 0;
+  for (int i = 0; i < faceids.size(); i++) {
+    face_get_nodes(faceids[i], &fnodes);
+    nodeids->insert(nodeids->end(), fnodes.begin(), fnodes.end());
+    (*offsets)[i+1] = nodeids->size();
+  }
+}
+
+
+void Mesh::faces_get_cells(Entity_ID_List const& faceids,
+                           const Entity_type ptype,
+                           std::vector<int> *offsets,
+                           Entity_ID_List *cellids) const {
+  offsets->resize(faceids.size()+1);
+  cellids->clear();
+  cellids->reserve(2*faceids.size());
+
+  Entity_ID_List fcells;
+  (*offsets)[0] = 0;
+  for (int i = 0; i < faceids.size(); i++) {
+    face_get_cells(faceids[i], ptype, &fcells);
+    cellids->insert(cellids->end(), fcells.begin(), fcells.end());
+    (*offsets)[i+1] = cellids->size();
+  }
+}
+
+
+void Mesh::nodes_get_cells(Entity_ID_List const& nodeids,
+                           const Entity_type ptype,
+                           std::vector<int> *offsets,
+                           Entity_ID_List *cellids) const {
+  offsets->resize(nodeids.size()+1);
+  cellids->clear();
+
+  Entity_ID_List ncells;
+  (*offsets)[0] = 0;
+  for (int i = 0; i < nodeids.size(); i++) {
+    node_get_cells(nodeids[i], ptype, &ncells);
+    cellids->insert(cellids->end(), ncells.begin(), ncells.end());
+    (*offsets)[i+1] = cellids->size();
+  }
 }
 
 
@@ -796,25 +1477,23 @@ void Mesh::face_get_edges_and_dirs(const Entity_ID faceid,
   // Cached version - turn off for profiling or to save memory
   //
 
-  assert(face2edge_info_cached);
-
-  *edgeids = face_edge_ids[faceid];  // copy operation
+  if (face2edge_info_cached) {
+    *edgeids = face_edge_ids[faceid];  // copy operation
 
-  if (edge_dirs) {
-    std::vector<dir_t> &fedgedirs = face_edge_dirs[faceid];
-    *edge_dirs = fedgedirs;  // copy operation
+    if (edge_dirs) {
+      std::vector<dir_t> &fedgedirs = face_edge_dirs[faceid];
+      *edge_dirs = fedgedirs;  // copy operation
+    }
+    return;
   }
 
-
-#else
+#endif
 
   //
   // Non-cached version
   //
 
   face_get_edges_and_dirs_internal(faceid, edgeids, edge_dirs, ordered);
-
-#endif
 }
 
 
@@ -829,21 +1508,22 @@ void Mesh::face_to_cell_edge_map(const Entity_ID faceid,
   // Cached version - turn off for profiling or to save memory
   //
 
-  assert(face2edge_info_cached && cell2edge_info_cached);
-
-  map->resize(face_edge_ids[faceid].size());
-  for (int f = 0; f < face_edge_ids[faceid].size(); ++f) {
-    Entity_ID fedge = face_edge_ids[faceid][f];
+  if (face2edge_info_cached && cell2edge_info_cached) {
+    map->resize(face_edge_ids[faceid].size());
+    for (int f = 0; f < face_edge_ids[faceid].size(); ++f) {
+      Entity_ID fedge = face_edge_ids[faceid][f];
 
-    for (int c = 0; c < cell_edge_ids[cellid].size(); ++c) {
-      if (fedge == cell_edge_ids[cellid][c]) {
-        (*map)[f] = c;
-        break;
+      for (int c = 0; c < cell_edge_ids[cellid].size(); ++c) {
+        if (fedge == cell_edge_ids[cellid][c]) {
+          (*map)[f] = c;
+          break;
+        }
       }
     }
+    return;
   }
 
-#else
+#endif
 
   Entity_ID_List fedgeids, cedgeids;
   std::vector<dir_t> fedgedirs;
@@ -862,8 +1542,6 @@ void Mesh::face_to_cell_edge_map(const Entity_ID faceid,
       }
     }
   }
-
-#endif
 }
 
 
@@ -875,19 +1553,18 @@ void Mesh::cell_get_edges(const Entity_ID cellid,
   // Cached version - turn off for profiling
   //
 
-  assert(cell2edge_info_cached);
-
-  *edgeids = cell_edge_ids[cellid];  // copy operation
+  if (cell2edge_info_cached) {
+    *edgeids = cell_edge_ids[cellid];  // copy operation
+    return;
+  }
 
-#else
+#endif
 
   //
   // Non-cached version
   //
 
   cell_get_edges_internal(cellid, edgeids);
-
-#endif
 }  // Mesh::cell_get_edges
 
 
@@ -900,20 +1577,19 @@ void Mesh::cell_2D_get_edges_and_dirs(const Entity_ID cellid,
   // Cached version - turn off for profiling
   //
 
-  assert(cell2edge_info_cached);
-
-  *edgeids = cell_edge_ids[cellid];  // copy operation
-  *edgedirs = cell_2D_edge_dirs[cellid];
+  if (cell2edge_info_cached) {
+    *edgeids = cell_edge_ids[cellid];  // copy operation
+    *edgedirs = cell_2D_edge_dirs[cellid];
+    return;
+  }
 
-#else
+#endif
 
   //
   // Non-cached version
   //
 
   cell_2D_get_edges_and_dirs_internal(cellid, edgeids, edgedirs);
-
-#endif
 }  // Mesh::cell_get_edges_and_dirs
 
 
@@ -2351,26 +3027,228 @@ Entity_type Mesh::entity_get_type(const Entity_kind kind,
   }
 }
 
-// Initialize mesh sets from regions (default behavior for all cells)
+// Is an entity owned and interior (i.e. not dependent on ghost data)?
 
-void Mesh::init_sets_from_geometric_model() {
-  std::map<std::string, std::vector<Entity_kind>> empty_map;
-  init_sets_from_geometric_model(empty_map);
+bool Mesh::entity_is_owned_interior(Entity_kind const kind,
+                                    Entity_ID const entid) const {
+  assert(interior_boundary_info_cached);
+  switch (kind) {
+    case Entity_kind::CELL:
+      return cell_owned_interior_[entid];
+    case Entity_kind::FACE:
+      return faces_requested ? face_owned_interior_[entid] : false;
+    case Entity_kind::NODE:
+      return node_owned_interior_[entid];
+    default:
+      return false;
+  }
 }
 
+namespace {
 
+// Call f(t, nthreads) for t = 0..nthreads-1 on nthreads threads. The
+// calling thread does t = 0
 
-// Initialize mesh sets from regions
+template<typename F>
+void run_on_threads(int const nthreads, F const& f) {
+  std::vector<std::thread> workers;
+  for (int t = 1; t < nthreads; t++)
+    workers.emplace_back(f, t, nthreads);
+  f(0, nthreads);
+  for (auto& w : workers)
+    w.join();
+}
 
-// @param region_entity_kinds_map    Map from region names to the kinds
-// of entities we want to retrieve on them - empty map means that we
-// will try to ask for default kinds of entities on each region (if
-// possible - labeled sets are tied to specific Entity_kind)
+// Region tests are cheap, so use no more than one thread per
+// kMinPointsPerThread points
+
+constexpr int kMinPointsPerThread = 16384;
+
+// Can the entities of 'kind' in the region be found by the batched
+// tests of Mesh::region_entities? These are the regions whose sets
+// are built from point tests at centroids or nodes
+
+bool batched_region(JaliGeometry::RegionPtr const region,
+                    Entity_kind const kind) {
+  switch (region->type()) {
+    case JaliGeometry::Region_type::BOX:
+      return (kind == Entity_kind::CELL || kind == Entity_kind::FACE ||
+              kind == Entity_kind::NODE);
+    case JaliGeometry::Region_type::PLANE:
+      return (kind == Entity_kind::CELL || kind == Entity_kind::FACE ||
+              kind == Entity_kind::NODE);
+    case JaliGeometry::Region_type::POLYGON:
+      return (kind == Entity_kind::FACE || kind == Entity_kind::NODE);
+    default:
+      return false;
+  }
+}
 
-void Mesh::init_sets_from_geometric_model(
-    std::map<std::string, std::vector<Entity_kind>> region_to_entity_kinds_map
-                                          ) {
-  if (!geometric_model_) return;
+// Bounding box of the region padded well beyond the tolerances of the
+// inside tests; false if the region is unbounded
+
+bool region_bounds(JaliGeometry::RegionPtr const region, int const dim,
+                   double *lo, double *hi) {
+  std::vector<JaliGeometry::Point> corners;
+  if (region->type() == JaliGeometry::Region_type::BOX) {
+    JaliGeometry::Point p0, p1;
+    ((JaliGeometry::BoxRegionPtr) region)->corners(&p0, &p1);
+    corners = {p0, p1};
+  } else if (region->type() == JaliGeometry::Region_type::POLYGON) {
+    corners = ((JaliGeometry::PolygonRegionPtr) region)->points();
+  } else {
+    return false;
+  }
+
+  for (int d = 0; d < dim; d++) {
+    lo[d] = std::numeric_limits<double>::max();
+    hi[d] = -std::numeric_limits<double>::max();
+    for (auto const& p : corners) {
+      double x = (d < p.dim()) ? p[d] : 0.0;
+      lo[d] = std::min(lo[d], x);
+      hi[d] = std::max(hi[d], x);
+    }
+  }
+  double extent = 0.0;
+  for (int d = 0; d < dim; d++)
+    extent = std::max(extent, hi[d]-lo[d]);
+  double pad = 1.0e-6*(1.0 + extent);
+  for (int d = 0; d < dim; d++) {
+    lo[d] -= pad;
+    hi[d] += pad;
+  }
+  return true;
+}
+
+// Set (*inside)[i] to whether the region contains point ids[i] of
+// the array xyz of dim-dimensional points, through the batched inside
+// test on chunks of the points (on several threads for long lists).
+// An exception thrown by the region on any thread is rethrown here
+
+void region_contains(JaliGeometry::RegionPtr const region, int const dim,
+                     std::vector<double> const& xyz,
+                     Entity_ID_List const& ids,
+                     std::vector<std::uint8_t> *inside) {
+  int n = ids.size();
+  inside->assign(n, 0);
+  int nhw = static_cast<int>(std::thread::hardware_concurrency());
+  int nthreads = std::max(1, std::min(nhw, n/kMinPointsPerThread));
+
+  std::vector<std::exception_ptr> errors(nthreads);
+  run_on_threads(nthreads, [&](int t, int nt) {
+      try {
+        int i0 = n*std::int64_t(t)/nt, i1 = n*std::int64_t(t+1)/nt;
+        std::vector<double> chunk(dim*(i1-i0));
+        for (int i = i0; i < i1; i++)
+          std::copy(&xyz[dim*ids[i]], &xyz[dim*ids[i]]+dim,
+                    &chunk[dim*(i-i0)]);
+        region->inside(chunk.data(), i1-i0, dim, inside->data()+i0);
+      } catch (...) {
+        errors[t] = std::current_exception();
+      }
+    });
+  for (auto const& e : errors)
+    if (e) std::rethrow_exception(e);
+}
+
+}  // namespace
+
+
+// Initialize mesh sets from regions (default behavior for all cells)
+
+void Mesh::init_sets_from_geometric_model() {
+  std::map<std::string, std::vector<Entity_kind>> empty_map;
+  init_sets_from_geometric_model(empty_map);
+}
+
+
+
+// Initialize mesh sets from regions
+
+// @param region_entity_kinds_map    Map from region names to the kinds
+// of entities we want to retrieve on them - empty map means that we
+// will try to ask for default kinds of entities on each region (if
+// possible - labeled sets are tied to specific Entity_kind)
+
+void Mesh::init_sets_from_geometric_model(
+    std::map<std::string, std::vector<Entity_kind>> region_to_entity_kinds_map
+                                          ) {
+  std::map<Entity_kind, std::vector<std::string>> requested;
+  geometric_model_sets(region_to_entity_kinds_map, &requested);
+
+  for (auto const& kind_names : requested)
+    build_sets_from_regions(kind_names.second, kind_names.first, false);
+}  // init_sets_from_geometric_model (must be called before querying sets from regions)
+
+
+// Register mesh sets on regions to be built on first query (default
+// behavior for all regions)
+
+void Mesh::register_sets_from_geometric_model() {
+  std::map<std::string, std::vector<Entity_kind>> empty_map;
+  register_sets_from_geometric_model(empty_map);
+}
+
+
+// Register mesh sets on regions to be built on first query
+
+void Mesh::register_sets_from_geometric_model(
+    std::map<std::string, std::vector<Entity_kind>> region_to_entity_kinds_map
+                                              ) {
+  std::map<Entity_kind, std::vector<std::string>> requested;
+  geometric_model_sets(region_to_entity_kinds_map, &requested);
+
+  std::lock_guard<std::recursive_mutex> lock(meshsets_mutex_);
+  for (auto const& kind_names : requested)
+    for (auto const& name : kind_names.second)
+      registered_meshsets_.emplace(name, kind_names.first);
+}
+
+
+// Build registered sets now - the named ones of 'kind' (of any kind
+// if kind is ANY_KIND) or all of them if no names are given
+
+void Mesh::prefetch_sets(std::vector<std::string> const& setnames,
+                         const Entity_kind kind) {
+  std::lock_guard<std::recursive_mutex> lock(meshsets_mutex_);
+
+  // Take the sets off the register first so that they are built
+  // together rather than one by one on lookup
+
+  std::map<Entity_kind, std::vector<std::string>> requested;
+  for (auto it = registered_meshsets_.begin();
+       it != registered_meshsets_.end();) {
+    bool wanted = (kind == Entity_kind::ANY_KIND || it->second == kind) &&
+        (setnames.empty() ||
+         std::find(setnames.begin(), setnames.end(), it->first) !=
+         setnames.end());
+    if (wanted) {
+      requested[it->second].push_back(it->first);
+      it = registered_meshsets_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  for (auto const& kind_names : requested)
+    build_sets_from_regions(kind_names.second, kind_names.first, false);
+}
+
+
+// Names of the regions to make sets on, by entity kind, for
+// init_sets_from_geometric_model and register_sets_from_geometric_model
+// (sets that are already built are left out)
+
+// @param region_entity_kinds_map    Map from region names to the kinds
+// of entities we want to retrieve on them - empty map means that we
+// will try to ask for default kinds of entities on each region (if
+// possible - labeled sets are tied to specific Entity_kind)
+
+void Mesh::geometric_model_sets(
+    std::map<std::string, std::vector<Entity_kind>> const&
+    region_to_entity_kinds_map,
+    std::map<Entity_kind, std::vector<std::string>> *requested) const {
+  if (!geometric_model_) return;
 
   std::map<std::string, Entity_kind> str_to_kind = {
       {"CELL", Entity_kind::CELL},
@@ -2394,16 +3272,16 @@ void Mesh::init_sets_from_geometric_model(
       if (pos != std::string::npos) pos += 2; else pos = 0;
       Entity_kind entity_kind = str_to_kind.at(entity_type.substr(pos));
 
-      auto mset = find_meshset(rgn->name(), entity_kind);
+      auto mset = built_meshset(rgn->name(), entity_kind);
       if (mset) continue;
       
-      mset = build_set_from_region(rgn->name(), entity_kind, false);
+      (*requested)[entity_kind].push_back(rgn->name());
 
     } else {
       // We have to account for users querying any type of entity on
       // the region
 
-      auto mset = find_meshset(rgn->name(), Entity_kind::CELL);
+      auto mset = built_meshset(rgn->name(), Entity_kind::CELL);
       if (mset) continue;
 
       
@@ -2448,21 +3326,23 @@ void Mesh::init_sets_from_geometric_model(
       }
 
       for (Entity_kind entity_kind : entity_kinds)
-        mset = build_set_from_region(rgn->name(), entity_kind, false);
+        (*requested)[entity_kind].push_back(rgn->name());
     }
   }
-}  // init_sets_from_geometric_model (must be called before querying sets from regions)
+}  // geometric_model_sets
 
 
 // Add a meshset to the mesh
 
 void Mesh::add_set(std::shared_ptr<MeshSet> set) {
+  std::lock_guard<std::recursive_mutex> lock(meshsets_mutex_);
   meshsets_.push_back(set);
 }
 
 // Number of sets on entities of 'kind'
 
 int Mesh::num_sets(const Entity_kind kind) const {
+  std::lock_guard<std::recursive_mutex> lock(meshsets_mutex_);
   if (kind == Entity_kind::ANY_KIND)
     return meshsets_.size();
   else {
@@ -2478,6 +3358,7 @@ int Mesh::num_sets(const Entity_kind kind) const {
 // Return a list of sets on entities of 'kind'
 
 std::vector<std::shared_ptr<MeshSet>> Mesh::sets(const Entity_kind kind) const {
+  std::lock_guard<std::recursive_mutex> lock(meshsets_mutex_);
   if (kind == Entity_kind::ANY_KIND)
     return meshsets_;
   else {
@@ -2489,9 +3370,10 @@ std::vector<std::shared_ptr<MeshSet>> Mesh::sets(const Entity_kind kind) const {
   }
 }
 
-// Return a list of sets on entities of 'kind'
+// Return a list of all sets
 
-std::vector<std::shared_ptr<MeshSet>> const& Mesh::sets() const {
+std::vector<std::shared_ptr<MeshSet>> Mesh::sets() const {
+  std::lock_guard<std::recursive_mutex> lock(meshsets_mutex_);
   return meshsets_;
 }
 
@@ -2561,10 +3443,8 @@ Mesh::find_meshset_from_region(std::string regname, const Entity_kind kind,
   assert(true && "Deprecated - Initialize sets using init_sets_from_geometric_model and then query specific sets using find_meshset");
   
   if (valid_region_name(regname, kind)) {
-    for (auto const& set : meshsets_) {
-      if (set->name() == regname && set->kind() == kind)
-        return set;
-    }
+    std::shared_ptr<MeshSet> set = find_meshset(regname, kind);
+    if (set) return set;
     if (create_if_missing)
       return build_set_from_region(regname, kind);
   }
@@ -2579,20 +3459,43 @@ Mesh::find_meshset_from_region(std::string regname, const Entity_kind kind)
     const {
   assert(true && "Deprecated - Initialize sets using init_sets_from_geometric_model and then query specific sets using find_meshset");
   
-  if (valid_region_name(regname, kind)) {
-    for (auto const& set : meshsets_) {
-      if (set->name() == regname && set->kind() == kind)
-        return set;
-    }
-  }
+  if (valid_region_name(regname, kind))
+    return find_meshset(regname, kind);
   return nullptr;
 }
 
 
-// Find a meshset with 'setname' containing entities of 'kind'
+// Find a meshset with 'setname' containing entities of 'kind',
+// building it if it was registered and this is its first query
 
 std::shared_ptr<MeshSet> Mesh::find_meshset(const std::string setname,
                                             const Entity_kind kind) const {
+  std::lock_guard<std::recursive_mutex> lock(meshsets_mutex_);
+  std::shared_ptr<MeshSet> mset = built_meshset(setname, kind);
+  if (mset) return mset;
+
+  // Take the set off the register while it is built so that lookups
+  // made in building it do not build it again. Building a set adds it
+  // to the mesh but does not change the mesh otherwise
+
+  if (!registered_meshsets_.erase(std::make_pair(setname, kind)))
+    return nullptr;
+  try {
+    mset = const_cast<Mesh *>(this)->build_set_from_region(setname, kind,
+                                                           false);
+  } catch (...) {
+    registered_meshsets_.emplace(setname, kind);
+    throw;
+  }
+  return mset;
+}
+
+// Meshset with 'setname' containing entities of 'kind' if it has
+// been built
+
+std::shared_ptr<MeshSet> Mesh::built_meshset(const std::string& setname,
+                                             const Entity_kind kind) const {
+  std::lock_guard<std::recursive_mutex> lock(meshsets_mutex_);
   for (auto const& set : meshsets_) {
     if (set->name() == setname && set->kind() == kind)
       return set;
@@ -2651,7 +3554,6 @@ std::shared_ptr<MeshSet> Mesh::build_set_from_region(const std::string setname,
                                                      const Entity_kind kind,
                                                      const bool with_reverse_map) {
 
-  int celldim = Mesh::manifold_dimension();
   int spacedim = Mesh::space_dimension();
 
   // Is there an appropriate region by this name?
@@ -2668,6 +3570,21 @@ std::shared_ptr<MeshSet> Mesh::build_set_from_region(const std::string setname,
     Exceptions::Jali_throw(mesg);
   }
 
+  // Sets from point tests at centroids or nodes go through the
+  // batched evaluation
+
+  if (batched_region(region, kind)) {
+    std::vector<Entity_ID_List> owned, ghost;
+    region_entities({region}, kind, &owned, &ghost);
+    return make_meshset(setname, *this, kind, owned[0], ghost[0],
+                        with_reverse_map);
+  }
+
+  // Sets on logical regions are evaluated from their components
+
+  if (region->type() == JaliGeometry::Region_type::LOGICAL)
+    return logical_region_sets({region}, kind, with_reverse_map)[0];
+
   // Create entity set based on the region defintion
   std::shared_ptr<MeshSet> mset;
   switch (kind) {
@@ -2675,8 +3592,7 @@ std::shared_ptr<MeshSet> Mesh::build_set_from_region(const std::string setname,
 
       Entity_ID_List owned_cells, ghost_cells;
 
-      if (region->type() == JaliGeometry::Region_type::BOX ||
-          region->type() == JaliGeometry::Region_type::COLORFUNCTION) {
+      if (region->type() == JaliGeometry::Region_type::COLORFUNCTION) {
 
         int ncell_owned = Mesh::num_entities(Entity_kind::CELL,
                                              Entity_type::PARALLEL_OWNED);
@@ -2694,30 +3610,12 @@ std::shared_ptr<MeshSet> Mesh::build_set_from_region(const std::string setname,
                             owned_cells, ghost_cells, with_reverse_map);
 
       } else if (region->type() == JaliGeometry::Region_type::POINT) {
-        JaliGeometry::Point vpnt(spacedim);
         JaliGeometry::Point rgnpnt(spacedim);
 
         rgnpnt = ((JaliGeometry::PointRegionPtr)region)->point();
 
-        int nnode = Mesh::num_entities(Entity_kind::NODE,
-                                       Entity_type::ALL);
-
-        double mindist2 = 1.e+16;
-        int minnode = -1;
-        for (int inode = 0; inode < nnode; inode++) {
-          node_get_coordinates(inode, &vpnt);
-
-          double dist2 = (vpnt-rgnpnt)*(vpnt-rgnpnt);
-          if (dist2 < mindist2) {
-            mindist2 = dist2;
-            minnode = inode;
-            if (mindist2 <= 1.0e-32)
-              break;
-          }
-        }
-
         Entity_ID_List cells1;
-        node_get_cells(minnode, Entity_type::ALL, &cells1);
+        cells_intersecting_box(rgnpnt, rgnpnt, &cells1);
 
         int ncells = cells1.size();
         for (int ic = 0; ic < ncells; ic++) {
@@ -2736,41 +3634,6 @@ std::shared_ptr<MeshSet> Mesh::build_set_from_region(const std::string setname,
         mset = make_meshset(setname, *this, Entity_kind::CELL,
                             owned_cells, ghost_cells, with_reverse_map);
 
-      } else if (region->type() == JaliGeometry::Region_type::PLANE) {
-
-        if (celldim == 2) {
-
-          int ncells = Mesh::num_entities(Entity_kind::CELL,
-                                          Entity_type::ALL);
-          for (int ic = 0; ic < ncells; ic++) {
-
-            std::vector<JaliGeometry::Point> ccoords(spacedim);
-
-            cell_get_coordinates(ic, &ccoords);
-
-            bool on_plane = true;
-            for (int j = 0; j < ccoords.size(); ++j) {
-              if (!region->inside(ccoords[j])) {
-                on_plane = false;
-                break;
-              }
-            }
-
-            if (on_plane) {
-              Entity_type ctype = entity_get_type(Entity_kind::CELL, ic);
-              if (ctype == Entity_type::PARALLEL_OWNED)
-                owned_cells.push_back(ic);
-              else if (ctype == Entity_type::PARALLEL_GHOST)
-                ghost_cells.push_back(ic);
-            }
-          }
-        }
-
-        mset = make_meshset(setname, *this, Entity_kind::CELL,
-                            owned_cells, ghost_cells, with_reverse_map);
-
-      } else if (region->type() == JaliGeometry::Region_type::LOGICAL) {
-        // will process later in this subroutine
       } else if (region->type() == JaliGeometry::Region_type::LABELEDSET) {
         // Just retrieve and return the set
         
@@ -2811,57 +3674,7 @@ std::shared_ptr<MeshSet> Mesh::build_set_from_region(const std::string setname,
 
       Entity_ID_List owned_faces, ghost_faces;
 
-      if (region->type() == JaliGeometry::Region_type::BOX)  {
-
-        int nface = Mesh::num_entities(Entity_kind::FACE,
-                                       Entity_type::ALL);
-
-        for (int iface = 0; iface < nface; iface++) {
-          JaliGeometry::Point fcen = face_centroid(iface);
-          if (region->inside(face_centroid(iface))) {
-            Entity_type ftype = entity_get_type(Entity_kind::FACE, iface);
-            if (ftype == Entity_type::PARALLEL_OWNED)
-              owned_faces.push_back(iface);
-            else if (ftype == Entity_type::PARALLEL_GHOST)
-              ghost_faces.push_back(iface);
-          }
-        }
-
-        mset = make_meshset(setname, *this, Entity_kind::FACE,
-                            owned_faces, ghost_faces, with_reverse_map);
-        
-      } else if (region->type() == JaliGeometry::Region_type::PLANE ||
-                 region->type() == JaliGeometry::Region_type::POLYGON) {
-
-        int nface = Mesh::num_entities(Entity_kind::FACE,
-                                       Entity_type::ALL);
-
-        for (int iface = 0; iface < nface; iface++) {
-          std::vector<JaliGeometry::Point> fcoords(spacedim);
-
-          face_get_coordinates(iface, &fcoords);
-
-          bool on_plane = true;
-          for (int j = 0; j < fcoords.size(); ++j) {
-            if (!region->inside(fcoords[j])) {
-              on_plane = false;
-              break;
-            }
-          }
-
-          if (on_plane) {
-            Entity_type ftype = entity_get_type(Entity_kind::FACE, iface);
-            if (ftype == Entity_type::PARALLEL_OWNED)
-              owned_faces.push_back(iface);
-            else if (ftype == Entity_type::PARALLEL_GHOST)
-              ghost_faces.push_back(iface);
-          }
-        }
-
-        mset = make_meshset(setname, *this, Entity_kind::FACE,
-                            owned_faces, ghost_faces, with_reverse_map);
-
-      } else if (region->type() == JaliGeometry::Region_type::LABELEDSET) {
+      if (region->type() == JaliGeometry::Region_type::LABELEDSET) {
         // Just retrieve and return the set
 
         JaliGeometry::LabeledSetRegionPtr lsrgn =
@@ -2879,8 +3692,6 @@ std::shared_ptr<MeshSet> Mesh::build_set_from_region(const std::string setname,
         mset = make_meshset(setname, *this, Entity_kind::FACE,
                             owned_faces, ghost_faces, with_reverse_map);
 
-      } else if (region->type() == JaliGeometry::Region_type::LOGICAL) {
-        // Will handle it later in the routine
       } else {
         Errors::Message mesg("Region type not applicable/supported for face sets");
         Exceptions::Jali_throw(mesg);
@@ -2892,16 +3703,14 @@ std::shared_ptr<MeshSet> Mesh::build_set_from_region(const std::string setname,
 
       std::vector<int> owned_nodes, ghost_nodes;
 
-      if (region->type() == JaliGeometry::Region_type::BOX ||
-          region->type() == JaliGeometry::Region_type::PLANE ||
-          region->type() == JaliGeometry::Region_type::POLYGON ||
-          region->type() == JaliGeometry::Region_type::POINT) {
-
-        int nnode = Mesh::num_entities(Entity_kind::NODE,
-                                       Entity_type::ALL);
+      if (region->type() == JaliGeometry::Region_type::POINT) {
 
-        for (int inode = 0; inode < nnode; inode++) {
+        // Only one node per point region - the nearest one if it is
+        // in the region
 
+        int inode = nearest_node(
+            ((JaliGeometry::PointRegionPtr)region)->point());
+        if (inode >= 0) {
           JaliGeometry::Point vpnt(spacedim);
           node_get_coordinates(inode, &vpnt);
 
@@ -2911,10 +3720,6 @@ std::shared_ptr<MeshSet> Mesh::build_set_from_region(const std::string setname,
               owned_nodes.push_back(inode);
             else if (ntype == Entity_type::PARALLEL_GHOST)
               ghost_nodes.push_back(inode);
-
-            // Only one node per point region
-            if (region->type() == JaliGeometry::Region_type::POINT)
-              break;
           }
         }
 
@@ -2939,8 +3744,6 @@ std::shared_ptr<MeshSet> Mesh::build_set_from_region(const std::string setname,
         mset = make_meshset(setname, *this, Entity_kind::NODE,
                             owned_nodes, ghost_nodes, with_reverse_map);
 
-      } else if (region->type() == JaliGeometry::Region_type::LOGICAL) {
-        // We will handle it later in the routine
       } else {
         Errors::Message mesg("Region type not applicable/supported for node sets");
         Exceptions::Jali_throw(mesg);
@@ -2951,75 +3754,392 @@ std::shared_ptr<MeshSet> Mesh::build_set_from_region(const std::string setname,
     default: {}
   }
 
+  return mset;
+}  // build_set_from_region
+
 
-  if (region->type() == JaliGeometry::Region_type::LOGICAL) {
-    JaliGeometry::LogicalRegionPtr boolregion =
-        (JaliGeometry::LogicalRegionPtr) region;
-    std::vector<std::string> region_names = boolregion->component_regions();
-    int nreg = region_names.size();
+// Build the sets on several regions together. The batched regions
+// are done first so that logical regions find their components
 
-    std::vector<std::shared_ptr<MeshSet>> msets;
-    std::vector<JaliGeometry::RegionPtr> regions;
+std::vector<std::shared_ptr<MeshSet>>
+Mesh::build_sets_from_regions(std::vector<std::string> const& setnames,
+                              const Entity_kind kind,
+                              const bool with_reverse_map) {
+  JaliGeometry::GeometricModelPtr gm = Mesh::geometric_model();
+  int nsets = setnames.size();
+  std::vector<std::shared_ptr<MeshSet>> msets(nsets);
+
+  std::vector<JaliGeometry::RegionPtr> regions, logical_regions;
+  std::vector<int> batched, logical;
+  std::map<std::string, int> first;  // first request for each name
+  for (int i = 0; i < nsets; i++) {
+    msets[i] = find_meshset(setnames[i], kind);
+    if (msets[i] || !first.emplace(setnames[i], i).second) continue;
+
+    JaliGeometry::RegionPtr region = gm ? gm->FindRegion(setnames[i]) :
+        nullptr;
+    if (region && batched_region(region, kind)) {
+      regions.push_back(region);
+      batched.push_back(i);
+    } else if (region &&
+               region->type() == JaliGeometry::Region_type::LOGICAL) {
+      logical_regions.push_back(region);
+      logical.push_back(i);
+    }
+  }
 
-    for (int r = 0; r < nreg; r++) {
-      JaliGeometry::RegionPtr rgn1 = gm->FindRegion(region_names[r]);
-      regions.push_back(rgn1);
+  std::vector<Entity_ID_List> owned, ghost;
+  region_entities(regions, kind, &owned, &ghost);
+  for (int r = 0; r < regions.size(); r++)
+    msets[batched[r]] = make_meshset(setnames[batched[r]], *this, kind,
+                                     owned[r], ghost[r], with_reverse_map);
+
+  if (!logical_regions.empty()) {
+    std::vector<std::shared_ptr<MeshSet>> logical_sets =
+        logical_region_sets(logical_regions, kind, with_reverse_map);
+    for (int r = 0; r < logical_regions.size(); r++)
+      msets[logical[r]] = logical_sets[r];
+  }
 
-      // Did not find the region
-      if (rgn1 == NULL) {
-        std::stringstream mesg_stream;
-        mesg_stream << "Geometric model has no region named " <<
-          region_names[r];
-        Errors::Message mesg(mesg_stream.str());
+  for (int i = 0; i < nsets; i++) {
+    if (msets[i]) continue;
+    int i0 = first.at(setnames[i]);
+    if (!msets[i0])
+      msets[i0] = build_set_from_region(setnames[i0], kind, with_reverse_map);
+    msets[i] = msets[i0];
+  }
+  return msets;
+}
+
+
+// Sets on logical regions, evaluated together as a DAG of set
+// expressions. Regions used by several logical regions, and logical
+// regions that are the same expression (the same operation on the
+// same regions in any order, where the order does not matter), are
+// evaluated once. The expressions are evaluated on masks over the
+// entities, all the expressions at one depth on several threads.
+// As with sets built one at a time, the sets on the primitive
+// regions at the leaves and on the logical regions in between are
+// added to the mesh, except for TEMPORARY logical regions that were
+// not asked for
+
+std::vector<std::shared_ptr<MeshSet>>
+Mesh::logical_region_sets(std::vector<JaliGeometry::RegionPtr> const& regions,
+                          const Entity_kind kind,
+                          const bool with_reverse_map) {
+  JaliGeometry::GeometricModelPtr gm = Mesh::geometric_model();
+  int nents = num_entities(kind, Entity_type::ALL);
+
+  struct Expression {
+    JaliGeometry::RegionPtr region;  // first region found to be this
+    JaliGeometry::Bool_type operation = JaliGeometry::Bool_type::UNION;
+    std::vector<int> operands;       // none for the leaves
+    int depth = 0;                   // 0 for the leaves
+    std::shared_ptr<MeshSet> set;    // of the leaves
+    std::vector<std::uint8_t> mask;  // is each entity in the set
+  };
+  std::vector<Expression> exprs;
+  std::map<std::string, int> expr_of_region;
+  std::map<std::vector<int>, int> expr_of_key;  // operation and operands
+
+  // Add the expression of a region (and those of its components) to
+  // the DAG, or find it there. Logical regions with sets on the mesh
+  // are leaves
+
+  std::function<int(std::string const&)> add_region =
+      [&](std::string const& name) -> int {
+    auto it = expr_of_region.find(name);
+    if (it != expr_of_region.end()) {
+      if (it->second < 0) {
+        Errors::Message mesg("Logical region " + name +
+                             " is defined in terms of itself");
         Exceptions::Jali_throw(mesg);
       }
+      return it->second;
+    }
+
+    JaliGeometry::RegionPtr region = gm->FindRegion(name);
+    if (region == NULL) {
+      Errors::Message mesg("Geometric model has no region named " + name);
+      Exceptions::Jali_throw(mesg);
+    }
+    expr_of_region[name] = -1;  // until its components are added
+
+    Expression expr;
+    expr.region = region;
+    int iexpr;
+    if (region->type() == JaliGeometry::Region_type::LOGICAL &&
+        !find_meshset(name, kind)) {
+      JaliGeometry::LogicalRegionPtr boolregion =
+          (JaliGeometry::LogicalRegionPtr) region;
+      expr.operation = boolregion->operation();
+      for (auto const& component : boolregion->component_regions())
+        expr.operands.push_back(add_region(component));
+
+      // Only the first operand of a subtraction is special
+
+      auto others = expr.operands.begin();
+      if (expr.operation == JaliGeometry::Bool_type::SUBTRACT &&
+          others != expr.operands.end())
+        ++others;
+      std::sort(others, expr.operands.end());
+      expr.operands.erase(std::unique(others, expr.operands.end()),
+                          expr.operands.end());
+
+      std::vector<int> key(1, static_cast<int>(expr.operation));
+      key.insert(key.end(), expr.operands.begin(), expr.operands.end());
+      auto found = expr_of_key.find(key);
+      if (found != expr_of_key.end()) {
+        iexpr = found->second;
+      } else {
+        for (auto const& op : expr.operands)
+          expr.depth = std::max(expr.depth, exprs[op].depth + 1);
+        iexpr = exprs.size();
+        exprs.push_back(expr);
+        expr_of_key[key] = iexpr;
+      }
+    } else {
+      iexpr = exprs.size();
+      exprs.push_back(expr);
+    }
+    expr_of_region[name] = iexpr;
+    return iexpr;
+  };
+
+  std::map<std::string, std::vector<int>> requested;
+  for (int r = 0; r < regions.size(); r++) {
+    add_region(regions[r]->name());
+    requested[regions[r]->name()].push_back(r);
+  }
 
-      std::shared_ptr<MeshSet> mset1 =
-          Mesh::find_meshset(region_names[r], kind);
-      if (!mset1)
-        mset1 = build_set_from_region(region_names[r], kind, with_reverse_map);
-      assert(mset1);
-      msets.push_back(mset1);
+  // Sets on the leaves - point tested regions are done together
+
+  std::vector<JaliGeometry::RegionPtr> batch;
+  std::vector<int> batch_exprs;
+  for (int e = 0; e < exprs.size(); e++) {
+    Expression& expr = exprs[e];
+    if (expr.depth) continue;
+    std::string name = expr.region->name();
+    expr.set = find_meshset(name, kind);
+    if (!expr.set && batched_region(expr.region, kind)) {
+      batch.push_back(expr.region);
+      batch_exprs.push_back(e);
+    } else if (!expr.set) {
+      expr.set = build_set_from_region(name, kind, with_reverse_map);
     }
+  }
+  std::vector<Entity_ID_List> owned, ghost;
+  region_entities(batch, kind, &owned, &ghost);
+  for (int b = 0; b < batch.size(); b++)
+    exprs[batch_exprs[b]].set = make_meshset(batch[b]->name(), *this, kind,
+                                             owned[b], ghost[b],
+                                             with_reverse_map);
+
+  int maxdepth = 0;
+  for (auto& expr : exprs) {
+    maxdepth = std::max(maxdepth, expr.depth);
+    if (expr.depth) continue;
+    expr.mask.assign(nents, 0);
+    if (expr.set)
+      for (auto const& ent : expr.set->entities<Entity_type::ALL>())
+        expr.mask[ent] = 1;
+  }
 
-    // Check the entity types of the sets are consistent with the
-    // entity type of the requested set
+  // Evaluate the expressions depth by depth. The masks are 0 or 1 so
+  // bitwise operations combine them
+
+  auto evaluate = [&](Expression& expr) {
+    expr.mask.assign(nents, 0);
+    for (int k = 0; k < expr.operands.size(); k++) {
+      std::vector<std::uint8_t> const& m = exprs[expr.operands[k]].mask;
+      if (k == 0)
+        expr.mask = m;
+      else if (expr.operation == JaliGeometry::Bool_type::INTERSECT)
+        for (int i = 0; i < nents; i++) expr.mask[i] &= m[i];
+      else if (expr.operation == JaliGeometry::Bool_type::SUBTRACT)
+        for (int i = 0; i < nents; i++) expr.mask[i] &= m[i] ^ 1;
+      else  // UNION and COMPLEMENT (of the union)
+        for (int i = 0; i < nents; i++) expr.mask[i] |= m[i];
+    }
+    if (expr.operation == JaliGeometry::Bool_type::COMPLEMENT)
+      for (int i = 0; i < nents; i++) expr.mask[i] ^= 1;
+  };
+
+  int nhw = static_cast<int>(std::thread::hardware_concurrency());
+  for (int depth = 1; depth <= maxdepth; depth++) {
+    std::vector<int> todo;
+    for (int e = 0; e < exprs.size(); e++)
+      if (exprs[e].depth == depth) todo.push_back(e);
+    int ntodo = todo.size();
+    int nthreads = (nents < kMinPointsPerThread) ? 1 :
+        std::max(1, std::min(nhw, ntodo));
+    run_on_threads(nthreads, [&](int t, int nt) {
+        for (int k = t; k < ntodo; k += nt)
+          evaluate(exprs[todo[k]]);
+      });
+  }
 
-    for (int ms = 0; ms < msets.size(); ms++)
-      if (msets[ms]->kind() != kind) {
-        Errors::Message
-          mesg("Jali cannot operate on sets of different entity types");
-        Exceptions::Jali_throw(mesg);
+  // Sets on the logical regions (under the names of all the regions
+  // that are the same expression)
+
+  std::vector<std::shared_ptr<MeshSet>> msets(regions.size());
+  for (auto const& region_expr : expr_of_region) {
+    std::string const& name = region_expr.first;
+    Expression const& expr = exprs[region_expr.second];
+    auto it = requested.find(name);
+
+    std::shared_ptr<MeshSet> mset = expr.set;
+    if (expr.depth) {
+      bool temporary = (gm->FindRegion(name)->lifecycle() ==
+                        JaliGeometry::LifeCycle_type::TEMPORARY);
+      if (temporary && it == requested.end()) continue;
+
+      Entity_ID_List owned_ents, ghost_ents;
+      for (int i = 0; i < nents; i++) {
+        if (!expr.mask[i]) continue;
+        Entity_type etype = entity_get_type(kind, i);
+        if (etype == Entity_type::PARALLEL_OWNED)
+          owned_ents.push_back(i);
+        else if (etype == Entity_type::PARALLEL_GHOST)
+          ghost_ents.push_back(i);
       }
+      if (temporary)
+        mset = std::make_shared<MeshSet>(name, *this, kind, owned_ents,
+                                         ghost_ents, with_reverse_map);
+      else
+        mset = make_meshset(name, *this, kind, owned_ents, ghost_ents,
+                            with_reverse_map);
+    }
 
+    if (it != requested.end())
+      for (auto const& r : it->second)
+        msets[r] = mset;
+  }
+  return msets;
+}
 
-    bool temporary = 
-        (boolregion->lifecycle() == JaliGeometry::LifeCycle_type::TEMPORARY) ?
-        true :
-        false;
 
-    if (boolregion->operation() == JaliGeometry::Bool_type::COMPLEMENT)
-      mset = complement(msets, temporary);
-    else if (boolregion->operation() == JaliGeometry::Bool_type::UNION)
-      mset = merge(msets, temporary);
-    else if (boolregion->operation() == JaliGeometry::Bool_type::INTERSECT)
-      mset = intersect(msets, temporary);
-    else if (boolregion->operation() == JaliGeometry::Bool_type::SUBTRACT) {
-      std::vector<std::shared_ptr<MeshSet>> msets1;
-      for (auto const& set : msets)
-        if (set != msets[0]) msets1.push_back(set);
-      mset = subtract(msets[0], msets1, temporary);      
+// Entities of 'kind' in each region, tested at the centroids (box
+// regions on cells and faces) or at the nodes (everything else -
+// cells in 2D and faces are in the region if all their nodes are). The
+// points are gathered once for all the regions and bounded regions
+// are only tested at the entities the spatial indices find near them
+
+void Mesh::region_entities(std::vector<JaliGeometry::RegionPtr> const& regions,
+                           const Entity_kind kind,
+                           std::vector<Entity_ID_List> *owned,
+                           std::vector<Entity_ID_List> *ghost) const {
+  int dim = space_dim_;
+  int nregions = regions.size();
+  owned->assign(nregions, Entity_ID_List());
+  ghost->assign(nregions, Entity_ID_List());
+
+  int nents = num_entities(kind, Entity_type::ALL);
+  int nnodes = num_entities(Entity_kind::NODE, Entity_type::ALL);
+  std::vector<double> centroids, nodexyz;
+
+  for (int r = 0; r < nregions; r++) {
+    JaliGeometry::RegionPtr region = regions[r];
+    bool at_centroids = (kind != Entity_kind::NODE &&
+                         region->type() == JaliGeometry::Region_type::BOX);
+
+    // Cells are only on planes in 2D
+    if (kind == Entity_kind::CELL && !at_centroids && manifold_dim_ != 2)
+      continue;
+
+    // Entities to test
+
+    Entity_ID_List candidates;
+    double lo[3], hi[3];
+    if (!region_bounds(region, dim, lo, hi)) {
+      candidates.resize(nents);
+      for (int i = 0; i < nents; i++)
+        candidates[i] = i;
+    } else if (kind == Entity_kind::NODE) {
+      node_bvh().for_each_overlapping(lo, hi, [&](int n) {
+          candidates.push_back(n);
+        });
+      std::sort(candidates.begin(), candidates.end());
+    } else {
+      JaliGeometry::Point plo(dim), phi(dim);
+      plo.set(dim, lo);
+      phi.set(dim, hi);
+      cells_intersecting_box(plo, phi, &candidates);
+      if (kind == Entity_kind::FACE) {
+        Entity_ID_List cfaces, faces;
+        for (auto const& c : candidates) {
+          cell_get_faces(c, &cfaces);
+          faces.insert(faces.end(), cfaces.begin(), cfaces.end());
+        }
+        std::sort(faces.begin(), faces.end());
+        faces.erase(std::unique(faces.begin(), faces.end()), faces.end());
+        candidates.swap(faces);
+      }
     }
 
-    // While building logical meshsets, the resulting meshset name reflects
-    // the operation but we need it to have the original region name so
-    // we can find it later
-    
-    mset->set_name(setname);
+    // Test them
+
+    std::vector<std::uint8_t> inside;
+    if (at_centroids) {
+      if (centroids.empty()) {
+        centroids.resize(dim*nents);
+        for (int i = 0; i < nents; i++) {
+          JaliGeometry::Point cen = (kind == Entity_kind::CELL) ?
+              cell_centroid(i) : face_centroid(i);
+          std::copy(&cen[0], &cen[0]+dim, &centroids[dim*i]);
+        }
+      }
+      region_contains(region, dim, centroids, candidates, &inside);
+    } else {
+      if (nodexyz.empty()) {
+        nodexyz.resize(dim*nnodes);
+        JaliGeometry::Point xyz;
+        for (int n = 0; n < nnodes; n++) {
+          node_get_coordinates(n, &xyz);
+          std::copy(&xyz[0], &xyz[0]+dim, &nodexyz[dim*n]);
+        }
+      }
+
+      if (kind == Entity_kind::NODE) {
+        region_contains(region, dim, nodexyz, candidates, &inside);
+      } else {
+        Entity_ID_List nodes;
+        std::vector<Entity_ID_List> candnodes(candidates.size());
+        for (int i = 0; i < candidates.size(); i++) {
+          if (kind == Entity_kind::CELL)
+            cell_get_nodes(candidates[i], &candnodes[i]);
+          else
+            face_get_nodes(candidates[i], &candnodes[i]);
+          nodes.insert(nodes.end(), candnodes[i].begin(), candnodes[i].end());
+        }
+        std::sort(nodes.begin(), nodes.end());
+        nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+
+        std::vector<std::uint8_t> nodeinside, node_in(nnodes, 0);
+        region_contains(region, dim, nodexyz, nodes, &nodeinside);
+        for (int i = 0; i < nodes.size(); i++)
+          node_in[nodes[i]] = nodeinside[i];
+
+        inside.assign(candidates.size(), 1);
+        for (int i = 0; i < candidates.size(); i++)
+          for (auto const& n : candnodes[i])
+            if (!node_in[n]) {
+              inside[i] = 0;
+              break;
+            }
+      }
+    }
+
+    for (int i = 0; i < candidates.size(); i++) {
+      if (!inside[i]) continue;
+      Entity_type etype = entity_get_type(kind, candidates[i]);
+      if (etype == Entity_type::PARALLEL_OWNED)
+        (*owned)[r].push_back(candidates[i]);
+      else if (etype == Entity_type::PARALLEL_GHOST)
+        (*ghost)[r].push_back(candidates[i]);
+    }
   }
-   
-  return mset;
-}  // build_set_from_region
+}
 
 
 
@@ -3078,15 +4198,163 @@ bool Mesh::point_in_cell(const JaliGeometry::Point &p,
 }
 
 
+// Point location through the spatial indices
+
+Entity_ID Mesh::locate_point(const JaliGeometry::Point &p) const {
+  Entity_ID_List candidates;
+  cells_intersecting_box(p, p, &candidates);
+  for (auto const& c : candidates)
+    if (point_in_cell(p, c)) return c;
+  return -1;
+}
+
+
+Entity_ID Mesh::nearest_node(const JaliGeometry::Point &p) const {
+  double x[3] = {p[0], space_dim_ > 1 ? p[1] : 0.0,
+                 space_dim_ > 2 ? p[2] : 0.0};
+  return node_bvh().nearest(x, [&](int n) {
+      JaliGeometry::Point xyz;
+      node_get_coordinates(n, &xyz);
+      return L22(xyz - p);
+    });
+}
+
+
+void Mesh::cells_intersecting_box(const JaliGeometry::Point &lo,
+                                  const JaliGeometry::Point &hi,
+                                  Entity_ID_List *cellids) const {
+  double xlo[3], xhi[3];
+  for (int d = 0; d < space_dim_; d++) {
+    xlo[d] = lo[d];
+    xhi[d] = hi[d];
+  }
+  cellids->clear();
+  cell_bvh().for_each_overlapping(xlo, xhi, [&](int c) {
+      cellids->push_back(c);
+    });
+  std::sort(cellids->begin(), cellids->end());
+}
+
+
+// Spatial indices, built by whichever thread first needs them while
+// any others wait (they may be needed while building sets, under the
+// lock on the sets, as well as by unlocked point queries)
+
+BoundingVolumeHierarchy const& Mesh::cell_bvh() const {
+  std::call_once(cell_bvh_once_, [this]() {
+      auto bvh = std::make_shared<BoundingVolumeHierarchy>();
+      bvh->build(space_dim_, cell_bounding_boxes());
+      cell_bvh_ = bvh;
+    });
+  return *cell_bvh_;
+}
+
+
+BoundingVolumeHierarchy const& Mesh::node_bvh() const {
+  std::call_once(node_bvh_once_, [this]() {
+      auto bvh = std::make_shared<BoundingVolumeHierarchy>();
+      bvh->build(space_dim_, node_bounding_boxes());
+      node_bvh_ = bvh;
+    });
+  return *node_bvh_;
+}
+
+
+// Degenerate boxes at the nodes, indexed by node ID
+
+std::vector<double> Mesh::node_bounding_boxes() const {
+  int dim = space_dim_;
+  int nnodes = num_nodes<Entity_type::ALL>();
+  std::vector<double> boxes(2*dim*nnodes);
+  for (int n = 0; n < nnodes; n++) {
+    JaliGeometry::Point xyz;
+    node_get_coordinates(n, &xyz);
+    for (int d = 0; d < dim; d++)
+      boxes[2*dim*n+d] = boxes[2*dim*n+dim+d] = xyz[d];
+  }
+  return boxes;
+}
+
+
+// Bounding boxes of the cells, indexed by cell ID and padded by a
+// small fraction of the extent of the mesh so that points on cell
+// boundaries are found despite roundoff
+
+std::vector<double> Mesh::cell_bounding_boxes() const {
+  int dim = space_dim_;
+  std::vector<double> nodeboxes = node_bounding_boxes();
+
+  double extent = 0.0;
+  if (!nodeboxes.empty())
+    for (int d = 0; d < dim; d++) {
+      double lo = nodeboxes[d], hi = nodeboxes[d];
+      for (std::size_t i = d; i < nodeboxes.size(); i += 2*dim) {
+        lo = std::min(lo, nodeboxes[i]);
+        hi = std::max(hi, nodeboxes[i]);
+      }
+      extent = std::max(extent, hi-lo);
+    }
+  double pad = 1.0e-10*extent;
+
+  Entity_ID_List const& cellids = cells<Entity_type::ALL>();
+  std::vector<int> offsets;
+  Entity_ID_List nodeids;
+  cells_get_nodes(cellids, &offsets, &nodeids);
+
+  std::vector<double> boxes(2*dim*num_cells<Entity_type::ALL>());
+  for (int i = 0; i < static_cast<int>(cellids.size()); i++) {
+    double *box = &(boxes[2*dim*cellids[i]]);
+    for (int d = 0; d < dim; d++) {
+      box[d] = std::numeric_limits<double>::max();
+      box[dim+d] = -std::numeric_limits<double>::max();
+    }
+    for (int j = offsets[i]; j < offsets[i+1]; j++)
+      for (int d = 0; d < dim; d++) {
+        box[d] = std::min(box[d], nodeboxes[2*dim*nodeids[j]+d]);
+        box[dim+d] = std::max(box[dim+d], nodeboxes[2*dim*nodeids[j]+d]);
+      }
+    for (int d = 0; d < dim; d++) {
+      box[d] -= pad;
+      box[dim+d] += pad;
+    }
+  }
+  return boxes;
+}
+
+
 void
 Mesh::get_partitioning(int const num_parts,
                        Partitioner_type const partitioner,
-                       std::vector<std::vector<Entity_ID>> *partitions) {
+                       std::vector<std::vector<Entity_ID>> *partitions,
+                       std::vector<double> const *cell_weights) {
 
+  if (num_parts < 1) {
+    Errors::Message mesg("Mesh::get_partitioning - need at least one part");
+    Exceptions::Jali_throw(mesg);
+  }
+  if (cell_weights &&
+      cell_weights->size() != num_cells<Entity_type::PARALLEL_OWNED>()) {
+    Errors::Message mesg("Mesh::get_partitioning - need one weight per "
+                         "owned cell");
+    Exceptions::Jali_throw(mesg);
+  }
 
+  partitions->clear();
   partitions->resize(num_parts);
 
-  if (partitioner == Partitioner_type::METIS && space_dimension() != 1) {
+  if (partitioner == Partitioner_type::SFC_HILBERT ||
+      partitioner == Partitioner_type::SFC_MORTON) {
+
+    get_partitioning_by_sfc(num_parts,
+                            partitioner == Partitioner_type::SFC_HILBERT,
+                            cell_weights, partitions);
+
+  } else if (partitioner == Partitioner_type::RCB) {
+
+    get_partitioning_by_rcb(num_parts, cell_weights, partitions);
+
+  } else if (partitioner == Partitioner_type::METIS &&
+             space_dimension() != 1) {
 
 #ifdef Jali_HAVE_METIS
 
@@ -3414,6 +4682,548 @@ void Mesh::get_partitioning_by_blocks(int const num_parts,
   }
 }
 
+
+namespace {
+
+// The native partitioners use one thread per core, but no more than
+// one per kMinCellsPerThread cells, so that small meshes (and small
+// tiles) are partitioned serially
+
+constexpr int kMinCellsPerThread = 32768;
+
+int partitioner_threads(int const ncells) {
+  int nhw = static_cast<int>(std::thread::hardware_concurrency());
+  return std::max(1, std::min(nhw, ncells/kMinCellsPerThread));
+}
+
+// Sort [first, last) on nthreads threads: sort equal chunks
+// concurrently, then merge neighbouring chunks pairwise
+
+template<typename RandomIt, typename Compare>
+void threaded_sort(RandomIt first, RandomIt last, Compare comp,
+                   int const nthreads) {
+  std::int64_t n = last - first;
+  if (nthreads < 2 || n < 2*kMinCellsPerThread) {
+    std::sort(first, last, comp);
+    return;
+  }
+
+  std::vector<std::int64_t> bounds(nthreads+1);
+  for (int t = 0; t <= nthreads; t++)
+    bounds[t] = n*t/nthreads;
+
+  run_on_threads(nthreads, [&](int t, int) {
+      std::sort(first + bounds[t], first + bounds[t+1], comp);
+    });
+
+  for (int width = 1; width < nthreads; width *= 2) {
+    std::vector<std::thread> workers;
+    for (int t = 0; t + width < nthreads; t += 2*width) {
+      int t2 = std::min(t + 2*width, nthreads);
+      workers.emplace_back([=]() {
+          std::inplace_merge(first + bounds[t], first + bounds[t+width],
+                             first + bounds[t2], comp);
+        });
+    }
+    for (auto& w : workers)
+      w.join();
+  }
+}
+
+// Interleave the low 'bits' bits of the dim integer coordinates,
+// most significant bit first and axis 0 first (Morton or Z order)
+
+std::uint64_t interleave_bits(int const dim, std::uint32_t const * const x,
+                              int const bits) {
+  std::uint64_t key = 0;
+  for (int b = bits-1; b >= 0; b--)
+    for (int d = 0; d < dim; d++)
+      key = (key << 1) | ((x[d] >> b) & 1u);
+  return key;
+}
+
+// Position along the Hilbert curve of the dim integer coordinates x
+// (overwritten) using Skilling's transpose algorithm ("Programming
+// the Hilbert curve", AIP Conf. Proc. 707, 2004)
+
+std::uint64_t hilbert_key(int const dim, std::uint32_t * const x,
+                          int const bits) {
+  std::uint32_t const m = 1u << (bits-1);
+
+  for (std::uint32_t q = m; q > 1; q >>= 1) {
+    std::uint32_t p = q - 1;
+    for (int d = 0; d < dim; d++) {
+      if (x[d] & q) {
+        x[0] ^= p;
+      } else {
+        std::uint32_t t = (x[0] ^ x[d]) & p;
+        x[0] ^= t;
+        x[d] ^= t;
+      }
+    }
+  }
+
+  for (int d = 1; d < dim; d++)
+    x[d] ^= x[d-1];
+  std::uint32_t t = 0;
+  for (std::uint32_t q = m; q > 1; q >>= 1)
+    if (x[dim-1] & q) t ^= q - 1;
+  for (int d = 0; d < dim; d++)
+    x[d] ^= t;
+
+  return interleave_bits(dim, x, bits);
+}
+
+// Assign cells in the given order to num_parts consecutive parts of
+// (nearly) equal total weight. A cell goes to the part containing the
+// midpoint of its weight interval, so no cell straddles two parts
+
+void split_ordered_cells(std::vector<int> const& order,
+                         std::vector<double> const *cell_weights,
+                         int const part0, int const num_parts,
+                         std::vector<int> *cell_part) {
+  int n = order.size();
+  double total = cell_weights ? 0.0 : n;
+  if (cell_weights)
+    for (auto const& c : order)
+      total += (*cell_weights)[c];
+  if (total <= 0.0) total = 1.0;
+
+  double sum = 0.0;
+  for (int i = 0; i < n; i++) {
+    int c = order[i];
+    double w = cell_weights ? (*cell_weights)[c] : 1.0;
+    int p = static_cast<int>((sum + 0.5*w)/total*num_parts);
+    (*cell_part)[c] = part0 + std::max(0, std::min(p, num_parts-1));
+    sum += w;
+  }
+}
+
+// Bisect the cells [first, last) of 'order' into nparts parts
+// numbered from part0, cutting along the longest axis of their
+// centroid bounding box so that each side carries weight in
+// proportion to its number of parts. Subtrees are handed to new
+// threads while nthreads > 1
+
+void rcb_bisect(int const dim, std::vector<double> const& centroids,
+                std::vector<double> const *cell_weights,
+                std::vector<int>::iterator first,
+                std::vector<int>::iterator last,
+                int const part0, int const nparts, int const nthreads,
+                std::vector<int> *cell_part) {
+  int n = last - first;
+  if (nparts == 1 || n == 0) {
+    for (auto it = first; it != last; ++it)
+      (*cell_part)[*it] = part0;
+    return;
+  }
+
+  double lo[3] = {1e20, 1e20, 1e20}, hi[3] = {-1e20, -1e20, -1e20};
+  for (auto it = first; it != last; ++it) {
+    for (int d = 0; d < dim; d++) {
+      double x = centroids[dim*(*it)+d];
+      lo[d] = std::min(lo[d], x);
+      hi[d] = std::max(hi[d], x);
+    }
+  }
+  int axis = 0;
+  for (int d = 1; d < dim; d++)
+    if (hi[d]-lo[d] > hi[axis]-lo[axis]) axis = d;
+
+  threaded_sort(first, last, [&](int a, int b) {
+      double xa = centroids[dim*a+axis], xb = centroids[dim*b+axis];
+      return xa < xb || (xa == xb && a < b);
+    }, nthreads);
+
+  // Cut where the running weight comes closest to the left share,
+  // leaving at least one cell per part on each side if possible
+
+  int nleft = nparts/2;
+  double total = 0.0;
+  for (auto it = first; it != last; ++it)
+    total += cell_weights ? (*cell_weights)[*it] : 1.0;
+  double target = total*nleft/nparts;
+
+  int cut = 0;
+  double sum = 0.0;
+  for (; cut < n; cut++) {
+    double w = cell_weights ? (*cell_weights)[*(first+cut)] : 1.0;
+    if (sum + 0.5*w > target) break;
+    sum += w;
+  }
+  if (n >= nparts)
+    cut = std::max(nleft, std::min(cut, n - (nparts - nleft)));
+
+  if (nthreads > 1) {
+    int nthreads_left = nthreads/2;
+    std::thread left(rcb_bisect, dim, std::cref(centroids), cell_weights,
+                     first, first + cut, part0, nleft, nthreads_left,
+                     cell_part);
+    rcb_bisect(dim, centroids, cell_weights, first + cut, last,
+               part0 + nleft, nparts - nleft, nthreads - nthreads_left,
+               cell_part);
+    left.join();
+  } else {
+    rcb_bisect(dim, centroids, cell_weights, first, first + cut, part0,
+               nleft, 1, cell_part);
+    rcb_bisect(dim, centroids, cell_weights, first + cut, last,
+               part0 + nleft, nparts - nleft, 1, cell_part);
+  }
+}
+
+// Gather the owned cells into partitions in ascending ID order
+
+void collect_partitions(std::vector<int> const& owned_cells,
+                        std::vector<int> const& cell_part,
+                        std::vector<std::vector<int>> *partitions) {
+  std::vector<int> count(partitions->size(), 0);
+  for (int i = 0; i < owned_cells.size(); i++)
+    count[cell_part[i]]++;
+  for (int p = 0; p < partitions->size(); p++) {
+    (*partitions)[p].clear();
+    (*partitions)[p].reserve(count[p]);
+  }
+  for (int i = 0; i < owned_cells.size(); i++)
+    (*partitions)[cell_part[i]].push_back(owned_cells[i]);
+}
+
+}  // namespace
+
+
+// Partition by ordering the cell centroids along a space filling
+// curve. The centroids are quantized on the bounding box to as many
+// bits per axis as fit in a 64 bit key
+
+void Mesh::get_partitioning_by_sfc(int const num_parts, bool const hilbert,
+                                   std::vector<double> const *cell_weights,
+                                   std::vector<std::vector<int>> *partitions) {
+  std::vector<Entity_ID> const& owned = cells<Entity_type::PARALLEL_OWNED>();
+  int ncells = owned.size();
+  int dim = space_dim_;
+  int nthreads = partitioner_threads(ncells);
+
+  if (!cell_geometry_precomputed) compute_cell_geometric_quantities();
+
+  std::vector<double> lo(nthreads*dim, 1e20), hi(nthreads*dim, -1e20);
+  run_on_threads(nthreads, [&](int t, int nt) {
+      for (int i = ncells*std::int64_t(t)/nt;
+           i < ncells*std::int64_t(t+1)/nt; i++) {
+        JaliGeometry::Point const& p = cell_centroids[owned[i]];
+        for (int d = 0; d < dim; d++) {
+          lo[t*dim+d] = std::min(lo[t*dim+d], p[d]);
+          hi[t*dim+d] = std::max(hi[t*dim+d], p[d]);
+        }
+      }
+    });
+  for (int t = 1; t < nthreads; t++) {
+    for (int d = 0; d < dim; d++) {
+      lo[d] = std::min(lo[d], lo[t*dim+d]);
+      hi[d] = std::max(hi[d], hi[t*dim+d]);
+    }
+  }
+
+  int bits = std::min(31, 63/dim);
+  double scale[3];
+  for (int d = 0; d < dim; d++)
+    scale[d] = (hi[d] > lo[d]) ? ((1u << bits) - 1)/(hi[d] - lo[d]) : 0.0;
+
+  std::vector<std::pair<std::uint64_t, int>> keys(ncells);
+  run_on_threads(nthreads, [&](int t, int nt) {
+      std::uint32_t x[3];
+      for (int i = ncells*std::int64_t(t)/nt;
+           i < ncells*std::int64_t(t+1)/nt; i++) {
+        JaliGeometry::Point const& p = cell_centroids[owned[i]];
+        for (int d = 0; d < dim; d++)
+          x[d] = static_cast<std::uint32_t>((p[d] - lo[d])*scale[d]);
+        keys[i].first = hilbert ? hilbert_key(dim, x, bits) :
+            interleave_bits(dim, x, bits);
+        keys[i].second = i;
+      }
+    });
+
+  threaded_sort(keys.begin(), keys.end(),
+                std::less<std::pair<std::uint64_t, int>>(), nthreads);
+
+  std::vector<int> order(ncells);
+  for (int i = 0; i < ncells; i++)
+    order[i] = keys[i].second;
+
+  std::vector<int> cell_part(ncells);
+  split_ordered_cells(order, cell_weights, 0, num_parts, &cell_part);
+  collect_partitions(owned, cell_part, partitions);
+}
+
+
+// Partition by recursive coordinate bisection of the cell centroids.
+// Each bisection splits the number of parts in half (rounding down
+// on the left) so any number of parts, not just powers of two, is
+// balanced
+
+void Mesh::get_partitioning_by_rcb(int const num_parts,
+                                   std::vector<double> const *cell_weights,
+                                   std::vector<std::vector<int>> *partitions) {
+  std::vector<Entity_ID> const& owned = cells<Entity_type::PARALLEL_OWNED>();
+  int ncells = owned.size();
+  int dim = space_dim_;
+  int nthreads = partitioner_threads(ncells);
+
+  if (!cell_geometry_precomputed) compute_cell_geometric_quantities();
+
+  std::vector<double> centroids(ncells*dim);
+  run_on_threads(nthreads, [&](int t, int nt) {
+      for (int i = ncells*std::int64_t(t)/nt;
+           i < ncells*std::int64_t(t+1)/nt; i++) {
+        JaliGeometry::Point const& p = cell_centroids[owned[i]];
+        for (int d = 0; d < dim; d++)
+          centroids[dim*i+d] = p[d];
+      }
+    });
+
+  std::vector<int> order(ncells);
+  for (int i = 0; i < ncells; i++)
+    order[i] = i;
+
+  std::vector<int> cell_part(ncells);
+  rcb_bisect(dim, centroids, cell_weights, order.begin(), order.end(), 0,
+             num_parts, nthreads, &cell_part);
+  collect_partitions(owned, cell_part, partitions);
+}
+
+
+// Partition the cells of the whole mesh over the ranks along a Hilbert
+// curve. The keys are computed on the global bounding box of the
+// centroids, and the P-1 cuts of the curve are found together by
+// bisecting the key range, with one reduction of the weights below
+// the trial keys per step, so no keys are moved between ranks
+
+void Mesh::get_rank_partitioning(std::vector<double> const *cell_weights,
+                                 std::vector<int> *cell_ranks) const {
+  std::vector<Entity_ID> const& owned = cells<Entity_type::PARALLEL_OWNED>();
+  int ncells = owned.size();
+  if (cell_weights && static_cast<int>(cell_weights->size()) != ncells) {
+    Errors::Message mesg("Mesh::get_rank_partitioning - need one weight "
+                         "per owned cell");
+    Exceptions::Jali_throw(mesg);
+  }
+
+  int nprocs;
+  MPI_Comm_size(comm, &nprocs);
+  cell_ranks->assign(ncells, 0);
+  if (nprocs == 1) return;
+
+  if (!cell_geometry_precomputed) compute_cell_geometric_quantities();
+
+  int dim = space_dim_;
+  double lo[3] = {1e20, 1e20, 1e20}, hi[3] = {-1e20, -1e20, -1e20};
+  for (auto const& c : owned) {
+    JaliGeometry::Point const& p = cell_centroids[c];
+    for (int d = 0; d < dim; d++) {
+      lo[d] = std::min(lo[d], p[d]);
+      hi[d] = std::max(hi[d], p[d]);
+    }
+  }
+  MPI_Allreduce(MPI_IN_PLACE, lo, dim, MPI_DOUBLE, MPI_MIN, comm);
+  MPI_Allreduce(MPI_IN_PLACE, hi, dim, MPI_DOUBLE, MPI_MAX, comm);
+
+  int bits = std::min(31, 63/dim);
+  double scale[3];
+  for (int d = 0; d < dim; d++)
+    scale[d] = (hi[d] > lo[d]) ? ((1u << bits) - 1)/(hi[d] - lo[d]) : 0.0;
+
+  // Local keys in ascending order with the running weight below each
+
+  std::vector<std::pair<std::uint64_t, int>> keys(ncells);
+  for (int i = 0; i < ncells; i++) {
+    JaliGeometry::Point const& p = cell_centroids[owned[i]];
+    std::uint32_t x[3];
+    for (int d = 0; d < dim; d++)
+      x[d] = static_cast<std::uint32_t>((p[d] - lo[d])*scale[d]);
+    keys[i] = std::make_pair(hilbert_key(dim, x, bits), i);
+  }
+  std::sort(keys.begin(), keys.end());
+
+  std::vector<double> below(ncells+1, 0.0);
+  for (int i = 0; i < ncells; i++)
+    below[i+1] = below[i] +
+        (cell_weights ? (*cell_weights)[keys[i].second] : 1.0);
+
+  double total = below[ncells];
+  MPI_Allreduce(MPI_IN_PLACE, &total, 1, MPI_DOUBLE, MPI_SUM, comm);
+
+  // Cut p is the smallest key with at least p/P of the total weight
+  // on keys below it
+
+  int ncuts = nprocs-1;
+  std::vector<std::uint64_t> cutlo(ncuts, 0), cuthi(ncuts, 1ull << 63);
+  std::vector<double> wbelow(ncuts);
+  for (int iter = 0; iter < 64; iter++) {
+    bool done = true;
+    for (int p = 0; p < ncuts; p++) {
+      std::uint64_t mid = cutlo[p] + (cuthi[p] - cutlo[p])/2;
+      int n = std::lower_bound(keys.begin(), keys.end(),
+                               std::make_pair(mid, -1)) - keys.begin();
+      wbelow[p] = below[n];
+      done = done && (cutlo[p] == cuthi[p]);
+    }
+    if (done) break;
+    MPI_Allreduce(MPI_IN_PLACE, wbelow.data(), ncuts, MPI_DOUBLE, MPI_SUM,
+                  comm);
+    for (int p = 0; p < ncuts; p++) {
+      std::uint64_t mid = cutlo[p] + (cuthi[p] - cutlo[p])/2;
+      if (wbelow[p] >= total*(p+1)/nprocs)
+        cuthi[p] = mid;
+      else
+        cutlo[p] = mid + 1;
+    }
+  }
+
+  for (auto const& k : keys)
+    (*cell_ranks)[k.second] =
+        std::upper_bound(cuthi.begin(), cuthi.end(), k.first) - cuthi.begin();
+}
+
+
+namespace {
+
+// Summary of a single part
+
+PartitionQuality single_part_quality(int const ncells, double const weight,
+                                     int const nghosts,
+                                     std::int64_t const nshared,
+                                     int const nnbrs) {
+  PartitionQuality q;
+  q.num_parts = 1;
+  q.min_cells = q.max_cells = q.total_cells = ncells;
+  q.min_weight = q.max_weight = q.total_weight = weight;
+  q.ghost_cells = nghosts;
+  q.shared_faces = nshared;
+  q.min_neighbors = q.max_neighbors = q.total_neighbors = nnbrs;
+  return q;
+}
+
+}  // namespace
+
+
+PartitionQuality
+Mesh::tile_partition_quality(std::vector<double> const *cell_weights) const {
+  if (!faces_requested) {
+    Errors::Message mesg("Mesh::tile_partition_quality - needs faces");
+    Exceptions::Jali_throw(mesg);
+  }
+  if (cell_weights &&
+      cell_weights->size() != num_cells<Entity_type::PARALLEL_OWNED>()) {
+    Errors::Message mesg("Mesh::tile_partition_quality - need one weight "
+                         "per owned cell");
+    Exceptions::Jali_throw(mesg);
+  }
+
+  PartitionQuality quality;
+  int ntiles = meshtiles.size();
+  if (!ntiles) return quality;
+
+  // Faces between owned cells of two tiles
+
+  std::vector<std::int64_t> nshared(ntiles, 0);
+  std::vector<std::vector<int>> nbrs(ntiles);
+  Entity_ID_List fcells;
+  for (auto const& f : faces()) {
+    face_get_cells(f, Entity_type::ALL, &fcells);
+    if (fcells.size() != 2) continue;
+    int t0 = cell_master_tile_ID_[fcells[0]];
+    int t1 = cell_master_tile_ID_[fcells[1]];
+    if (t0 < 0 || t1 < 0 || t0 == t1) continue;
+    nshared[t0]++;
+    nshared[t1]++;
+    nbrs[t0].push_back(t1);
+    nbrs[t1].push_back(t0);
+  }
+
+  for (int t = 0; t < ntiles; t++) {
+    MeshTile const& tile = *(meshtiles[t]);
+    std::vector<Entity_ID> const& tcells =
+        tile.cells<Entity_type::PARALLEL_OWNED>();
+    double weight = cell_weights ? 0.0 : tcells.size();
+    if (cell_weights)
+      for (auto const& c : tcells)
+        weight += (*cell_weights)[c];
+
+    std::sort(nbrs[t].begin(), nbrs[t].end());
+    int nnbrs = std::unique(nbrs[t].begin(), nbrs[t].end()) - nbrs[t].begin();
+
+    int nghosts = tile.num_cells<Entity_type::PARALLEL_GHOST>();
+    quality.combine(single_part_quality(tcells.size(), weight, nghosts,
+                                        nshared[t], nnbrs));
+  }
+  return quality;
+}
+
+
+PartitionQuality
+Mesh::rank_partition_quality(std::vector<double> const *cell_weights) const {
+  if (!faces_requested) {
+    Errors::Message mesg("Mesh::rank_partition_quality - needs faces");
+    Exceptions::Jali_throw(mesg);
+  }
+  int ncells_owned = num_cells<Entity_type::PARALLEL_OWNED>();
+  if (cell_weights && cell_weights->size() != ncells_owned) {
+    Errors::Message mesg("Mesh::rank_partition_quality - need one weight "
+                         "per owned cell");
+    Exceptions::Jali_throw(mesg);
+  }
+
+  double weight = cell_weights ? 0.0 : ncells_owned;
+  if (cell_weights)
+    for (auto const& w : *cell_weights)
+      weight += w;
+
+  // Faces between owned and ghost cells. The cells across them are
+  // the ones other ranks may ask about and the ghost cells whose
+  // owners are our neighbors
+
+  std::int64_t nshared = 0;
+  std::vector<int> boundary_gids, ghost_gids;
+  Entity_ID_List fcells;
+  for (auto const& f : faces()) {
+    face_get_cells(f, Entity_type::ALL, &fcells);
+    if (fcells.size() != 2) continue;
+    Entity_type p0 = entity_get_type(Entity_kind::CELL, fcells[0]);
+    Entity_type p1 = entity_get_type(Entity_kind::CELL, fcells[1]);
+    if (p1 == Entity_type::PARALLEL_OWNED) {
+      std::swap(fcells[0], fcells[1]);
+      std::swap(p0, p1);
+    }
+    if (p0 != Entity_type::PARALLEL_OWNED ||
+        p1 != Entity_type::PARALLEL_GHOST) continue;
+    nshared++;
+    boundary_gids.push_back(GID(fcells[0], Entity_kind::CELL));
+    ghost_gids.push_back(GID(fcells[1], Entity_kind::CELL));
+  }
+
+  int nprocs;
+  MPI_Comm_size(comm, &nprocs);
+  int nnbrs = 0;
+  if (nprocs > 1) {
+    for (auto gids : {&boundary_gids, &ghost_gids}) {
+      std::sort(gids->begin(), gids->end());
+      gids->erase(std::unique(gids->begin(), gids->end()), gids->end());
+    }
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    std::vector<int> owners =
+        directory_lookup(boundary_gids,
+                         std::vector<int>(boundary_gids.size(), rank),
+                         ghost_gids, -1, comm);
+    std::sort(owners.begin(), owners.end());
+    owners.erase(std::unique(owners.begin(), owners.end()), owners.end());
+    nnbrs = std::count_if(owners.begin(), owners.end(),
+                          [](int r) { return r >= 0; });
+  }
+
+  return single_part_quality(ncells_owned, weight,
+                             num_cells<Entity_type::PARALLEL_GHOST>(),
+                             nshared, nnbrs);
+}
+
 // @brief Get the partitioning of a regular mesh such that each
 // partition is a rectangular block
 //
@@ -55,6 +55,8 @@
 #include <vector>
 #include <array>
 #include <map>
+#include <mutex>
+#include <set>
 #include <string>
 #include <algorithm>
 #include <cassert>
@@ -68,6 +70,8 @@
 #include "Geometry.hh"
 #include "MeshTile.hh"
 #include "MeshSet.hh"
+#include "MeshPartitionQuality.hh"
+#include "MeshBVH.hh"
 
 #define JALI_CACHE_VARS 1  // Switch to 0 to turn caching off
 
@@ -175,8 +179,9 @@ class Mesh {
     partitioner_pref_(partitioner),
     cell2face_info_cached(false), face2cell_info_cached(false),
     cell2edge_info_cached(false), face2edge_info_cached(false),
-    side_info_cached(false), wedge_info_cached(false),
+    edge2node_info_cached(false), side_info_cached(false), wedge_info_cached(false),
     corner_info_cached(false), type_info_cached(false),
+    interior_boundary_info_cached(false),
     geometric_model_(NULL), comm(incomm),
     geomtype(geom_type) {
     
@@ -345,6 +350,57 @@ class Mesh {
 
   int num_tiles() const {return meshtiles.size();}
 
+  //! Number of layers of ghost cells around the cells owned by a rank
+
+  int num_ghost_layers_distmesh() const {return num_ghost_layers_distmesh_;}
+
+  //! Partition the owned cells of this mesh into num_parts parts
+  //! using the given partitioner. This is what the mesh uses to make
+  //! its tiles but it may also be called directly, e.g. to evaluate
+  //! partitioners. The native partitioners (SFC_HILBERT, SFC_MORTON
+  //! and RCB) need no third party library, run on multiple threads
+  //! for large meshes and balance the sum of 'cell_weights' (one per
+  //! owned cell, unit weights if null) across the parts; the other
+  //! partitioners ignore the weights. Each part lists cell IDs in
+  //! ascending order
+
+  void get_partitioning(int const num_parts,
+                        Partitioner_type const parttype,
+                        std::vector<std::vector<int>> *partitions,
+                        std::vector<double> const *cell_weights = nullptr);
+
+  //! Assign each owned cell to a rank of the mesh communicator so
+  //! that the ranks get equal shares of the total 'cell_weights' (one
+  //! per owned cell, unit weights if null) and compact pieces of the
+  //! domain. The cells are ordered along a Hilbert curve through the
+  //! cell centroids of the whole mesh and the curve is cut into
+  //! pieces of equal weight. Collective. Used with
+  //! MeshFactory::redistribute to rebalance a running simulation
+
+  void get_rank_partitioning(std::vector<double> const *cell_weights,
+                             std::vector<int> *cell_ranks) const;
+
+  //! Quality of the division of the owned cells of this rank into
+  //! tiles: cells, weight (from 'cell_weights', one per owned cell, or
+  //! cell counts if null) and halo cells per tile, and faces and
+  //! neighbors shared between tiles. Needs faces. Merge the results
+  //! of all ranks with global_partition_quality
+
+  PartitionQuality
+  tile_partition_quality(std::vector<double> const *cell_weights =
+                         nullptr) const;
+
+  //! Quality of the distribution of cells over ranks, describing this
+  //! rank as a single part: owned and ghost cells, weight, faces
+  //! shared with other ranks and the number of ranks sharing them.
+  //! Needs faces. Collective on the mesh communicator since owners
+  //! of ghost cells are looked up on other ranks. Merge the results
+  //! of all ranks with global_partition_quality
+
+  PartitionQuality
+  rank_partition_quality(std::vector<double> const *cell_weights =
+                         nullptr) const;
+
   //! Nodes of mesh (of a particular parallel type OWNED, GHOST or ALL)
 
   template<Entity_type type = Entity_type::ALL>
@@ -381,6 +437,60 @@ class Mesh {
   const std::vector<Entity_ID> & cells() const;
 
 
+  // Owned entities split by their distance from parallel ghost cells.
+  //
+  // An owned cell is on the parallel boundary if it is within
+  // num_ghost_layers_distmesh node-connected layers of a
+  // PARALLEL_GHOST cell; otherwise it is interior. An owned face or
+  // node is interior if all the cells connected to it are interior
+  // owned cells. Interior entities can be updated without any ghost
+  // data, so codes can start a halo exchange, process the interior
+  // lists, finish the exchange and then process the boundary lists.
+  // On a serial mesh all owned entities are interior.
+
+  //! Owned cells that do not depend on any ghost cell data
+
+  const std::vector<Entity_ID> & cells_owned_interior() const {
+    return cellids_owned_interior_;
+  }
+
+  //! Owned cells within num_ghost_layers_distmesh layers of ghost cells
+
+  const std::vector<Entity_ID> & cells_owned_boundary() const {
+    return cellids_owned_boundary_;
+  }
+
+  //! Owned faces connected only to interior owned cells
+
+  const std::vector<Entity_ID> & faces_owned_interior() const {
+    return faceids_owned_interior_;
+  }
+
+  //! Owned faces connected to a boundary owned cell or a ghost cell
+
+  const std::vector<Entity_ID> & faces_owned_boundary() const {
+    return faceids_owned_boundary_;
+  }
+
+  //! Owned nodes connected only to interior owned cells
+
+  const std::vector<Entity_ID> & nodes_owned_interior() const {
+    return nodeids_owned_interior_;
+  }
+
+  //! Owned nodes connected to a boundary owned cell or a ghost cell
+
+  const std::vector<Entity_ID> & nodes_owned_boundary() const {
+    return nodeids_owned_boundary_;
+  }
+
+  //! Is the entity (CELL, FACE or NODE) owned and interior, i.e. can
+  //! it be updated without ghost data? Returns false for ghost entities
+
+  bool entity_is_owned_interior(Entity_kind const kind,
+                                Entity_ID const entid) const;
+
+
   // Master tile ID for entities
 
   int master_tile_ID_of_node(Entity_ID const nodeid) const {
@@ -734,6 +844,55 @@ class Mesh {
   Entity_ID wedge_get_adjacent_wedge(const Entity_ID wedgeid) const;
 
 
+  // Batch adjacencies
+  //------------------
+  //
+  // These fill the adjacencies of a whole list of entities (such as
+  // mesh->cells() or a set) in compressed row storage (CRS) in one
+  // call. On return, offsets has entityids.size()+1 entries and the
+  // adjacent entities of entityids[i] are adjids[offsets[i]] through
+  // adjids[offsets[i+1]-1] in the same order as the per-entity
+  // query. Frameworks can override them to fill the arrays in one
+  // traversal of their data structures
+
+  //! Nodes of a list of cells
+
+  virtual
+  void cells_get_nodes(Entity_ID_List const& cellids,
+                       std::vector<int> *offsets,
+                       Entity_ID_List *nodeids) const;
+
+  //! Faces of a list of cells and the directions in which the cells
+  //! use them (facedirs may be NULL)
+
+  void cells_get_faces_and_dirs(Entity_ID_List const& cellids,
+                                std::vector<int> *offsets,
+                                Entity_ID_List *faceids,
+                                std::vector<dir_t> *facedirs) const;
+
+  //! Nodes of a list of faces
+
+  virtual
+  void faces_get_nodes(Entity_ID_List const& faceids,
+                       std::vector<int> *offsets,
+                       Entity_ID_List *nodeids) const;
+
+  //! Cells of type 'type' connected to a list of faces
+
+  void faces_get_cells(Entity_ID_List const& faceids,
+                       const Entity_type type,
+                       std::vector<int> *offsets,
+                       Entity_ID_List *cellids) const;
+
+  //! Cells of type 'type' connected to a list of nodes
+
+  virtual
+  void nodes_get_cells(Entity_ID_List const& nodeids,
+                       const Entity_type type,
+                       std::vector<int> *offsets,
+                       Entity_ID_List *cellids) const;
+
+
   //
   // Mesh entity geometry
   //--------------
@@ -952,6 +1111,31 @@ class Mesh {
   bool point_in_cell(const JaliGeometry::Point &p,
                       const Entity_ID cellid) const;
 
+  //
+  // Point location
+  //---------------
+  //
+  // These search bounding volume hierarchies over the cell bounding
+  // boxes and over the nodes, built on first use and refit by
+  // update_geometric_quantities (so call that after moving nodes)
+
+  //! Cell containing point p - the lowest numbered one if p is on
+  //! the boundary of several cells, so owned cells come first; -1 if
+  //! no cell on this rank contains it
+
+  Entity_ID locate_point(const JaliGeometry::Point &p) const;
+
+  //! Node nearest to point p (-1 if there are no nodes)
+
+  Entity_ID nearest_node(const JaliGeometry::Point &p) const;
+
+  //! Cells whose bounding boxes overlap the box with corners lo and
+  //! hi, in ascending order
+
+  void cells_intersecting_box(const JaliGeometry::Point &lo,
+                              const JaliGeometry::Point &hi,
+                              Entity_ID_List *cellids) const;
+
 
   //! Outward normal to facet of side that is shared with side from
   //! neighboring cell.
@@ -1006,6 +1190,48 @@ class Mesh {
 
   void update_geometric_quantities();
 
+  //! Number of calls to update_geometric_quantities - clients caching
+  //! geometry (like probes) compare it to tell if nodes may have moved
+
+  unsigned int geometry_version() const { return geometry_version_; }
+
+  //
+  // Persistent caches of derived entities
+  //--------------------------------------
+
+  //! Fingerprint of the mesh partition on this rank computed from its
+  //! entity counts, topology and node coordinates. Meshes with the
+  //! same fingerprint have the same derived entities and geometry
+
+  uint64_t fingerprint() const;
+
+  //! Write the sides, wedges and corners (with their adjacencies and
+  //! geometric quantities) of this rank's partition to a sidecar
+  //! binary file tagged with the mesh fingerprint. The file is
+  //! replaced atomically (written as filename.tmp and renamed)
+
+  void write_derived_cache(std::string const& filename) const;
+
+  //! Read derived entities and their geometric quantities from a
+  //! file written by write_derived_cache. Returns false and leaves
+  //! the mesh unchanged if the file does not exist, is truncated or
+  //! corrupt, was written for a mesh with a different fingerprint or
+  //! does not have at least the requested entities
+
+  bool read_derived_cache(std::string const& filename,
+                          bool request_sides, bool request_wedges,
+                          bool request_corners);
+
+  //! Build the requested derived entities (sides, wedges, corners)
+  //! if they were not requested at construction, reading them from
+  //! the sidecar file 'cachefile' if it matches the mesh and
+  //! writing it otherwise (no file is used if cachefile is
+  //! empty). Returns true if the entities were read from the file
+
+  bool cache_derived_entities(bool request_sides, bool request_wedges,
+                              bool request_corners,
+                              std::string const& cachefile = "");
+
   //
   // Mesh Sets for ICs, BCs, Material Properties and whatever else
   //--------------------------------------------------------------
@@ -1019,9 +1245,10 @@ class Mesh {
 
   std::vector<std::shared_ptr<MeshSet>> sets(const Entity_kind kind) const;
 
-  //! Return a list of all sets
+  //! Return a list of all sets (a copy, as sets may be added
+  //! concurrently)
 
-  std::vector<std::shared_ptr<MeshSet>> const& sets() const;
+  std::vector<std::shared_ptr<MeshSet>> sets() const;
 
   //! Is this is a valid name of a geometric region defined on for
   //! containing entities of 'kind'
@@ -1045,6 +1272,7 @@ class Mesh {
   find_meshset_from_region(std::string setname, Entity_kind kind) const;
 
   //! Find a meshset with 'setname' containing entities of 'kind'
+  //! (building it if it is registered but not built yet)
 
   std::shared_ptr<MeshSet> find_meshset(const std::string setname,
                                         const Entity_kind kind) const;
@@ -1118,6 +1346,26 @@ class Mesh {
 
   void init_sets_from_geometric_model(
       std::map<std::string,std::vector<Entity_kind>> region_to_entity_kinds_map);
+
+  // Register the same meshsets as init_sets_from_geometric_model
+  // without building them. Each set is built on its first query
+  // through find_meshset, get_set_size or get_set_entities (which is
+  // safe to do from several threads); until then it is not counted
+  // by num_sets or listed by sets
+
+  void register_sets_from_geometric_model();
+
+  void register_sets_from_geometric_model(
+      std::map<std::string,std::vector<Entity_kind>> region_to_entity_kinds_map);
+
+  //! Build registered meshsets ahead of their first query, together
+  //! so that they share one pass over the mesh - those named (all of
+  //! them if no names are given) on entities of 'kind' (any kind by
+  //! default)
+
+  void prefetch_sets(std::vector<std::string> const& setnames =
+                     std::vector<std::string>(),
+                     const Entity_kind kind = Entity_kind::ANY_KIND);
   
   //! Add a meshset created in some manner
 
@@ -1129,8 +1377,24 @@ class Mesh {
                                                  const Entity_kind kind,
                                                  const bool build_reverse_map = true);
 
+  //! build the mesh sets of one kind of entity on several regions in
+  //! one pass (and add them to the mesh) - the coordinates of the
+  //! entities are gathered once for all box, plane and polygon
+  //! regions. Sets already on the mesh are returned as they are
+
+  std::vector<std::shared_ptr<MeshSet>>
+  build_sets_from_regions(std::vector<std::string> const& setnames,
+                          const Entity_kind kind,
+                          const bool build_reverse_map = true);
+
  protected:
 
+  // Apply io to each cached array of the parts (a mask of the parts
+  // of the derived entity cache file) in file order
+
+  template <class IO>
+  void derived_cache_fields(IO *io, int parts) const;
+
   int compute_cell_geometric_quantities() const;
   int compute_face_geometric_quantities() const;
   int compute_edge_geometric_quantities() const;
@@ -1297,6 +1561,7 @@ class Mesh {
                               double *volume) const;
 
   void cache_type_info() const;
+  void cache_interior_boundary_info() const;
   void cache_cell2face_info() const;
   void cache_face2cell_info() const;
   void cache_cell2edge_info() const;
@@ -1383,6 +1648,12 @@ class Mesh {
   bool meshsets_initialized_ = false;
   std::vector<std::shared_ptr<MeshSet>> meshsets_;
 
+  // Sets registered to be built on first query, and the lock that
+  // guards them and meshsets_
+
+  mutable std::set<std::pair<std::string, Entity_kind>> registered_meshsets_;
+  mutable std::recursive_mutex meshsets_mutex_;
+
   // Some geometric quantities
 
   mutable std::vector<double> cell_volumes, face_areas, edge_lengths,
@@ -1396,6 +1667,14 @@ class Mesh {
   // of wedge 0 of side into wedge 1
   mutable std::vector<JaliGeometry::Point> side_mid_facet_normal;
 
+  // Spatial indices of the cells and nodes (built once on demand, from
+  // any thread)
+
+  mutable std::shared_ptr<BoundingVolumeHierarchy> cell_bvh_, node_bvh_;
+  mutable std::once_flag cell_bvh_once_, node_bvh_once_;
+
+  unsigned int geometry_version_ = 0;
+
   // Entity lists
 
   mutable std::vector<int> nodeids_owned_, nodeids_ghost_, nodeids_all_;
@@ -1411,6 +1690,16 @@ class Mesh {
     cellids_boundary_ghost_, cellids_all_;
   std::vector<int> dummy_list_;  // for unspecialized cases
 
+  // Owned entities split into interior and parallel boundary
+  // entities (see cells_owned_interior) along with per-entity flags
+  // marking interior owned entities
+
+  mutable std::vector<int> cellids_owned_interior_, cellids_owned_boundary_;
+  mutable std::vector<int> faceids_owned_interior_, faceids_owned_boundary_;
+  mutable std::vector<int> nodeids_owned_interior_, nodeids_owned_boundary_;
+  mutable std::vector<bool> cell_owned_interior_, face_owned_interior_,
+    node_owned_interior_;
+
   // Type info for essential entities - sides, wedges and corners will
   // get their type from their owning cell
 
@@ -1483,6 +1772,7 @@ class Mesh {
   mutable bool faces_requested, edges_requested, sides_requested,
     wedges_requested, corners_requested;
   mutable bool type_info_cached;
+  mutable bool interior_boundary_info_cached;
   mutable bool cell2face_info_cached, face2cell_info_cached;
   mutable bool cell2edge_info_cached, face2edge_info_cached;
   mutable bool edge2node_info_cached;
@@ -1534,11 +1824,43 @@ class Mesh {
 
  private:
 
-  /// Method to get partitioning of a mesh into num parts
+  /// Bounding boxes of the cells and nodes for the spatial indices
 
-  void get_partitioning(int const num_parts,
-                        Partitioner_type const parttype,
-                        std::vector<std::vector<int>> *partitions);
+  std::vector<double> cell_bounding_boxes() const;
+  std::vector<double> node_bounding_boxes() const;
+
+  /// Spatial indices of the cells and nodes, built on first use
+
+  BoundingVolumeHierarchy const& cell_bvh() const;
+  BoundingVolumeHierarchy const& node_bvh() const;
+
+  /// Meshset if it is already built (unlike find_meshset)
+
+  std::shared_ptr<MeshSet> built_meshset(const std::string& setname,
+                                         const Entity_kind kind) const;
+
+  /// Names of the regions of the geometric model to make sets on, by
+  /// entity kind, leaving out sets that are already built
+
+  void geometric_model_sets(
+      std::map<std::string, std::vector<Entity_kind>> const&
+      region_to_entity_kinds_map,
+      std::map<Entity_kind, std::vector<std::string>> *requested) const;
+
+  /// Sets of entities of 'kind' on logical regions, evaluated
+  /// together with shared subexpressions evaluated once
+
+  std::vector<std::shared_ptr<MeshSet>>
+  logical_region_sets(std::vector<JaliGeometry::RegionPtr> const& regions,
+                      const Entity_kind kind, const bool with_reverse_map);
+
+  /// Owned and ghost entities of 'kind' in each of the regions, by
+  /// batched point tests (box, plane and polygon regions only)
+
+  void region_entities(std::vector<JaliGeometry::RegionPtr> const& regions,
+                       const Entity_kind kind,
+                       std::vector<Entity_ID_List> *owned,
+                       std::vector<Entity_ID_List> *ghost) const;
 
   /// Method to get crude partitioning by chopping up the index space
 
@@ -1550,6 +1872,21 @@ class Mesh {
   void get_partitioning_by_blocks(int const num_parts,
                                        std::vector<std::vector<int>> *partitions);
 
+  /// Method to get partitioning by sorting cell centroids along a
+  /// space filling curve (Hilbert or Morton) and cutting the curve
+  /// into pieces of equal weight
+
+  void get_partitioning_by_sfc(int const num_parts, bool const hilbert,
+                               std::vector<double> const *cell_weights,
+                               std::vector<std::vector<int>> *partitions);
+
+  /// Method to get partitioning by recursive coordinate bisection of
+  /// cell centroids into pieces of equal weight
+
+  void get_partitioning_by_rcb(int const num_parts,
+                               std::vector<double> const *cell_weights,
+                               std::vector<std::vector<int>> *partitions);
+
   /// Method to get partitioning of a mesh into num parts using METIS
 
 #ifdef Jali_HAVE_METIS
@@ -2023,12 +2360,14 @@ void Mesh::cell_get_faces(const Entity_ID cellid, Entity_ID_List *faceids,
 inline
 void Mesh::edge_get_nodes(const Entity_ID edgeid, Entity_ID *nodeid0,
                           Entity_ID *nodeid1) const {
-#ifdef JALI_CACHE_VARS
-  *nodeid0 = edge_node_ids[edgeid][0];
-  *nodeid1 = edge_node_ids[edgeid][1];
-#else
-  edge_get_nodes_internal(edgeid, nodeid0, nodeid1);
+#if JALI_CACHE_VARS != 0
+  if (edge2node_info_cached) {
+    *nodeid0 = edge_node_ids[edgeid][0];
+    *nodeid1 = edge_node_ids[edgeid][1];
+    return;
+  }
 #endif
+  edge_get_nodes_internal(edgeid, nodeid0, nodeid1);
 }
 
 inline
@@ -2068,7 +2407,7 @@ Entity_ID Mesh::side_get_cell(const Entity_ID sideid) const {
 inline
 Entity_ID Mesh::side_get_node(const Entity_ID sideid, const int inode) const {
   assert(sides_requested);
-  assert(side_info_cached && edge2node_info_cached);
+  assert(side_info_cached);
   assert(inode == 0 || inode == 1);
 
   Entity_ID edgeid = side_edge_id[sideid];
@@ -0,0 +1,158 @@
+/*
+ Copyright (c) 2019, Triad National Security, LLC
+ All rights reserved.
+
+ Copyright 2019. Triad National Security, LLC. This software was
+ produced under U.S. Government contract 89233218CNA000001 for Los
+ Alamos National Laboratory (LANL), which is operated by Triad
+ National Security, LLC for the U.S. Department of Energy. 
+ All rights in the program are reserved by Triad National Security,
+ LLC, and the U.S. Department of Energy/National Nuclear Security
+ Administration. The Government is granted for itself and others acting
+ on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+ in this material to reproduce, prepare derivative works, distribute
+ copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+
+ 
+ This is open source software distributed under the 3-clause BSD license.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of Triad National Security, LLC, Los Alamos
+    National Laboratory, LANL, the U.S. Government, nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ 
+ THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+ BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#include "MeshBVH.hh"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+namespace Jali {
+
+void BoundingVolumeHierarchy::build(int const dim,
+                                    std::vector<double> const& boxes) {
+  dim_ = dim;
+  boxes_ = boxes;
+  int nitems = boxes.size()/(2*dim);
+
+  std::vector<double> centers(dim*nitems);
+  for (int i = 0; i < nitems; i++)
+    for (int d = 0; d < dim; d++)
+      centers[dim*i+d] = 0.5*(boxes[2*dim*i+d] + boxes[2*dim*i+dim+d]);
+
+  items_.resize(nitems);
+  for (int i = 0; i < nitems; i++)
+    items_[i] = i;
+  nodes_.clear();
+  nodes_.reserve(nitems ? 2*((nitems + kLeafSize - 1)/kLeafSize) : 0);
+  if (nitems) build_node(0, nitems, centers);
+}
+
+
+// Make a node for items_[first, first+count) and its subtree; returns
+// the index of the node
+
+int BoundingVolumeHierarchy::build_node(int first, int count,
+                                        std::vector<double> const& centers) {
+  int inode = nodes_.size();
+  nodes_.push_back(Node());
+  nodes_[inode].first = first;
+  nodes_[inode].count = count;
+  nodes_[inode].right = -1;
+  set_box(&(nodes_[inode]));
+  if (count <= kLeafSize) return inode;
+
+  // Split at the median center along the axis of largest spread
+
+  double lo[3], hi[3];
+  for (int d = 0; d < dim_; d++) {
+    lo[d] = std::numeric_limits<double>::max();
+    hi[d] = -std::numeric_limits<double>::max();
+  }
+  for (int i = first; i < first + count; i++)
+    for (int d = 0; d < dim_; d++) {
+      double x = centers[dim_*items_[i]+d];
+      lo[d] = std::min(lo[d], x);
+      hi[d] = std::max(hi[d], x);
+    }
+  int axis = 0;
+  for (int d = 1; d < dim_; d++)
+    if (hi[d]-lo[d] > hi[axis]-lo[axis]) axis = d;
+
+  int half = count/2;
+  std::nth_element(items_.begin() + first, items_.begin() + first + half,
+                   items_.begin() + first + count,
+                   [&](int a, int b) {
+                     return centers[dim_*a+axis] < centers[dim_*b+axis];
+                   });
+
+  nodes_[inode].count = 0;
+  build_node(first, half, centers);
+  int right = build_node(first + half, count - half, centers);
+  nodes_[inode].right = right;
+  return inode;
+}
+
+
+// Box of a leaf from its items
+
+void BoundingVolumeHierarchy::set_box(Node *node) const {
+  for (int d = 0; d < 3; d++) {
+    node->lo[d] = std::numeric_limits<double>::max();
+    node->hi[d] = -std::numeric_limits<double>::max();
+  }
+  for (int i = node->first; i < node->first + node->count; i++) {
+    double const *box = &(boxes_[2*dim_*items_[i]]);
+    for (int d = 0; d < dim_; d++) {
+      node->lo[d] = std::min(node->lo[d], box[d]);
+      node->hi[d] = std::max(node->hi[d], box[dim_+d]);
+    }
+  }
+}
+
+
+// Children come after their parent, so a backward pass sees the
+// children of a node before the node itself
+
+void BoundingVolumeHierarchy::refit(std::vector<double> const& boxes) {
+  boxes_ = boxes;
+  for (int inode = nodes_.size()-1; inode >= 0; inode--) {
+    Node& node = nodes_[inode];
+    if (node.count) {
+      set_box(&node);
+    } else {
+      Node const& left = nodes_[inode+1];
+      Node const& right = nodes_[node.right];
+      for (int d = 0; d < dim_; d++) {
+        node.lo[d] = std::min(left.lo[d], right.lo[d]);
+        node.hi[d] = std::max(left.hi[d], right.hi[d]);
+      }
+    }
+  }
+}
+
+}  // namespace Jali
@@ -0,0 +1,191 @@
+/*
+ Copyright (c) 2019, Triad National Security, LLC
+ All rights reserved.
+
+ Copyright 2019. Triad National Security, LLC. This software was
+ produced under U.S. Government contract 89233218CNA000001 for Los
+ Alamos National Laboratory (LANL), which is operated by Triad
+ National Security, LLC for the U.S. Department of Energy. 
+ All rights in the program are reserved by Triad National Security,
+ LLC, and the U.S. Department of Energy/National Nuclear Security
+ Administration. The Government is granted for itself and others acting
+ on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+ in this material to reproduce, prepare derivative works, distribute
+ copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+
+ 
+ This is open source software distributed under the 3-clause BSD license.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of Triad National Security, LLC, Los Alamos
+    National Laboratory, LANL, the U.S. Government, nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ 
+ THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+ BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#ifndef _JALI_MESHBVH_H_
+#define _JALI_MESHBVH_H_
+
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+namespace Jali {
+
+/*!
+  @class BoundingVolumeHierarchy "MeshBVH.hh"
+  @brief Binary tree of axis aligned boxes for spatial queries
+
+  Built over a list of item boxes (e.g. the bounding boxes of the
+  cells of a mesh) by splitting the items at the median of their box
+  centers along the longest axis until at most a few items are left
+  in each leaf. Nodes are stored depth first, so the first child of
+  a node is the next node. When the items move without changing the
+  topology of the mesh the tree can be refit in linear time; the
+  queries stay correct although the boxes of the nodes may then
+  overlap more than those of a rebuilt tree.
+
+  Boxes are given as 2*dim doubles per item: the low corner followed
+  by the high corner.
+*/
+
+class BoundingVolumeHierarchy {
+ public:
+  //! Build the tree over nitems = boxes.size()/(2*dim) boxes
+  void build(int const dim, std::vector<double> const& boxes);
+
+  //! Recompute the node boxes from new item boxes (same items)
+  void refit(std::vector<double> const& boxes);
+
+  int dimension() const { return dim_; }
+  int num_items() const { return items_.size(); }
+
+  //! Call f(item) for every item whose box overlaps the box [lo, hi]
+  template <class Function>
+  void for_each_overlapping(double const *lo, double const *hi,
+                            Function const& f) const {
+    if (nodes_.empty()) return;
+    int stack[kMaxDepth];
+    int top = 0;
+    stack[top++] = 0;
+    while (top) {
+      int inode = stack[--top];
+      Node const& node = nodes_[inode];
+      if (!overlaps(node, lo, hi)) continue;
+      if (node.count) {
+        for (int i = node.first; i < node.first + node.count; i++)
+          if (overlaps(items_[i], lo, hi)) f(items_[i]);
+      } else {
+        stack[top++] = node.right;
+        stack[top++] = inode + 1;
+      }
+    }
+  }
+
+  //! Item minimizing dist2(item) among the items, visiting nodes in
+  //! order of the squared distance from p to their boxes; dist2 must
+  //! be at least the squared distance from p to the box of the item.
+  //! Returns -1 if there are no items
+  template <class Function>
+  int nearest(double const *p, Function const& dist2,
+              double *mindist2 = nullptr) const {
+    int best = -1;
+    double bestd2 = 0.0;
+    typedef std::pair<double, int> Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+    if (!nodes_.empty()) queue.push(Entry(box_dist2(nodes_[0], p), 0));
+    while (!queue.empty()) {
+      Entry entry = queue.top();
+      queue.pop();
+      if (best >= 0 && entry.first >= bestd2) break;
+      Node const& node = nodes_[entry.second];
+      if (node.count) {
+        for (int i = node.first; i < node.first + node.count; i++) {
+          double d2 = dist2(items_[i]);
+          if (best < 0 || d2 < bestd2 ||
+              (d2 == bestd2 && items_[i] < best)) {
+            best = items_[i];
+            bestd2 = d2;
+          }
+        }
+      } else {
+        int left = entry.second + 1;
+        queue.push(Entry(box_dist2(nodes_[left], p), left));
+        queue.push(Entry(box_dist2(nodes_[node.right], p), node.right));
+      }
+    }
+    if (mindist2) *mindist2 = bestd2;
+    return best;
+  }
+
+ private:
+  // Items per leaf and bound on the depth of the tree (median splits
+  // halve the items at each level)
+  static constexpr int kLeafSize = 4;
+  static constexpr int kMaxDepth = 128;
+
+  struct Node {
+    double lo[3], hi[3];
+    int right;   // second child (internal nodes)
+    int first;   // first item in items_ (leaves)
+    int count;   // number of items (0 for internal nodes)
+  };
+
+  int build_node(int first, int count, std::vector<double> const& centers);
+  void set_box(Node *node) const;
+
+  bool overlaps(Node const& node, double const *lo, double const *hi) const {
+    for (int d = 0; d < dim_; d++)
+      if (node.hi[d] < lo[d] || hi[d] < node.lo[d]) return false;
+    return true;
+  }
+
+  bool overlaps(int item, double const *lo, double const *hi) const {
+    double const *box = &(boxes_[2*dim_*item]);
+    for (int d = 0; d < dim_; d++)
+      if (box[dim_+d] < lo[d] || hi[d] < box[d]) return false;
+    return true;
+  }
+
+  double box_dist2(Node const& node, double const *p) const {
+    double d2 = 0.0;
+    for (int d = 0; d < dim_; d++) {
+      double gap = (p[d] < node.lo[d]) ? node.lo[d] - p[d] :
+          (p[d] > node.hi[d]) ? p[d] - node.hi[d] : 0.0;
+      d2 += gap*gap;
+    }
+    return d2;
+  }
+
+  int dim_ = 0;
+  std::vector<Node> nodes_;
+  std::vector<int> items_;      // items in leaf order
+  std::vector<double> boxes_;   // item boxes
+};
+
+}  // namespace Jali
+
+#endif  // _JALI_MESHBVH_H_
@@ -0,0 +1,136 @@
+/*
+ Copyright (c) 2019, Triad National Security, LLC
+ All rights reserved.
+
+ Copyright 2019. Triad National Security, LLC. This software was
+ produced under U.S. Government contract 89233218CNA000001 for Los
+ Alamos National Laboratory (LANL), which is operated by Triad
+ National Security, LLC for the U.S. Department of Energy. 
+ All rights in the program are reserved by Triad National Security,
+ LLC, and the U.S. Department of Energy/National Nuclear Security
+ Administration. The Government is granted for itself and others acting
+ on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+ in this material to reproduce, prepare derivative works, distribute
+ copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+
+ 
+ This is open source software distributed under the 3-clause BSD license.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of Triad National Security, LLC, Los Alamos
+    National Laboratory, LANL, the U.S. Government, nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ 
+ THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+ BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef _JALI_MESHBLOCKS_H_
+#define _JALI_MESHBLOCKS_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "errors.hh"
+
+namespace Jali {
+
+// Generation and decomposition of regular (tensor product) meshes
+//
+// The nodes of a regular mesh are given by their coordinates along
+// each axis. In parallel the ranks are arranged in a grid of blocks of
+// cells - along each direction the n cells are split into np nearly
+// equal ranges and rank r holds block (r % npx, (r/npx) % npy,
+// r/(npx*npy)). Frameworks that generate regular meshes share these
+// so that they all give every rank the same cells
+
+typedef std::int64_t GlobalIndex;
+
+// Node coordinates of n uniform cells from x0 to x1
+
+inline
+std::vector<double> regular_axis(double x0, double x1, int n) {
+  if (n <= 0) {
+    Errors::Message mesg("Regular mesh needs at least one cell in each"
+                         " direction");
+    Exceptions::Jali_throw(mesg);
+  }
+  std::vector<double> x(n+1);
+  for (int i = 0; i < n; i++)
+    x[i] = x0 + i*(x1-x0)/n;
+  x[n] = x1;
+  return x;
+}
+
+// First cell of block p of np blocks along a direction with n cells
+
+inline
+int block_start(int p, int np, int n) {
+  return static_cast<int>(static_cast<GlobalIndex>(p)*n/np);
+}
+
+// Block holding cell i along a direction with n cells
+
+inline
+int block_of(int i, int np, int n) {
+  return static_cast<int>((static_cast<GlobalIndex>(i+1)*np + n - 1)/n - 1);
+}
+
+// Arrange nprocs ranks in a grid of blocks with the smallest total
+// area of cuts between blocks; returns false if there is no grid with
+// at least one cell per block
+
+inline
+bool block_grid(int dim, int const *ncells, int nprocs, int *nblocks) {
+  bool found = false;
+  double best = 0.0;
+  for (int px = 1; px <= nprocs; px++) {
+    if (nprocs % px) continue;
+    int rest = nprocs/px;
+    for (int py = 1; py <= rest; py++) {
+      if (rest % py) continue;
+      int p[3] = {px, py, rest/py};
+      bool ok = true;
+      double cut = 0.0;
+      for (int d = 0; d < 3; d++) {
+        ok = ok && (p[d] <= ncells[d]);
+        double area = 1.0;
+        for (int e = 0; e < dim; e++)
+          if (e != d) area *= ncells[e];
+        cut += (p[d]-1)*area;
+      }
+      if (ok && (!found || cut < best)) {
+        found = true;
+        best = cut;
+        std::copy(p, p+3, nblocks);
+      }
+    }
+  }
+  return found;
+}
+
+}  // close namespace Jali
+
+#endif  // _JALI_MESHBLOCKS_H_
@@ -251,9 +251,12 @@ enum class Partitioner_type : std::uint8_t {
     BLOCK,
     METIS,
     ZOLTAN_GRAPH,
-    ZOLTAN_RCB
+    ZOLTAN_RCB,
+    SFC_HILBERT,  // Native: Hilbert curve through cell centroids
+    SFC_MORTON,   // Native: Morton (Z-order) curve through cell centroids
+    RCB           // Native: recursive coordinate bisection of centroids
 };
-constexpr int NUM_PARTITIONER_TYPES = 5;
+constexpr int NUM_PARTITIONER_TYPES = 8;
 constexpr Partitioner_type PARTITIONER_DEFAULT = Partitioner_type::METIS;
 
 // Return an string description for each partitioner type
@@ -262,7 +265,9 @@ std::string Partitioner_type_string(const Partitioner_type partitioner_type) {
   static std::string partitioner_type_str[NUM_PARTITIONER_TYPES] =
       {"Partitioner_type::INDEX", "Partitioner_type::BLOCK",
        "Partitioner_type::METIS",
-       "Partitioner_type::ZOLTAN_GRAPH", "Partitioner_type::ZOLTAN_RCB"};
+       "Partitioner_type::ZOLTAN_GRAPH", "Partitioner_type::ZOLTAN_RCB",
+       "Partitioner_type::SFC_HILBERT", "Partitioner_type::SFC_MORTON",
+       "Partitioner_type::RCB"};
 
   int iptype = static_cast<int>(partitioner_type);
   return (iptype >= 0 && iptype < NUM_PARTITIONER_TYPES) ?
@@ -0,0 +1,162 @@
+/*
+ Copyright (c) 2019, Triad National Security, LLC
+ All rights reserved.
+
+ Copyright 2019. Triad National Security, LLC. This software was
+ produced under U.S. Government contract 89233218CNA000001 for Los
+ Alamos National Laboratory (LANL), which is operated by Triad
+ National Security, LLC for the U.S. Department of Energy. 
+ All rights in the program are reserved by Triad National Security,
+ LLC, and the U.S. Department of Energy/National Nuclear Security
+ Administration. The Government is granted for itself and others acting
+ on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+ in this material to reproduce, prepare derivative works, distribute
+ copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+
+ 
+ This is open source software distributed under the 3-clause BSD license.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of Triad National Security, LLC, Los Alamos
+    National Laboratory, LANL, the U.S. Government, nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ 
+ THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+ BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef _JALI_MESHEXCHANGE_H_
+#define _JALI_MESHEXCHANGE_H_
+
+#include <mpi.h>
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+namespace Jali {
+
+// Collective helpers for moving lists of plain data between the ranks
+// of a communicator, used to redistribute meshes and their data
+
+
+//! Send sendbufs[r] to rank r and return what each rank sent to this
+//! one. T must be copyable bytewise (collective)
+
+template <class T>
+std::vector<std::vector<T>>
+exchange_lists(std::vector<std::vector<T>> const& sendbufs,
+               MPI_Comm const comm) {
+  int nprocs = sendbufs.size();
+  std::vector<int> sendcounts(nprocs), recvcounts(nprocs);
+  for (int r = 0; r < nprocs; r++)
+    sendcounts[r] = sendbufs[r].size()*sizeof(T);
+  MPI_Alltoall(sendcounts.data(), 1, MPI_INT, recvcounts.data(), 1, MPI_INT,
+               comm);
+
+  std::vector<int> senddispls(nprocs+1, 0), recvdispls(nprocs+1, 0);
+  for (int r = 0; r < nprocs; r++) {
+    senddispls[r+1] = senddispls[r] + sendcounts[r];
+    recvdispls[r+1] = recvdispls[r] + recvcounts[r];
+  }
+  std::vector<char> sendbuf(senddispls[nprocs]), recvbuf(recvdispls[nprocs]);
+  for (int r = 0; r < nprocs; r++)
+    if (sendcounts[r])
+      std::copy(reinterpret_cast<char const *>(sendbufs[r].data()),
+                reinterpret_cast<char const *>(sendbufs[r].data()) +
+                sendcounts[r], sendbuf.begin() + senddispls[r]);
+  MPI_Alltoallv(sendbuf.data(), sendcounts.data(), senddispls.data(),
+                MPI_BYTE, recvbuf.data(), recvcounts.data(),
+                recvdispls.data(), MPI_BYTE, comm);
+
+  std::vector<std::vector<T>> recvbufs(nprocs);
+  for (int r = 0; r < nprocs; r++) {
+    recvbufs[r].resize(recvcounts[r]/sizeof(T));
+    if (recvcounts[r])
+      std::copy(recvbuf.begin() + recvdispls[r],
+                recvbuf.begin() + recvdispls[r+1],
+                reinterpret_cast<char *>(recvbufs[r].data()));
+  }
+  return recvbufs;
+}
+
+
+//! Look up values by integer key (e.g. a global ID) across ranks.
+//! Every rank registers the values of the keys it knows and asks for
+//! the values of 'queries'; unregistered keys give 'missing'. The
+//! directory is spread over the ranks by key modulo the number of
+//! ranks, so only registered and queried keys are communicated
+//! (collective)
+
+template <class V>
+std::vector<V> directory_lookup(std::vector<int> const& keys,
+                                std::vector<V> const& values,
+                                std::vector<int> const& queries,
+                                V const& missing, MPI_Comm const comm) {
+  int nprocs;
+  MPI_Comm_size(comm, &nprocs);
+
+  std::vector<std::vector<int>> keybufs(nprocs);
+  std::vector<std::vector<V>> valbufs(nprocs);
+  for (int i = 0; i < static_cast<int>(keys.size()); i++) {
+    keybufs[keys[i] % nprocs].push_back(keys[i]);
+    valbufs[keys[i] % nprocs].push_back(values[i]);
+  }
+  std::vector<std::vector<int>> regkeys = exchange_lists(keybufs, comm);
+  std::vector<std::vector<V>> regvals = exchange_lists(valbufs, comm);
+
+  std::unordered_map<int, V> directory;
+  for (int r = 0; r < nprocs; r++)
+    for (int i = 0; i < static_cast<int>(regkeys[r].size()); i++)
+      directory[regkeys[r][i]] = regvals[r][i];
+
+  for (auto& buf : keybufs)
+    buf.clear();
+  for (auto const& key : queries)
+    keybufs[key % nprocs].push_back(key);
+  std::vector<std::vector<int>> asked = exchange_lists(keybufs, comm);
+
+  for (int r = 0; r < nprocs; r++) {
+    valbufs[r].clear();
+    for (auto const& key : asked[r]) {
+      auto it = directory.find(key);
+      valbufs[r].push_back(it == directory.end() ? missing : it->second);
+    }
+  }
+  std::vector<std::vector<V>> answers = exchange_lists(valbufs, comm);
+
+  // Answers come back from each directory rank in query order
+
+  std::vector<V> result(queries.size());
+  std::vector<int> next(nprocs, 0);
+  for (int i = 0; i < static_cast<int>(queries.size()); i++) {
+    int r = queries[i] % nprocs;
+    result[i] = answers[r][next[r]++];
+  }
+  return result;
+}
+
+}  // close namespace Jali
+
+#endif  // _JALI_MESHEXCHANGE_H_
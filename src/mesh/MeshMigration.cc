@@ -0,0 +1,172 @@
+/*
+ Copyright (c) 2019, Triad National Security, LLC
+ All rights reserved.
+
+ Copyright 2019. Triad National Security, LLC. This software was
+ produced under U.S. Government contract 89233218CNA000001 for Los
+ Alamos National Laboratory (LANL), which is operated by Triad
+ National Security, LLC for the U.S. Department of Energy. 
+ All rights in the program are reserved by Triad National Security,
+ LLC, and the U.S. Department of Energy/National Nuclear Security
+ Administration. The Government is granted for itself and others acting
+ on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+ in this material to reproduce, prepare derivative works, distribute
+ copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+
+ 
+ This is open source software distributed under the 3-clause BSD license.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of Triad National Security, LLC, Los Alamos
+    National Laboratory, LANL, the U.S. Government, nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ 
+ THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+ BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#include "MeshMigration.hh"
+
+#include <mpi.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Mesh.hh"
+#include "MeshExchange.hh"
+
+#include "errors.hh"
+
+namespace Jali {
+
+namespace {
+
+// Global IDs of the entities of a kind and type in local ID order
+// (owned entities come first in every framework, so the owned
+// entities are the first ones of the ALL list); non-owned entities
+// get -1 if only owned entities are wanted
+
+std::vector<int> transfer_gids(Mesh const& mesh, Entity_kind const kind,
+                               Entity_type const type, bool owned_only) {
+  if ((kind != Entity_kind::NODE && kind != Entity_kind::EDGE &&
+       kind != Entity_kind::FACE && kind != Entity_kind::CELL) ||
+      (type != Entity_type::ALL && type != Entity_type::PARALLEL_OWNED)) {
+    Errors::Message mesg("EntityTransfer: can only move data on all or"
+                         " owned nodes, edges, faces or cells");
+    Exceptions::Jali_throw(mesg);
+  }
+
+  int n = mesh.num_entities(kind, type);
+  std::vector<int> gids(n);
+  for (int i = 0; i < n; i++)
+    gids[i] = (owned_only &&
+               mesh.entity_get_type(kind, i) != Entity_type::PARALLEL_OWNED) ?
+        -1 : mesh.GID(i, kind);
+  return gids;
+}
+
+}  // namespace
+
+
+EntityTransfer::EntityTransfer(Mesh const& oldmesh, Mesh const& newmesh,
+                               Entity_kind const kind,
+                               Entity_type const type) :
+    comm_(newmesh.get_comm()) {
+  setup_(transfer_gids(oldmesh, kind, type, true),
+         transfer_gids(newmesh, kind, type, false));
+}
+
+
+EntityTransfer::EntityTransfer(MPI_Comm const comm,
+                               std::vector<int> const& src_gids,
+                               std::vector<int> const& dst_gids) :
+    comm_(comm) {
+  setup_(src_gids, dst_gids);
+}
+
+
+// Find the rank and index of the source of every destination element
+// through a directory of the source global IDs and tell the source
+// ranks which elements to send
+
+void EntityTransfer::setup_(std::vector<int> const& src_gids,
+                            std::vector<int> const& dst_gids) {
+  int nprocs, rank;
+  MPI_Comm_size(comm_, &nprocs);
+  MPI_Comm_rank(comm_, &rank);
+
+  num_sources_ = src_gids.size();
+  std::vector<int> keys;
+  std::vector<std::pair<int, int>> sources;
+  for (int i = 0; i < num_sources_; i++)
+    if (src_gids[i] >= 0) {
+      keys.push_back(src_gids[i]);
+      sources.emplace_back(rank, i);
+    }
+  std::vector<std::pair<int, int>> found =
+      directory_lookup(keys, sources, dst_gids, std::make_pair(-1, -1),
+                       comm_);
+
+  std::vector<std::vector<int>> requests(nprocs);
+  recv_index_.resize(dst_gids.size());
+  num_missing_ = 0;
+  for (int j = 0; j < static_cast<int>(dst_gids.size()); j++) {
+    int r = found[j].first;
+    if (r < 0) {
+      recv_index_[j] = found[j];
+      num_missing_++;
+      continue;
+    }
+    recv_index_[j] = std::make_pair(r, static_cast<int>(requests[r].size()));
+    requests[r].push_back(found[j].second);
+  }
+  send_index_ = exchange_lists(requests, comm_);
+}
+
+
+void EntityTransfer::move(void const *src, void *dst,
+                          std::size_t const elemsize) const {
+  int nprocs = send_index_.size();
+  char const *srcbytes = static_cast<char const *>(src);
+  char *dstbytes = static_cast<char *>(dst);
+
+  std::vector<std::vector<char>> sendbufs(nprocs);
+  for (int r = 0; r < nprocs; r++) {
+    sendbufs[r].resize(send_index_[r].size()*elemsize);
+    for (int k = 0; k < static_cast<int>(send_index_[r].size()); k++)
+      std::memcpy(&(sendbufs[r][k*elemsize]),
+                  srcbytes + send_index_[r][k]*elemsize, elemsize);
+  }
+  std::vector<std::vector<char>> recvbufs = exchange_lists(sendbufs, comm_);
+
+  for (int j = 0; j < static_cast<int>(recv_index_.size()); j++) {
+    int r = recv_index_[j].first;
+    if (r >= 0)
+      std::memcpy(dstbytes + j*elemsize,
+                  &(recvbufs[r][recv_index_[j].second*elemsize]), elemsize);
+  }
+}
+
+}  // namespace Jali
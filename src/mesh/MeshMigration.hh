@@ -0,0 +1,127 @@
+/*
+ Copyright (c) 2019, Triad National Security, LLC
+ All rights reserved.
+
+ Copyright 2019. Triad National Security, LLC. This software was
+ produced under U.S. Government contract 89233218CNA000001 for Los
+ Alamos National Laboratory (LANL), which is operated by Triad
+ National Security, LLC for the U.S. Department of Energy. 
+ All rights in the program are reserved by Triad National Security,
+ LLC, and the U.S. Department of Energy/National Nuclear Security
+ Administration. The Government is granted for itself and others acting
+ on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+ in this material to reproduce, prepare derivative works, distribute
+ copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+
+ 
+ This is open source software distributed under the 3-clause BSD license.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of Triad National Security, LLC, Los Alamos
+    National Laboratory, LANL, the U.S. Government, nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ 
+ THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+ BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#ifndef _JALI_MESHMIGRATION_H_
+#define _JALI_MESHMIGRATION_H_
+
+#include <mpi.h>
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "MeshDefs.hh"
+
+namespace Jali {
+
+class Mesh;
+
+/*!
+  @class EntityTransfer "MeshMigration.hh"
+  @brief Moves data on mesh entities to a redistributed mesh
+
+  Entities are matched by global ID. Every source element with a
+  global ID sends its data to all the destination elements with that
+  ID, on whichever rank they are, so ghost copies on the new mesh are
+  filled as well. The pattern is set up once and can move any number
+  of arrays of plain data (collective).
+*/
+
+class EntityTransfer {
+ public:
+  //! Data on the entities of a kind and type (ALL or PARALLEL_OWNED)
+  //! of oldmesh, indexed like the entities, to the same kind and
+  //! type on newmesh; only owned entities of oldmesh are sources.
+  //! Supports nodes, edges, faces and cells
+  EntityTransfer(Mesh const& oldmesh, Mesh const& newmesh,
+                 Entity_kind const kind,
+                 Entity_type const type = Entity_type::ALL);
+
+  //! Data on elements with global IDs src_gids to elements with
+  //! global IDs dst_gids; source elements with a negative ID send
+  //! nothing and each ID must have at most one source element
+  EntityTransfer(MPI_Comm const comm, std::vector<int> const& src_gids,
+                 std::vector<int> const& dst_gids);
+
+  //! Number of source and destination elements on this rank
+  int num_sources() const { return num_sources_; }
+  int num_destinations() const { return recv_index_.size(); }
+
+  //! Number of destination elements on this rank whose global ID has
+  //! no source (these are left unchanged by move)
+  int num_missing() const { return num_missing_; }
+
+  //! Copy elements of elemsize bytes from the source array to the
+  //! destination array (collective)
+  void move(void const *src, void *dst, std::size_t const elemsize) const;
+
+  //! Copy a vector of plain data, resizing the destination (collective)
+  template <class T>
+  void move(std::vector<T> const& src, std::vector<T> *dst) const {
+    dst->resize(num_destinations());
+    move(src.data(), dst->data(), sizeof(T));
+  }
+
+ private:
+  void setup_(std::vector<int> const& src_gids,
+              std::vector<int> const& dst_gids);
+
+  MPI_Comm comm_;
+  int num_sources_ = 0, num_missing_ = 0;
+
+  // Source elements to send to each rank, in the order that rank
+  // expects them
+  std::vector<std::vector<int>> send_index_;
+
+  // Rank and position in its message of the data for each
+  // destination element (-1 if missing)
+  std::vector<std::pair<int, int>> recv_index_;
+};
+
+}  // namespace Jali
+
+#endif  // _JALI_MESHMIGRATION_H_
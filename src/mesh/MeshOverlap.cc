@@ -0,0 +1,409 @@
+/*
+ Copyright (c) 2019, Triad National Security, LLC
+ All rights reserved.
+
+ Copyright 2019. Triad National Security, LLC. This software was
+ produced under U.S. Government contract 89233218CNA000001 for Los
+ Alamos National Laboratory (LANL), which is operated by Triad
+ National Security, LLC for the U.S. Department of Energy. 
+ All rights in the program are reserved by Triad National Security,
+ LLC, and the U.S. Department of Energy/National Nuclear Security
+ Administration. The Government is granted for itself and others acting
+ on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+ in this material to reproduce, prepare derivative works, distribute
+ copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+
+ 
+ This is open source software distributed under the 3-clause BSD license.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of Triad National Security, LLC, Los Alamos
+    National Laboratory, LANL, the U.S. Government, nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ 
+ THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+ BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#include "MeshOverlap.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <exception>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Mesh.hh"
+#include "Geometry.hh"
+
+#include "errors.hh"
+
+namespace Jali {
+
+namespace {
+
+using JaliGeometry::Point;
+typedef std::vector<Point> Polygon;
+
+// Each thread clips the candidates of at least this many target cells
+
+constexpr int kMinTargetsPerThread = 256;
+
+// Half space of points p with (p - point)*normal <= 0, normal being
+// a unit vector
+
+struct HalfSpace {
+  Point point, normal;
+};
+
+// Clip a polygon (in 2D) by a half space; points within tol of the
+// boundary count as on it
+
+void clip_polygon(HalfSpace const& h, double const tol, Polygon *polygon) {
+  int np = polygon->size();
+  std::vector<double> dist(np);
+  bool any_in = false, any_out = false;
+  for (int i = 0; i < np; i++) {
+    dist[i] = ((*polygon)[i] - h.point)*h.normal;
+    if (std::fabs(dist[i]) <= tol) dist[i] = 0.0;
+    any_in = any_in || dist[i] < 0.0;
+    any_out = any_out || dist[i] > 0.0;
+  }
+  if (!any_out) return;
+  if (!any_in) {
+    polygon->clear();
+    return;
+  }
+
+  Polygon clipped;
+  for (int i = 0; i < np; i++) {
+    int j = (i+1) % np;
+    Point const& p = (*polygon)[i];
+    Point const& q = (*polygon)[j];
+    if (dist[i] <= 0.0) clipped.push_back(p);
+    if ((dist[i] < 0.0 && dist[j] > 0.0) || (dist[i] > 0.0 && dist[j] < 0.0))
+      clipped.push_back(p + (dist[i]/(dist[i]-dist[j]))*(q-p));
+  }
+  polygon->swap(clipped);
+}
+
+// Clip a polyhedron, given by its faces oriented outward, by a half
+// space. The clipped faces are closed by a cap polygon on the plane
+// (which is convex if the polyhedron is)
+
+void clip_polyhedron(HalfSpace const& h, double const tol,
+                     std::vector<Polygon> *faces) {
+  bool any_in = false, any_out = false;
+  for (auto const& face : *faces)
+    for (auto const& p : face) {
+      double d = (p - h.point)*h.normal;
+      any_in = any_in || d < -tol;
+      any_out = any_out || d > tol;
+    }
+  if (!any_out) return;
+  if (!any_in) {
+    faces->clear();
+    return;
+  }
+
+  std::vector<Polygon> clipped;
+  Polygon cap;
+  for (auto const& face : *faces) {
+    Polygon polygon = face;
+    int np = polygon.size();
+    for (int i = 0; i < np; i++) {
+      double d = (polygon[i] - h.point)*h.normal;
+      double dnext = (polygon[(i+1) % np] - h.point)*h.normal;
+      if (std::fabs(d) <= tol)
+        cap.push_back(polygon[i]);
+      else if ((d < -tol && dnext > tol) || (d > tol && dnext < -tol))
+        cap.push_back(polygon[i] +
+                      (d/(d-dnext))*(polygon[(i+1) % np]-polygon[i]));
+    }
+    clip_polygon(h, tol, &polygon);
+    if (polygon.size() >= 3) clipped.push_back(polygon);
+  }
+
+  // Order the cap points counterclockwise about the normal of the
+  // plane (which points out of the clipped polyhedron), dropping
+  // repeated points
+
+  if (cap.size() >= 3) {
+    Point center(3);
+    for (auto const& p : cap) center += p;
+    center /= cap.size();
+
+    Point u = cap[0] - center;
+    for (auto const& p : cap)
+      if (norm(p - center) > norm(u)) u = p - center;
+    u -= (u*h.normal)*h.normal;
+    u /= norm(u);
+    Point v = h.normal^u;
+
+    std::vector<std::pair<double, int>> angles(cap.size());
+    for (int i = 0; i < cap.size(); i++)
+      angles[i] = std::make_pair(std::atan2((cap[i]-center)*v,
+                                            (cap[i]-center)*u), i);
+    std::sort(angles.begin(), angles.end());
+
+    Polygon ordered;
+    for (auto const& a : angles) {
+      Point const& p = cap[a.second];
+      if (ordered.empty() || norm(p - ordered.back()) > tol)
+        ordered.push_back(p);
+    }
+    if (ordered.size() > 1 && norm(ordered.front() - ordered.back()) <= tol)
+      ordered.pop_back();
+    if (ordered.size() >= 3) clipped.push_back(ordered);
+  }
+  faces->swap(clipped);
+}
+
+// Largest extent of the bounding box of points
+
+double extent(Polygon const& points) {
+  if (points.empty()) return 0.0;
+  int dim = points[0].dim();
+  double ext = 0.0;
+  for (int d = 0; d < dim; d++) {
+    double lo = points[0][d], hi = points[0][d];
+    for (auto const& p : points) {
+      lo = std::min(lo, p[d]);
+      hi = std::max(hi, p[d]);
+    }
+    ext = std::max(ext, hi-lo);
+  }
+  return ext;
+}
+
+// What the clipping needs of a cell, copied out of its mesh so that
+// the volumes can be computed on threads that do not touch the mesh
+// (mesh frameworks such as MSTK are not thread safe): its node
+// coordinates, in 3D its faces oriented outward if it is clipped and
+// the half spaces bounded by its faces (whose intersection is the
+// cell if it is convex with planar faces) if it clips
+
+struct CellShape {
+  Polygon coords;
+  std::vector<Polygon> faces;
+  std::vector<HalfSpace> halfspaces;
+};
+
+CellShape clipped_shape(Mesh const& mesh, Entity_ID const c, int const dim) {
+  CellShape shape;
+  mesh.cell_get_coordinates(c, &shape.coords);
+  if (dim == 3) {
+    Entity_ID_List faces;
+    std::vector<dir_t> dirs;
+    mesh.cell_get_faces_and_dirs(c, &faces, &dirs);
+    shape.faces.resize(faces.size());
+    for (int i = 0; i < faces.size(); i++) {
+      mesh.face_get_coordinates(faces[i], &shape.faces[i]);
+      if (dirs[i] != 1)
+        std::reverse(shape.faces[i].begin(), shape.faces[i].end());
+    }
+  }
+  return shape;
+}
+
+CellShape clipping_shape(Mesh const& mesh, Entity_ID const c,
+                         int const dim) {
+  CellShape shape;
+  mesh.cell_get_coordinates(c, &shape.coords);
+  if (dim > 1) {
+    Entity_ID_List faces;
+    mesh.cell_get_faces(c, &faces);
+    shape.halfspaces.resize(faces.size());
+    for (int i = 0; i < faces.size(); i++) {
+      HalfSpace& h = shape.halfspaces[i];
+      h.point = mesh.face_centroid(faces[i]);
+      h.normal = mesh.face_normal(faces[i], false, c);
+      h.normal /= norm(h.normal);
+    }
+  }
+  return shape;
+}
+
+// Volume of the intersection of the source cell with the target cell
+
+double shape_intersection_volume(int const dim, CellShape const& source,
+                                 CellShape const& target) {
+  double tol = 1.0e-12*std::max(extent(source.coords),
+                                extent(target.coords));
+
+  if (dim == 1) {
+    Polygon const& s = source.coords;
+    Polygon const& t = target.coords;
+    double lo = std::max(std::min(s[0][0], s[1][0]),
+                         std::min(t[0][0], t[1][0]));
+    double hi = std::min(std::max(s[0][0], s[1][0]),
+                         std::max(t[0][0], t[1][0]));
+    return std::max(0.0, hi-lo);
+  }
+
+  if (dim == 2) {
+    Polygon polygon = source.coords;
+    for (auto const& h : target.halfspaces) {
+      clip_polygon(h, tol, &polygon);
+      if (polygon.size() < 3) return 0.0;
+    }
+    double area;
+    Point centroid(2), normal(2);
+    JaliGeometry::polygon_get_area_centroid_normal(polygon, &area,
+                                                   &centroid, &normal);
+    return area;
+  }
+
+  std::vector<Polygon> polyhedron = source.faces;
+  for (auto const& h : target.halfspaces) {
+    clip_polyhedron(h, tol, &polyhedron);
+    if (polyhedron.size() < 4) return 0.0;
+  }
+
+  // The kernel reports the volume as negative if any of its tets is
+  // inverted, which flat slivers left by clipping can be
+
+  Polygon fcoords;
+  std::vector<unsigned int> nfnodes;
+  for (auto const& face : polyhedron) {
+    fcoords.insert(fcoords.end(), face.begin(), face.end());
+    nfnodes.push_back(face.size());
+  }
+  double volume;
+  Point centroid(3);
+  JaliGeometry::polyhed_get_vol_centroid(fcoords, polyhedron.size(), nfnodes,
+                                         fcoords, &volume, &centroid);
+  return std::fabs(volume);
+}
+
+void check_solid_meshes(Mesh const& source, Mesh const& target,
+                        std::string const& caller) {
+  int dim = source.manifold_dimension();
+  if (dim != target.manifold_dimension() ||
+      source.space_dimension() != dim || target.space_dimension() != dim) {
+    Errors::Message mesg(caller + ": the meshes must be solid meshes of"
+                         " the same dimension");
+    Exceptions::Jali_throw(mesg);
+  }
+}
+
+}  // namespace
+
+
+double intersection_volume(Mesh const& source, Entity_ID const sourcecell,
+                           Mesh const& target, Entity_ID const targetcell) {
+  check_solid_meshes(source, target, "intersection_volume");
+  int dim = source.manifold_dimension();
+  return shape_intersection_volume(dim,
+                                   clipped_shape(source, sourcecell, dim),
+                                   clipping_shape(target, targetcell, dim));
+}
+
+
+void overlap_candidates(Mesh const& source, Mesh const& target,
+                        Entity_ID_List const& targetcells,
+                        std::vector<int> *offsets,
+                        Entity_ID_List *sourcecells,
+                        std::vector<double> *volumes,
+                        int const numthreads) {
+  int dim = source.space_dimension();
+  if (target.space_dimension() != dim) {
+    Errors::Message mesg("overlap_candidates: the meshes must be in spaces"
+                         " of the same dimension");
+    Exceptions::Jali_throw(mesg);
+  }
+  if (volumes) check_solid_meshes(source, target, "overlap_candidates");
+
+  // The candidates come from the spatial index of the source mesh,
+  // queried on this thread like everything else touching the meshes
+
+  int ntargets = targetcells.size();
+  offsets->assign(1, 0);
+  offsets->reserve(ntargets+1);
+  sourcecells->clear();
+  std::vector<CellShape> targetshapes;
+  if (volumes) targetshapes.reserve(ntargets);
+  Entity_ID_List cells;
+  Polygon tcoords;
+  for (int i = 0; i < ntargets; i++) {
+    target.cell_get_coordinates(targetcells[i], &tcoords);
+    Point lo = tcoords[0], hi = tcoords[0];
+    for (auto const& p : tcoords)
+      for (int d = 0; d < dim; d++) {
+        lo[d] = std::min(lo[d], p[d]);
+        hi[d] = std::max(hi[d], p[d]);
+      }
+    source.cells_intersecting_box(lo, hi, &cells);
+    offsets->push_back(offsets->back() + cells.size());
+    sourcecells->insert(sourcecells->end(), cells.begin(), cells.end());
+    if (volumes)
+      targetshapes.push_back(clipping_shape(target, targetcells[i], dim));
+  }
+  if (!volumes) return;
+
+  // Shapes of the candidate source cells
+
+  std::vector<int> shapeindex(source.num_cells<Entity_type::ALL>(), -1);
+  std::vector<CellShape> sourceshapes;
+  for (auto const& c : *sourcecells)
+    if (shapeindex[c] < 0) {
+      shapeindex[c] = sourceshapes.size();
+      sourceshapes.push_back(clipped_shape(source, c, dim));
+    }
+
+  // Each thread clips the candidates of a contiguous range of the
+  // target cells, using only the shapes
+
+  int nhw = static_cast<int>(std::thread::hardware_concurrency());
+  int nthreads = numthreads > 0 ? numthreads :
+      std::max(1, std::min(nhw, ntargets/kMinTargetsPerThread));
+
+  volumes->assign(sourcecells->size(), 0.0);
+  std::vector<std::exception_ptr> errors(nthreads);
+  auto clip = [&](int t) {
+    try {
+      int i0 = ntargets*std::int64_t(t)/nthreads;
+      int i1 = ntargets*std::int64_t(t+1)/nthreads;
+      for (int i = i0; i < i1; i++)
+        for (int j = (*offsets)[i]; j < (*offsets)[i+1]; j++)
+          (*volumes)[j] = shape_intersection_volume(
+              dim, sourceshapes[shapeindex[(*sourcecells)[j]]],
+              targetshapes[i]);
+    } catch (...) {
+      errors[t] = std::current_exception();
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (int t = 1; t < nthreads; t++)
+    workers.emplace_back(clip, t);
+  clip(0);
+  for (auto& w : workers)
+    w.join();
+  for (auto const& e : errors)
+    if (e) std::rethrow_exception(e);
+}
+
+}  // namespace Jali
@@ -0,0 +1,100 @@
+/*
+ Copyright (c) 2019, Triad National Security, LLC
+ All rights reserved.
+
+ Copyright 2019. Triad National Security, LLC. This software was
+ produced under U.S. Government contract 89233218CNA000001 for Los
+ Alamos National Laboratory (LANL), which is operated by Triad
+ National Security, LLC for the U.S. Department of Energy. 
+ All rights in the program are reserved by Triad National Security,
+ LLC, and the U.S. Department of Energy/National Nuclear Security
+ Administration. The Government is granted for itself and others acting
+ on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+ in this material to reproduce, prepare derivative works, distribute
+ copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+
+ 
+ This is open source software distributed under the 3-clause BSD license.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of Triad National Security, LLC, Los Alamos
+    National Laboratory, LANL, the U.S. Government, nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ 
+ THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+ BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef _JALI_MESHOVERLAP_H_
+#define _JALI_MESHOVERLAP_H_
+
+#include <vector>
+
+#include "MeshDefs.hh"
+
+namespace Jali {
+
+class Mesh;
+
+/*!
+  @brief Source cells that may overlap each of a list of target cells
+
+  For remapping between two meshes: the candidates for targetcells[i]
+  are sourcecells[offsets[i]] through sourcecells[offsets[i+1]-1], in
+  ascending order (the compressed row storage of the batch adjacency
+  queries of Mesh). They are the source cells whose bounding boxes
+  overlap that of the target cell, found through the spatial index
+  of the source mesh.
+
+  Only the source cells on this rank (owned and ghost) are searched,
+  so the part of the source mesh on each rank has to cover the part
+  of the target mesh there - as for meshes of the same domain with
+  the same partitioning, or with enough ghost layers.
+
+  If volumes is not NULL, volumes[j] is the volume (area in 2D) of
+  the intersection of sourcecells[j] with its target cell, from
+  clipping the source cell by the faces of the target cell. This is
+  exact for convex target cells with planar faces. The geometry of
+  the cells is copied out of the meshes on the calling thread, which
+  then clips with nthreads threads or, if nthreads is 0, as many as
+  the hardware supports with at least 256 target cells each. The
+  meshes are only used from the calling thread and the results do
+  not depend on the number of threads.
+*/
+
+void overlap_candidates(Mesh const& source, Mesh const& target,
+                        Entity_ID_List const& targetcells,
+                        std::vector<int> *offsets,
+                        Entity_ID_List *sourcecells,
+                        std::vector<double> *volumes = nullptr,
+                        int const nthreads = 0);
+
+//! Volume (area in 2D, length in 1D) of the intersection of a cell of
+//! the source mesh with a convex cell of the target mesh
+double intersection_volume(Mesh const& source, Entity_ID const sourcecell,
+                           Mesh const& target, Entity_ID const targetcell);
+
+}  // namespace Jali
+
+#endif  // _JALI_MESHOVERLAP_H_
@@ -0,0 +1,205 @@
+/*
+ Copyright (c) 2019, Triad National Security, LLC
+ All rights reserved.
+
+ Copyright 2019. Triad National Security, LLC. This software was
+ produced under U.S. Government contract 89233218CNA000001 for Los
+ Alamos National Laboratory (LANL), which is operated by Triad
+ National Security, LLC for the U.S. Department of Energy. 
+ All rights in the program are reserved by Triad National Security,
+ LLC, and the U.S. Department of Energy/National Nuclear Security
+ Administration. The Government is granted for itself and others acting
+ on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+ in this material to reproduce, prepare derivative works, distribute
+ copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+
+ 
+ This is open source software distributed under the 3-clause BSD license.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of Triad National Security, LLC, Los Alamos
+    National Laboratory, LANL, the U.S. Government, nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ 
+ THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+ BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef _JALI_MESHPARTITIONQUALITY_H_
+#define _JALI_MESHPARTITIONQUALITY_H_
+
+#include <mpi.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+
+namespace Jali {
+
+/*!
+  @struct PartitionQuality "MeshPartitionQuality.hh"
+  @brief Summary of how the owned cells of a mesh are divided into parts
+
+  The parts are either the tiles on a rank (Mesh::tile_partition_quality)
+  or the ranks of the mesh communicator (Mesh::rank_partition_quality,
+  which describes the calling rank as a single part). Summaries of
+  disjoint sets of parts are merged with 'combine', and
+  'global_partition_quality' merges the summaries of all ranks, so
+  that e.g. the tile summaries of all ranks give the quality of all
+  tiles in the run.
+
+  Weights are the cell weights passed in by the caller, or cell counts
+  if none were given. A face is shared by two parts if its two cells
+  are owned by different parts, so the edge cut of the face adjacency
+  graph is half the total number of shared faces.
+*/
+
+struct PartitionQuality {
+  int num_parts = 0;
+
+  // Owned cells per part
+  int min_cells = 0, max_cells = 0;
+  std::int64_t total_cells = 0;
+
+  // Weight of owned cells per part
+  double min_weight = 0.0, max_weight = 0.0, total_weight = 0.0;
+
+  // Ghost cells (tile halo cells or MPI ghost cells) of all parts
+  std::int64_t ghost_cells = 0;
+
+  // Faces of each part shared with other parts, summed over parts
+  std::int64_t shared_faces = 0;
+
+  // Parts sharing at least one face with a part
+  int min_neighbors = 0, max_neighbors = 0;
+  std::int64_t total_neighbors = 0;
+
+  double mean_cells() const {
+    return num_parts ? static_cast<double>(total_cells)/num_parts : 0.0;
+  }
+
+  double mean_weight() const {
+    return num_parts ? total_weight/num_parts : 0.0;
+  }
+
+  //! Maximum over mean part weight (1 is perfect balance)
+  double imbalance() const {
+    return total_weight > 0.0 ? max_weight/mean_weight() : 1.0;
+  }
+
+  //! Ghost cells per owned cell
+  double ghost_ratio() const {
+    return total_cells ? static_cast<double>(ghost_cells)/total_cells : 0.0;
+  }
+
+  //! Faces between owned cells of different parts
+  std::int64_t edge_cut() const { return shared_faces/2; }
+
+  double mean_neighbors() const {
+    return num_parts ? static_cast<double>(total_neighbors)/num_parts : 0.0;
+  }
+
+  //! Merge in the summary of another, disjoint, set of parts
+  void combine(PartitionQuality const& other) {
+    if (!other.num_parts) return;
+    if (!num_parts) {
+      *this = other;
+      return;
+    }
+    num_parts += other.num_parts;
+    min_cells = std::min(min_cells, other.min_cells);
+    max_cells = std::max(max_cells, other.max_cells);
+    total_cells += other.total_cells;
+    min_weight = std::min(min_weight, other.min_weight);
+    max_weight = std::max(max_weight, other.max_weight);
+    total_weight += other.total_weight;
+    ghost_cells += other.ghost_cells;
+    shared_faces += other.shared_faces;
+    min_neighbors = std::min(min_neighbors, other.min_neighbors);
+    max_neighbors = std::max(max_neighbors, other.max_neighbors);
+    total_neighbors += other.total_neighbors;
+  }
+};
+
+
+//! Merge the summaries of all ranks of comm (collective)
+
+inline
+PartitionQuality global_partition_quality(PartitionQuality const& local,
+                                          MPI_Comm const comm) {
+  // Ranks without parts must not contribute to the minima, so negate
+  // the minima and take maxima throughout
+
+  bool empty = (local.num_parts == 0);
+  double const lowest = -1e300;
+  double maxvals[6] = {
+    empty ? lowest : -local.min_cells,
+    empty ? lowest : static_cast<double>(local.max_cells),
+    empty ? lowest : -local.min_weight,
+    empty ? lowest : local.max_weight,
+    empty ? lowest : -local.min_neighbors,
+    empty ? lowest : static_cast<double>(local.max_neighbors)};
+  MPI_Allreduce(MPI_IN_PLACE, maxvals, 6, MPI_DOUBLE, MPI_MAX, comm);
+
+  std::int64_t sums[5] = {local.num_parts, local.total_cells,
+                          local.ghost_cells, local.shared_faces,
+                          local.total_neighbors};
+  MPI_Allreduce(MPI_IN_PLACE, sums, 5, MPI_INT64_T, MPI_SUM, comm);
+
+  double total_weight = local.total_weight;
+  MPI_Allreduce(MPI_IN_PLACE, &total_weight, 1, MPI_DOUBLE, MPI_SUM, comm);
+
+  PartitionQuality global;
+  global.num_parts = static_cast<int>(sums[0]);
+  if (!global.num_parts) return global;
+  global.min_cells = static_cast<int>(-maxvals[0]);
+  global.max_cells = static_cast<int>(maxvals[1]);
+  global.total_cells = sums[1];
+  global.min_weight = -maxvals[2];
+  global.max_weight = maxvals[3];
+  global.total_weight = total_weight;
+  global.ghost_cells = sums[2];
+  global.shared_faces = sums[3];
+  global.min_neighbors = static_cast<int>(-maxvals[4]);
+  global.max_neighbors = static_cast<int>(maxvals[5]);
+  global.total_neighbors = sums[4];
+  return global;
+}
+
+
+//! Print a one line summary
+
+inline
+std::ostream& operator<<(std::ostream& os, PartitionQuality const& q) {
+  os << q.num_parts << " parts, cells " << q.min_cells << "/" <<
+      q.mean_cells() << "/" << q.max_cells << " (min/mean/max), imbalance " <<
+      q.imbalance() << ", ghost ratio " << q.ghost_ratio() << ", edge cut " <<
+      q.edge_cut() << ", neighbors " << q.min_neighbors << "/" <<
+      q.mean_neighbors() << "/" << q.max_neighbors;
+  return os;
+}
+
+}  // close namespace Jali
+
+#endif  // _JALI_MESHPARTITIONQUALITY_H_
@@ -168,7 +168,6 @@ void MeshSet::rem_entity(Entity_ID const& mesh_entity) {
 
 void MeshSet::add_entities(std::vector<Entity_ID> const& in_entities) {
   int nowned_old = entityids_owned_.size();
-  int nghost_old = entityids_ghost_.size();
   int nall = in_entities.size();
   int nowned = 0;
   int nghost = 0;
@@ -183,7 +182,7 @@ void MeshSet::add_entities(std::vector<Entity_ID> const& in_entities) {
     entityids_owned_.insert(entityids_owned_.end(), in_entities.begin(),
                             in_entities.end());
   else if (nall == nghost)
-    entityids_owned_.insert(entityids_ghost_.end(), in_entities.begin(),
+    entityids_ghost_.insert(entityids_ghost_.end(), in_entities.begin(),
                             in_entities.end());
   else
     for (auto const& mesh_entity : in_entities)
@@ -200,19 +199,13 @@ void MeshSet::add_entities(std::vector<Entity_ID> const& in_entities) {
                     entityids_ghost_.end());
     entityids_all_.swap(tmp_list);
   } else
-    entityids_all_.insert(entityids_all_.begin(), in_entities.begin(),
-                          in_entities.end());
+    entityids_all_ = entityids_owned_;
 
   if (have_reverse_map_) {  // have to update mesh to subset map
-    // new owned entities should have gone in after old owned entities
-    int start = nowned_old;
-    for (int i = start; i < start + nowned; i++)
-      mesh2subset_[entityids_all_[i]] = i;
-    
-    // new ghost entities should have gone in after old+new owned
-    // entities and old ghost entities
-    start = nowned_old + nowned + nghost_old;
-    for (int i = start; i < start + nghost; i++)
+    // new owned entities went in after old owned entities, which
+    // shifts the old ghost entities; new ghost entities went in last
+    int nall_new = entityids_all_.size();
+    for (int i = nowned_old; i < nall_new; i++)
       mesh2subset_[entityids_all_[i]] = i;
   }
 }
@@ -308,6 +308,30 @@ MeshTile::MeshTile(Mesh& parent_mesh,
     cornerids_all_.insert(cornerids_all_.end(),
                           cornerids_ghost_.begin(), cornerids_ghost_.end());
   }
+
+  // Split the owned entities of the tile into those that can be
+  // processed without MPI ghost data and those that cannot
+
+  for (auto const& c : cellids_owned_) {
+    if (mesh_.entity_is_owned_interior(Entity_kind::CELL, c))
+      cellids_owned_interior_.emplace_back(c);
+    else
+      cellids_owned_boundary_.emplace_back(c);
+  }
+
+  for (auto const& f : faceids_owned_) {
+    if (mesh_.entity_is_owned_interior(Entity_kind::FACE, f))
+      faceids_owned_interior_.emplace_back(f);
+    else
+      faceids_owned_boundary_.emplace_back(f);
+  }
+
+  for (auto const& n : nodeids_owned_) {
+    if (mesh_.entity_is_owned_interior(Entity_kind::NODE, n))
+      nodeids_owned_interior_.emplace_back(n);
+    else
+      nodeids_owned_boundary_.emplace_back(n);
+  }
 }  // MeshTile::MeshTile
 
 // Standalone function to make a tile and return a pointer to it so
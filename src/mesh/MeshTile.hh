@@ -287,6 +287,54 @@ class MeshTile {
   const & cells() const;
 
 
+  /*!
+    @brief Tile owned cells that do not depend on MPI ghost data
+
+    Tile owned entities are split into those that are interior owned
+    entities of the mesh (see Mesh::cells_owned_interior) and the rest,
+    so that a tile can be processed while a halo exchange is in progress
+  */
+  std::vector<Entity_ID> const & cells_owned_interior() const {
+    return cellids_owned_interior_;
+  }
+
+  /*!
+    @brief Tile owned cells that depend on MPI ghost data
+  */
+  std::vector<Entity_ID> const & cells_owned_boundary() const {
+    return cellids_owned_boundary_;
+  }
+
+  /*!
+    @brief Tile owned faces that do not depend on MPI ghost data
+  */
+  std::vector<Entity_ID> const & faces_owned_interior() const {
+    return faceids_owned_interior_;
+  }
+
+  /*!
+    @brief Tile owned faces that depend on MPI ghost data
+  */
+  std::vector<Entity_ID> const & faces_owned_boundary() const {
+    return faceids_owned_boundary_;
+  }
+
+  /*!
+    @brief Tile owned nodes that do not depend on MPI ghost data
+  */
+  std::vector<Entity_ID> const & nodes_owned_interior() const {
+    return nodeids_owned_interior_;
+  }
+
+  /*!
+    @brief Tile owned nodes that depend on MPI ghost data (includes
+    MPI ghost nodes owned by the tile)
+  */
+  std::vector<Entity_ID> const & nodes_owned_boundary() const {
+    return nodeids_owned_boundary_;
+  }
+
+
   //! Get list of tile entities of type 'kind' and 'ptype' in set ('setname')
 
   void get_set_entities(const Set_Name setname,
@@ -324,6 +372,9 @@ class MeshTile {
   Entity_ID_List wedgeids_owned_, wedgeids_ghost_, wedgeids_all_;
   Entity_ID_List cornerids_owned_, cornerids_ghost_, cornerids_all_;
   Entity_ID_List cellids_owned_, cellids_ghost_, cellids_all_;
+  Entity_ID_List nodeids_owned_interior_, nodeids_owned_boundary_;
+  Entity_ID_List faceids_owned_interior_, faceids_owned_boundary_;
+  Entity_ID_List cellids_owned_interior_, cellids_owned_boundary_;
   Entity_ID_List dummy_list_;
 
   
@@ -50,6 +50,8 @@
 #include "Geometry.hh"
 
 #include "Mesh_simple.hh"
+#include "Mesh_flat.hh"
+#include "Mesh_structured.hh"
 
 #ifdef HAVE_MSTK_MESH
 #include "Mesh_MSTK.hh"
@@ -81,6 +83,12 @@ std::string framework_name(MeshFramework_t const& f) {
     case (MSTK):
       return "MSTK";
       break;
+    case (Flat):
+      return "Flat";
+      break;
+    case (Structured):
+      return "Structured";
+      break;
     default:
       Errors::Message mesg("Unknown framework");
       Exceptions::Jali_throw(mesg);
@@ -90,7 +98,7 @@ std::string framework_name(MeshFramework_t const& f) {
 
 /// Check if a framework is available for use
 bool framework_available(MeshFramework_t const& f) {
-  if (f == Simple || f == MSTK)
+  if (f == Simple || f == MSTK || f == Flat || f == Structured)
     return true;
   else
     return false;
@@ -106,6 +114,9 @@ bool framework_generates(MeshFramework_t const& f, bool const parallel,
       return (dim == 2 || dim == 3);
     case Jali::STKMESH:
       return (dim == 3 && !parallel);
+    case Jali::Flat:
+    case Jali::Structured:
+      return (dim >= 1 && dim <= 3);
     default:
       return false;
   }
@@ -120,6 +131,8 @@ bool framework_reads(MeshFramework_t const& f, bool const parallel,
       return (format == Jali::ExodusII && !parallel);
     case Jali::MOAB:
       return (format == Jali::MOABHDF5);
+    case Jali::Flat:
+      return (format == Jali::JaliFlat);
     default:
       return false;
   }
@@ -177,6 +190,73 @@ void MeshFactory::reset_options(void) {
 
   /// Continuous GIDs
   contiguous_gids_ = false;
+
+  /// Derived entity cache file
+  derived_cache_file_.clear();
+
+  /// Freezing
+  freeze_ = false;
+}
+
+
+// Create a mesh without sides, wedges and corners and then read them
+// (along with their geometric quantities) from the derived entity
+// cache file, or compute them and write the file if it does not
+// match. If meshes are to be frozen, create the framework mesh with
+// just the faces and edges needed and copy it into a flat mesh,
+// releasing the framework mesh
+
+std::shared_ptr<Mesh>
+MeshFactory::create_and_finish(
+    std::function<std::shared_ptr<Mesh>()> const& creator) {
+  bool request_sides = request_sides_, request_wedges = request_wedges_;
+  bool request_corners = request_corners_;
+  bool use_cache = (!derived_cache_file_.empty() && !num_tiles_ &&
+                    (request_sides || request_wedges || request_corners));
+  if (!use_cache && !freeze_)
+    return creator();
+
+  bool request_faces = request_faces_, request_edges = request_edges_;
+  int num_tiles = num_tiles_;
+  request_faces_ = true;  // sides and frozen meshes need these
+  request_edges_ = (request_edges || request_sides || request_wedges ||
+                    request_corners);
+  request_sides_ = request_wedges_ = request_corners_ = false;
+  if (freeze_) num_tiles_ = 0;  // tiles are built on the frozen mesh
+
+  auto restore_requests = [&]() {
+    request_faces_ = request_faces;
+    request_edges_ = request_edges;
+    request_sides_ = request_sides;
+    request_wedges_ = request_wedges;
+    request_corners_ = request_corners;
+    num_tiles_ = num_tiles;
+  };
+
+  std::shared_ptr<Mesh> mesh;
+  try {
+    mesh = creator();
+  } catch (...) {
+    restore_requests();
+    throw;
+  }
+  restore_requests();
+
+  if (mesh && freeze_)
+    mesh = std::make_shared<Mesh_flat>(*mesh, geometric_model_,
+                                       request_faces, request_edges,
+                                       use_cache ? false : request_sides,
+                                       use_cache ? false : request_wedges,
+                                       use_cache ? false : request_corners,
+                                       num_tiles_, num_ghost_layers_tile_,
+                                       num_ghost_layers_distmesh_,
+                                       request_boundary_ghosts_,
+                                       partitioner_);
+
+  if (mesh && use_cache)
+    mesh->cache_derived_entities(request_sides, request_wedges,
+                                 request_corners, derived_cache_file_);
+  return mesh;
 }
 
 /**
@@ -193,9 +273,38 @@ MeshFactory::create(std::string const& filename) {
 
   std::shared_ptr<Mesh> result;
   try {
-    switch (framework_) {
+    // Native flat binary files are mapped directly whatever the
+    // chosen framework
+
+    MeshFramework_t framework = framework_;
+    if (is_flat_mesh_file(filename, comm_))
+      framework = Flat;
+    switch (framework) {
+      case Flat: {
+        result =
+            std::make_shared<Mesh_flat>(filename, comm_, geometric_model_,
+                                        request_faces_, request_edges_,
+                                        request_sides_, request_wedges_,
+                                        request_corners_,
+                                        num_tiles_, num_ghost_layers_tile_,
+                                        num_ghost_layers_distmesh_,
+                                        request_boundary_ghosts_,
+                                        partitioner_);
+        if (geometric_model_ &&
+            (geometric_model_->dimension() != result->space_dimension())) {
+          errmsg.add_data("Geometric model and mesh dimension do not match");
+          Exceptions::Jali_throw(errmsg);
+        }
+        return result;
+        break;
+      }
 #ifdef HAVE_MSTK_MESH
       case MSTK: {        
+        // MSTK cannot partition by index, so files are distributed
+        // with the default partitioner unless another one was chosen
+        Partitioner_type partitioner =
+            (partitioner_ == Partitioner_type::INDEX) ? PARTITIONER_DEFAULT :
+            partitioner_;
         result =
             std::make_shared<Mesh_MSTK>(filename, comm_, geometric_model_,
                                         request_faces_, request_edges_,
@@ -204,7 +313,7 @@ MeshFactory::create(std::string const& filename) {
                                         num_tiles_, num_ghost_layers_tile_,
                                         num_ghost_layers_distmesh_,
                                         request_boundary_ghosts_,
-                                        partitioner_, contiguous_gids_,
+                                        partitioner, contiguous_gids_,
                                         geom_type_);
         if (geometric_model_ &&
             (geometric_model_->dimension() != result->space_dimension())) {
@@ -322,6 +431,34 @@ MeshFactory::create(double const x0, double const y0, double const z0,
         return result;
       }
 #endif
+      case Flat: {
+        result =
+            std::make_shared<Mesh_flat>(x0, y0, z0, x1, y1, z1, nx, ny, nz,
+                                        comm_, geometric_model_,
+                                        request_faces_, request_edges_,
+                                        request_sides_, request_wedges_,
+                                        request_corners_,
+                                        num_tiles_, num_ghost_layers_tile_,
+                                        num_ghost_layers_distmesh_,
+                                        request_boundary_ghosts_,
+                                        partitioner_);
+        return result;
+      }
+      case Structured: {
+        result =
+            std::make_shared<Mesh_structured>(x0, y0, z0, x1, y1, z1,
+                                              nx, ny, nz,
+                                              comm_, geometric_model_,
+                                              request_faces_, request_edges_,
+                                              request_sides_, request_wedges_,
+                                              request_corners_,
+                                              num_tiles_,
+                                              num_ghost_layers_tile_,
+                                              num_ghost_layers_distmesh_,
+                                              request_boundary_ghosts_,
+                                              partitioner_);
+        return result;
+      }
       default:
         ierr = 1;
         errmsg.add_data("Chosen framework cannot generate meshes");
@@ -427,7 +564,35 @@ MeshFactory::create(double const x0, double const y0,
         return result;
       }
 #endif
+      case Flat: {
+        result =
+            std::make_shared<Mesh_flat>(x0, y0, x1, y1, nx, ny,
+                                        comm_, geometric_model_,
+                                        request_faces_, request_edges_,
+                                        request_sides_, request_wedges_,
+                                        request_corners_,
+                                        num_tiles_, num_ghost_layers_tile_,
+                                        num_ghost_layers_distmesh_,
+                                        request_boundary_ghosts_,
+                                        partitioner_, geom_type_);
+        return result;
+      }
+      case Structured: {
+        result =
+            std::make_shared<Mesh_structured>(x0, y0, x1, y1, nx, ny,
+                                              comm_, geometric_model_,
+                                              request_faces_, request_edges_,
+                                              request_sides_, request_wedges_,
+                                              request_corners_,
+                                              num_tiles_,
+                                              num_ghost_layers_tile_,
+                                              num_ghost_layers_distmesh_,
+                                              request_boundary_ghosts_,
+                                              partitioner_, geom_type_);
+        return result;
+      }
       default: {
+        ierr = 1;
         errmsg.add_data("Chosen framework cannnot generate meshes");        
       }
     }
@@ -507,6 +672,31 @@ MeshFactory::create(std::vector<double> const& x) {
         }
         break;
       }
+      case Flat: {
+        result =
+            std::make_shared<Mesh_flat>(x, comm_, geometric_model_,
+                                        request_faces_, request_edges_,
+                                        request_sides_, request_wedges_,
+                                        request_corners_,
+                                        num_tiles_, num_ghost_layers_tile_,
+                                        num_ghost_layers_distmesh_,
+                                        request_boundary_ghosts_,
+                                        partitioner_, geom_type_);
+        return result;
+      }
+      case Structured: {
+        result =
+            std::make_shared<Mesh_structured>(x, comm_, geometric_model_,
+                                              request_faces_, request_edges_,
+                                              request_sides_, request_wedges_,
+                                              request_corners_,
+                                              num_tiles_,
+                                              num_ghost_layers_tile_,
+                                              num_ghost_layers_distmesh_,
+                                              request_boundary_ghosts_,
+                                              partitioner_, geom_type_);
+        return result;
+      }
       default: {
         ierr = 1;
         errmsg.add_data("Chosen framework cannot generate 1D mesh");
@@ -590,4 +780,23 @@ MeshFactory::create(std::shared_ptr<Mesh> const inmesh,
   return nullptr;
 }
 
+
+// Compute the new rank of every owned cell and build the part of the
+// redistributed mesh that lands on this rank
+
+std::shared_ptr<Mesh>
+MeshFactory::redistribute(Mesh const& mesh,
+                          std::vector<double> const *cell_weights) {
+  std::vector<int> cell_ranks;
+  mesh.get_rank_partitioning(cell_weights, &cell_ranks);
+  return std::make_shared<Mesh_flat>(mesh, cell_ranks, geometric_model_,
+                                     request_faces_, request_edges_,
+                                     request_sides_, request_wedges_,
+                                     request_corners_, num_tiles_,
+                                     num_ghost_layers_tile_,
+                                     num_ghost_layers_distmesh_,
+                                     request_boundary_ghosts_,
+                                     partitioner_);
+}
+
 }  // namespace Jali
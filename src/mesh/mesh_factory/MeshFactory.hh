@@ -63,6 +63,7 @@
 #include <vector>
 #include <memory>
 #include <utility>
+#include <functional>
 
 #include "MeshDefs.hh"
 #include "Mesh.hh"
@@ -78,14 +79,17 @@ enum MeshFramework_t {
   Simple = 1,
   MSTK,
   MOAB,
-  STKMESH
+  STKMESH,
+  Flat,
+  Structured
 };
 
 /// A type to identify mesh file formats
 enum MeshFormat_t {
   ExodusII = 1,
   MOABHDF5,
-  FLAGX3D
+  FLAGX3D,
+  JaliFlat
 };
 
 /// Get a name for a given framework
@@ -131,7 +135,8 @@ class MeshFactory {
 
   /// Set the framework to use
   void framework(MeshFramework_t const& framework) {
-    if (framework == Simple || framework == MSTK) {
+    if (framework == Simple || framework == MSTK || framework == Flat ||
+        framework == Structured) {
       framework_ = framework;
     } else {
       std::stringstream mesgstrm;
@@ -211,6 +216,36 @@ class MeshFactory {
     num_ghost_layers_tile_ = num_layers;
   }
 
+  /// Get the sidecar file caching derived entities (sides, wedges,
+  /// corners) and their geometric quantities (default none)
+  std::string derived_cache_file(void) const {
+    return derived_cache_file_;
+  }
+
+  /// Set the sidecar file caching derived entities and their
+  /// geometric quantities. If the file matches the mesh being created, these
+  /// are read from it instead of being computed; otherwise they are
+  /// computed and the file is (re)written. Not used for meshes with
+  /// tiles
+  void derived_cache_file(std::string const& filename) {
+    derived_cache_file_ = filename;
+  }
+
+  /// Are meshes frozen after creation? (default false)
+  bool freeze(void) const {
+    return freeze_;
+  }
+
+  /// Freeze meshes after creation - once created with the chosen
+  /// framework, a mesh is copied into flat arrays (a Mesh_flat in
+  /// memory) which answer all queries, and the framework mesh (e.g.
+  /// the MSTK mesh with its handle maps) is released. For simulations
+  /// whose mesh topology does not change; node coordinates can still
+  /// be modified
+  void freeze(bool frozen) {
+    freeze_ = frozen;
+  }
+
   /// Request that the GIDs be made contiguous
   void contiguous_gids(bool make_contiguous) {
     contiguous_gids_ = make_contiguous;
@@ -307,29 +342,37 @@ class MeshFactory {
   }
 
   /// Create a mesh by reading the specified file (or set of files) -- operator
+  /// (files in the Jali flat binary format are recognized automatically
+  /// and read with the Flat framework)
   std::shared_ptr<Mesh> operator() (std::string const& filename) {
-    return create(filename);
+    return create_and_finish([&]() { return create(filename); });
   }
 
   /// Create a hexahedral mesh of the specified dimensions -- operator
+  /// (the Flat framework generates regular meshes on any number of
+  /// ranks with no communication, each rank building its own block;
+  /// the Structured framework does the same but stores no
+  /// connectivity at all)
   std::shared_ptr<Mesh> operator() (double const x0, double const y0,
                                     double const z0,
                                     double const x1, double const y1,
                                     double const z1,
                                     int const nx, int const ny, int const nz) {
-    return create(x0, y0, z0, x1, y1, z1, nx, ny, nz);
+    return create_and_finish([&]() {
+        return create(x0, y0, z0, x1, y1, z1, nx, ny, nz); });
   }
 
   /// Create a quadrilateral mesh of the specified dimensions -- operator
   std::shared_ptr<Mesh> operator() (double const x0, double const y0,
                                     double const x1, double const y1,
                                     int const nx, int const ny) {
-    return create(x0, y0, x1, y1, nx, ny);
+    return create_and_finish([&]() {
+        return create(x0, y0, x1, y1, nx, ny); });
   }
 
   /// Create a 1d mesh -- operator
   std::shared_ptr<Mesh> operator() (std::vector<double> const& x) {
-    return create(x);
+    return create_and_finish([&]() { return create(x); });
   }
 
   /// Create a 1d mesh -- operator
@@ -344,7 +387,7 @@ class MeshFactory {
       myX += dX;
     }
 
-    return create(x);
+    return create_and_finish([&]() { return create(x); });
   }
 
   /// Create a mesh by extract subsets of entities from an existing mesh
@@ -353,11 +396,29 @@ class MeshFactory {
                                     Entity_kind const setkind,
                                     bool const flatten = false,
                                     bool const extrude = false) {
-    return create(inmesh, setnames, setkind, flatten, extrude);
+    return create_and_finish([&]() {
+        return create(inmesh, setnames, setkind, flatten, extrude); });
   }
 
+  /// Redistribute a mesh so that every rank gets about the same total
+  /// cell weight (cell_weights is indexed like the owned cells; cells
+  /// count equally without it). The result is a Flat mesh with the
+  /// entities, tiles and ghost layers requested from this factory,
+  /// keeping the global IDs and mesh sets of the input mesh, which
+  /// needs at least as many ghost layers. Data on the input mesh can
+  /// be moved over with State::migrate (collective)
+  std::shared_ptr<Mesh> redistribute(Mesh const& mesh,
+                                     std::vector<double> const *
+                                     cell_weights = nullptr);
+
  private:
 
+  /// Create a mesh with the creator, deferring the derived entities
+  /// to go through the derived entity cache file if one is set and
+  /// freezing the mesh if requested
+  std::shared_ptr<Mesh> create_and_finish(
+      std::function<std::shared_ptr<Mesh>()> const& creator);
+
   /// Create a mesh by reading the specified file (or set of files)
   std::shared_ptr<Mesh> create(std::string const& filename);
 
@@ -442,6 +503,12 @@ class MeshFactory {
 
   /// Should GIDs be made contiguous?
   bool contiguous_gids_ = false;
+
+  /// Sidecar file caching derived entities and geometric quantities
+  std::string derived_cache_file_;
+
+  /// Freeze meshes into flat arrays after creation?
+  bool freeze_ = false;
 };
 
 }  // namespace Jali
@@ -0,0 +1,2311 @@
+/*
+ Copyright (c) 2019, Triad National Security, LLC
+ All rights reserved.
+
+ Copyright 2019. Triad National Security, LLC. This software was
+ produced under U.S. Government contract 89233218CNA000001 for Los
+ Alamos National Laboratory (LANL), which is operated by Triad
+ National Security, LLC for the U.S. Department of Energy. 
+ All rights in the program are reserved by Triad National Security,
+ LLC, and the U.S. Department of Energy/National Nuclear Security
+ Administration. The Government is granted for itself and others acting
+ on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+ in this material to reproduce, prepare derivative works, distribute
+ copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+
+ 
+ This is open source software distributed under the 3-clause BSD license.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of Triad National Security, LLC, Los Alamos
+    National Laboratory, LANL, the U.S. Government, nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ 
+ THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+ BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <unordered_map>
+
+#include "Mesh_flat.hh"
+#include "LabeledSetRegion.hh"
+#include "MeshSet.hh"
+#include "MeshBlocks.hh"
+#include "MeshExchange.hh"
+
+#include "errors.hh"
+
+namespace Jali {
+
+namespace {
+
+// On-disk layout: FlatHeader, nsections FlatSection records, then the
+// section data, each section starting at a multiple of 64 bytes
+
+const char flat_magic[8] = {'J', 'A', 'L', 'I', 'F', 'L', 'A', 'T'};
+const std::uint32_t flat_version = 1;
+const std::uint32_t flat_endian_check = 0x01020304;
+const std::size_t flat_alignment = 64;
+
+struct FlatHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t endian;
+  std::int32_t space_dim;
+  std::int32_t manifold_dim;
+  std::int32_t mesh_type;
+  std::int32_t geom_type;
+  std::int32_t nprocs;
+  std::int32_t rank;
+  std::int32_t nsections;
+  std::int32_t reserved;
+};
+
+struct FlatSection {
+  char name[40];
+  std::uint32_t elem_size;
+  std::uint32_t reserved;
+  std::uint64_t offset;
+  std::uint64_t count;
+};
+
+std::size_t align_up(std::size_t n) {
+  return ((n + flat_alignment - 1)/flat_alignment)*flat_alignment;
+}
+
+void flat_error(std::string const& filename, std::string const& what) {
+  Errors::Message mesg("Flat mesh file " + filename + ": " + what);
+  Exceptions::Jali_throw(mesg);
+}
+
+// Read and validate the header of a flat mesh file; returns false if
+// the file cannot be read or is not a flat mesh file
+
+bool read_flat_header(std::string const& filename, FlatHeader *hdr) {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file.read(reinterpret_cast<char *>(hdr), sizeof(FlatHeader)))
+    return false;
+  return (std::memcmp(hdr->magic, flat_magic, sizeof(flat_magic)) == 0);
+}
+
+// Find a section in a mapped file
+
+template <class T>
+T const * find_section(void const *map, std::string const& name,
+                       std::size_t *count) {
+  FlatHeader const *hdr = static_cast<FlatHeader const *>(map);
+  FlatSection const *sections = reinterpret_cast<FlatSection const *>(hdr+1);
+  for (int i = 0; i < hdr->nsections; i++) {
+    if (name == sections[i].name && sections[i].elem_size == sizeof(T)) {
+      *count = sections[i].count;
+      return reinterpret_cast<T const *>(static_cast<char const *>(map) +
+                                         sections[i].offset);
+    }
+  }
+  *count = 0;
+  return nullptr;
+}
+
+// Collects sections and writes them out in the flat mesh layout
+
+class FlatWriter {
+ public:
+  template <class T>
+  void add(std::string const& name, std::vector<T> const& data) {
+    assert(name.size() < sizeof(FlatSection::name));
+    FlatSection sec;
+    std::memset(&sec, 0, sizeof(FlatSection));
+    std::strncpy(sec.name, name.c_str(), sizeof(sec.name)-1);
+    sec.elem_size = sizeof(T);
+    sec.count = data.size();
+    sections_.push_back(sec);
+    char const *bytes = reinterpret_cast<char const *>(data.data());
+    data_.emplace_back(bytes, bytes + data.size()*sizeof(T));
+  }
+
+  // Add an adjacency in compressed row storage with optional
+  // directions; get(i, &list, &dirs) must return the list of entity i
+
+  template <class Function>
+  void add_crs(std::string const& name, int n, bool with_dirs,
+               Function const& get) {
+    std::vector<Entity_ID> offset(n+1, 0), ids;
+    std::vector<dir_t> dirs;
+    Entity_ID_List list;
+    std::vector<dir_t> listdirs;
+    for (int i = 0; i < n; i++) {
+      get(i, &list, &listdirs);
+      ids.insert(ids.end(), list.begin(), list.end());
+      if (with_dirs) dirs.insert(dirs.end(), listdirs.begin(), listdirs.end());
+      offset[i+1] = ids.size();
+    }
+    add(name + "_offset", offset);
+    add(name + "_id", ids);
+    if (with_dirs) add(name + "_dir", dirs);
+  }
+
+  // Place the sections after the header and the section table;
+  // returns the total size of the image
+
+  std::size_t layout(FlatHeader *hdr) {
+    hdr->nsections = sections_.size();
+    std::size_t offset = align_up(sizeof(FlatHeader) +
+                                  sections_.size()*sizeof(FlatSection));
+    for (auto & sec : sections_) {
+      sec.offset = offset;
+      offset = align_up(offset + sec.count*sec.elem_size);
+    }
+    return offset;
+  }
+
+  void write(std::string const& filename, FlatHeader hdr) {
+    layout(&hdr);
+
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    if (!file) flat_error(filename, "cannot open for writing");
+
+    file.write(reinterpret_cast<char const *>(&hdr), sizeof(FlatHeader));
+    file.write(reinterpret_cast<char const *>(sections_.data()),
+               sections_.size()*sizeof(FlatSection));
+    std::vector<char> zeros(flat_alignment, 0);
+    std::size_t pos = sizeof(FlatHeader) + sections_.size()*sizeof(FlatSection);
+    for (int i = 0; i < static_cast<int>(sections_.size()); i++) {
+      file.write(zeros.data(), sections_[i].offset - pos);
+      file.write(data_[i].data(), data_[i].size());
+      pos = sections_[i].offset + data_[i].size();
+    }
+    file.write(zeros.data(), align_up(pos) - pos);
+    if (!file) flat_error(filename, "error writing file");
+  }
+
+  // Copy the image into zeroed memory of the size returned by layout()
+
+  void copy(void *image, FlatHeader hdr) {
+    layout(&hdr);
+    char *dst = static_cast<char *>(image);
+    std::memcpy(dst, &hdr, sizeof(FlatHeader));
+    std::memcpy(dst + sizeof(FlatHeader), sections_.data(),
+                sections_.size()*sizeof(FlatSection));
+    for (int i = 0; i < static_cast<int>(sections_.size()); i++) {
+      std::memcpy(dst + sections_[i].offset, data_[i].data(),
+                  data_[i].size());
+      std::vector<char>().swap(data_[i]);  // release as we go
+    }
+  }
+
+ private:
+  std::vector<FlatSection> sections_;
+  std::vector<std::vector<char>> data_;
+};
+
+// Geometry type of the mesh in a flat mesh file (needed before the
+// Mesh base class is constructed)
+
+JaliGeometry::Geom_type flat_mesh_geom_type(std::string const& filename,
+                                            MPI_Comm const& comm) {
+  int nprocs, rank;
+  MPI_Comm_size(comm, &nprocs);
+  MPI_Comm_rank(comm, &rank);
+  FlatHeader hdr;
+  std::string rankfile = flat_mesh_filename(filename, nprocs, rank);
+  if (!read_flat_header(rankfile, &hdr))
+    flat_error(rankfile, "not a Jali flat mesh file");
+  return static_cast<JaliGeometry::Geom_type>(hdr.geom_type);
+}
+
+}  // namespace
+
+
+// Name of the file holding the partition of a rank
+
+std::string flat_mesh_filename(std::string const& filename, int nprocs,
+                               int rank) {
+  if (nprocs == 1) return filename;
+  std::stringstream name;
+  name << filename << "." << nprocs << "." << rank;
+  return name.str();
+}
+
+// Is filename (or the file for this rank) a Jali flat binary mesh?
+
+bool is_flat_mesh_file(std::string const& filename, MPI_Comm const& comm) {
+  int nprocs, rank;
+  MPI_Comm_size(comm, &nprocs);
+  MPI_Comm_rank(comm, &rank);
+  FlatHeader hdr;
+  int isflat = read_flat_header(flat_mesh_filename(filename, nprocs, rank),
+                                &hdr) ? 1 : 0;
+  int allflat;
+  MPI_Allreduce(&isflat, &allflat, 1, MPI_INT, MPI_MIN, comm);
+  return allflat == 1;
+}
+
+
+namespace {
+
+// Collect the sections describing a mesh and the header of its flat
+// mesh image
+
+void build_flat_image(Mesh const& mesh, FlatWriter *writer,
+                      FlatHeader *hdr) {
+  int nprocs, rank;
+  MPI_Comm comm = mesh.get_comm();
+  MPI_Comm_size(comm, &nprocs);
+  MPI_Comm_rank(comm, &rank);
+
+  int spacedim = mesh.space_dimension();
+  int nnodes = mesh.num_nodes<Entity_type::ALL>();
+  int nfaces = mesh.num_faces<Entity_type::ALL>();
+  int ncells = mesh.num_cells<Entity_type::ALL>();
+  int nedges = mesh.num_edges<Entity_type::ALL>();
+
+  if (ncells && !nfaces) {
+    Errors::Message mesg("Flat mesh image needs a mesh with faces");
+    Exceptions::Jali_throw(mesg);
+  }
+
+  // Coordinates
+
+  std::vector<double> coords(nnodes*spacedim);
+  for (int n = 0; n < nnodes; n++) {
+    JaliGeometry::Point xyz;
+    mesh.node_get_coordinates(n, &xyz);
+    for (int d = 0; d < spacedim; d++)
+      coords[n*spacedim+d] = xyz[d];
+  }
+  writer->add("node_coords", coords);
+
+  // Parallel entity lists and global IDs
+
+  writer->add("node_owned", mesh.nodes<Entity_type::PARALLEL_OWNED>());
+  writer->add("node_ghost", mesh.nodes<Entity_type::PARALLEL_GHOST>());
+  writer->add("node_all", mesh.nodes<Entity_type::ALL>());
+  writer->add("face_owned", mesh.faces<Entity_type::PARALLEL_OWNED>());
+  writer->add("face_ghost", mesh.faces<Entity_type::PARALLEL_GHOST>());
+  writer->add("face_all", mesh.faces<Entity_type::ALL>());
+  writer->add("cell_owned", mesh.cells<Entity_type::PARALLEL_OWNED>());
+  writer->add("cell_ghost", mesh.cells<Entity_type::PARALLEL_GHOST>());
+  writer->add("cell_boundary_ghost",
+              mesh.cells<Entity_type::BOUNDARY_GHOST>());
+  writer->add("cell_all", mesh.cells<Entity_type::ALL>());
+
+  auto add_gids = [&](std::string const& name, Entity_kind kind, int n) {
+    std::vector<Entity_ID> gids(n);
+    for (int i = 0; i < n; i++)
+      gids[i] = mesh.GID(i, kind);
+    writer->add(name, gids);
+  };
+  add_gids("node_gid", Entity_kind::NODE, nnodes);
+  add_gids("face_gid", Entity_kind::FACE, nfaces);
+  add_gids("cell_gid", Entity_kind::CELL, ncells);
+
+  // Ranks owning the entities, looked up by global ID for the ghosts
+  // (collective, so done for edges on all ranks if any rank has them)
+
+  auto add_owners = [&](std::string const& name, Entity_kind kind, int n,
+                        std::vector<Entity_ID> const& owned,
+                        std::vector<Entity_ID> const& ghost) {
+    std::vector<int> owners(n, rank);
+    if (nprocs > 1) {
+      std::vector<int> ownedgids, ghostgids;
+      for (auto const& e : owned) ownedgids.push_back(mesh.GID(e, kind));
+      for (auto const& e : ghost) ghostgids.push_back(mesh.GID(e, kind));
+      std::vector<int> ghostowners =
+          directory_lookup(ownedgids, std::vector<int>(owned.size(), rank),
+                           ghostgids, -1, comm);
+      for (int i = 0; i < static_cast<int>(ghost.size()); i++)
+        owners[ghost[i]] = ghostowners[i];
+    }
+    if (n) writer->add(name, owners);
+  };
+  add_owners("node_owner", Entity_kind::NODE, nnodes,
+             mesh.nodes<Entity_type::PARALLEL_OWNED>(),
+             mesh.nodes<Entity_type::PARALLEL_GHOST>());
+  add_owners("face_owner", Entity_kind::FACE, nfaces,
+             mesh.faces<Entity_type::PARALLEL_OWNED>(),
+             mesh.faces<Entity_type::PARALLEL_GHOST>());
+  add_owners("cell_owner", Entity_kind::CELL, ncells,
+             mesh.cells<Entity_type::PARALLEL_OWNED>(),
+             mesh.cells<Entity_type::PARALLEL_GHOST>());
+  int hasedges = (nedges > 0), anyedges = hasedges;
+  if (nprocs > 1)
+    MPI_Allreduce(&hasedges, &anyedges, 1, MPI_INT, MPI_MAX, comm);
+  if (anyedges)
+    add_owners("edge_owner", Entity_kind::EDGE, nedges,
+               nedges ? mesh.edges<Entity_type::PARALLEL_OWNED>() :
+               std::vector<Entity_ID>(),
+               nedges ? mesh.edges<Entity_type::PARALLEL_GHOST>() :
+               std::vector<Entity_ID>());
+
+  std::vector<std::uint8_t> celltypes(ncells);
+  for (int c = 0; c < ncells; c++)
+    celltypes[c] = static_cast<std::uint8_t>(mesh.cell_get_type(c));
+  writer->add("cell_type", celltypes);
+
+  // Topology
+
+  writer->add_crs("cell_face", ncells, true,
+                  [&](int c, Entity_ID_List *ids, std::vector<dir_t> *dirs) {
+                    mesh.cell_get_faces_and_dirs(c, ids, dirs, true);
+                  });
+  writer->add_crs("cell_node", ncells, false,
+                  [&](int c, Entity_ID_List *ids, std::vector<dir_t> *dirs) {
+                    mesh.cell_get_nodes(c, ids);
+                  });
+  writer->add_crs("face_node", nfaces, false,
+                  [&](int f, Entity_ID_List *ids, std::vector<dir_t> *dirs) {
+                    mesh.face_get_nodes(f, ids);
+                  });
+  writer->add_crs("node_cell", nnodes, false,
+                  [&](int n, Entity_ID_List *ids, std::vector<dir_t> *dirs) {
+                    mesh.node_get_cells(n, Entity_type::ALL, ids);
+                  });
+  writer->add_crs("node_face", nnodes, false,
+                  [&](int n, Entity_ID_List *ids, std::vector<dir_t> *dirs) {
+                    mesh.node_get_faces(n, Entity_type::ALL, ids);
+                  });
+
+  std::vector<Entity_ID> facecells(2*nfaces, -1);
+  for (int f = 0; f < nfaces; f++) {
+    Entity_ID_List fcells;
+    mesh.face_get_cells(f, Entity_type::ALL, &fcells);
+    for (int i = 0; i < std::min(2, static_cast<int>(fcells.size())); i++)
+      facecells[2*f+i] = fcells[i];
+  }
+  writer->add("face_cell", facecells);
+
+  // Edges (only if the mesh has them)
+
+  if (nedges) {
+    writer->add("edge_owned", mesh.edges<Entity_type::PARALLEL_OWNED>());
+    writer->add("edge_ghost", mesh.edges<Entity_type::PARALLEL_GHOST>());
+    writer->add("edge_all", mesh.edges<Entity_type::ALL>());
+    add_gids("edge_gid", Entity_kind::EDGE, nedges);
+
+    std::vector<Entity_ID> edgenodes(2*nedges);
+    for (int e = 0; e < nedges; e++)
+      mesh.edge_get_nodes(e, &(edgenodes[2*e]), &(edgenodes[2*e+1]));
+    writer->add("edge_node", edgenodes);
+
+    writer->add_crs("face_edge", nfaces, true,
+                    [&](int f, Entity_ID_List *ids, std::vector<dir_t> *dirs) {
+                      mesh.face_get_edges_and_dirs(f, ids, dirs, true);
+                    });
+    if (mesh.manifold_dimension() == 2)
+      writer->add_crs("cell_edge", ncells, true,
+                      [&](int c, Entity_ID_List *ids,
+                          std::vector<dir_t> *dirs) {
+                        mesh.cell_2D_get_edges_and_dirs(c, ids, dirs);
+                      });
+    else
+      writer->add_crs("cell_edge", ncells, false,
+                      [&](int c, Entity_ID_List *ids,
+                          std::vector<dir_t> *dirs) {
+                        mesh.cell_get_edges(c, ids);
+                      });
+  }
+
+  // Mesh sets of nodes, edges, faces and cells
+
+  std::vector<int> setkinds, setnumowned, setnumghost;
+  std::vector<char> setnames;
+  std::vector<Entity_ID> setentities;
+  for (auto const& set : mesh.sets()) {
+    Entity_kind kind = set->kind();
+    if (kind != Entity_kind::NODE && kind != Entity_kind::EDGE &&
+        kind != Entity_kind::FACE && kind != Entity_kind::CELL)
+      continue;
+    setkinds.push_back(static_cast<int>(kind));
+    auto const& owned = set->entities<Entity_type::PARALLEL_OWNED>();
+    auto const& ghost = set->entities<Entity_type::PARALLEL_GHOST>();
+    setnumowned.push_back(owned.size());
+    setnumghost.push_back(ghost.size());
+    setnames.insert(setnames.end(), set->name().begin(), set->name().end());
+    setnames.push_back('\0');
+    setentities.insert(setentities.end(), owned.begin(), owned.end());
+    setentities.insert(setentities.end(), ghost.begin(), ghost.end());
+  }
+  writer->add("set_kind", setkinds);
+  writer->add("set_num_owned", setnumowned);
+  writer->add("set_num_ghost", setnumghost);
+  writer->add("set_names", setnames);
+  writer->add("set_entities", setentities);
+
+  std::memset(hdr, 0, sizeof(FlatHeader));
+  std::memcpy(hdr->magic, flat_magic, sizeof(flat_magic));
+  hdr->version = flat_version;
+  hdr->endian = flat_endian_check;
+  hdr->space_dim = spacedim;
+  hdr->manifold_dim = mesh.manifold_dimension();
+  hdr->mesh_type = static_cast<int>(mesh.mesh_type());
+  hdr->geom_type = static_cast<int>(mesh.geom_type());
+  hdr->nprocs = nprocs;
+  hdr->rank = rank;
+}
+
+// Map zeroed anonymous memory and copy a flat mesh image into it
+
+void *map_anonymous_image(FlatWriter *writer, FlatHeader hdr,
+                          std::size_t *size) {
+  *size = writer->layout(&hdr);
+  void *map = mmap(nullptr, *size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (map == MAP_FAILED) {
+    Errors::Message mesg("Mesh_flat: cannot allocate memory for mesh");
+    Exceptions::Jali_throw(mesg);
+  }
+  writer->copy(map, hdr);
+  return map;
+}
+
+// Unmaps the image of a Mesh_flat whose constructor throws after
+// mapping it (the destructor is not called then) unless released
+
+class MapGuard {
+ public:
+  MapGuard(void * const& map, std::size_t const& size) :
+      map_(map), size_(size) {}
+  ~MapGuard() { if (!released_ && map_) munmap(map_, size_); }
+  void release() { released_ = true; }
+
+ private:
+  void * const& map_;
+  std::size_t const& size_;
+  bool released_ = false;
+};
+
+
+// Distributed generation of regular (tensor product) meshes
+//
+// Every entity of a regular mesh is identified by its family (cells,
+// nodes, faces normal to each direction or edges along each
+// direction) and its global (i,j,k) index within the family. The
+// ranks are arranged in a grid of blocks of cells and an entity is
+// owned by the block holding the cell with the same index (clipped to
+// the last cell in each direction), so each rank works out the global
+// IDs and owners of all the entities of its block and ghost layers
+// on its own
+
+// A family of entities of a regular mesh with the local IDs of those
+// in the box of this rank
+
+struct RegularFamily {
+  int nodal[3] = {0, 0, 0};  // indexed by node (1) or by cell (0)
+  int lo[3], ext[3];         // box of entities on this rank
+  GlobalIndex gext[3];       // global extents
+  GlobalIndex gid0 = 0;      // global ID of the first entity
+  std::vector<Entity_ID> lid;
+
+  void init(int const *ncells, int const *cell_lo, int const *cell_hi) {
+    for (int d = 0; d < 3; d++) {
+      lo[d] = cell_lo[d];
+      ext[d] = cell_hi[d] - cell_lo[d] + nodal[d];
+      gext[d] = ncells[d] + nodal[d];
+    }
+    lid.assign(static_cast<std::size_t>(ext[0])*ext[1]*ext[2], -1);
+  }
+
+  GlobalIndex size() const { return gext[0]*gext[1]*gext[2]; }
+
+  // Local ID of entity (i,j,k), -1 if it is not in the box
+
+  Entity_ID operator()(int i, int j, int k) const {
+    i -= lo[0]; j -= lo[1]; k -= lo[2];
+    if (i < 0 || j < 0 || k < 0 || i >= ext[0] || j >= ext[1] ||
+        k >= ext[2])
+      return -1;
+    return lid[(static_cast<std::size_t>(k)*ext[1] + j)*ext[0] + i];
+  }
+
+  // Call f(i, j, k, local ID) for each entity in the box
+
+  template <class Function>
+  void for_each(Function const& f) const {
+    std::size_t n = 0;
+    for (int k = lo[2]; k < lo[2]+ext[2]; k++)
+      for (int j = lo[1]; j < lo[1]+ext[1]; j++)
+        for (int i = lo[0]; i < lo[0]+ext[0]; i++, n++)
+          f(i, j, k, lid[n]);
+  }
+};
+
+// Number the entities of the families of one kind, owned entities
+// first, and add their entity lists, global IDs and owners to the
+// image
+
+int number_regular_entities(std::vector<RegularFamily> *families,
+                            std::string const& kind, int dim,
+                            int const *ncells, int const *nblocks,
+                            int const *myblock, FlatWriter *writer) {
+  GlobalIndex gid0 = 0;
+  for (auto & fam : *families) {
+    fam.gid0 = gid0;
+    gid0 += fam.size();
+  }
+  if (gid0 > std::numeric_limits<Entity_ID>::max()) {
+    Errors::Message mesg("Regular mesh has too many " + kind +
+                         "s for the range of global IDs");
+    Exceptions::Jali_throw(mesg);
+  }
+
+  std::vector<Entity_ID> owned, ghost, gids;
+  std::vector<int> owners;
+  Entity_ID nent = 0;
+  for (int pass = 0; pass < 2; pass++) {
+    for (auto & fam : *families) {
+      std::size_t n = 0;
+      for (int k = fam.lo[2]; k < fam.lo[2]+fam.ext[2]; k++)
+        for (int j = fam.lo[1]; j < fam.lo[1]+fam.ext[1]; j++)
+          for (int i = fam.lo[0]; i < fam.lo[0]+fam.ext[0]; i++, n++) {
+            int idx[3] = {i, j, k};
+            int block[3] = {0, 0, 0};
+            bool mine = true;
+            for (int d = 0; d < dim; d++) {
+              block[d] = block_of(std::min(idx[d], ncells[d]-1),
+                                  nblocks[d], ncells[d]);
+              mine = mine && (block[d] == myblock[d]);
+            }
+            if (mine != (pass == 0)) continue;
+            fam.lid[n] = nent;
+            (mine ? owned : ghost).push_back(nent++);
+            gids.push_back(fam.gid0 +
+                           (k*fam.gext[1] + j)*fam.gext[0] + i);
+            owners.push_back(block[0] +
+                             nblocks[0]*(block[1] + nblocks[1]*block[2]));
+          }
+    }
+  }
+
+  std::vector<Entity_ID> all(nent);
+  for (Entity_ID e = 0; e < nent; e++)
+    all[e] = e;
+  writer->add(kind + "_owned", owned);
+  writer->add(kind + "_ghost", ghost);
+  writer->add(kind + "_all", all);
+  writer->add(kind + "_gid", gids);
+  writer->add(kind + "_owner", owners);
+  return nent;
+}
+
+// Add an adjacency with the same number of entries for every entity
+
+void add_fixed_crs(FlatWriter *writer, std::string const& name,
+                   int stride, std::vector<Entity_ID> const& ids,
+                   std::vector<dir_t> const *dirs = nullptr) {
+  int n = ids.size()/stride;
+  std::vector<Entity_ID> offset(n+1);
+  for (int i = 0; i <= n; i++)
+    offset[i] = i*stride;
+  writer->add(name + "_offset", offset);
+  writer->add(name + "_id", ids);
+  if (dirs) writer->add(name + "_dir", *dirs);
+}
+
+// Add the entities of some families around each node
+
+void add_node_crs(FlatWriter *writer, std::string const& name, int dim,
+                  RegularFamily const& nodes, int nnodes,
+                  std::vector<RegularFamily> const& families) {
+  std::vector<Entity_ID> offset(nnodes+1, 0), ids;
+  for (int pass = 0; pass < 2; pass++) {
+    std::vector<Entity_ID> pos(offset.begin(), offset.end()-1);
+    nodes.for_each([&](int i, int j, int k, Entity_ID n) {
+        int idx[3] = {i, j, k};
+        for (auto const& fam : families) {
+          // entities indexed by cell touch the node from both sides
+          int lo[3];
+          for (int d = 0; d < 3; d++)
+            lo[d] = (d < dim && !fam.nodal[d]) ? idx[d]-1 : idx[d];
+          for (int kk = lo[2]; kk <= k; kk++)
+            for (int jj = lo[1]; jj <= j; jj++)
+              for (int ii = lo[0]; ii <= i; ii++) {
+                Entity_ID e = fam(ii, jj, kk);
+                if (e < 0) continue;
+                if (pass)
+                  ids[pos[n]++] = e;
+                else
+                  offset[n+1]++;
+              }
+        }
+      });
+    if (!pass) {
+      for (int n = 0; n < nnodes; n++)
+        offset[n+1] += offset[n];
+      ids.resize(offset[nnodes]);
+    }
+  }
+  writer->add(name + "_offset", offset);
+  writer->add(name + "_id", ids);
+}
+
+// Build the image of the block of this rank of a regular mesh with
+// node coordinates axes[d] along each direction d
+
+void build_regular_image(int dim, std::vector<double> const *axes,
+                         int nghost, bool with_edges,
+                         JaliGeometry::Geom_type geom_type, MPI_Comm comm,
+                         FlatWriter *writer, FlatHeader *hdr) {
+  int nprocs, rank;
+  MPI_Comm_size(comm, &nprocs);
+  MPI_Comm_rank(comm, &rank);
+
+  if (dim == 1 && with_edges) {
+    Errors::Message mesg("Flat regular meshes have no edges in 1D");
+    Exceptions::Jali_throw(mesg);
+  }
+
+  int ncells[3] = {1, 1, 1};
+  for (int d = 0; d < dim; d++)
+    ncells[d] = static_cast<int>(axes[d].size()) - 1;
+
+  int nblocks[3];
+  if (!block_grid(dim, ncells, nprocs, nblocks)) {
+    Errors::Message mesg("Cannot divide regular mesh into " +
+                         std::to_string(nprocs) + " blocks");
+    Exceptions::Jali_throw(mesg);
+  }
+  int myblock[3] = {rank % nblocks[0], (rank/nblocks[0]) % nblocks[1],
+                    rank/(nblocks[0]*nblocks[1])};
+
+  // Box of cells of this block and its ghost layers
+
+  int cell_lo[3] = {0, 0, 0}, cell_hi[3] = {1, 1, 1};
+  for (int d = 0; d < dim; d++) {
+    cell_lo[d] = std::max(0, block_start(myblock[d], nblocks[d],
+                                         ncells[d]) - nghost);
+    cell_hi[d] = std::min(ncells[d], block_start(myblock[d]+1, nblocks[d],
+                                                 ncells[d]) + nghost);
+  }
+
+  std::vector<RegularFamily> cells(1), nodes(1), faces(dim), edges;
+  for (int d = 0; d < dim; d++) {
+    nodes[0].nodal[d] = 1;
+    faces[d].nodal[d] = 1;
+  }
+  if (with_edges && dim == 3) {
+    edges.resize(3);
+    for (int a = 0; a < 3; a++)
+      for (int d = 0; d < 3; d++)
+        edges[a].nodal[d] = (d != a);
+  }
+  for (auto fams : {&cells, &nodes, &faces, &edges})
+    for (auto & fam : *fams)
+      fam.init(ncells, cell_lo, cell_hi);
+
+  int nn = number_regular_entities(&nodes, "node", dim, ncells, nblocks,
+                                   myblock, writer);
+  int nf = number_regular_entities(&faces, "face", dim, ncells, nblocks,
+                                   myblock, writer);
+  int nc = number_regular_entities(&cells, "cell", dim, ncells, nblocks,
+                                   myblock, writer);
+  writer->add("cell_boundary_ghost", std::vector<Entity_ID>());
+  if (!edges.empty())
+    number_regular_entities(&edges, "edge", dim, ncells, nblocks, myblock,
+                            writer);
+
+  RegularFamily const& node = nodes[0];
+
+  std::vector<double> coords(static_cast<std::size_t>(nn)*dim);
+  node.for_each([&](int i, int j, int k, Entity_ID n) {
+      int idx[3] = {i, j, k};
+      for (int d = 0; d < dim; d++)
+        coords[n*dim+d] = axes[d][idx[d]];
+    });
+  writer->add("node_coords", coords);
+
+  Cell_type ctype = (dim == 3) ? Cell_type::HEX :
+      ((dim == 2) ? Cell_type::QUAD : Cell_type::CELLTYPE_UNKNOWN);
+  writer->add("cell_type", std::vector<std::uint8_t>(
+      nc, static_cast<std::uint8_t>(ctype)));
+
+  // Nodes of cells in the standard (Exodus II) order and faces of
+  // cells in the standard order with the directions in which the
+  // cells use them
+
+  int ncn = 1 << dim, ncf = 2*dim;
+  std::vector<Entity_ID> cellnodes(nc*ncn), cellfaces(nc*ncf);
+  std::vector<dir_t> cellfacedirs(nc*ncf);
+  cells[0].for_each([&](int i, int j, int k, Entity_ID c) {
+      Entity_ID *cn = &(cellnodes[c*ncn]);
+      Entity_ID *cf = &(cellfaces[c*ncf]);
+      dir_t *cd = &(cellfacedirs[c*ncf]);
+      if (dim == 1) {
+        cn[0] = node(i, 0, 0);
+        cn[1] = node(i+1, 0, 0);
+        cf[0] = faces[0](i, 0, 0);    cd[0] = -1;
+        cf[1] = faces[0](i+1, 0, 0);  cd[1] = 1;
+        return;
+      }
+      for (int l = 0; l < dim-1; l++) {  // bottom and top layers
+        cn[4*l]   = node(i, j, k+l);
+        cn[4*l+1] = node(i+1, j, k+l);
+        cn[4*l+2] = node(i+1, j+1, k+l);
+        cn[4*l+3] = node(i, j+1, k+l);
+      }
+      cf[0] = faces[1](i, j, k);    cd[0] = 1;
+      cf[1] = faces[0](i+1, j, k);  cd[1] = 1;
+      cf[2] = faces[1](i, j+1, k);  cd[2] = -1;
+      cf[3] = faces[0](i, j, k);    cd[3] = -1;
+      if (dim == 3) {
+        cf[4] = faces[2](i, j, k);    cd[4] = -1;
+        cf[5] = faces[2](i, j, k+1);  cd[5] = 1;
+      }
+    });
+  add_fixed_crs(writer, "cell_face", ncf, cellfaces, &cellfacedirs);
+  add_fixed_crs(writer, "cell_node", ncn, cellnodes);
+  if (with_edges && dim == 2)  // edges are the faces in 2D
+    add_fixed_crs(writer, "cell_edge", ncf, cellfaces, &cellfacedirs);
+  std::vector<Entity_ID>().swap(cellnodes);
+  std::vector<Entity_ID>().swap(cellfaces);
+  std::vector<dir_t>().swap(cellfacedirs);
+
+  // Nodes of faces (counterclockwise about the face normal in 3D) and
+  // the cells on either side
+
+  int nfn = (dim == 3) ? 4 : dim;
+  std::vector<Entity_ID> facenodes(nf*nfn), facecells(2*nf, -1);
+  for (int a = 0; a < dim; a++) {
+    faces[a].for_each([&](int i, int j, int k, Entity_ID f) {
+        Entity_ID *fn = &(facenodes[f*nfn]);
+        if (dim == 1) {
+          fn[0] = node(i, 0, 0);
+        } else if (dim == 2) {
+          fn[0] = node(i, j, 0);
+          fn[1] = (a == 0) ? node(i, j+1, 0) : node(i+1, j, 0);
+        } else if (a == 0) {
+          fn[0] = node(i, j, k);      fn[1] = node(i, j+1, k);
+          fn[2] = node(i, j+1, k+1);  fn[3] = node(i, j, k+1);
+        } else if (a == 1) {
+          fn[0] = node(i, j, k);      fn[1] = node(i+1, j, k);
+          fn[2] = node(i+1, j, k+1);  fn[3] = node(i, j, k+1);
+        } else {
+          fn[0] = node(i, j, k);      fn[1] = node(i+1, j, k);
+          fn[2] = node(i+1, j+1, k);  fn[3] = node(i, j+1, k);
+        }
+
+        int m[3] = {i, j, k};
+        m[a]--;
+        Entity_ID *fc = &(facecells[2*f]);
+        Entity_ID c0 = cells[0](m[0], m[1], m[2]);
+        Entity_ID c1 = cells[0](i, j, k);
+        if (c0 >= 0) *fc++ = c0;
+        if (c1 >= 0) *fc = c1;
+      });
+  }
+  add_fixed_crs(writer, "face_node", nfn, facenodes);
+  writer->add("face_cell", facecells);
+  std::vector<Entity_ID>().swap(facecells);
+
+  add_node_crs(writer, "node_cell", dim, node, nn, cells);
+  add_node_crs(writer, "node_face", dim, node, nn, faces);
+
+  // Edges - the faces themselves in 2D
+
+  if (with_edges && dim == 2) {
+    std::vector<RegularFamily> faceedges(faces);
+    number_regular_entities(&faceedges, "edge", dim, ncells, nblocks,
+                            myblock, writer);
+    writer->add("edge_node", facenodes);
+    std::vector<Entity_ID> ids(nf);
+    for (int f = 0; f < nf; f++)
+      ids[f] = f;
+    std::vector<dir_t> dirs(nf, 1);
+    add_fixed_crs(writer, "face_edge", 1, ids, &dirs);
+  } else if (with_edges) {
+    int ne = edges[0].lid.size() + edges[1].lid.size() + edges[2].lid.size();
+    std::vector<Entity_ID> edgenodes(2*ne);
+    for (int a = 0; a < 3; a++)
+      edges[a].for_each([&](int i, int j, int k, Entity_ID e) {
+          int n[3] = {i, j, k};
+          edgenodes[2*e] = node(n[0], n[1], n[2]);
+          n[a]++;
+          edgenodes[2*e+1] = node(n[0], n[1], n[2]);
+        });
+    writer->add("edge_node", edgenodes);
+
+    // Edges of faces in the same order as the face nodes
+
+    RegularFamily const& ex = edges[0];
+    RegularFamily const& ey = edges[1];
+    RegularFamily const& ez = edges[2];
+    std::vector<Entity_ID> faceedges(4*nf);
+    std::vector<dir_t> faceedgedirs(4*nf);
+    for (int a = 0; a < 3; a++)
+      faces[a].for_each([&](int i, int j, int k, Entity_ID f) {
+          Entity_ID *fe = &(faceedges[4*f]);
+          dir_t *fd = &(faceedgedirs[4*f]);
+          if (a == 0) {
+            fe[0] = ey(i, j, k);    fe[1] = ez(i, j+1, k);
+            fe[2] = ey(i, j, k+1);  fe[3] = ez(i, j, k);
+          } else if (a == 1) {
+            fe[0] = ex(i, j, k);    fe[1] = ez(i+1, j, k);
+            fe[2] = ex(i, j, k+1);  fe[3] = ez(i, j, k);
+          } else {
+            fe[0] = ex(i, j, k);    fe[1] = ey(i+1, j, k);
+            fe[2] = ex(i, j+1, k);  fe[3] = ey(i, j, k);
+          }
+          fd[0] = fd[1] = 1;
+          fd[2] = fd[3] = -1;
+        });
+    add_fixed_crs(writer, "face_edge", 4, faceedges, &faceedgedirs);
+
+    std::vector<Entity_ID> celledges(12*nc);
+    cells[0].for_each([&](int i, int j, int k, Entity_ID c) {
+        Entity_ID *ce = &(celledges[12*c]);
+        for (int l = 0; l < 4; l++) {
+          int p = l & 1, q = l >> 1;
+          ce[l]   = ex(i, j+p, k+q);
+          ce[4+l] = ey(i+p, j, k+q);
+          ce[8+l] = ez(i+p, j+q, k);
+        }
+      });
+    add_fixed_crs(writer, "cell_edge", 12, celledges);
+  }
+
+  // No mesh sets
+
+  writer->add("set_kind", std::vector<int>());
+  writer->add("set_num_owned", std::vector<int>());
+  writer->add("set_num_ghost", std::vector<int>());
+  writer->add("set_names", std::vector<char>());
+  writer->add("set_entities", std::vector<Entity_ID>());
+
+  std::memset(hdr, 0, sizeof(FlatHeader));
+  std::memcpy(hdr->magic, flat_magic, sizeof(flat_magic));
+  hdr->version = flat_version;
+  hdr->endian = flat_endian_check;
+  hdr->space_dim = dim;
+  hdr->manifold_dim = dim;
+  hdr->mesh_type = static_cast<int>(Mesh_type::RECTANGULAR);
+  hdr->geom_type = static_cast<int>(geom_type);
+  hdr->nprocs = nprocs;
+  hdr->rank = rank;
+}
+
+
+// Redistribution of a mesh of any framework
+//
+// Each rank sends every cell it owns to the new rank of the cell and
+// to the new ranks of the cells within nlayers node-connected layers
+// of it (where it will be a ghost), with its faces, edges and nodes
+// described by global IDs. Entities keep their global IDs and a node,
+// edge or face is owned by the lowest new rank owning a cell around
+// it. Face orientations are taken from the sending ranks, which agree
+// on them as in every Jali framework
+
+// An entity received during redistribution; its adjacent entities are
+// global IDs until the entities are numbered
+
+struct MigratedEntity {
+  Entity_ID gid;
+  int owner;
+  int type;
+  std::vector<Entity_ID> nodes, faces, edges;
+  std::vector<dir_t> facedirs, edgedirs;
+};
+
+// Number received entities of one kind, owned ones first and each in
+// global ID order, and add their entity lists, global IDs and owners
+// to the image; returns the index of the entity with each local ID.
+// Owners of ghosts on the rim of the ghost layers are looked up from
+// the owning ranks as only some of the cells around them are here
+// (collective)
+
+std::vector<int> number_migrated(std::string const& kind,
+                                 std::vector<Entity_ID> const& gids,
+                                 std::vector<int> const& owners, int rank,
+                                 MPI_Comm comm, FlatWriter *writer) {
+  int n = gids.size();
+  std::vector<int> order(n);
+  for (int i = 0; i < n; i++) order[i] = i;
+  std::sort(order.begin(), order.end(), [&](int a, int b) {
+      bool ghost_a = (owners[a] != rank), ghost_b = (owners[b] != rank);
+      return ghost_a != ghost_b ? ghost_b : gids[a] < gids[b];
+    });
+
+  std::vector<Entity_ID> owned, ghost, all(n), sortedgids(n);
+  std::vector<Entity_ID> ownedgids, ghostgids;
+  for (int k = 0; k < n; k++) {
+    all[k] = k;
+    sortedgids[k] = gids[order[k]];
+    if (owners[order[k]] == rank) {
+      owned.push_back(k);
+      ownedgids.push_back(sortedgids[k]);
+    } else {
+      ghost.push_back(k);
+      ghostgids.push_back(sortedgids[k]);
+    }
+  }
+
+  std::vector<int> sortedowners(n, rank);
+  std::vector<int> ghostowners =
+      directory_lookup(ownedgids, std::vector<int>(owned.size(), rank),
+                       ghostgids, -1, comm);
+  for (int i = 0; i < static_cast<int>(ghost.size()); i++)
+    sortedowners[ghost[i]] = ghostowners[i];
+  writer->add(kind + "_owned", owned);
+  writer->add(kind + "_ghost", ghost);
+  writer->add(kind + "_all", all);
+  writer->add(kind + "_gid", sortedgids);
+  writer->add(kind + "_owner", sortedowners);
+  return order;
+}
+
+// Build the image of the part of a mesh that this rank gets when the
+// owned cells of every rank move to the ranks given by cell_ranks
+
+void build_migrated_image(Mesh const& mesh,
+                          std::vector<int> const& cell_ranks, int nlayers,
+                          FlatWriter *writer, FlatHeader *hdr) {
+  int nprocs, rank;
+  MPI_Comm comm = mesh.get_comm();
+  MPI_Comm_size(comm, &nprocs);
+  MPI_Comm_rank(comm, &rank);
+
+  int spacedim = mesh.space_dimension();
+  int mdim = mesh.manifold_dimension();
+  int nnodes = mesh.num_nodes<Entity_type::ALL>();
+  int nfaces = mesh.num_faces<Entity_type::ALL>();
+  int ncells = mesh.num_cells<Entity_type::ALL>();
+  int nedges = mesh.num_edges<Entity_type::ALL>();
+  auto const& ownedcells = mesh.cells<Entity_type::PARALLEL_OWNED>();
+  auto const& ghostcells = mesh.cells<Entity_type::PARALLEL_GHOST>();
+
+  // Check the input on every rank before communicating
+
+  std::string errmsg;
+  if (ncells && !nfaces)
+    errmsg = "needs a mesh with faces";
+  else if (cell_ranks.size() != ownedcells.size())
+    errmsg = "needs a new rank for every owned cell";
+  else if (std::any_of(cell_ranks.begin(), cell_ranks.end(),
+                       [&](int r) { return r < 0 || r >= nprocs; }))
+    errmsg = "new ranks out of range";
+  else if (nprocs > 1 && nlayers < 1)
+    errmsg = "needs at least one layer of ghost cells";
+  else if (nprocs > 1 && mesh.num_ghost_layers_distmesh() < nlayers)
+    errmsg = "needs as many layers of ghost cells in the input mesh";
+  int ierr = errmsg.empty() ? 0 : 1, aerr = 0;
+  MPI_Allreduce(&ierr, &aerr, 1, MPI_INT, MPI_SUM, comm);
+  if (aerr) {
+    Errors::Message mesg("Mesh redistribution failed on " +
+                         std::to_string(aerr) + " rank(s) " + errmsg);
+    Exceptions::Jali_throw(mesg);
+  }
+
+  int local_edges = (nedges > 0 && mdim > 1) ? 1 : 0, with_edges = 0;
+  MPI_Allreduce(&local_edges, &with_edges, 1, MPI_INT, MPI_MAX, comm);
+
+  // New ranks of the owned and ghost cells
+
+  std::vector<int> newrank(ncells, -1);
+  std::vector<int> ownedgids(ownedcells.size()), ghostgids(ghostcells.size());
+  for (int i = 0; i < static_cast<int>(ownedcells.size()); i++) {
+    newrank[ownedcells[i]] = cell_ranks[i];
+    ownedgids[i] = mesh.GID(ownedcells[i], Entity_kind::CELL);
+  }
+  for (int i = 0; i < static_cast<int>(ghostcells.size()); i++)
+    ghostgids[i] = mesh.GID(ghostcells[i], Entity_kind::CELL);
+  std::vector<int> ghostranks =
+      directory_lookup(ownedgids, cell_ranks, ghostgids, -1, comm);
+  for (int i = 0; i < static_cast<int>(ghostcells.size()); i++)
+    newrank[ghostcells[i]] = ghostranks[i];
+
+  // Ranks that need each owned cell
+
+  std::vector<std::vector<Entity_ID>> sendcells(nprocs);
+  std::vector<int> cellstamp(ncells, -1), dests;
+  Entity_ID_List layer, nextlayer, adjcells;
+  for (auto const& c : ownedcells) {
+    dests.assign(1, newrank[c]);
+    layer.assign(1, c);
+    cellstamp[c] = c;
+    for (int l = 0; l < nlayers && nprocs > 1; l++) {
+      nextlayer.clear();
+      for (auto const& c2 : layer) {
+        mesh.cell_get_node_adj_cells(c2, Entity_type::ALL, &adjcells);
+        for (auto const& c3 : adjcells)
+          if (cellstamp[c3] != c) {
+            cellstamp[c3] = c;
+            nextlayer.push_back(c3);
+            if (newrank[c3] >= 0) dests.push_back(newrank[c3]);
+          }
+      }
+      layer.swap(nextlayer);
+    }
+    std::sort(dests.begin(), dests.end());
+    dests.erase(std::unique(dests.begin(), dests.end()), dests.end());
+    for (auto const& r : dests)
+      sendcells[r].push_back(c);
+  }
+
+  // Describe the cells and their faces, edges and nodes for each
+  // destination in a list of integers and a list of coordinates
+
+  std::vector<std::shared_ptr<MeshSet>> sets;
+  for (auto const& set : mesh.sets()) {
+    Entity_kind kind = set->kind();
+    if (kind == Entity_kind::NODE || kind == Entity_kind::FACE ||
+        kind == Entity_kind::CELL ||
+        (kind == Entity_kind::EDGE && with_edges))
+      sets.push_back(set);
+  }
+
+  std::vector<std::vector<int>> ibufs(nprocs);
+  std::vector<std::vector<double>> xbufs(nprocs);
+  std::vector<int> nodestamp(nnodes, -1), facestamp(nfaces, -1);
+  std::vector<int> edgestamp(nedges, -1), sentstamp(ncells, -1);
+  Entity_ID_List ids;
+  std::vector<dir_t> dirs;
+  for (int r = 0; r < nprocs; r++) {
+    if (sendcells[r].empty()) continue;
+    std::vector<int>& buf = ibufs[r];
+    std::vector<Entity_ID> sendnodes, sendfaces, sendedges;
+    auto pack = [&](Entity_kind kind, std::vector<int> *stamp,
+                    std::vector<Entity_ID> *sent, bool with_dirs) {
+      buf.push_back(ids.size());
+      for (int i = 0; i < static_cast<int>(ids.size()); i++) {
+        buf.push_back(mesh.GID(ids[i], kind));
+        if (with_dirs) buf.push_back(dirs[i]);
+        if ((*stamp)[ids[i]] != r) {
+          (*stamp)[ids[i]] = r;
+          sent->push_back(ids[i]);
+        }
+      }
+    };
+
+    buf.push_back(sendcells[r].size());
+    for (auto const& c : sendcells[r]) {
+      sentstamp[c] = r;
+      buf.push_back(mesh.GID(c, Entity_kind::CELL));
+      buf.push_back(newrank[c]);
+      buf.push_back(static_cast<int>(mesh.cell_get_type(c)));
+      mesh.cell_get_nodes(c, &ids);
+      pack(Entity_kind::NODE, &nodestamp, &sendnodes, false);
+      mesh.cell_get_faces_and_dirs(c, &ids, &dirs, true);
+      pack(Entity_kind::FACE, &facestamp, &sendfaces, true);
+      if (with_edges) {
+        if (mdim == 2) {
+          mesh.cell_2D_get_edges_and_dirs(c, &ids, &dirs);
+        } else {
+          mesh.cell_get_edges(c, &ids);
+          dirs.assign(ids.size(), 1);
+        }
+        pack(Entity_kind::EDGE, &edgestamp, &sendedges, true);
+      }
+    }
+
+    buf.push_back(sendfaces.size());
+    for (auto const& f : sendfaces) {
+      buf.push_back(mesh.GID(f, Entity_kind::FACE));
+      mesh.face_get_nodes(f, &ids);
+      pack(Entity_kind::NODE, &nodestamp, &sendnodes, false);
+      if (with_edges) {
+        mesh.face_get_edges_and_dirs(f, &ids, &dirs, true);
+        pack(Entity_kind::EDGE, &edgestamp, &sendedges, true);
+      }
+    }
+
+    if (with_edges) {
+      buf.push_back(sendedges.size());
+      for (auto const& e : sendedges) {
+        Entity_ID n0, n1;
+        mesh.edge_get_nodes(e, &n0, &n1);
+        buf.push_back(mesh.GID(e, Entity_kind::EDGE));
+        buf.push_back(mesh.GID(n0, Entity_kind::NODE));
+        buf.push_back(mesh.GID(n1, Entity_kind::NODE));
+      }
+    }
+
+    buf.push_back(sendnodes.size());
+    for (auto const& n : sendnodes) {
+      JaliGeometry::Point xyz;
+      mesh.node_get_coordinates(n, &xyz);
+      buf.push_back(mesh.GID(n, Entity_kind::NODE));
+      for (int d = 0; d < spacedim; d++)
+        xbufs[r].push_back(xyz[d]);
+    }
+
+    // Sets with the entities sent to this rank (even if there are
+    // none so that every rank that gets cells knows the sets)
+
+    buf.push_back(sets.size());
+    for (auto const& set : sets) {
+      Entity_kind kind = set->kind();
+      std::vector<int> const& stamp =
+          (kind == Entity_kind::NODE) ? nodestamp :
+          (kind == Entity_kind::EDGE) ? edgestamp :
+          (kind == Entity_kind::FACE) ? facestamp : sentstamp;
+      buf.push_back(static_cast<int>(kind));
+      buf.push_back(set->name().size());
+      buf.insert(buf.end(), set->name().begin(), set->name().end());
+      std::size_t countpos = buf.size();
+      buf.push_back(0);
+      for (auto const& ent : set->entities<Entity_type::ALL>()) {
+        if (stamp[ent] == r) {
+          buf.push_back(mesh.GID(ent, kind));
+          buf[countpos]++;
+        }
+      }
+    }
+  }
+
+  std::vector<std::vector<int>> irecv = exchange_lists(ibufs, comm);
+  std::vector<std::vector<double>> xrecv = exchange_lists(xbufs, comm);
+
+  // Collect the entities received from all ranks, each only once
+
+  std::vector<MigratedEntity> cells, faces, edges;
+  std::vector<Entity_ID> nodegids;
+  std::vector<double> nodexyz;
+  std::unordered_map<Entity_ID, int> cellidx, faceidx, edgeidx, nodeidx;
+  std::map<std::string, std::pair<Entity_kind, std::vector<Entity_ID>>>
+      setgids;
+  for (int r = 0; r < nprocs; r++) {
+    if (irecv[r].empty()) continue;
+    int const *p = irecv[r].data();
+    double const *x = xrecv[r].data();
+    auto unpack = [&](std::vector<Entity_ID> *list,
+                      std::vector<dir_t> *listdirs) {
+      int n = *p++;
+      list->resize(n);
+      if (listdirs) listdirs->resize(n);
+      for (int i = 0; i < n; i++) {
+        (*list)[i] = *p++;
+        if (listdirs) (*listdirs)[i] = *p++;
+      }
+    };
+
+    int n = *p++;
+    for (int i = 0; i < n; i++) {
+      MigratedEntity ent;
+      ent.gid = *p++;
+      ent.owner = *p++;
+      ent.type = *p++;
+      unpack(&ent.nodes, nullptr);
+      unpack(&ent.faces, &ent.facedirs);
+      if (with_edges) unpack(&ent.edges, &ent.edgedirs);
+      if (cellidx.emplace(ent.gid, cells.size()).second)
+        cells.push_back(std::move(ent));
+    }
+
+    n = *p++;
+    for (int i = 0; i < n; i++) {
+      MigratedEntity ent;
+      ent.gid = *p++;
+      unpack(&ent.nodes, nullptr);
+      if (with_edges) unpack(&ent.edges, &ent.edgedirs);
+      if (faceidx.emplace(ent.gid, faces.size()).second)
+        faces.push_back(std::move(ent));
+    }
+
+    if (with_edges) {
+      n = *p++;
+      for (int i = 0; i < n; i++) {
+        MigratedEntity ent;
+        ent.gid = *p++;
+        ent.nodes.assign(p, p+2);
+        p += 2;
+        if (edgeidx.emplace(ent.gid, edges.size()).second)
+          edges.push_back(std::move(ent));
+      }
+    }
+
+    n = *p++;
+    for (int i = 0; i < n; i++) {
+      Entity_ID gid = *p++;
+      if (nodeidx.emplace(gid, nodegids.size()).second) {
+        nodegids.push_back(gid);
+        nodexyz.insert(nodexyz.end(), x, x+spacedim);
+      }
+      x += spacedim;
+    }
+
+    n = *p++;
+    for (int i = 0; i < n; i++) {
+      Entity_kind kind = static_cast<Entity_kind>(*p++);
+      int len = *p++;
+      std::string name(p, p+len);
+      p += len;
+      auto& set = setgids[name];
+      set.first = kind;
+      int count = *p++;
+      set.second.insert(set.second.end(), p, p+count);
+      p += count;
+    }
+  }
+
+  // Owners of the cells are given; other entities belong to the
+  // lowest rank owning a cell around them
+
+  int ncells_new = cells.size(), nfaces_new = faces.size();
+  int nedges_new = edges.size(), nnodes_new = nodegids.size();
+  std::vector<int> cellowner(ncells_new), faceowner(nfaces_new, nprocs);
+  std::vector<int> edgeowner(nedges_new, nprocs), nodeowner(nnodes_new, nprocs);
+  std::vector<Entity_ID> cellgids(ncells_new), facegids(nfaces_new);
+  std::vector<Entity_ID> edgegids(nedges_new);
+  for (int i = 0; i < ncells_new; i++) {
+    MigratedEntity const& cell = cells[i];
+    cellowner[i] = cell.owner;
+    cellgids[i] = cell.gid;
+    for (auto const& gid : cell.nodes) {
+      int& owner = nodeowner[nodeidx[gid]];
+      owner = std::min(owner, cell.owner);
+    }
+    for (auto const& gid : cell.faces) {
+      int& owner = faceowner[faceidx[gid]];
+      owner = std::min(owner, cell.owner);
+    }
+    for (auto const& gid : cell.edges) {
+      int& owner = edgeowner[edgeidx[gid]];
+      owner = std::min(owner, cell.owner);
+    }
+  }
+  for (int i = 0; i < nfaces_new; i++)
+    facegids[i] = faces[i].gid;
+  for (int i = 0; i < nedges_new; i++)
+    edgegids[i] = edges[i].gid;
+
+  // Number the entities and write out the image
+
+  std::vector<int> nodeorder = number_migrated("node", nodegids, nodeowner,
+                                               rank, comm, writer);
+  std::vector<int> faceorder = number_migrated("face", facegids, faceowner,
+                                               rank, comm, writer);
+  std::vector<int> cellorder = number_migrated("cell", cellgids, cellowner,
+                                               rank, comm, writer);
+  writer->add("cell_boundary_ghost", std::vector<Entity_ID>());
+  std::vector<int> edgeorder;
+  if (with_edges)
+    edgeorder = number_migrated("edge", edgegids, edgeowner, rank, comm,
+                                writer);
+
+  // Global ID to local ID maps in place of the index maps
+
+  auto to_local = [](std::unordered_map<Entity_ID, int> *idx,
+                     std::vector<int> const& order) {
+    std::vector<Entity_ID> lid(order.size());
+    for (int k = 0; k < static_cast<int>(order.size()); k++)
+      lid[order[k]] = k;
+    for (auto& kv : *idx)
+      kv.second = lid[kv.second];
+  };
+  to_local(&nodeidx, nodeorder);
+  to_local(&faceidx, faceorder);
+  to_local(&cellidx, cellorder);
+  to_local(&edgeidx, edgeorder);
+  auto localize = [](std::unordered_map<Entity_ID, int> const& idx,
+                     std::vector<Entity_ID> const& gids,
+                     Entity_ID_List *lids) {
+    lids->resize(gids.size());
+    for (int i = 0; i < static_cast<int>(gids.size()); i++)
+      (*lids)[i] = idx.at(gids[i]);
+  };
+
+  std::vector<double> coords(nnodes_new*spacedim);
+  for (int k = 0; k < nnodes_new; k++)
+    std::copy(nodexyz.begin() + nodeorder[k]*spacedim,
+              nodexyz.begin() + (nodeorder[k]+1)*spacedim,
+              coords.begin() + k*spacedim);
+  writer->add("node_coords", coords);
+
+  std::vector<std::uint8_t> celltypes(ncells_new);
+  for (int k = 0; k < ncells_new; k++)
+    celltypes[k] = static_cast<std::uint8_t>(cells[cellorder[k]].type);
+  writer->add("cell_type", celltypes);
+
+  writer->add_crs("cell_face", ncells_new, true,
+                  [&](int c, Entity_ID_List *ids, std::vector<dir_t> *dirs) {
+                    MigratedEntity const& cell = cells[cellorder[c]];
+                    localize(faceidx, cell.faces, ids);
+                    *dirs = cell.facedirs;
+                  });
+  writer->add_crs("cell_node", ncells_new, false,
+                  [&](int c, Entity_ID_List *ids, std::vector<dir_t> *dirs) {
+                    localize(nodeidx, cells[cellorder[c]].nodes, ids);
+                  });
+  writer->add_crs("face_node", nfaces_new, false,
+                  [&](int f, Entity_ID_List *ids, std::vector<dir_t> *dirs) {
+                    localize(nodeidx, faces[faceorder[f]].nodes, ids);
+                  });
+
+  // Upward adjacencies in local ID order; the cell for which a face
+  // points outwards comes first
+
+  std::vector<Entity_ID_List> nodecells(nnodes_new), nodefaces(nnodes_new);
+  std::vector<Entity_ID> facecells(2*nfaces_new, -1);
+  for (int c = 0; c < ncells_new; c++) {
+    MigratedEntity const& cell = cells[cellorder[c]];
+    for (auto const& gid : cell.nodes)
+      nodecells[nodeidx.at(gid)].push_back(c);
+    for (int i = 0; i < static_cast<int>(cell.faces.size()); i++) {
+      Entity_ID f = faceidx.at(cell.faces[i]);
+      int slot = (cell.facedirs[i] > 0) ? 0 : 1;
+      if (facecells[2*f+slot] >= 0) slot = 1-slot;
+      facecells[2*f+slot] = c;
+    }
+  }
+  for (int f = 0; f < nfaces_new; f++) {
+    if (facecells[2*f] < 0) std::swap(facecells[2*f], facecells[2*f+1]);
+    for (auto const& gid : faces[faceorder[f]].nodes)
+      nodefaces[nodeidx.at(gid)].push_back(f);
+  }
+  writer->add_crs("node_cell", nnodes_new, false,
+                  [&](int n, Entity_ID_List *ids, std::vector<dir_t> *dirs) {
+                    *ids = nodecells[n];
+                  });
+  writer->add_crs("node_face", nnodes_new, false,
+                  [&](int n, Entity_ID_List *ids, std::vector<dir_t> *dirs) {
+                    *ids = nodefaces[n];
+                  });
+  writer->add("face_cell", facecells);
+
+  if (with_edges) {
+    std::vector<Entity_ID> edgenodes(2*nedges_new);
+    for (int e = 0; e < nedges_new; e++)
+      for (int i = 0; i < 2; i++)
+        edgenodes[2*e+i] = nodeidx.at(edges[edgeorder[e]].nodes[i]);
+    writer->add("edge_node", edgenodes);
+
+    writer->add_crs("face_edge", nfaces_new, true,
+                    [&](int f, Entity_ID_List *ids, std::vector<dir_t> *dirs) {
+                      MigratedEntity const& face = faces[faceorder[f]];
+                      localize(edgeidx, face.edges, ids);
+                      *dirs = face.edgedirs;
+                    });
+    writer->add_crs("cell_edge", ncells_new, mdim == 2,
+                    [&](int c, Entity_ID_List *ids, std::vector<dir_t> *dirs) {
+                      MigratedEntity const& cell = cells[cellorder[c]];
+                      localize(edgeidx, cell.edges, ids);
+                      *dirs = cell.edgedirs;
+                    });
+  }
+
+  // Mesh sets, owned entities first
+
+  std::vector<int> setkinds, setnumowned, setnumghost;
+  std::vector<char> setnames;
+  std::vector<Entity_ID> setentities;
+  for (auto const& kv : setgids) {
+    Entity_kind kind = kv.second.first;
+    std::unordered_map<Entity_ID, int> const& idx =
+        (kind == Entity_kind::NODE) ? nodeidx :
+        (kind == Entity_kind::EDGE) ? edgeidx :
+        (kind == Entity_kind::FACE) ? faceidx : cellidx;
+    std::vector<int> const& owners =
+        (kind == Entity_kind::NODE) ? nodeowner :
+        (kind == Entity_kind::EDGE) ? edgeowner :
+        (kind == Entity_kind::FACE) ? faceowner : cellowner;
+    std::vector<int> const& order =
+        (kind == Entity_kind::NODE) ? nodeorder :
+        (kind == Entity_kind::EDGE) ? edgeorder :
+        (kind == Entity_kind::FACE) ? faceorder : cellorder;
+
+    Entity_ID_List lids;
+    localize(idx, kv.second.second, &lids);
+    std::sort(lids.begin(), lids.end());
+    lids.erase(std::unique(lids.begin(), lids.end()), lids.end());
+    int numowned = 0;
+    while (numowned < static_cast<int>(lids.size()) &&
+           owners[order[lids[numowned]]] == rank)
+      numowned++;
+
+    setkinds.push_back(static_cast<int>(kind));
+    setnumowned.push_back(numowned);
+    setnumghost.push_back(lids.size() - numowned);
+    setnames.insert(setnames.end(), kv.first.begin(), kv.first.end());
+    setnames.push_back('\0');
+    setentities.insert(setentities.end(), lids.begin(), lids.end());
+  }
+  writer->add("set_kind", setkinds);
+  writer->add("set_num_owned", setnumowned);
+  writer->add("set_num_ghost", setnumghost);
+  writer->add("set_names", setnames);
+  writer->add("set_entities", setentities);
+
+  std::memset(hdr, 0, sizeof(FlatHeader));
+  std::memcpy(hdr->magic, flat_magic, sizeof(flat_magic));
+  hdr->version = flat_version;
+  hdr->endian = flat_endian_check;
+  hdr->space_dim = spacedim;
+  hdr->manifold_dim = mdim;
+  hdr->mesh_type = static_cast<int>(mesh.mesh_type());
+  hdr->geom_type = static_cast<int>(mesh.geom_type());
+  hdr->nprocs = nprocs;
+  hdr->rank = rank;
+}
+
+}  // namespace
+
+
+// Write any mesh in the Jali flat binary format
+
+void write_flat_mesh(Mesh const& mesh, std::string const& filename) {
+  int nprocs, rank;
+  MPI_Comm comm = mesh.get_comm();
+  MPI_Comm_size(comm, &nprocs);
+  MPI_Comm_rank(comm, &rank);
+
+  FlatWriter writer;
+  FlatHeader hdr;
+  int ierr = 0, aerr = 0;
+  std::string errmsg;
+  try {
+    build_flat_image(mesh, &writer, &hdr);
+    writer.write(flat_mesh_filename(filename, nprocs, rank), hdr);
+  } catch (Errors::Message const& msg) {
+    ierr = 1;
+    errmsg = msg.what();
+  }
+  MPI_Allreduce(&ierr, &aerr, 1, MPI_INT, MPI_SUM, comm);
+  if (aerr) {
+    Errors::Message mesg("write_flat_mesh: failed on " +
+                         std::to_string(aerr) + " rank(s) " + errmsg);
+    Exceptions::Jali_throw(mesg);
+  }
+}
+
+
+//--------------------------------------
+// Constructor - read a mesh in flat binary format
+//--------------------------------------
+
+Mesh_flat::Mesh_flat(std::string const& filename,
+                     const MPI_Comm& mycomm,
+                     const JaliGeometry::GeometricModelPtr& gm,
+                     const bool request_faces,
+                     const bool request_edges,
+                     const bool request_sides,
+                     const bool request_wedges,
+                     const bool request_corners,
+                     const int num_tiles,
+                     const int num_ghost_layers_tile,
+                     const int num_ghost_layers_distmesh,
+                     const bool request_boundary_ghosts,
+                     const Partitioner_type partitioner) :
+    Mesh(request_faces, request_edges, request_sides, request_wedges,
+         request_corners, num_tiles, num_ghost_layers_tile,
+         num_ghost_layers_distmesh, request_boundary_ghosts,
+         partitioner, flat_mesh_geom_type(filename, mycomm), mycomm) {
+
+  int nprocs, rank;
+  MPI_Comm_size(mycomm, &nprocs);
+  MPI_Comm_rank(mycomm, &rank);
+  std::string rankfile = flat_mesh_filename(filename, nprocs, rank);
+
+  MapGuard guard(map_, map_size_);
+  map_file_(rankfile);
+  init_(rankfile, gm);
+  guard.release();
+}
+
+
+//--------------------------------------
+// Constructor - freeze a mesh of another framework into flat arrays
+//--------------------------------------
+
+Mesh_flat::Mesh_flat(Mesh const& inmesh,
+                     const JaliGeometry::GeometricModelPtr& gm,
+                     const bool request_faces,
+                     const bool request_edges,
+                     const bool request_sides,
+                     const bool request_wedges,
+                     const bool request_corners,
+                     const int num_tiles,
+                     const int num_ghost_layers_tile,
+                     const int num_ghost_layers_distmesh,
+                     const bool request_boundary_ghosts,
+                     const Partitioner_type partitioner) :
+    Mesh(request_faces, request_edges, request_sides, request_wedges,
+         request_corners, num_tiles, num_ghost_layers_tile,
+         num_ghost_layers_distmesh, request_boundary_ghosts,
+         partitioner, inmesh.geom_type(), inmesh.get_comm()) {
+
+  // Build the same image as write_flat_mesh would write but in
+  // anonymous memory so that the queries are answered exactly as for
+  // a mesh read from a file
+
+  FlatWriter writer;
+  FlatHeader hdr;
+  build_flat_image(inmesh, &writer, &hdr);
+
+  map_ = map_anonymous_image(&writer, hdr, &map_size_);
+  MapGuard guard(map_, map_size_);
+
+  init_("frozen mesh", gm);
+  guard.release();
+}
+
+
+//--------------------------------------
+// Constructor - redistribute a mesh of any framework
+//--------------------------------------
+
+Mesh_flat::Mesh_flat(Mesh const& inmesh,
+                     std::vector<int> const& cell_ranks,
+                     const JaliGeometry::GeometricModelPtr& gm,
+                     const bool request_faces,
+                     const bool request_edges,
+                     const bool request_sides,
+                     const bool request_wedges,
+                     const bool request_corners,
+                     const int num_tiles,
+                     const int num_ghost_layers_tile,
+                     const int num_ghost_layers_distmesh,
+                     const bool request_boundary_ghosts,
+                     const Partitioner_type partitioner) :
+    Mesh(request_faces, request_edges, request_sides, request_wedges,
+         request_corners, num_tiles, num_ghost_layers_tile,
+         num_ghost_layers_distmesh, request_boundary_ghosts,
+         partitioner, inmesh.geom_type(), inmesh.get_comm()) {
+  if (boundary_ghosts_requested_) {
+    Errors::Message mesg("Mesh_flat cannot generate boundary ghosts");
+    Exceptions::Jali_throw(mesg);
+  }
+
+  FlatWriter writer;
+  FlatHeader hdr;
+  build_migrated_image(inmesh, cell_ranks, num_ghost_layers_distmesh_,
+                       &writer, &hdr);
+  map_ = map_anonymous_image(&writer, hdr, &map_size_);
+  MapGuard guard(map_, map_size_);
+
+  init_("redistributed mesh", gm);
+  guard.release();
+}
+
+
+//--------------------------------------
+// Constructors - generate regular meshes distributed in blocks
+//--------------------------------------
+
+Mesh_flat::Mesh_flat(const double x0, const double y0, const double z0,
+                     const double x1, const double y1, const double z1,
+                     const int nx, const int ny, const int nz,
+                     const MPI_Comm& mycomm,
+                     const JaliGeometry::GeometricModelPtr& gm,
+                     const bool request_faces,
+                     const bool request_edges,
+                     const bool request_sides,
+                     const bool request_wedges,
+                     const bool request_corners,
+                     const int num_tiles,
+                     const int num_ghost_layers_tile,
+                     const int num_ghost_layers_distmesh,
+                     const bool request_boundary_ghosts,
+                     const Partitioner_type partitioner) :
+    Mesh(request_faces, request_edges, request_sides, request_wedges,
+         request_corners, num_tiles, num_ghost_layers_tile,
+         num_ghost_layers_distmesh, request_boundary_ghosts,
+         partitioner, JaliGeometry::Geom_type::CARTESIAN, mycomm) {
+  std::vector<double> axes[3] = {regular_axis(x0, x1, nx),
+                                 regular_axis(y0, y1, ny),
+                                 regular_axis(z0, z1, nz)};
+  generate_regular_(3, axes, gm);
+}
+
+
+Mesh_flat::Mesh_flat(const double x0, const double y0,
+                     const double x1, const double y1,
+                     const int nx, const int ny,
+                     const MPI_Comm& mycomm,
+                     const JaliGeometry::GeometricModelPtr& gm,
+                     const bool request_faces,
+                     const bool request_edges,
+                     const bool request_sides,
+                     const bool request_wedges,
+                     const bool request_corners,
+                     const int num_tiles,
+                     const int num_ghost_layers_tile,
+                     const int num_ghost_layers_distmesh,
+                     const bool request_boundary_ghosts,
+                     const Partitioner_type partitioner,
+                     const JaliGeometry::Geom_type geom_type) :
+    Mesh(request_faces, request_edges, request_sides, request_wedges,
+         request_corners, num_tiles, num_ghost_layers_tile,
+         num_ghost_layers_distmesh, request_boundary_ghosts,
+         partitioner, geom_type, mycomm) {
+  std::vector<double> axes[2] = {regular_axis(x0, x1, nx),
+                                 regular_axis(y0, y1, ny)};
+  generate_regular_(2, axes, gm);
+}
+
+
+Mesh_flat::Mesh_flat(const std::vector<double>& x,
+                     const MPI_Comm& mycomm,
+                     const JaliGeometry::GeometricModelPtr& gm,
+                     const bool request_faces,
+                     const bool request_edges,
+                     const bool request_sides,
+                     const bool request_wedges,
+                     const bool request_corners,
+                     const int num_tiles,
+                     const int num_ghost_layers_tile,
+                     const int num_ghost_layers_distmesh,
+                     const bool request_boundary_ghosts,
+                     const Partitioner_type partitioner,
+                     const JaliGeometry::Geom_type geom_type) :
+    Mesh(request_faces, request_edges, request_sides, request_wedges,
+         request_corners, num_tiles, num_ghost_layers_tile,
+         num_ghost_layers_distmesh, request_boundary_ghosts,
+         partitioner, geom_type, mycomm) {
+  generate_regular_(1, &x, gm);
+}
+
+
+// Build the block of this rank of a regular mesh in memory
+
+void Mesh_flat::generate_regular_(int dim, std::vector<double> const *axes,
+                                  const JaliGeometry::GeometricModelPtr& gm) {
+  if (boundary_ghosts_requested_) {
+    Errors::Message mesg("Mesh_flat cannot generate boundary ghosts");
+    Exceptions::Jali_throw(mesg);
+  }
+
+  bool with_edges = (edges_requested || sides_requested ||
+                     wedges_requested || corners_requested);
+
+  FlatWriter writer;
+  FlatHeader hdr;
+  build_regular_image(dim, axes, num_ghost_layers_distmesh_, with_edges,
+                      geom_type(), get_comm(), &writer, &hdr);
+  map_ = map_anonymous_image(&writer, hdr, &map_size_);
+  MapGuard guard(map_, map_size_);
+
+  init_("regular mesh", gm);
+  guard.release();
+}
+
+
+// Set up the mesh from the mapped image
+
+void Mesh_flat::init_(std::string const& rankfile,
+                      const JaliGeometry::GeometricModelPtr& gm) {
+  int nprocs, rank;
+  MPI_Comm_size(get_comm(), &nprocs);
+  MPI_Comm_rank(get_comm(), &rank);
+
+  FlatHeader const *hdr = static_cast<FlatHeader const *>(map_);
+  if (hdr->nprocs != nprocs || hdr->rank != rank)
+    flat_error(rankfile, "written for rank " + std::to_string(hdr->rank) +
+               " of " + std::to_string(hdr->nprocs) + " ranks");
+
+  set_space_dimension(hdr->space_dim);
+  set_manifold_dimension(hdr->manifold_dim);
+  set_mesh_type(static_cast<Mesh_type>(hdr->mesh_type));
+  if (gm != (JaliGeometry::GeometricModelPtr) NULL)
+    Mesh::set_geometric_model(gm);
+
+  // Sections are checked against the entity counts and the CRS
+  // offsets so that a damaged image is reported rather than read out
+  // of bounds. Their contents are not scanned so that pages are still
+  // only read when they are used
+
+  std::size_t count;
+  auto required = [&](std::string const& name, void const *section) {
+    if (!section) flat_error(rankfile, "missing section " + name);
+  };
+  auto sized = [&](std::string const& name, std::size_t expected) {
+    if (count != expected)
+      flat_error(rankfile, "section " + name + " has " +
+                 std::to_string(count) + " entries instead of " +
+                 std::to_string(expected));
+  };
+
+  std::size_t nnodes, nfaces, ncells, nedges = 0;
+  required("node_all", find_section<Entity_ID>(map_, "node_all", &nnodes));
+  required("face_all", find_section<Entity_ID>(map_, "face_all", &nfaces));
+  required("cell_all", find_section<Entity_ID>(map_, "cell_all", &ncells));
+
+  coords_ = const_cast<double *>(find_section<double>(map_, "node_coords",
+                                                      &count));
+  required("node_coords", coords_);
+  sized("node_coords", nnodes*hdr->space_dim);
+  cell_types_ = reinterpret_cast<Cell_type const *>(
+      find_section<std::uint8_t>(map_, "cell_type", &count));
+  required("cell_type", cell_types_);
+  sized("cell_type", ncells);
+
+  auto get_gids = [&](std::string const& kind, Entity_kind k,
+                      std::size_t n) {
+    gids_[static_cast<int>(k)] =
+        find_section<Entity_ID>(map_, kind + "_gid", &count);
+    required(kind + "_gid", gids_[static_cast<int>(k)]);
+    sized(kind + "_gid", n);
+
+    // Owners (not in files written before they were stored)
+
+    owners_[static_cast<int>(k)] =
+        find_section<int>(map_, kind + "_owner", &count);
+    if (owners_[static_cast<int>(k)]) sized(kind + "_owner", n);
+  };
+  get_gids("node", Entity_kind::NODE, nnodes);
+  get_gids("face", Entity_kind::FACE, nfaces);
+  get_gids("cell", Entity_kind::CELL, ncells);
+
+  // Adjacencies of nrows entities; returns the number of entries
+
+  auto get_crs = [&](std::string const& name, std::size_t nrows,
+                     CRS<> *crs) {
+    crs->offset = find_section<Entity_ID>(map_, name + "_offset", &count);
+    required(name + "_offset", crs->offset);
+    sized(name + "_offset", nrows+1);
+    crs->ids = find_section<Entity_ID>(map_, name + "_id", &count);
+    required(name + "_id", crs->ids);
+    if (crs->offset[0] != 0 ||
+        static_cast<std::size_t>(crs->offset[nrows]) != count)
+      flat_error(rankfile, "section " + name + "_offset does not match " +
+                 name + "_id");
+    return count;
+  };
+  auto get_dirs = [&](std::string const& name, std::size_t n) {
+    dir_t const *dirs = find_section<dir_t>(map_, name, &count);
+    required(name, dirs);
+    sized(name, n);
+    return dirs;
+  };
+  std::size_t n = get_crs("cell_face", ncells, &cell_faces_);
+  cell_face_dirs_ = get_dirs("cell_face_dir", n);
+  get_crs("cell_node", ncells, &cell_nodes_);
+  get_crs("face_node", nfaces, &face_nodes_);
+  get_crs("node_cell", nnodes, &node_cells_);
+  get_crs("node_face", nnodes, &node_faces_);
+  face_cells_ = find_section<Entity_ID>(map_, "face_cell", &count);
+  required("face_cell", face_cells_);
+  sized("face_cell", 2*nfaces);
+
+  // Entity lists in the base class so that iterators work
+
+  auto get_list = [&](std::string const& name, std::vector<int> *list) {
+    Entity_ID const *ids = find_section<Entity_ID>(map_, name, &count);
+    required(name, ids);
+    list->assign(ids, ids + count);
+  };
+  get_list("node_owned", &nodeids_owned_);
+  get_list("node_ghost", &nodeids_ghost_);
+  get_list("node_all", &nodeids_all_);
+  if (faces_requested) {
+    get_list("face_owned", &faceids_owned_);
+    get_list("face_ghost", &faceids_ghost_);
+    get_list("face_all", &faceids_all_);
+  }
+  get_list("cell_owned", &cellids_owned_);
+  get_list("cell_ghost", &cellids_ghost_);
+  get_list("cell_boundary_ghost", &cellids_boundary_ghost_);
+  get_list("cell_all", &cellids_all_);
+
+  edge_nodes_ = find_section<Entity_ID>(map_, "edge_node", &count);
+  have_edges_ = (edge_nodes_ != nullptr);
+  if (have_edges_) {
+    required("edge_all", find_section<Entity_ID>(map_, "edge_all", &nedges));
+    find_section<Entity_ID>(map_, "edge_node", &count);
+    sized("edge_node", 2*nedges);
+    get_gids("edge", Entity_kind::EDGE, nedges);
+    n = get_crs("face_edge", nfaces, &face_edges_);
+    face_edge_dirs_ = get_dirs("face_edge_dir", n);
+    n = get_crs("cell_edge", ncells, &cell_edges_);
+    if (hdr->manifold_dim == 2)
+      cell_edge_dirs_ = get_dirs("cell_edge_dir", n);
+  }
+  if (edges_requested) {
+    check_edges_();
+    get_list("edge_owned", &edgeids_owned_);
+    get_list("edge_ghost", &edgeids_ghost_);
+    get_list("edge_all", &edgeids_all_);
+  }
+
+  // Mesh sets
+
+  std::size_t nsets, nnames, nsetentities;
+  int const *setkinds = find_section<int>(map_, "set_kind", &nsets);
+  required("set_kind", setkinds);
+  int const *setnumowned = find_section<int>(map_, "set_num_owned", &count);
+  required("set_num_owned", setnumowned);
+  sized("set_num_owned", nsets);
+  int const *setnumghost = find_section<int>(map_, "set_num_ghost", &count);
+  required("set_num_ghost", setnumghost);
+  sized("set_num_ghost", nsets);
+  char const *setname = find_section<char>(map_, "set_names", &nnames);
+  required("set_names", setname);
+  Entity_ID const *setentities =
+      find_section<Entity_ID>(map_, "set_entities", &nsetentities);
+  required("set_entities", setentities);
+
+  char const *namesend = setname + nnames;
+  Entity_ID const *entitiesend = setentities + nsetentities;
+  for (int i = 0; i < static_cast<int>(nsets); i++) {
+    char const *nameend = std::find(setname, namesend, '\0');
+    Entity_kind kind = static_cast<Entity_kind>(setkinds[i]);
+    if (nameend == namesend ||
+        (kind != Entity_kind::NODE && kind != Entity_kind::EDGE &&
+         kind != Entity_kind::FACE && kind != Entity_kind::CELL) ||
+        setnumowned[i] < 0 || setnumghost[i] < 0 ||
+        setnumowned[i] + setnumghost[i] > entitiesend - setentities)
+      flat_error(rankfile, "sections set_* do not match");
+    StoredSet set;
+    set.name.assign(setname, nameend);
+    setname = nameend + 1;
+    set.kind = kind;
+    set.num_owned = setnumowned[i];
+    set.num_ghost = setnumghost[i];
+    set.owned = setentities;
+    set.ghost = setentities + set.num_owned;
+    setentities += set.num_owned + set.num_ghost;
+    stored_sets_.push_back(set);
+  }
+
+  cache_extra_variables();
+
+  // Recreate the mesh sets that existed on the mesh that was written
+
+  for (auto const& set : stored_sets_) {
+    if (set.kind == Entity_kind::EDGE && !edges_requested) continue;
+    if (set.kind == Entity_kind::FACE && !faces_requested) continue;
+    Entity_ID_List owned(set.owned, set.owned + set.num_owned);
+    Entity_ID_List ghost(set.ghost, set.ghost + set.num_ghost);
+    make_meshset(set.name, *this, set.kind, owned, ghost, true);
+  }
+
+  if (Mesh::num_tiles_ini_)
+    Mesh::build_tiles();
+}
+
+
+// The adjacencies in the image are looked up as quickly as the base
+// class caches, so they are not copied into them
+
+void Mesh_flat::cache_extra_variables() {
+  cache_type_info();
+  cache_interior_boundary_info();
+
+  if (sides_requested)
+    cache_side_info();
+  if (wedges_requested) {  // keep this order
+    if (!side_info_cached) cache_side_info();
+    cache_wedge_info();
+  }
+  if (corners_requested) {  // Keep this order
+    if (!side_info_cached) cache_side_info();
+    if (!wedge_info_cached) cache_wedge_info();
+    cache_corner_info();
+  }
+
+  update_geometric_quantities();
+}
+
+
+Mesh_flat::~Mesh_flat() {
+  if (map_) munmap(map_, map_size_);
+}
+
+
+// Map the file copy-on-write so that node coordinates can be modified
+// in memory; pages that are only read stay shared with the page cache
+
+void Mesh_flat::map_file_(std::string const& filename) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) flat_error(filename, "cannot open");
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      static_cast<std::size_t>(st.st_size) < sizeof(FlatHeader)) {
+    close(fd);
+    flat_error(filename, "cannot read");
+  }
+  map_size_ = st.st_size;
+
+  map_ = mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map_ == MAP_FAILED) {
+    map_ = nullptr;
+    flat_error(filename, "cannot map into memory");
+  }
+
+  FlatHeader const *hdr = static_cast<FlatHeader const *>(map_);
+  if (std::memcmp(hdr->magic, flat_magic, sizeof(flat_magic)) != 0)
+    flat_error(filename, "not a Jali flat mesh file");
+  if (hdr->endian != flat_endian_check)
+    flat_error(filename, "written on a machine with different endianness");
+  if (hdr->version != flat_version)
+    flat_error(filename, "unsupported version " +
+               std::to_string(hdr->version));
+
+  FlatSection const *sections = reinterpret_cast<FlatSection const *>(hdr+1);
+  if (sizeof(FlatHeader) + hdr->nsections*sizeof(FlatSection) > map_size_)
+    flat_error(filename, "truncated section table");
+  for (int i = 0; i < hdr->nsections; i++)
+    if (sections[i].elem_size == 0 || sections[i].offset > map_size_ ||
+        sections[i].count > (map_size_ - sections[i].offset)/
+        sections[i].elem_size)
+      flat_error(filename, "truncated section " +
+                 std::string(sections[i].name));
+}
+
+
+void Mesh_flat::check_edges_() const {
+  if (!have_edges_) {
+    Errors::Message mesg("Flat mesh file has no edges - write it from a mesh"
+                         " with edges to use edges, sides, wedges or corners");
+    Exceptions::Jali_throw(mesg);
+  }
+}
+
+
+Cell_type Mesh_flat::cell_get_type(const Entity_ID cellid) const {
+  return cell_types_[cellid];
+}
+
+
+Entity_ID Mesh_flat::GID(const Entity_ID lid, const Entity_kind kind) const {
+  int ikind = static_cast<int>(kind);
+  if (ikind < 0 || ikind >= NUM_ENTITY_KINDS || !gids_[ikind]) {
+    Errors::Message mesg("Global IDs of " + Entity_kind_string(kind) +
+                         " not stored in flat mesh");
+    Exceptions::Jali_throw(mesg);
+  }
+  return gids_[ikind][lid];
+}
+
+
+int Mesh_flat::entity_owner(const Entity_ID lid,
+                            const Entity_kind kind) const {
+  int ikind = static_cast<int>(kind);
+  if (ikind < 0 || ikind >= NUM_ENTITY_KINDS || !owners_[ikind]) {
+    Errors::Message mesg("Owners of " + Entity_kind_string(kind) +
+                         " not stored in flat mesh");
+    Exceptions::Jali_throw(mesg);
+  }
+  return owners_[ikind][lid];
+}
+
+
+void Mesh_flat::cell_get_nodes(const Entity_ID cellid,
+                               Entity_ID_List *nodeids) const {
+  nodeids->assign(cell_nodes_.ids + cell_nodes_.offset[cellid],
+                  cell_nodes_.ids + cell_nodes_.offset[cellid+1]);
+}
+
+
+void Mesh_flat::face_get_nodes(const Entity_ID faceid,
+                               Entity_ID_List *nodeids) const {
+  nodeids->assign(face_nodes_.ids + face_nodes_.offset[faceid],
+                  face_nodes_.ids + face_nodes_.offset[faceid+1]);
+}
+
+
+void Mesh_flat::node_get_cells(const Entity_ID nodeid,
+                               const Entity_type ptype,
+                               Entity_ID_List *cellids) const {
+  cellids->clear();
+  for (int i = node_cells_.offset[nodeid]; i < node_cells_.offset[nodeid+1];
+       i++) {
+    Entity_ID c = node_cells_.ids[i];
+    if (ptype == Entity_type::ALL ||
+        entity_get_type(Entity_kind::CELL, c) == ptype)
+      cellids->push_back(c);
+  }
+}
+
+
+void Mesh_flat::node_get_faces(const Entity_ID nodeid,
+                               const Entity_type ptype,
+                               Entity_ID_List *faceids) const {
+  faceids->clear();
+  for (int i = node_faces_.offset[nodeid]; i < node_faces_.offset[nodeid+1];
+       i++) {
+    Entity_ID f = node_faces_.ids[i];
+    if (ptype == Entity_type::ALL ||
+        entity_get_type(Entity_kind::FACE, f) == ptype)
+      faceids->push_back(f);
+  }
+}
+
+
+void Mesh_flat::node_get_cell_faces(const Entity_ID nodeid,
+                                    const Entity_ID cellid,
+                                    const Entity_type ptype,
+                                    Entity_ID_List *faceids) const {
+  faceids->clear();
+  for (int i = cell_faces_.offset[cellid]; i < cell_faces_.offset[cellid+1];
+       i++) {
+    Entity_ID f = cell_faces_.ids[i];
+    if (ptype != Entity_type::ALL &&
+        entity_get_type(Entity_kind::FACE, f) != ptype)
+      continue;
+    Entity_ID const *fbegin = face_nodes_.ids + face_nodes_.offset[f];
+    Entity_ID const *fend = face_nodes_.ids + face_nodes_.offset[f+1];
+    if (std::find(fbegin, fend, nodeid) != fend)
+      faceids->push_back(f);
+  }
+}
+
+
+void Mesh_flat::cell_get_face_adj_cells(const Entity_ID cellid,
+                                        const Entity_type ptype,
+                                        Entity_ID_List *fadj_cellids) const {
+  fadj_cellids->clear();
+  for (int i = cell_faces_.offset[cellid]; i < cell_faces_.offset[cellid+1];
+       i++) {
+    Entity_ID f = cell_faces_.ids[i];
+    Entity_ID c = (face_cells_[2*f] == cellid) ? face_cells_[2*f+1] :
+        face_cells_[2*f];
+    if (c < 0) continue;
+    if (ptype == Entity_type::ALL ||
+        entity_get_type(Entity_kind::CELL, c) == ptype)
+      fadj_cellids->push_back(c);
+  }
+}
+
+
+void Mesh_flat::cell_get_node_adj_cells(const Entity_ID cellid,
+                                        const Entity_type ptype,
+                                        Entity_ID_List *nadj_cellids) const {
+  nadj_cellids->clear();
+  for (int i = cell_nodes_.offset[cellid]; i < cell_nodes_.offset[cellid+1];
+       i++) {
+    Entity_ID n = cell_nodes_.ids[i];
+    for (int j = node_cells_.offset[n]; j < node_cells_.offset[n+1]; j++) {
+      Entity_ID c = node_cells_.ids[j];
+      if (c == cellid ||
+          std::find(nadj_cellids->begin(), nadj_cellids->end(), c) !=
+          nadj_cellids->end())
+        continue;
+      if (ptype == Entity_type::ALL ||
+          entity_get_type(Entity_kind::CELL, c) == ptype)
+        nadj_cellids->push_back(c);
+    }
+  }
+}
+
+
+// Batch adjacencies are copied straight out of the CRS arrays
+
+void Mesh_flat::gather_rows_(CRS<> const& crs,
+                             Entity_ID_List const& entityids,
+                             std::vector<int> *offsets,
+                             Entity_ID_List *ids) {
+  offsets->resize(entityids.size()+1);
+  (*offsets)[0] = 0;
+  for (int i = 0; i < entityids.size(); i++) {
+    Entity_ID e = entityids[i];
+    (*offsets)[i+1] = (*offsets)[i] + crs.offset[e+1] - crs.offset[e];
+  }
+
+  ids->resize(offsets->back());
+  for (int i = 0; i < entityids.size(); i++) {
+    Entity_ID e = entityids[i];
+    std::copy(crs.ids + crs.offset[e], crs.ids + crs.offset[e+1],
+              ids->begin() + (*offsets)[i]);
+  }
+}
+
+
+void Mesh_flat::cells_get_nodes(Entity_ID_List const& cellids,
+                                std::vector<int> *offsets,
+                                Entity_ID_List *nodeids) const {
+  gather_rows_(cell_nodes_, cellids, offsets, nodeids);
+}
+
+
+void Mesh_flat::faces_get_nodes(Entity_ID_List const& faceids,
+                                std::vector<int> *offsets,
+                                Entity_ID_List *nodeids) const {
+  gather_rows_(face_nodes_, faceids, offsets, nodeids);
+}
+
+
+void Mesh_flat::nodes_get_cells(Entity_ID_List const& nodeids,
+                                const Entity_type ptype,
+                                std::vector<int> *offsets,
+                                Entity_ID_List *cellids) const {
+  if (ptype == Entity_type::ALL) {
+    gather_rows_(node_cells_, nodeids, offsets, cellids);
+    return;
+  }
+
+  offsets->resize(nodeids.size()+1);
+  cellids->clear();
+  (*offsets)[0] = 0;
+  for (int i = 0; i < nodeids.size(); i++) {
+    Entity_ID n = nodeids[i];
+    for (int j = node_cells_.offset[n]; j < node_cells_.offset[n+1]; j++) {
+      Entity_ID c = node_cells_.ids[j];
+      if (entity_get_type(Entity_kind::CELL, c) == ptype)
+        cellids->push_back(c);
+    }
+    (*offsets)[i+1] = cellids->size();
+  }
+}
+
+
+void Mesh_flat::node_get_coordinates(const Entity_ID nodeid,
+                                     JaliGeometry::Point *ncoord) const {
+  int dim = space_dimension();
+  ncoord->set(dim, coords_ + nodeid*dim);
+}
+
+
+void Mesh_flat::face_get_coordinates(const Entity_ID faceid,
+                                     std::vector<JaliGeometry::Point> *fcoords)
+    const {
+  fcoords->clear();
+  for (int i = face_nodes_.offset[faceid]; i < face_nodes_.offset[faceid+1];
+       i++) {
+    JaliGeometry::Point xyz;
+    node_get_coordinates(face_nodes_.ids[i], &xyz);
+    fcoords->push_back(xyz);
+  }
+}
+
+
+void Mesh_flat::cell_get_coordinates(const Entity_ID cellid,
+                                     std::vector<JaliGeometry::Point> *ccoords)
+    const {
+  ccoords->clear();
+  for (int i = cell_nodes_.offset[cellid]; i < cell_nodes_.offset[cellid+1];
+       i++) {
+    JaliGeometry::Point xyz;
+    node_get_coordinates(cell_nodes_.ids[i], &xyz);
+    ccoords->push_back(xyz);
+  }
+}
+
+
+void Mesh_flat::node_set_coordinates(const Entity_ID nodeid,
+                                     const JaliGeometry::Point coords) {
+  int dim = space_dimension();
+  for (int d = 0; d < dim; d++)
+    coords_[nodeid*dim+d] = coords[d];
+}
+
+
+void Mesh_flat::node_set_coordinates(const Entity_ID nodeid,
+                                     const double *coords) {
+  int dim = space_dimension();
+  std::copy(coords, coords + dim, coords_ + nodeid*dim);
+}
+
+
+void Mesh_flat::get_labeled_set_entities(
+    const JaliGeometry::LabeledSetRegionPtr r, const Entity_kind kind,
+    Entity_ID_List *owned_entities, Entity_ID_List *ghost_entities) const {
+  owned_entities->clear();
+  ghost_entities->clear();
+  for (auto const& set : stored_sets_) {
+    if (set.kind == kind && set.name == r->label()) {
+      owned_entities->assign(set.owned, set.owned + set.num_owned);
+      ghost_entities->assign(set.ghost, set.ghost + set.num_ghost);
+      return;
+    }
+  }
+}
+
+
+void Mesh_flat::cell_get_faces_and_dirs_internal(const Entity_ID cellid,
+                                                 Entity_ID_List *faceids,
+                                                 std::vector<dir_t> *face_dirs,
+                                                 const bool ordered) const {
+  // faces are stored in standard order
+  faceids->assign(cell_faces_.ids + cell_faces_.offset[cellid],
+                  cell_faces_.ids + cell_faces_.offset[cellid+1]);
+  if (face_dirs)
+    face_dirs->assign(cell_face_dirs_ + cell_faces_.offset[cellid],
+                      cell_face_dirs_ + cell_faces_.offset[cellid+1]);
+}
+
+
+void Mesh_flat::face_get_cells_internal(const Entity_ID faceid,
+                                        const Entity_type ptype,
+                                        Entity_ID_List *cellids) const {
+  cellids->clear();
+  for (int i = 0; i < 2; i++) {
+    Entity_ID c = face_cells_[2*faceid+i];
+    if (c < 0) continue;
+    if (ptype == Entity_type::ALL ||
+        entity_get_type(Entity_kind::CELL, c) == ptype)
+      cellids->push_back(c);
+  }
+}
+
+
+void Mesh_flat::face_get_edges_and_dirs_internal(const Entity_ID faceid,
+                                                 Entity_ID_List *edgeids,
+                                                 std::vector<dir_t> *edge_dirs,
+                                                 const bool ordered) const {
+  check_edges_();
+  edgeids->assign(face_edges_.ids + face_edges_.offset[faceid],
+                  face_edges_.ids + face_edges_.offset[faceid+1]);
+  if (edge_dirs)
+    edge_dirs->assign(face_edge_dirs_ + face_edges_.offset[faceid],
+                      face_edge_dirs_ + face_edges_.offset[faceid+1]);
+}
+
+
+void Mesh_flat::cell_get_edges_internal(const Entity_ID cellid,
+                                        Entity_ID_List *edgeids) const {
+  check_edges_();
+  edgeids->assign(cell_edges_.ids + cell_edges_.offset[cellid],
+                  cell_edges_.ids + cell_edges_.offset[cellid+1]);
+}
+
+
+void Mesh_flat::cell_2D_get_edges_and_dirs_internal(const Entity_ID cellid,
+                                                    Entity_ID_List *edgeids,
+                                                    std::vector<dir_t>
+                                                    *edge_dirs) const {
+  check_edges_();
+  if (!cell_edge_dirs_) {
+    Errors::Message mesg("cell_2D_get_edges_and_dirs called on a 3D mesh");
+    Exceptions::Jali_throw(mesg);
+  }
+  edgeids->assign(cell_edges_.ids + cell_edges_.offset[cellid],
+                  cell_edges_.ids + cell_edges_.offset[cellid+1]);
+  if (edge_dirs)
+    edge_dirs->assign(cell_edge_dirs_ + cell_edges_.offset[cellid],
+                      cell_edge_dirs_ + cell_edges_.offset[cellid+1]);
+}
+
+
+void Mesh_flat::edge_get_nodes_internal(const Entity_ID edgeid,
+                                        Entity_ID *enode0,
+                                        Entity_ID *enode1) const {
+  check_edges_();
+  *enode0 = edge_nodes_[2*edgeid];
+  *enode1 = edge_nodes_[2*edgeid+1];
+}
+
+}  // close namespace Jali
@@ -0,0 +1,421 @@
+/*
+ Copyright (c) 2019, Triad National Security, LLC
+ All rights reserved.
+
+ Copyright 2019. Triad National Security, LLC. This software was
+ produced under U.S. Government contract 89233218CNA000001 for Los
+ Alamos National Laboratory (LANL), which is operated by Triad
+ National Security, LLC for the U.S. Department of Energy. 
+ All rights in the program are reserved by Triad National Security,
+ LLC, and the U.S. Department of Energy/National Nuclear Security
+ Administration. The Government is granted for itself and others acting
+ on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+ in this material to reproduce, prepare derivative works, distribute
+ copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+
+ 
+ This is open source software distributed under the 3-clause BSD license.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of Triad National Security, LLC, Los Alamos
+    National Laboratory, LANL, the U.S. Government, nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ 
+ THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+ BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef _MESH_FLAT_H_
+#define _MESH_FLAT_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <string>
+#include "mpi.h"
+
+#include "Mesh.hh"
+#include "Region.hh"
+
+#include "Geometry.hh"
+#include "GeometricModel.hh"
+#include "errors.hh"
+
+namespace Jali {
+
+// Jali native (flat) binary mesh format
+//
+// Each rank's partition of the mesh is stored in its own file as a
+// header, a table of named sections and the sections themselves -
+// flat arrays of connectivity (in compressed row storage), node
+// coordinates, owned/ghost entity lists, global IDs, owning ranks and
+// mesh sets, each aligned to a 64 byte boundary. Mesh_flat maps the
+// file into memory and answers queries directly from these arrays, so
+// reading a mesh involves no partitioning, renumbering or ghost
+// exchange.
+//
+// For a mesh written from N > 1 ranks, rank r's file is named
+// <filename>.<N>.<r>; on a single rank it is just <filename>. The
+// mesh must be read on the same number of ranks it was written from.
+//
+// A Mesh_flat can also be built in memory from a mesh of another
+// framework ("freezing" it) so that the other mesh can be released.
+//
+// Finally, regular meshes in 1D, 2D and 3D can be generated directly
+// in flat arrays on any number of ranks. The ranks are arranged in a
+// grid of blocks and each rank builds its own block and the ghost
+// layers around it from the global (i,j,k) indices of the entities,
+// from which the global IDs and owners follow. This needs no
+// communication at all, so generation time does not grow with the
+// number of ranks.
+
+//! Name of the file holding the partition of a rank
+std::string flat_mesh_filename(std::string const& filename, int nprocs,
+                               int rank);
+
+//! Is filename (or the file for this rank) a Jali flat binary mesh?
+bool is_flat_mesh_file(std::string const& filename, MPI_Comm const& comm);
+
+//! Write any mesh in the Jali flat binary format (collective)
+void write_flat_mesh(Mesh const& mesh, std::string const& filename);
+
+
+class Mesh_flat : public virtual Mesh {
+ public:
+
+  // Read a mesh written by write_flat_mesh. Edges must be present in
+  // the file if edges (or sides, wedges, corners) are requested
+
+  Mesh_flat(std::string const& filename,
+            const MPI_Comm& communicator,
+            const JaliGeometry::GeometricModelPtr& gm =
+            (JaliGeometry::GeometricModelPtr) NULL,
+            const bool request_faces = true,
+            const bool request_edges = false,
+            const bool request_sides = false,
+            const bool request_wedges = false,
+            const bool request_corners = false,
+            const int num_tiles = 0,
+            const int num_ghost_layers_tile = 0,
+            const int num_ghost_layers_distmesh = 1,
+            const bool request_boundary_ghosts = false,
+            const Partitioner_type partitioner = Partitioner_type::METIS);
+
+  // Freeze a mesh of any framework - copy everything needed to
+  // answer queries into flat arrays so that the original mesh (and
+  // its framework data structures) can be released. The mesh must
+  // have faces, and edges if edges, sides, wedges or corners are
+  // requested
+
+  Mesh_flat(Mesh const& inmesh,
+            const JaliGeometry::GeometricModelPtr& gm =
+            (JaliGeometry::GeometricModelPtr) NULL,
+            const bool request_faces = true,
+            const bool request_edges = false,
+            const bool request_sides = false,
+            const bool request_wedges = false,
+            const bool request_corners = false,
+            const int num_tiles = 0,
+            const int num_ghost_layers_tile = 0,
+            const int num_ghost_layers_distmesh = 1,
+            const bool request_boundary_ghosts = false,
+            const Partitioner_type partitioner = Partitioner_type::METIS);
+
+  // Redistribute a mesh of any framework - every rank gets the cells
+  // that cell_ranks (indexed like the owned cells of inmesh, e.g. from
+  // Mesh::get_rank_partitioning) sends to it, with
+  // num_ghost_layers_distmesh layers of ghost cells which inmesh must
+  // also have. Entities keep their global IDs and mesh sets are
+  // carried over. The mesh must have faces, and edges if edges,
+  // sides, wedges or corners are requested (collective)
+
+  Mesh_flat(Mesh const& inmesh,
+            std::vector<int> const& cell_ranks,
+            const JaliGeometry::GeometricModelPtr& gm =
+            (JaliGeometry::GeometricModelPtr) NULL,
+            const bool request_faces = true,
+            const bool request_edges = false,
+            const bool request_sides = false,
+            const bool request_wedges = false,
+            const bool request_corners = false,
+            const int num_tiles = 0,
+            const int num_ghost_layers_tile = 0,
+            const int num_ghost_layers_distmesh = 1,
+            const bool request_boundary_ghosts = false,
+            const Partitioner_type partitioner = Partitioner_type::METIS);
+
+  // Generate a regular hexahedral mesh distributed over the ranks of
+  // the communicator in blocks (the partitioner is not used). Edges
+  // are generated if edges, sides, wedges or corners are requested
+
+  Mesh_flat(const double x0, const double y0, const double z0,
+            const double x1, const double y1, const double z1,
+            const int nx, const int ny, const int nz,
+            const MPI_Comm& communicator,
+            const JaliGeometry::GeometricModelPtr& gm =
+            (JaliGeometry::GeometricModelPtr) NULL,
+            const bool request_faces = true,
+            const bool request_edges = false,
+            const bool request_sides = false,
+            const bool request_wedges = false,
+            const bool request_corners = false,
+            const int num_tiles = 0,
+            const int num_ghost_layers_tile = 0,
+            const int num_ghost_layers_distmesh = 1,
+            const bool request_boundary_ghosts = false,
+            const Partitioner_type partitioner = Partitioner_type::BLOCK);
+
+  // Generate a regular quadrilateral mesh distributed over the ranks
+  // of the communicator in blocks
+
+  Mesh_flat(const double x0, const double y0,
+            const double x1, const double y1,
+            const int nx, const int ny,
+            const MPI_Comm& communicator,
+            const JaliGeometry::GeometricModelPtr& gm =
+            (JaliGeometry::GeometricModelPtr) NULL,
+            const bool request_faces = true,
+            const bool request_edges = false,
+            const bool request_sides = false,
+            const bool request_wedges = false,
+            const bool request_corners = false,
+            const int num_tiles = 0,
+            const int num_ghost_layers_tile = 0,
+            const int num_ghost_layers_distmesh = 1,
+            const bool request_boundary_ghosts = false,
+            const Partitioner_type partitioner = Partitioner_type::BLOCK,
+            const JaliGeometry::Geom_type geom_type =
+            JaliGeometry::Geom_type::CARTESIAN);
+
+  // Generate a 1D mesh with node coordinates x distributed over the
+  // ranks of the communicator in blocks (edges are not supported)
+
+  Mesh_flat(const std::vector<double>& x,
+            const MPI_Comm& communicator,
+            const JaliGeometry::GeometricModelPtr& gm =
+            (JaliGeometry::GeometricModelPtr) NULL,
+            const bool request_faces = true,
+            const bool request_edges = false,
+            const bool request_sides = false,
+            const bool request_wedges = false,
+            const bool request_corners = false,
+            const int num_tiles = 0,
+            const int num_ghost_layers_tile = 0,
+            const int num_ghost_layers_distmesh = 1,
+            const bool request_boundary_ghosts = false,
+            const Partitioner_type partitioner = Partitioner_type::BLOCK,
+            const JaliGeometry::Geom_type geom_type =
+            JaliGeometry::Geom_type::CARTESIAN);
+
+  virtual ~Mesh_flat();
+
+
+  // Get cell type
+  Cell_type cell_get_type(const Entity_ID cellid) const;
+
+  // Global ID of any entity
+  Entity_ID GID(const Entity_ID lid, const Entity_kind kind) const;
+
+  // Rank owning a node, edge, face or cell (this rank for owned
+  // entities and boundary ghosts)
+  int entity_owner(const Entity_ID lid, const Entity_kind kind) const;
+
+  // Size in bytes of the file or memory image the mesh is read from
+  std::size_t image_size() const { return map_size_; }
+
+  // Downward Adjacencies
+  //---------------------
+
+  // Get nodes of cell (in standard order for standard cells)
+  void cell_get_nodes(const Entity_ID cellid,
+                      Entity_ID_List *nodeids) const;
+
+  // Get nodes of face
+  void face_get_nodes(const Entity_ID faceid,
+                      Entity_ID_List *nodeids) const;
+
+  // Upward adjacencies
+  //-------------------
+
+  // Cells of type 'ptype' connected to a node
+  void node_get_cells(const Entity_ID nodeid,
+                      const Entity_type ptype,
+                      Entity_ID_List *cellids) const;
+
+  // Faces of type 'ptype' connected to a node
+  void node_get_faces(const Entity_ID nodeid,
+                      const Entity_type ptype,
+                      Entity_ID_List *faceids) const;
+
+  // Get faces of ptype of a particular cell that are connected to the
+  // given node
+  void node_get_cell_faces(const Entity_ID nodeid,
+                           const Entity_ID cellid,
+                           const Entity_type ptype,
+                           Entity_ID_List *faceids) const;
+
+  // Same level adjacencies
+  //-----------------------
+
+  // Face connected neighboring cells of given cell of a particular ptype
+  void cell_get_face_adj_cells(const Entity_ID cellid,
+                               const Entity_type ptype,
+                               Entity_ID_List *fadj_cellids) const;
+
+  // Node connected neighboring cells of given cell of a particular ptype
+  void cell_get_node_adj_cells(const Entity_ID cellid,
+                               const Entity_type ptype,
+                               Entity_ID_List *nadj_cellids) const;
+
+  // Batch adjacencies
+  //------------------
+
+  void cells_get_nodes(Entity_ID_List const& cellids,
+                       std::vector<int> *offsets,
+                       Entity_ID_List *nodeids) const;
+
+  void faces_get_nodes(Entity_ID_List const& faceids,
+                       std::vector<int> *offsets,
+                       Entity_ID_List *nodeids) const;
+
+  void nodes_get_cells(Entity_ID_List const& nodeids,
+                       const Entity_type ptype,
+                       std::vector<int> *offsets,
+                       Entity_ID_List *cellids) const;
+
+  // Mesh entity geometry
+  //---------------------
+
+  // Node coordinates
+  void node_get_coordinates(const Entity_ID nodeid,
+                            JaliGeometry::Point *ncoord) const;
+
+  // Face coordinates - conventions same as face_to_nodes call
+  void face_get_coordinates(const Entity_ID faceid,
+                            std::vector<JaliGeometry::Point> *fcoords) const;
+
+  // Coordinates of cells in standard order
+  void cell_get_coordinates(const Entity_ID cellid,
+                            std::vector<JaliGeometry::Point> *ccoords) const;
+
+  // Modify the coordinates of a node (the file is mapped copy-on-write
+  // so it is not modified)
+
+  void node_set_coordinates(const Entity_ID nodeid,
+                            const JaliGeometry::Point coords);
+
+  void node_set_coordinates(const Entity_ID nodeid, const double *coords);
+
+ protected:
+
+  // Cache the parallel types, derived entities and geometric
+  // quantities but not the adjacencies, which are read straight from
+  // the image
+
+  void cache_extra_variables();
+
+  // Labeled sets are the mesh sets stored in the file
+
+  void get_labeled_set_entities(const JaliGeometry::LabeledSetRegionPtr r,
+                                const Entity_kind kind,
+                                Entity_ID_List *owned_entities,
+                                Entity_ID_List *ghost_entities) const;
+
+  void cell_get_faces_and_dirs_internal(const Entity_ID cellid,
+                                        Entity_ID_List *faceids,
+                                        std::vector<dir_t> *face_dirs,
+                                        const bool ordered = false) const;
+
+  void face_get_cells_internal(const Entity_ID faceid,
+                               const Entity_type ptype,
+                               Entity_ID_List *cellids) const;
+
+  void face_get_edges_and_dirs_internal(const Entity_ID faceid,
+                                        Entity_ID_List *edgeids,
+                                        std::vector<dir_t> *edge_dirs,
+                                        const bool ordered = true) const;
+
+  void cell_get_edges_internal(const Entity_ID cellid,
+                               Entity_ID_List *edgeids) const;
+
+  void cell_2D_get_edges_and_dirs_internal(const Entity_ID cellid,
+                                           Entity_ID_List *edgeids,
+                                           std::vector<dir_t> *edge_dirs)
+      const;
+
+  void edge_get_nodes_internal(const Entity_ID edgeid,
+                               Entity_ID *enode0, Entity_ID *enode1) const;
+
+ private:
+
+  // Compressed row storage view of an adjacency in the mapped file
+  template <class T = Entity_ID>
+  struct CRS {
+    Entity_ID const *offset = nullptr;
+    T const *ids = nullptr;
+  };
+
+  // Gather the rows of a CRS adjacency for a list of entities
+  static void gather_rows_(CRS<> const& crs, Entity_ID_List const& entityids,
+                           std::vector<int> *offsets, Entity_ID_List *ids);
+
+  void map_file_(std::string const& filename);
+  void generate_regular_(int dim, std::vector<double> const *axes,
+                         const JaliGeometry::GeometricModelPtr& gm);
+  void init_(std::string const& source,
+             const JaliGeometry::GeometricModelPtr& gm);
+  void check_edges_() const;
+
+  // Memory mapped file
+  void *map_ = nullptr;
+  std::size_t map_size_ = 0;
+
+  double *coords_ = nullptr;    // writable (private mapping)
+  Cell_type const *cell_types_ = nullptr;
+  Entity_ID const *gids_[NUM_ENTITY_KINDS] = {};
+  int const *owners_[NUM_ENTITY_KINDS] = {};
+
+  CRS<> cell_faces_, cell_nodes_, face_nodes_, node_cells_, node_faces_;
+  dir_t const *cell_face_dirs_ = nullptr;
+  Entity_ID const *face_cells_ = nullptr;  // 2 per face, -1 if absent
+
+  bool have_edges_ = false;
+  Entity_ID const *edge_nodes_ = nullptr;  // 2 per edge
+  CRS<> face_edges_, cell_edges_;
+  dir_t const *face_edge_dirs_ = nullptr;
+  dir_t const *cell_edge_dirs_ = nullptr;  // only for 2D cells
+
+  // Mesh sets stored in the file
+  struct StoredSet {
+    std::string name;
+    Entity_kind kind;
+    Entity_ID const *owned, *ghost;
+    int num_owned, num_ghost;
+  };
+  std::vector<StoredSet> stored_sets_;
+};
+
+}  // close namespace Jali
+
+#endif /* _MESH_FLAT_H_ */
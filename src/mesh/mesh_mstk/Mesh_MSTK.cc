@@ -61,11 +61,38 @@ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 namespace Jali {
 
+int Mesh_MSTK::mstk_partition_method(const Partitioner_type partitioner) {
+  switch (partitioner) {
+  case Partitioner_type::METIS:
+    return 0;
+  case Partitioner_type::ZOLTAN_GRAPH:
+    return 1;
+  case Partitioner_type::ZOLTAN_RCB:
+  case Partitioner_type::RCB:
+    return 2;
+  default: {
+    // MSTK does not know about the INDEX, BLOCK and space filling
+    // curve partitioners
+    Errors::Message mesg("Partitioner " +
+                         Partitioner_type_string(partitioner) +
+                         " is not supported by MSTK - use METIS,"
+                         " ZOLTAN_GRAPH or (ZOLTAN_)RCB, or redistribute"
+                         " a flat mesh");
+    Exceptions::Jali_throw(mesg);
+    return -1;
+  }
+  }
+}
+
+
 void Mesh_MSTK::init_mesh_from_file_(std::string const filename,
                                      const Partitioner_type partitioner) {
 
   int ok = 0;
 
+  // Check the partitioner before reading anything in
+  int method = (numprocs > 1) ? mstk_partition_method(partitioner) : 0;
+
   mesh = MESH_New(F1);
 
   if (filename.find(".exo") != std::string::npos) {  // Exodus file
@@ -84,9 +111,6 @@ void Mesh_MSTK::init_mesh_from_file_(std::string const filename,
       int topo_dim = MESH_Num_Regions(mesh) ? 3 : 2;
       int with_attr = 1;  // Redistribute any attributes and sets
 
-      // MSTK does not know about INDEX, BLOCK partitioners
-      int method = static_cast<int>(partitioner)-2; 
-
       int del_inmesh = 1;  // Delete input mesh (on P0) after distribution
       
       Mesh_ptr globalmesh = mesh;
@@ -181,7 +205,7 @@ Mesh_MSTK::Mesh_MSTK(const std::string filename, const MPI_Comm& incomm,
   int space_dim = 3;
   pre_create_steps_(space_dim, gm);
 
-  init_mesh_from_file_(filename);
+  init_mesh_from_file_(filename, partitioner);
 
   int cell_dim = MESH_Num_Regions(mesh) ? 3 : 2;
 
@@ -1868,6 +1892,73 @@ void Mesh_MSTK::face_get_nodes(const Entity_ID faceid,
 }  // Mesh_MSTK::face_get_nodes
 
 
+// Nodes of a list of cells in compressed row storage
+
+void Mesh_MSTK::cells_get_nodes(Entity_ID_List const& cellids,
+                                std::vector<int> *offsets,
+                                Entity_ID_List *nodeids) const {
+  assert(offsets != NULL && nodeids != NULL);
+
+  int nc = cellids.size();
+  offsets->resize(nc+1);
+  nodeids->clear();
+  nodeids->reserve(8*nc);
+
+  (*offsets)[0] = 0;
+  for (int i = 0; i < nc; ++i) {
+    MEntity_ptr cell = cell_id_to_handle[cellids[i]];
+
+    List_ptr cverts;
+    if (manifold_dimension() == 3)          // Volume mesh
+      cverts = MR_Vertices(cell);
+    else                                    // Surface mesh
+      cverts = MF_Vertices(cell, 1, 0);
+
+    int nn = List_Num_Entries(cverts);
+    for (int j = 0; j < nn; ++j)
+      nodeids->push_back(MEnt_ID(List_Entry(cverts, j))-1);
+    List_Delete(cverts);
+
+    (*offsets)[i+1] = nodeids->size();
+  }
+}  // Mesh_MSTK::cells_get_nodes
+
+
+// Nodes of a list of faces in compressed row storage
+
+void Mesh_MSTK::faces_get_nodes(Entity_ID_List const& faceids,
+                                std::vector<int> *offsets,
+                                Entity_ID_List *nodeids) const {
+  assert(faces_initialized);
+  assert(offsets != NULL && nodeids != NULL);
+
+  int nf = faceids.size();
+  offsets->resize(nf+1);
+  nodeids->clear();
+  nodeids->reserve(4*nf);
+
+  (*offsets)[0] = 0;
+  for (int i = 0; i < nf; ++i) {
+    Entity_ID f = faceids[i];
+    MEntity_ptr genface = face_id_to_handle[f];
+
+    if (manifold_dimension() == 3) {  // Volume mesh
+      List_ptr fverts = MF_Vertices(genface, !faceflip[f], 0);
+      int nn = List_Num_Entries(fverts);
+      for (int j = 0; j < nn; ++j)
+        nodeids->push_back(MEnt_ID(List_Entry(fverts, j))-1);
+      List_Delete(fverts);
+    } else {                          // Surface mesh or 2D mesh
+      int i0 = faceflip[f] ? 1 : 0;
+      nodeids->push_back(MEnt_ID(ME_Vertex(genface, i0))-1);
+      nodeids->push_back(MEnt_ID(ME_Vertex(genface, !i0))-1);
+    }
+
+    (*offsets)[i+1] = nodeids->size();
+  }
+}  // Mesh_MSTK::faces_get_nodes
+
+
 // Get nodes of an edge
 
 void Mesh_MSTK::edge_get_nodes_internal(const Entity_ID edgeid,
@@ -4649,7 +4740,7 @@ int Mesh_MSTK::generate_regular_mesh(Mesh_ptr regmesh, double x0, double y0,
   int i, j, k, ii, jj, kk, gid, gdim, globalid;
   int IG, JG, KG, IOFFSET = 0, JOFFSET = 0, KOFFSET = 0;
   double xyz[3], dx, dy, dz, DX, DY, DZ;
-  MVertex_ptr ***verts, mv, rverts[8], fverts[4], everts[2];
+  MVertex_ptr mv, rverts[8], fverts[4], everts[2];
   MEdge_ptr me;
   MFace_ptr mf;
   MRegion_ptr mr;
@@ -4686,12 +4777,10 @@ int Mesh_MSTK::generate_regular_mesh(Mesh_ptr regmesh, double x0, double y0,
     NZ = nz;
   }
 
-  verts = (MVertex_ptr ***) malloc((nx+1)*sizeof(MVertex_ptr **));
-  for (j = 0; j < nx+1; ++j) {
-    verts[j] = (MVertex_ptr **) malloc((ny+1)*sizeof(MVertex_ptr *));
-    for (k = 0; k < ny+1; ++k)
-      verts[j][k] = (MVertex_ptr *) malloc((nz+1)*sizeof(MVertex_ptr));
-  }
+  std::vector<MVertex_ptr> vertarray((nx+1)*(ny+1)*(nz+1));
+  auto verts = [&](int iv, int jv, int kv) -> MVertex_ptr& {
+    return vertarray[(iv*(ny+1) + jv)*(nz+1) + kv];
+  };
 
   for (i = 0; i < nx+1; ++i) {
     xyz[0] = (i == nx) ? x1 : x0 + i*dx;
@@ -4710,7 +4799,7 @@ int Mesh_MSTK::generate_regular_mesh(Mesh_ptr regmesh, double x0, double y0,
 
         mv = MV_New(regmesh);
         MV_Set_Coords(mv, xyz);
-        verts[i][j][k] = mv;
+        verts(i, j, k) = mv;
 
         gdim  = vgdim_tmpl[ii][jj][kk];
         MV_Set_GEntDim(mv, gdim);
@@ -4738,8 +4827,8 @@ int Mesh_MSTK::generate_regular_mesh(Mesh_ptr regmesh, double x0, double y0,
 	KG = KOFFSET + k;
         me = ME_New(regmesh);
 
-        everts[0] = verts[i][j][k];
-        everts[1] = verts[i][j][k+1];
+        everts[0] = verts(i, j, k);
+        everts[1] = verts(i, j, k+1);
         ME_Set_Vertex(me, 0, everts[0]);
         ME_Set_Vertex(me, 1, everts[1]);
 
@@ -4767,8 +4856,8 @@ int Mesh_MSTK::generate_regular_mesh(Mesh_ptr regmesh, double x0, double y0,
         KG = KOFFSET + k;
         me = ME_New(regmesh);
 
-        everts[0] = verts[i][j][k];
-        everts[1] = verts[i][j+1][k];
+        everts[0] = verts(i, j, k);
+        everts[1] = verts(i, j+1, k);
         ME_Set_Vertex(me, 0, everts[0]);
         ME_Set_Vertex(me, 1, everts[1]);
 
@@ -4796,8 +4885,8 @@ int Mesh_MSTK::generate_regular_mesh(Mesh_ptr regmesh, double x0, double y0,
         JG = JOFFSET + j;
         me = ME_New(regmesh);
 
-        everts[0] = verts[i][j][k];
-        everts[1] = verts[i+1][j][k];
+        everts[0] = verts(i, j, k);
+        everts[1] = verts(i+1, j, k);
         ME_Set_Vertex(me, 0, everts[0]);
         ME_Set_Vertex(me, 1, everts[1]);
 
@@ -4829,10 +4918,10 @@ int Mesh_MSTK::generate_regular_mesh(Mesh_ptr regmesh, double x0, double y0,
 	KG = KOFFSET + k;
         mf = MF_New(regmesh);
 
-        fverts[0] = verts[i][j][k];
-        fverts[1] = verts[i][j+1][k];
-        fverts[2] = verts[i][j+1][k+1];
-        fverts[3] = verts[i][j][k+1];
+        fverts[0] = verts(i, j, k);
+        fverts[1] = verts(i, j+1, k);
+        fverts[2] = verts(i, j+1, k+1);
+        fverts[3] = verts(i, j, k+1);
         MF_Set_Vertices(mf, 4, fverts);
 
         ii = (IG%NX) ? 1 : (IG ? 2 : 0);
@@ -4858,10 +4947,10 @@ int Mesh_MSTK::generate_regular_mesh(Mesh_ptr regmesh, double x0, double y0,
 	KG = KOFFSET + k;
         mf = MF_New(regmesh);
 
-        fverts[0] = verts[i][j][k];
-        fverts[1] = verts[i+1][j][k];
-        fverts[2] = verts[i+1][j][k+1];
-        fverts[3] = verts[i][j][k+1];
+        fverts[0] = verts(i, j, k);
+        fverts[1] = verts(i+1, j, k);
+        fverts[2] = verts(i+1, j, k+1);
+        fverts[3] = verts(i, j, k+1);
         MF_Set_Vertices(mf, 4, fverts);
 
         jj = (JG%NY) ? 1 : (JG ? 2 : 0);
@@ -4887,10 +4976,10 @@ int Mesh_MSTK::generate_regular_mesh(Mesh_ptr regmesh, double x0, double y0,
         KG = KOFFSET + k;
         mf = MF_New(regmesh);
 
-        fverts[0] = verts[i][j][k];
-        fverts[1] = verts[i+1][j][k];
-        fverts[2] = verts[i+1][j+1][k];
-        fverts[3] = verts[i][j+1][k];
+        fverts[0] = verts(i, j, k);
+        fverts[1] = verts(i+1, j, k);
+        fverts[2] = verts(i+1, j+1, k);
+        fverts[3] = verts(i, j+1, k);
         MF_Set_Vertices(mf, 4, fverts);
 
         kk = (KG%NZ) ? 1 : (KG ? 2 : 0);
@@ -4919,10 +5008,10 @@ int Mesh_MSTK::generate_regular_mesh(Mesh_ptr regmesh, double x0, double y0,
         mr = MR_New(regmesh);
         MR_Set_GEntID(mr, 1);
 
-        rverts[0] = verts[i][j][k];       rverts[1] = verts[i+1][j][k];
-        rverts[2] = verts[i+1][j+1][k];   rverts[3] = verts[i][j+1][k];
-        rverts[4] = verts[i][j][k+1];     rverts[5] = verts[i+1][j][k+1];
-        rverts[6] = verts[i+1][j+1][k+1]; rverts[7] = verts[i][j+1][k+1];
+        rverts[0] = verts(i, j, k);       rverts[1] = verts(i+1, j, k);
+        rverts[2] = verts(i+1, j+1, k);   rverts[3] = verts(i, j+1, k);
+        rverts[4] = verts(i, j, k+1);     rverts[5] = verts(i+1, j, k+1);
+        rverts[6] = verts(i+1, j+1, k+1); rverts[7] = verts(i, j+1, k+1);
 
         MR_Set_Vertices(mr, 8, rverts, 6, NULL);
 
@@ -4932,13 +5021,6 @@ int Mesh_MSTK::generate_regular_mesh(Mesh_ptr regmesh, double x0, double y0,
     }
   }
 
-  for (i = 0; i < nx+1; ++i) {
-    for (j = 0; j < ny+1; ++j)
-      free(verts[i][j]);
-    free(verts[i]);
-  }
-  free(verts);
-
   return 1;
 }
 
@@ -4951,7 +5033,7 @@ int Mesh_MSTK::generate_regular_mesh(Mesh_ptr regmesh, double x0, double y0,
   int i, j, dir[4], globalid;
   int IG, JG, IOFFSET = 0, JOFFSET = 0;
   double xyz[3], dx, dy, DX, DY;
-  MVertex_ptr **verts, v0, v1, mv;
+  MVertex_ptr v0, v1, mv;
   MEdge_ptr fedges[4], me;
   MFace_ptr mf;
 
@@ -4968,22 +5050,10 @@ int Mesh_MSTK::generate_regular_mesh(Mesh_ptr regmesh, double x0, double y0,
     NY = ny;
   }
 
-  int rank, nprocs;
-  MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
-  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-  for (int r = 0; r < nprocs; r++) {
-    if (r == rank) {
-      std::cerr << "Rank " << rank << " I0 = " << IOFFSET <<
-          " J0 = " << JOFFSET << " x0 = " << x0 << " y0 = " << y0 <<
-          " DX = " << DX << " DY = " << DY << " (x0-X0)/DX =" << (x0-X0)/DX <<
-          " (y0-Y0)/DY =" << (y0-Y0)/DY << "\n";
-    }
-    MPI_Barrier(MPI_COMM_WORLD);
-  }
-  
-  verts = (MVertex_ptr **) malloc((nx+1)*sizeof(MVertex_ptr *));
-  for (i = 0; i < nx+1; ++i)
-    verts[i] = (MVertex_ptr *) malloc((ny+1)*sizeof(MVertex_ptr));
+  std::vector<MVertex_ptr> vertarray((nx+1)*(ny+1));
+  auto verts = [&](int iv, int jv) -> MVertex_ptr& {
+    return vertarray[iv*(ny+1) + jv];
+  };
 
   xyz[2] = 0.0;
   for (i = 0; i < nx+1; ++i) {
@@ -5035,7 +5105,7 @@ int Mesh_MSTK::generate_regular_mesh(Mesh_ptr regmesh, double x0, double y0,
       globalid = IG*(NY+1) + JG;
       MV_Set_GlobalID(mv, globalid+1);
       
-      verts[i][j] = mv;
+      verts(i, j) = mv;
     }
   }
 
@@ -5049,8 +5119,8 @@ int Mesh_MSTK::generate_regular_mesh(Mesh_ptr regmesh, double x0, double y0,
       mf = MF_New(regmesh);
 
       /* edge 0 - bottom edge */
-      v0 = verts[i][j];
-      v1 = verts[i+1][j];
+      v0 = verts(i, j);
+      v1 = verts(i+1, j);
       fedges[0] = MVs_CommonEdge(v0, v1);
       if (fedges[0])
         dir[0] = (ME_Vertex(fedges[0], 0) == v0) ? 1 : 0;
@@ -5077,8 +5147,8 @@ int Mesh_MSTK::generate_regular_mesh(Mesh_ptr regmesh, double x0, double y0,
 
 
       /* edge 1 - right edge */
-      v0 = verts[i+1][j];
-      v1 = verts[i+1][j+1];
+      v0 = verts(i+1, j);
+      v1 = verts(i+1, j+1);
       fedges[1] = MVs_CommonEdge(v0, v1);
       if (fedges[1])
         dir[1] = (ME_Vertex(fedges[1], 0) == v0) ? 1 : 0;
@@ -5106,8 +5176,8 @@ int Mesh_MSTK::generate_regular_mesh(Mesh_ptr regmesh, double x0, double y0,
 
 
       /* edge 2 - top edge*/
-      v0 = verts[i+1][j+1];
-      v1 = verts[i][j+1];
+      v0 = verts(i+1, j+1);
+      v1 = verts(i, j+1);
       fedges[2] = MVs_CommonEdge(v0, v1);
       if (fedges[2])
         dir[2] = (ME_Vertex(fedges[2], 0) == v0) ? 1 : 0;
@@ -5134,8 +5204,8 @@ int Mesh_MSTK::generate_regular_mesh(Mesh_ptr regmesh, double x0, double y0,
 
 
       /* edge 3 - left edge */
-      v0 = verts[i][j+1];
-      v1 = verts[i][j];
+      v0 = verts(i, j+1);
+      v1 = verts(i, j);
       fedges[3] = MVs_CommonEdge(v0, v1);
       if (fedges[3])
         dir[3] = (ME_Vertex(fedges[3], 0) == v0) ? 1 : 0;
@@ -5172,10 +5242,6 @@ int Mesh_MSTK::generate_regular_mesh(Mesh_ptr regmesh, double x0, double y0,
     }
   }
 
-  for (i = 0; i < nx+1; ++i)
-    free(verts[i]);
-  free(verts);
-
   return 1;
 }
 
@@ -5377,6 +5443,24 @@ void Mesh_MSTK::get_field_info(Entity_kind on_what, int *num,
 
 }
 
+// Handles of entities of a kind in the order of their IDs - field
+// data arrays are indexed by entity ID, which for MSTK meshes is not
+// the order of the entities in the MSTK mesh lists (owned entities
+// are numbered first)
+
+std::vector<MEntity_ptr> const&
+Mesh_MSTK::field_entity_handles(Entity_kind on_what) const {
+  static const std::vector<MEntity_ptr> no_handles;
+  switch (on_what) {
+    case Entity_kind::NODE: return vtx_id_to_handle;
+    case Entity_kind::EDGE: return edge_id_to_handle;
+    case Entity_kind::FACE: return face_id_to_handle;
+    case Entity_kind::CELL: return cell_id_to_handle;
+    default: return no_handles;
+  }
+}
+
+
 // Retrieve integer field data from the mesh
 
 bool Mesh_MSTK::get_field(std::string field_name, Entity_kind on_what,
@@ -5389,32 +5473,13 @@ bool Mesh_MSTK::get_field(std::string field_name, Entity_kind on_what,
 
   if (MAttrib_Get_Type(mattrib) != INT) return false;
 
-  MType enttype = MAttrib_Get_EntDim(mattrib);
-
-  int nent;
-  switch (enttype) {
-    case MVERTEX: nent = MESH_Num_Vertices(mesh); break;
-    case MEDGE: nent = MESH_Num_Edges(mesh); break;
-    case MFACE: nent = MESH_Num_Faces(mesh); break;
-    case MREGION: nent = MESH_Num_Regions(mesh); break;
-    default: nent = 0; break;
-  }
-
-  MEntity_ptr ment;
+  std::vector<MEntity_ptr> const& handles = field_entity_handles(on_what);
+  int nent = handles.size();
   for (int i = 0; i < nent; i++) {
-    switch (enttype) {
-      case MVERTEX: ment = MESH_Vertex(mesh, i); break;
-      case MEDGE: ment = MESH_Edge(mesh, i); break;
-      case MFACE: ment = MESH_Face(mesh, i); break;
-      case MREGION: ment = MESH_Region(mesh, i); break;
-      default: ment = NULL; break;
-    }
-    if (ment == NULL) continue;  // not needed since nent=0 but here anyway
-
     double rval;
     void *pval;
-    MEnt_Get_AttVal(ment, mattrib, &(data[i]), &rval, &pval);
-  }  // for
+    MEnt_Get_AttVal(handles[i], mattrib, &(data[i]), &rval, &pval);
+  }
 
   return true;
 }  // Mesh_MSTK::get_mesh_field
@@ -5433,32 +5498,13 @@ bool Mesh_MSTK::get_field(std::string field_name, Entity_kind on_what,
 
   if (MAttrib_Get_Type(mattrib) != DOUBLE) return false;
 
-  MType enttype = MAttrib_Get_EntDim(mattrib);
-
-  int nent;
-  switch (enttype) {
-    case MVERTEX: nent = MESH_Num_Vertices(mesh); break;
-    case MEDGE: nent = MESH_Num_Edges(mesh); break;
-    case MFACE: nent = MESH_Num_Faces(mesh); break;
-    case MREGION: nent = MESH_Num_Regions(mesh); break;
-    default: nent = 0; break;
-  }
-
-  MEntity_ptr ment;
+  std::vector<MEntity_ptr> const& handles = field_entity_handles(on_what);
+  int nent = handles.size();
   for (int i = 0; i < nent; i++) {
-    switch (enttype) {
-      case MVERTEX: ment = MESH_Vertex(mesh, i); break;
-      case MEDGE: ment = MESH_Edge(mesh, i); break;
-      case MFACE: ment = MESH_Face(mesh, i); break;
-      case MREGION: ment = MESH_Region(mesh, i); break;
-      default: ment = NULL; break;
-    }
-    if (ment == NULL) continue;  // not needed since nent=0 but here anyway
-
     int ival;
     void *pval;
-    MEnt_Get_AttVal(ment, mattrib, &ival, &(data[i]), &pval);
-  }  // for
+    MEnt_Get_AttVal(handles[i], mattrib, &ival, &(data[i]), &pval);
+  }
 
   return true;
 }  // Mesh_MSTK::get_mesh_field
@@ -5483,29 +5529,10 @@ bool Mesh_MSTK::store_field(std::string field_name, Entity_kind on_what,
   } else
     mattrib = MAttrib_New(mesh, field_name.c_str(), INT, mtype);
 
-  int nent;
-  switch (mtype) {
-    case MVERTEX: nent = MESH_Num_Vertices(mesh); break;
-    case MEDGE: nent = MESH_Num_Edges(mesh); break;
-    case MFACE: nent = MESH_Num_Faces(mesh); break;
-    case MREGION: nent = MESH_Num_Regions(mesh); break;
-    default: nent = 0; break;
-  }
-
-  MEntity_ptr ment;
-  for (int i = 0; i < nent; i++) {
-    switch (mtype) {
-      case MVERTEX: ment = MESH_Vertex(mesh, i); break;
-      case MEDGE: ment = MESH_Edge(mesh, i); break;
-      case MFACE: ment = MESH_Face(mesh, i); break;
-      case MREGION: ment = MESH_Region(mesh, i); break;
-      default: ment = NULL; break;
-    }
-    if (ment == NULL) continue;  // not needed since nent=0 but here anyway
-
-    MEnt_Set_AttVal(ment, mattrib, data[i], 0.0, NULL);
-
-  }  // for (int i...);
+  std::vector<MEntity_ptr> const& handles = field_entity_handles(on_what);
+  int nent = handles.size();
+  for (int i = 0; i < nent; i++)
+    MEnt_Set_AttVal(handles[i], mattrib, data[i], 0.0, NULL);
 
   return true;
 }  // Mesh_MSTK::store_mesh_field
@@ -5530,28 +5557,10 @@ bool Mesh_MSTK::store_field(std::string field_name, Entity_kind on_what,
   } else
     mattrib = MAttrib_New(mesh, field_name.c_str(), DOUBLE, mtype);
 
-  int nent;
-  switch (mtype) {
-    case MVERTEX: nent = MESH_Num_Vertices(mesh); break;
-    case MEDGE: nent = MESH_Num_Edges(mesh); break;
-    case MFACE: nent = MESH_Num_Faces(mesh); break;
-    case MREGION: nent = MESH_Num_Regions(mesh); break;
-    default: nent = 0; break;
-  }
-
-  MEntity_ptr ment;
-  for (int i = 0; i < nent; i++) {
-    switch (mtype) {
-      case MVERTEX: ment = MESH_Vertex(mesh, i); break;
-      case MEDGE: ment = MESH_Edge(mesh, i); break;
-      case MFACE: ment = MESH_Face(mesh, i); break;
-      case MREGION: ment = MESH_Region(mesh, i); break;
-      default: ment = NULL; break;
-    }
-    if (ment == NULL) continue;  // not needed since nent=0 but here anyway
-
-    MEnt_Set_AttVal(ment, mattrib, 0.0, data[i], NULL);
-  }  // for (int i...);
+  std::vector<MEntity_ptr> const& handles = field_entity_handles(on_what);
+  int nent = handles.size();
+  for (int i = 0; i < nent; i++)
+    MEnt_Set_AttVal(handles[i], mattrib, 0, data[i], NULL);
 
   return true;
 }  // Mesh_MSTK::store_mesh_field
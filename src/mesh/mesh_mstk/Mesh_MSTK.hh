@@ -243,6 +243,14 @@ class Mesh_MSTK : public Mesh {
   Entity_ID GID(const Entity_ID lid, const Entity_kind kind) const;
 
 
+  // MSTK distribution method for a partitioner type. The native RCB
+  // partitioner is mapped to Zoltan's RCB; the INDEX, BLOCK and space
+  // filling curve partitioners have no MSTK counterpart and throw an
+  // error
+
+  static int mstk_partition_method(const Partitioner_type partitioner);
+
+
 
   //
   // Mesh Entity Adjacencies
@@ -273,6 +281,18 @@ class Mesh_MSTK : public Mesh {
                       Entity_ID_List *nodeids) const;
 
 
+  // Nodes of a list of cells and of a list of faces in compressed
+  // row storage, in one pass over the MSTK entities
+
+  void cells_get_nodes(Entity_ID_List const& cellids,
+                       std::vector<int> *offsets,
+                       Entity_ID_List *nodeids) const;
+
+  void faces_get_nodes(Entity_ID_List const& faceids,
+                       std::vector<int> *offsets,
+                       Entity_ID_List *nodeids) const;
+
+
   // Get nodes of edge On a distributed mesh all nodes (Entity_type::PARALLEL_OWNED or
   // Entity_type::PARALLEL_GHOST) of the face are returned
 
@@ -766,6 +786,12 @@ class Mesh_MSTK : public Mesh {
   mutable std::vector<MEntity_ptr> face_id_to_handle;
   std::vector<MEntity_ptr> cell_id_to_handle;
 
+  // Handles of entities of a kind in the order of their IDs (what
+  // field data arrays are indexed by)
+
+  std::vector<MEntity_ptr> const&
+  field_entity_handles(Entity_kind on_what) const;
+
 
   // flag whether to flip a face dir or not when returning nodes of a
   // face (relevant only on partition boundaries)
@@ -814,40 +840,22 @@ bool Mesh_MSTK::get_field_internal(std::string field_name, Entity_kind on_what,
   if (atttype != VECTOR && atttype != TENSOR)
     return false;
 
-  MType enttype = MAttrib_Get_EntDim(mattrib);
   int ncomp = MAttrib_Get_NumComps(mattrib);
 
   if (ncomp != N) return false;
 
-  int nent;
-  switch (enttype) {
-    case MVERTEX: nent = MESH_Num_Vertices(mesh); break;
-    case MEDGE: nent = MESH_Num_Edges(mesh); break;
-    case MFACE: nent = MESH_Num_Faces(mesh); break;
-    case MREGION: nent = MESH_Num_Regions(mesh); break;
-    default: nent = 0; break;
-  }
+  // Attribute values of vectors and tensors are arrays owned by MSTK
+  // - copy them straight into the field data
 
-  MEntity_ptr ment;
+  std::vector<MEntity_ptr> const& handles = field_entity_handles(on_what);
+  int nent = handles.size();
   for (int i = 0; i < nent; i++) {
-    switch (enttype) {
-      case MVERTEX: ment = MESH_Vertex(mesh, i); break;
-      case MEDGE: ment = MESH_Edge(mesh, i); break;
-      case MFACE: ment = MESH_Face(mesh, i); break;
-      case MREGION: ment = MESH_Region(mesh, i); break;
-      default: ment = NULL; break;
-    }
-    if (ment == NULL) continue;  // not needed since nent=0 but here anyway
-
     int ival;
     double rval;
-    void *pval;
-    MEnt_Get_AttVal(ment, mattrib, &ival, &rval, &pval);
-
-    for (int j = 0; j < N; j++)
-      data[i][j] = ((double *)pval)[j];
-
-  }  // for (int i...);
+    void *pval = nullptr;
+    if (MEnt_Get_AttVal(handles[i], mattrib, &ival, &rval, &pval) && pval)
+      std::copy((double *) pval, (double *) pval + N, &(data[i][0]));
+  }
 
   return true;
 }  // Mesh_MSTK::get_mesh_field
@@ -872,7 +880,7 @@ bool Mesh_MSTK::store_field_internal(std::string field_name,
       return false;
 
     atttype = MAttrib_Get_Type(mattrib);
-    if (atttype != VECTOR || atttype != TENSOR) {
+    if (atttype != VECTOR && atttype != TENSOR) {
       std::cerr << "Mesh_MSTK::store_field -" <<
           " found attribute with same name but different type" << std::endl;
       return false;
@@ -891,33 +899,22 @@ bool Mesh_MSTK::store_field_internal(std::string field_name,
     mattrib = MAttrib_New(mesh, field_name.c_str(), atttype, mtype, N);
   }
 
-  int nent;
-  switch (mtype) {
-    case MVERTEX: nent = MESH_Num_Vertices(mesh); break;
-    case MEDGE: nent = MESH_Num_Edges(mesh); break;
-    case MFACE: nent = MESH_Num_Faces(mesh); break;
-    case MREGION: nent = MESH_Num_Regions(mesh); break;
-    default: nent = 0; break;
-  }
+  // Reuse the value arrays of entities that already have the
+  // attribute (e.g. on repeated exports) and only allocate new ones
+  // for entities that don't
 
-  MEntity_ptr ment;
+  std::vector<MEntity_ptr> const& handles = field_entity_handles(on_what);
+  int nent = handles.size();
   for (int i = 0; i < nent; i++) {
-    switch (mtype) {
-      case MVERTEX: ment = MESH_Vertex(mesh, i); break;
-      case MEDGE: ment = MESH_Edge(mesh, i); break;
-      case MFACE: ment = MESH_Face(mesh, i); break;
-      case MREGION: ment = MESH_Region(mesh, i); break;
-      default: ment = NULL; break;
+    int ival;
+    double rval;
+    void *pval = nullptr;
+    if (!MEnt_Get_AttVal(handles[i], mattrib, &ival, &rval, &pval) || !pval) {
+      pval = new double[N];
+      MEnt_Set_AttVal(handles[i], mattrib, 0, 0.0, pval);
     }
-    if (ment == NULL) continue;  // not needed since nent=0 but here anyway
-
-    void *pval;
-    double *vec = new double[N];
-    std::copy(&(data[i][0]), &(data[i][0]) + N, vec);
-    pval = vec;
-
-    MEnt_Set_AttVal(ment, mattrib, 0, 0.0, pval);
-  } // for
+    std::copy(&(data[i][0]), &(data[i][0]) + N, (double *) pval);
+  }
 
   return true;
 }  // Mesh_MSTK::store_mesh_field
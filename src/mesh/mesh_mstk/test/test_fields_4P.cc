@@ -0,0 +1,168 @@
+/*
+ Copyright (c) 2019, Triad National Security, LLC
+ All rights reserved.
+
+ Copyright 2019. Triad National Security, LLC. This software was
+ produced under U.S. Government contract 89233218CNA000001 for Los
+ Alamos National Laboratory (LANL), which is operated by Triad
+ National Security, LLC for the U.S. Department of Energy. 
+ All rights in the program are reserved by Triad National Security,
+ LLC, and the U.S. Department of Energy/National Nuclear Security
+ Administration. The Government is granted for itself and others acting
+ on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+ in this material to reproduce, prepare derivative works, distribute
+ copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+
+ 
+ This is open source software distributed under the 3-clause BSD license.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of Triad National Security, LLC, Los Alamos
+    National Laboratory, LANL, the U.S. Government, nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ 
+ THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+ BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#include <UnitTest++.h>
+
+#include <array>
+#include <iostream>
+#include <vector>
+
+#include "../Mesh_MSTK.hh"
+
+// Special class just for testing protected functions
+
+namespace Jali {
+class Mesh_MSTK_Fields_Test : public Mesh_MSTK {
+ public:
+
+  // Simplified constructor that generates a 3D mesh
+
+  Mesh_MSTK_Fields_Test(const double x0, const double y0, const double z0,
+                        const double x1, const double y1, const double z1,
+                        const int nx, const int ny, const int nz,
+                        const MPI_Comm& incomm) :
+      Mesh_MSTK(x0, y0, z0, x1, y1, z1, nx, ny, nz, incomm) {
+  }
+
+  ~Mesh_MSTK_Fields_Test() {}
+
+  // pass through functions for accessing protected functions
+
+  template<class T>
+  bool get_field(std::string field_name, Entity_kind on_what, T *data) const {
+    return Mesh_MSTK::get_field(field_name, on_what, data);
+  }
+
+  template<class T>
+  bool store_field(std::string field_name, Entity_kind on_what, T *data) {
+    return Mesh_MSTK::store_field(field_name, on_what, data);
+  }
+};  // end class Mesh_MSTK_Fields_Test
+}  // end namespace Jali
+
+
+// Fields stored on a distributed mesh are read back in the order of
+// the Jali IDs on every rank, ghosts included
+
+TEST(MSTK_FIELDS_ROUNDTRIP_4P) {
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  Jali::Mesh_MSTK_Fields_Test mesh(0.0, 0.0, 0.0, 1.0, 1.0, 1.0, 4, 4, 4,
+                                   MPI_COMM_WORLD);
+
+  int nc = mesh.num_entities(Jali::Entity_kind::CELL,
+                             Jali::Entity_type::ALL);
+  int nv = mesh.num_entities(Jali::Entity_kind::NODE,
+                             Jali::Entity_type::ALL);
+
+  // Cell fields of ints and doubles set to the global IDs
+
+  std::vector<int> cellgid_out(nc), cellgid_in(nc, -1);
+  std::vector<double> cellval_out(nc), cellval_in(nc, -1.0);
+  for (int c = 0; c < nc; c++) {
+    cellgid_out[c] = mesh.GID(c, Jali::Entity_kind::CELL);
+    cellval_out[c] = 0.5 + cellgid_out[c];
+  }
+  CHECK(mesh.store_field("cellgid", Jali::Entity_kind::CELL,
+                         cellgid_out.data()));
+  CHECK(mesh.store_field("cellval", Jali::Entity_kind::CELL,
+                         cellval_out.data()));
+
+  // Node fields of doubles and vectors derived from the global IDs
+
+  std::vector<double> nodeval_out(nv), nodeval_in(nv, -1.0);
+  std::vector<std::array<double, 3>> nodevec_out(nv), nodevec_in(nv);
+  for (int n = 0; n < nv; n++) {
+    int gid = mesh.GID(n, Jali::Entity_kind::NODE);
+    nodeval_out[n] = 2.0*gid;
+    nodevec_out[n] = {{1.0*gid, 2.0*gid, 3.0*gid}};
+    nodevec_in[n] = {{-1.0, -1.0, -1.0}};
+  }
+  CHECK(mesh.store_field("nodeval", Jali::Entity_kind::NODE,
+                         nodeval_out.data()));
+  CHECK(mesh.store_field("nodevec", Jali::Entity_kind::NODE,
+                         nodevec_out.data()));
+
+  // Storing again overwrites the values in place
+
+  for (int n = 0; n < nv; n++)
+    nodevec_out[n][0] += 0.25;
+  CHECK(mesh.store_field("nodevec", Jali::Entity_kind::NODE,
+                         nodevec_out.data()));
+
+  CHECK(mesh.get_field("cellgid", Jali::Entity_kind::CELL,
+                       cellgid_in.data()));
+  CHECK(mesh.get_field("cellval", Jali::Entity_kind::CELL,
+                       cellval_in.data()));
+  for (int c = 0; c < nc; c++) {
+    int gid = mesh.GID(c, Jali::Entity_kind::CELL);
+    CHECK_EQUAL(gid, cellgid_in[c]);
+    CHECK_EQUAL(0.5 + gid, cellval_in[c]);
+  }
+
+  CHECK(mesh.get_field("nodeval", Jali::Entity_kind::NODE,
+                       nodeval_in.data()));
+  CHECK(mesh.get_field("nodevec", Jali::Entity_kind::NODE,
+                       nodevec_in.data()));
+  for (int n = 0; n < nv; n++) {
+    int gid = mesh.GID(n, Jali::Entity_kind::NODE);
+    CHECK_EQUAL(2.0*gid, nodeval_in[n]);
+    CHECK_EQUAL(gid + 0.25, nodevec_in[n][0]);
+    CHECK_EQUAL(2.0*gid, nodevec_in[n][1]);
+    CHECK_EQUAL(3.0*gid, nodevec_in[n][2]);
+  }
+
+  // Fields are found only on the kind of entity and with the type
+  // they were stored with
+
+  CHECK(!mesh.get_field("cellgid", Jali::Entity_kind::NODE,
+                        nodeval_in.data()));
+  CHECK(!mesh.get_field("cellval", Jali::Entity_kind::CELL,
+                        cellgid_in.data()));
+}
@@ -48,6 +48,7 @@
 #include <UnitTest++.h>
 
 #include <iostream>
+#include <memory>
 
 #include "../Mesh_MSTK.hh"
 
@@ -76,3 +77,31 @@ TEST(MSTK_HEX_3x3x3_4P) {
   CHECK(mesh);
 }
 
+
+
+TEST(MSTK_HEX_3x3x3_4P_PARTITIONERS) {
+
+  auto method = &Jali::Mesh_MSTK::mstk_partition_method;
+
+  // The native RCB partitioner is handed to MSTK as Zoltan's RCB
+
+  CHECK_EQUAL(method(Jali::Partitioner_type::ZOLTAN_RCB),
+              method(Jali::Partitioner_type::RCB));
+  CHECK(method(Jali::Partitioner_type::METIS) !=
+        method(Jali::Partitioner_type::RCB));
+
+  // Partitioners MSTK does not know cannot be used to distribute a
+  // mesh read from a file (all ranks throw before reading anything)
+
+  CHECK_THROW(method(Jali::Partitioner_type::INDEX), Errors::Message);
+  CHECK_THROW(method(Jali::Partitioner_type::BLOCK), Errors::Message);
+  CHECK_THROW(method(Jali::Partitioner_type::SFC_HILBERT), Errors::Message);
+
+  Jali::Partitioner_type sfc = Jali::Partitioner_type::SFC_MORTON;
+  std::unique_ptr<Jali::Mesh_MSTK> mesh;
+  CHECK_THROW(mesh.reset(new Jali::Mesh_MSTK("test/hex_3x3x3_sets.exo",
+                                             MPI_COMM_WORLD, NULL, true,
+                                             false, false, false, false, 0,
+                                             0, 1, false, sfc)),
+              Errors::Message);
+}
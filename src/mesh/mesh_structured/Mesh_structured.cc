@@ -0,0 +1,805 @@
+/*
+ Copyright (c) 2019, Triad National Security, LLC
+ All rights reserved.
+
+ Copyright 2019. Triad National Security, LLC. This software was
+ produced under U.S. Government contract 89233218CNA000001 for Los
+ Alamos National Laboratory (LANL), which is operated by Triad
+ National Security, LLC for the U.S. Department of Energy. 
+ All rights in the program are reserved by Triad National Security,
+ LLC, and the U.S. Department of Energy/National Nuclear Security
+ Administration. The Government is granted for itself and others acting
+ on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+ in this material to reproduce, prepare derivative works, distribute
+ copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+
+ 
+ This is open source software distributed under the 3-clause BSD license.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of Triad National Security, LLC, Los Alamos
+    National Laboratory, LANL, the U.S. Government, nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ 
+ THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+ BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <algorithm>
+#include <limits>
+
+#include "Mesh_structured.hh"
+#include "LabeledSetRegion.hh"
+
+#include "errors.hh"
+
+namespace Jali {
+
+//--------------------------------------
+// Constructors
+//--------------------------------------
+
+Mesh_structured::Mesh_structured(const double x0, const double y0,
+                                 const double z0,
+                                 const double x1, const double y1,
+                                 const double z1,
+                                 const int nx, const int ny, const int nz,
+                                 const MPI_Comm& mycomm,
+                                 const JaliGeometry::GeometricModelPtr& gm,
+                                 const bool request_faces,
+                                 const bool request_edges,
+                                 const bool request_sides,
+                                 const bool request_wedges,
+                                 const bool request_corners,
+                                 const int num_tiles,
+                                 const int num_ghost_layers_tile,
+                                 const int num_ghost_layers_distmesh,
+                                 const bool request_boundary_ghosts,
+                                 const Partitioner_type partitioner) :
+    Mesh(request_faces, request_edges, request_sides, request_wedges,
+         request_corners, num_tiles, num_ghost_layers_tile,
+         num_ghost_layers_distmesh, request_boundary_ghosts,
+         partitioner, JaliGeometry::Geom_type::CARTESIAN, mycomm),
+    dim_(3) {
+  axes_[0] = regular_axis(x0, x1, nx);
+  axes_[1] = regular_axis(y0, y1, ny);
+  axes_[2] = regular_axis(z0, z1, nz);
+  init_(gm);
+}
+
+
+Mesh_structured::Mesh_structured(const double x0, const double y0,
+                                 const double x1, const double y1,
+                                 const int nx, const int ny,
+                                 const MPI_Comm& mycomm,
+                                 const JaliGeometry::GeometricModelPtr& gm,
+                                 const bool request_faces,
+                                 const bool request_edges,
+                                 const bool request_sides,
+                                 const bool request_wedges,
+                                 const bool request_corners,
+                                 const int num_tiles,
+                                 const int num_ghost_layers_tile,
+                                 const int num_ghost_layers_distmesh,
+                                 const bool request_boundary_ghosts,
+                                 const Partitioner_type partitioner,
+                                 const JaliGeometry::Geom_type geom_type) :
+    Mesh(request_faces, request_edges, request_sides, request_wedges,
+         request_corners, num_tiles, num_ghost_layers_tile,
+         num_ghost_layers_distmesh, request_boundary_ghosts,
+         partitioner, geom_type, mycomm),
+    dim_(2) {
+  axes_[0] = regular_axis(x0, x1, nx);
+  axes_[1] = regular_axis(y0, y1, ny);
+  init_(gm);
+}
+
+
+Mesh_structured::Mesh_structured(const std::vector<double>& x,
+                                 const MPI_Comm& mycomm,
+                                 const JaliGeometry::GeometricModelPtr& gm,
+                                 const bool request_faces,
+                                 const bool request_edges,
+                                 const bool request_sides,
+                                 const bool request_wedges,
+                                 const bool request_corners,
+                                 const int num_tiles,
+                                 const int num_ghost_layers_tile,
+                                 const int num_ghost_layers_distmesh,
+                                 const bool request_boundary_ghosts,
+                                 const Partitioner_type partitioner,
+                                 const JaliGeometry::Geom_type geom_type) :
+    Mesh(request_faces, request_edges, request_sides, request_wedges,
+         request_corners, num_tiles, num_ghost_layers_tile,
+         num_ghost_layers_distmesh, request_boundary_ghosts,
+         partitioner, geom_type, mycomm),
+    dim_(1) {
+  axes_[0] = x;
+  init_(gm);
+}
+
+
+// Set up the families of entities of the block of this rank
+
+void Mesh_structured::init_(const JaliGeometry::GeometricModelPtr& gm) {
+  if (boundary_ghosts_requested_) {
+    Errors::Message mesg("Mesh_structured cannot generate boundary ghosts");
+    Exceptions::Jali_throw(mesg);
+  }
+  if (dim_ == 1 && edges_requested) {
+    Errors::Message mesg("Mesh_structured has no edges in 1D");
+    Exceptions::Jali_throw(mesg);
+  }
+
+  set_space_dimension(dim_);
+  set_manifold_dimension(dim_);
+  set_mesh_type(Mesh_type::RECTANGULAR);
+  if (gm != (JaliGeometry::GeometricModelPtr) NULL)
+    Mesh::set_geometric_model(gm);
+
+  int nprocs, rank;
+  MPI_Comm_size(get_comm(), &nprocs);
+  MPI_Comm_rank(get_comm(), &rank);
+
+  int ncells[3] = {1, 1, 1};
+  for (int d = 0; d < dim_; d++)
+    ncells[d] = static_cast<int>(axes_[d].size()) - 1;
+
+  int nblocks[3];
+  if (!block_grid(dim_, ncells, nprocs, nblocks)) {
+    Errors::Message mesg("Cannot divide regular mesh into " +
+                         std::to_string(nprocs) + " blocks");
+    Exceptions::Jali_throw(mesg);
+  }
+  int myblock[3] = {rank % nblocks[0], (rank/nblocks[0]) % nblocks[1],
+                    rank/(nblocks[0]*nblocks[1])};
+
+  // Cells of this block and of the block with its ghost layers
+
+  int nghost = num_ghost_layers_distmesh_;
+  int own_lo[3], own_hi[3], cell_lo[3], cell_hi[3];
+  for (int d = 0; d < 3; d++) {
+    own_lo[d] = block_start(myblock[d], nblocks[d], ncells[d]);
+    own_hi[d] = block_start(myblock[d]+1, nblocks[d], ncells[d]);
+    cell_lo[d] = (d < dim_) ? std::max(0, own_lo[d] - nghost) : 0;
+    cell_hi[d] = (d < dim_) ? std::min(ncells[d], own_hi[d] + nghost) : 1;
+  }
+
+  // An entity indexed by node along a direction is owned by the block
+  // holding the cell with the same index, or the last cell
+
+  auto family = [&](int const *nodal) {
+    Family fam;
+    for (int d = 0; d < 3; d++) {
+      fam.nodal[d] = nodal[d];
+      fam.lo[d] = cell_lo[d];
+      fam.ext[d] = cell_hi[d] - cell_lo[d] + nodal[d];
+      fam.olo[d] = own_lo[d];
+      fam.oext[d] = own_hi[d] - own_lo[d] +
+          ((nodal[d] && own_hi[d] == ncells[d]) ? 1 : 0);
+      fam.gext[d] = ncells[d] + nodal[d];
+    }
+    return fam;
+  };
+
+  int nodal[3] = {0, 0, 0};
+  families_[CELL].push_back(family(nodal));
+  for (int a = 0; a < dim_; a++) {
+    nodal[a] = 1;
+    families_[FACE].push_back(family(nodal));
+    nodal[a] = 0;
+  }
+  for (int d = 0; d < dim_; d++)
+    nodal[d] = 1;
+  families_[NODE].push_back(family(nodal));
+  if (dim_ == 3) {
+    for (int a = 0; a < 3; a++) {
+      for (int d = 0; d < 3; d++)
+        nodal[d] = (d != a);
+      families_[EDGE].push_back(family(nodal));
+    }
+  } else if (dim_ == 2) {
+    families_[EDGE] = families_[FACE];  // edges are the faces in 2D
+  }
+
+  // Entity lists in the base class so that iterators work
+
+  int nn = number_(&(families_[NODE]), "node");
+  int nf = number_(&(families_[FACE]), "face");
+  int ne = number_(&(families_[EDGE]), "edge");
+  int nc = number_(&(families_[CELL]), "cell");
+
+  auto set_lists = [](std::vector<Family> const& fams, int n,
+                      std::vector<int> *owned, std::vector<int> *ghost,
+                      std::vector<int> *all) {
+    int nowned = 0;
+    for (auto const& fam : fams)
+      nowned += fam.num_owned();
+    all->resize(n);
+    for (int i = 0; i < n; i++)
+      (*all)[i] = i;
+    owned->assign(all->begin(), all->begin() + nowned);
+    ghost->assign(all->begin() + nowned, all->end());
+  };
+  set_lists(families_[NODE], nn, &nodeids_owned_, &nodeids_ghost_,
+            &nodeids_all_);
+  if (faces_requested)
+    set_lists(families_[FACE], nf, &faceids_owned_, &faceids_ghost_,
+              &faceids_all_);
+  if (edges_requested)
+    set_lists(families_[EDGE], ne, &edgeids_owned_, &edgeids_ghost_,
+              &edgeids_all_);
+  set_lists(families_[CELL], nc, &cellids_owned_, &cellids_ghost_,
+            &cellids_all_);
+
+  cache_extra_variables();
+
+  if (Mesh::num_tiles_ini_)
+    Mesh::build_tiles();
+}
+
+
+// Number the entities of the families of one kind - owned entities
+// of all the families first - and return the number of entities
+
+int Mesh_structured::number_(std::vector<Family> *families,
+                             std::string const& kind) {
+  GlobalIndex gid0 = 0;
+  int nowned = 0;
+  for (auto & fam : *families) {
+    fam.gid0 = gid0;
+    gid0 += fam.gext[0]*fam.gext[1]*fam.gext[2];
+    fam.owned0 = nowned;
+    nowned += fam.num_owned();
+  }
+  if (gid0 > std::numeric_limits<Entity_ID>::max()) {
+    Errors::Message mesg("Regular mesh has too many " + kind +
+                         "s for the range of global IDs");
+    Exceptions::Jali_throw(mesg);
+  }
+
+  int n = nowned;
+  for (auto & fam : *families) {
+    fam.ghost0 = n;
+    n += fam.num_ghost();
+  }
+  return n;
+}
+
+
+Entity_ID Mesh_structured::Family::lid(int i, int j, int k) const {
+  int l[3] = {i - lo[0], j - lo[1], k - lo[2]};
+  int o[3] = {i - olo[0], j - olo[1], k - olo[2]};
+  bool owned = true;
+  for (int d = 0; d < 3; d++) {
+    if (l[d] < 0 || l[d] >= ext[d]) return -1;
+    owned = owned && (o[d] >= 0 && o[d] < oext[d]);
+  }
+  if (owned)
+    return owned0 + (o[2]*oext[1] + o[1])*oext[0] + o[0];
+
+  // Position in the box less the number of owned entities before it
+
+  int pos = (l[2]*ext[1] + l[1])*ext[0] + l[0];
+  int before = std::min(std::max(o[2], 0), oext[2])*oext[1]*oext[0];
+  if (o[2] >= 0 && o[2] < oext[2]) {
+    before += std::min(std::max(o[1], 0), oext[1])*oext[0];
+    if (o[1] >= 0 && o[1] < oext[1])
+      before += std::min(std::max(o[0], 0), oext[0]);
+  }
+  return ghost0 + pos - before;
+}
+
+
+void Mesh_structured::Family::index(Entity_ID id, int *ijk) const {
+  if (id < ghost0) {
+    int r = id - owned0;
+    ijk[0] = olo[0] + r % oext[0];
+    ijk[1] = olo[1] + (r/oext[0]) % oext[1];
+    ijk[2] = olo[2] + r/(oext[0]*oext[1]);
+    return;
+  }
+
+  // The ghost entities fill the planes below and above the owned box
+  // and, in between, the rows in front of and behind the owned box
+  // and the ends of the rows through it
+
+  int a[3] = {olo[0]-lo[0], olo[1]-lo[1], olo[2]-lo[2]};
+  int row = ext[0], plane = ext[0]*ext[1];
+  int holedrow = row - oext[0], holedplane = plane - oext[0]*oext[1];
+  int g = id - ghost0;
+  int l[3];
+
+  auto in_plane = [&](int p) {  // position p in a plane with no hole
+    l[1] = p/row;
+    l[0] = p % row;
+  };
+
+  if (g < a[2]*plane) {
+    l[2] = g/plane;
+    in_plane(g % plane);
+  } else if ((g -= a[2]*plane) < oext[2]*holedplane) {
+    l[2] = a[2] + g/holedplane;
+    g %= holedplane;
+    if (g < a[1]*row) {
+      in_plane(g);
+    } else if ((g -= a[1]*row) < oext[1]*holedrow) {
+      l[1] = a[1] + g/holedrow;
+      l[0] = g % holedrow;
+      if (l[0] >= a[0]) l[0] += oext[0];
+    } else {
+      g -= oext[1]*holedrow;
+      in_plane(g);
+      l[1] += a[1] + oext[1];
+    }
+  } else {
+    g -= oext[2]*holedplane;
+    l[2] = a[2] + oext[2] + g/plane;
+    in_plane(g % plane);
+  }
+
+  for (int d = 0; d < 3; d++)
+    ijk[d] = lo[d] + l[d];
+}
+
+
+int Mesh_structured::locate_(Entity_kind kind, Entity_ID lid,
+                             int *ijk) const {
+  std::vector<Family> const& fams = families_[static_cast<int>(kind)];
+  for (int a = 0; a < fams.size(); a++) {
+    Family const& fam = fams[a];
+    if ((lid >= fam.owned0 && lid < fam.owned0 + fam.num_owned()) ||
+        (lid >= fam.ghost0 && lid < fam.ghost0 + fam.num_ghost())) {
+      fam.index(lid, ijk);
+      return a;
+    }
+  }
+  Errors::Message mesg("Mesh_structured: invalid " +
+                       Entity_kind_string(kind) + " " + std::to_string(lid));
+  Exceptions::Jali_throw(mesg);
+  return -1;
+}
+
+
+// The adjacencies are computed as quickly as they can be looked up,
+// so they are not cached
+
+void Mesh_structured::cache_extra_variables() {
+  cache_type_info();
+  cache_interior_boundary_info();
+
+  if (sides_requested)
+    cache_side_info();
+  if (wedges_requested) {  // keep this order
+    if (!side_info_cached) cache_side_info();
+    cache_wedge_info();
+  }
+  if (corners_requested) {  // Keep this order
+    if (!side_info_cached) cache_side_info();
+    if (!wedge_info_cached) cache_wedge_info();
+    cache_corner_info();
+  }
+
+  update_geometric_quantities();
+}
+
+
+Cell_type Mesh_structured::cell_get_type(const Entity_ID cellid) const {
+  return (dim_ == 3) ? Cell_type::HEX :
+      ((dim_ == 2) ? Cell_type::QUAD : Cell_type::CELLTYPE_UNKNOWN);
+}
+
+
+Entity_ID Mesh_structured::GID(const Entity_ID lid,
+                               const Entity_kind kind) const {
+  int ikind = static_cast<int>(kind);
+  if (ikind < 0 || ikind > CELL || families_[ikind].empty()) {
+    Errors::Message mesg("Global IDs of " + Entity_kind_string(kind) +
+                         " not available in structured mesh");
+    Exceptions::Jali_throw(mesg);
+  }
+  int n[3];
+  Family const& fam = families_[ikind][locate_(kind, lid, n)];
+  return fam.gid0 + (n[2]*fam.gext[1] + n[1])*fam.gext[0] + n[0];
+}
+
+
+// Nodes of cells in the standard (Exodus II) order
+
+void Mesh_structured::cell_get_nodes(const Entity_ID cellid,
+                                     Entity_ID_List *nodeids) const {
+  int n[3];
+  locate_(Entity_kind::CELL, cellid, n);
+  int i = n[0], j = n[1], k = n[2];
+  nodeids->resize(1 << dim_);
+  Entity_ID *cn = nodeids->data();
+  if (dim_ == 1) {
+    cn[0] = node_(i, 0, 0);
+    cn[1] = node_(i+1, 0, 0);
+    return;
+  }
+  for (int l = 0; l < dim_-1; l++) {  // bottom and top layers
+    cn[4*l]   = node_(i, j, k+l);
+    cn[4*l+1] = node_(i+1, j, k+l);
+    cn[4*l+2] = node_(i+1, j+1, k+l);
+    cn[4*l+3] = node_(i, j+1, k+l);
+  }
+}
+
+
+// Nodes of faces (counterclockwise about the face normal in 3D)
+
+void Mesh_structured::face_get_nodes(const Entity_ID faceid,
+                                     Entity_ID_List *nodeids) const {
+  int n[3];
+  int a = locate_(Entity_kind::FACE, faceid, n);
+  int i = n[0], j = n[1], k = n[2];
+  nodeids->resize((dim_ == 3) ? 4 : dim_);
+  Entity_ID *fn = nodeids->data();
+  if (dim_ == 1) {
+    fn[0] = node_(i, 0, 0);
+  } else if (dim_ == 2) {
+    fn[0] = node_(i, j, 0);
+    fn[1] = (a == 0) ? node_(i, j+1, 0) : node_(i+1, j, 0);
+  } else if (a == 0) {
+    fn[0] = node_(i, j, k);      fn[1] = node_(i, j+1, k);
+    fn[2] = node_(i, j+1, k+1);  fn[3] = node_(i, j, k+1);
+  } else if (a == 1) {
+    fn[0] = node_(i, j, k);      fn[1] = node_(i+1, j, k);
+    fn[2] = node_(i+1, j, k+1);  fn[3] = node_(i, j, k+1);
+  } else {
+    fn[0] = node_(i, j, k);      fn[1] = node_(i+1, j, k);
+    fn[2] = node_(i+1, j+1, k);  fn[3] = node_(i, j+1, k);
+  }
+}
+
+
+// Entities of a family indexed by cell along a direction touch a
+// node from both sides, so the entities of a family around a node
+// are those in a box of up to 2x2x2 entities ending at the node
+
+void Mesh_structured::node_get_cells(const Entity_ID nodeid,
+                                     const Entity_type ptype,
+                                     Entity_ID_List *cellids) const {
+  int n[3];
+  locate_(Entity_kind::NODE, nodeid, n);
+  int lo[3];
+  for (int d = 0; d < 3; d++)
+    lo[d] = (d < dim_) ? n[d]-1 : n[d];
+
+  cellids->clear();
+  for (int k = lo[2]; k <= n[2]; k++)
+    for (int j = lo[1]; j <= n[1]; j++)
+      for (int i = lo[0]; i <= n[0]; i++) {
+        Entity_ID c = cell_(i, j, k);
+        if (c < 0) continue;
+        if (ptype == Entity_type::ALL ||
+            entity_get_type(Entity_kind::CELL, c) == ptype)
+          cellids->push_back(c);
+      }
+}
+
+
+void Mesh_structured::node_get_faces(const Entity_ID nodeid,
+                                     const Entity_type ptype,
+                                     Entity_ID_List *faceids) const {
+  int n[3];
+  locate_(Entity_kind::NODE, nodeid, n);
+
+  faceids->clear();
+  for (int a = 0; a < dim_; a++) {
+    int lo[3];
+    for (int d = 0; d < 3; d++)
+      lo[d] = (d < dim_ && d != a) ? n[d]-1 : n[d];
+    for (int k = lo[2]; k <= n[2]; k++)
+      for (int j = lo[1]; j <= n[1]; j++)
+        for (int i = lo[0]; i <= n[0]; i++) {
+          Entity_ID f = face_(a, i, j, k);
+          if (f < 0) continue;
+          if (ptype == Entity_type::ALL ||
+              entity_get_type(Entity_kind::FACE, f) == ptype)
+            faceids->push_back(f);
+        }
+  }
+}
+
+
+void Mesh_structured::node_get_cell_faces(const Entity_ID nodeid,
+                                          const Entity_ID cellid,
+                                          const Entity_type ptype,
+                                          Entity_ID_List *faceids) const {
+  Entity_ID_List cfaces, fnodes;
+  cell_get_faces_and_dirs_internal(cellid, &cfaces, NULL);
+
+  faceids->clear();
+  for (auto const& f : cfaces) {
+    if (ptype != Entity_type::ALL &&
+        entity_get_type(Entity_kind::FACE, f) != ptype)
+      continue;
+    face_get_nodes(f, &fnodes);
+    if (std::find(fnodes.begin(), fnodes.end(), nodeid) != fnodes.end())
+      faceids->push_back(f);
+  }
+}
+
+
+// Cells across the faces of a cell in the standard face order
+
+void Mesh_structured::cell_get_face_adj_cells(const Entity_ID cellid,
+                                              const Entity_type ptype,
+                                              Entity_ID_List *fadj_cellids)
+    const {
+  int n[3];
+  locate_(Entity_kind::CELL, cellid, n);
+  int i = n[0], j = n[1], k = n[2];
+
+  Entity_ID nbrs[6] = {cell_(i, j-1, k), cell_(i+1, j, k),
+                       cell_(i, j+1, k), cell_(i-1, j, k),
+                       cell_(i, j, k-1), cell_(i, j, k+1)};
+  if (dim_ == 1) {
+    nbrs[0] = cell_(i-1, 0, 0);
+    nbrs[1] = cell_(i+1, 0, 0);
+  }
+
+  fadj_cellids->clear();
+  for (int f = 0; f < 2*dim_; f++) {
+    Entity_ID c = nbrs[f];
+    if (c < 0) continue;
+    if (ptype == Entity_type::ALL ||
+        entity_get_type(Entity_kind::CELL, c) == ptype)
+      fadj_cellids->push_back(c);
+  }
+}
+
+
+void Mesh_structured::cell_get_node_adj_cells(const Entity_ID cellid,
+                                              const Entity_type ptype,
+                                              Entity_ID_List *nadj_cellids)
+    const {
+  Entity_ID_List cnodes, ncells;
+  cell_get_nodes(cellid, &cnodes);
+
+  nadj_cellids->clear();
+  for (auto const& n : cnodes) {
+    node_get_cells(n, ptype, &ncells);
+    for (auto const& c : ncells)
+      if (c != cellid &&
+          std::find(nadj_cellids->begin(), nadj_cellids->end(), c) ==
+          nadj_cellids->end())
+        nadj_cellids->push_back(c);
+  }
+}
+
+
+void Mesh_structured::node_get_coordinates(const Entity_ID nodeid,
+                                           JaliGeometry::Point *ncoord)
+    const {
+  if (!coords_.empty()) {
+    ncoord->set(dim_, &(coords_[nodeid*dim_]));
+    return;
+  }
+  int n[3];
+  locate_(Entity_kind::NODE, nodeid, n);
+  double xyz[3];
+  for (int d = 0; d < dim_; d++)
+    xyz[d] = axes_[d][n[d]];
+  ncoord->set(dim_, xyz);
+}
+
+
+void Mesh_structured::face_get_coordinates(const Entity_ID faceid,
+                                           std::vector<JaliGeometry::Point>
+                                           *fcoords) const {
+  Entity_ID_List fnodes;
+  face_get_nodes(faceid, &fnodes);
+  fcoords->resize(fnodes.size());
+  for (int i = 0; i < fnodes.size(); i++)
+    node_get_coordinates(fnodes[i], &((*fcoords)[i]));
+}
+
+
+void Mesh_structured::cell_get_coordinates(const Entity_ID cellid,
+                                           std::vector<JaliGeometry::Point>
+                                           *ccoords) const {
+  Entity_ID_List cnodes;
+  cell_get_nodes(cellid, &cnodes);
+  ccoords->resize(cnodes.size());
+  for (int i = 0; i < cnodes.size(); i++)
+    node_get_coordinates(cnodes[i], &((*ccoords)[i]));
+}
+
+
+void Mesh_structured::node_set_coordinates(const Entity_ID nodeid,
+                                           const JaliGeometry::Point coords) {
+  double xyz[3];
+  for (int d = 0; d < dim_; d++)
+    xyz[d] = coords[d];
+  node_set_coordinates(nodeid, xyz);
+}
+
+
+void Mesh_structured::node_set_coordinates(const Entity_ID nodeid,
+                                           const double *coords) {
+  if (coords_.empty()) {
+    int nnodes = num_nodes<Entity_type::ALL>();
+    std::vector<double> xyz(nnodes*dim_);
+    JaliGeometry::Point p;
+    for (int n = 0; n < nnodes; n++) {
+      node_get_coordinates(n, &p);
+      for (int d = 0; d < dim_; d++)
+        xyz[n*dim_+d] = p[d];
+    }
+    coords_.swap(xyz);
+  }
+  std::copy(coords, coords + dim_, &(coords_[nodeid*dim_]));
+}
+
+
+void Mesh_structured::get_labeled_set_entities(
+    const JaliGeometry::LabeledSetRegionPtr r, const Entity_kind kind,
+    Entity_ID_List *owned_entities, Entity_ID_List *ghost_entities) const {
+  owned_entities->clear();
+  ghost_entities->clear();
+}
+
+
+// Faces of cells in the standard order with the directions in which
+// the cells use them
+
+void Mesh_structured::cell_get_faces_and_dirs_internal(
+    const Entity_ID cellid, Entity_ID_List *faceids,
+    std::vector<dir_t> *face_dirs, const bool ordered) const {
+  int n[3];
+  locate_(Entity_kind::CELL, cellid, n);
+  int i = n[0], j = n[1], k = n[2];
+
+  faceids->resize(2*dim_);
+  Entity_ID *cf = faceids->data();
+  static const dir_t dirs1[2] = {-1, 1};
+  static const dir_t dirs[6] = {1, 1, -1, -1, -1, 1};
+  if (dim_ == 1) {
+    cf[0] = face_(0, i, 0, 0);
+    cf[1] = face_(0, i+1, 0, 0);
+  } else {
+    cf[0] = face_(1, i, j, k);
+    cf[1] = face_(0, i+1, j, k);
+    cf[2] = face_(1, i, j+1, k);
+    cf[3] = face_(0, i, j, k);
+    if (dim_ == 3) {
+      cf[4] = face_(2, i, j, k);
+      cf[5] = face_(2, i, j, k+1);
+    }
+  }
+  if (face_dirs)
+    face_dirs->assign((dim_ == 1) ? dirs1 : dirs,
+                      ((dim_ == 1) ? dirs1 : dirs) + 2*dim_);
+}
+
+
+void Mesh_structured::face_get_cells_internal(const Entity_ID faceid,
+                                              const Entity_type ptype,
+                                              Entity_ID_List *cellids) const {
+  int n[3];
+  int a = locate_(Entity_kind::FACE, faceid, n);
+  Entity_ID c1 = cell_(n[0], n[1], n[2]);
+  n[a]--;
+  Entity_ID c0 = cell_(n[0], n[1], n[2]);
+
+  cellids->clear();
+  for (auto const& c : {c0, c1}) {
+    if (c < 0) continue;
+    if (ptype == Entity_type::ALL ||
+        entity_get_type(Entity_kind::CELL, c) == ptype)
+      cellids->push_back(c);
+  }
+}
+
+
+// Edges of faces in the same order as the face nodes (the face
+// itself in 2D)
+
+void Mesh_structured::face_get_edges_and_dirs_internal(
+    const Entity_ID faceid, Entity_ID_List *edgeids,
+    std::vector<dir_t> *edge_dirs, const bool ordered) const {
+  if (dim_ == 2) {
+    edgeids->assign(1, faceid);
+    if (edge_dirs) edge_dirs->assign(1, 1);
+    return;
+  }
+
+  int n[3];
+  int a = locate_(Entity_kind::FACE, faceid, n);
+  int i = n[0], j = n[1], k = n[2];
+  edgeids->resize(4);
+  Entity_ID *fe = edgeids->data();
+  if (a == 0) {
+    fe[0] = edge_(1, i, j, k);    fe[1] = edge_(2, i, j+1, k);
+    fe[2] = edge_(1, i, j, k+1);  fe[3] = edge_(2, i, j, k);
+  } else if (a == 1) {
+    fe[0] = edge_(0, i, j, k);    fe[1] = edge_(2, i+1, j, k);
+    fe[2] = edge_(0, i, j, k+1);  fe[3] = edge_(2, i, j, k);
+  } else {
+    fe[0] = edge_(0, i, j, k);    fe[1] = edge_(1, i+1, j, k);
+    fe[2] = edge_(0, i, j+1, k);  fe[3] = edge_(1, i, j, k);
+  }
+  if (edge_dirs) {
+    static const dir_t dirs[4] = {1, 1, -1, -1};
+    edge_dirs->assign(dirs, dirs+4);
+  }
+}
+
+
+// Edges of cells - those along x, then y, then z in 3D and the faces
+// in 2D
+
+void Mesh_structured::cell_get_edges_internal(const Entity_ID cellid,
+                                              Entity_ID_List *edgeids) const {
+  if (dim_ == 2) {
+    cell_get_faces_and_dirs_internal(cellid, edgeids, NULL);
+    return;
+  }
+
+  int n[3];
+  locate_(Entity_kind::CELL, cellid, n);
+  int i = n[0], j = n[1], k = n[2];
+  edgeids->resize(12);
+  Entity_ID *ce = edgeids->data();
+  for (int l = 0; l < 4; l++) {
+    int p = l & 1, q = l >> 1;
+    ce[l]   = edge_(0, i, j+p, k+q);
+    ce[4+l] = edge_(1, i+p, j, k+q);
+    ce[8+l] = edge_(2, i+p, j+q, k);
+  }
+}
+
+
+void Mesh_structured::cell_2D_get_edges_and_dirs_internal(
+    const Entity_ID cellid, Entity_ID_List *edgeids,
+    std::vector<dir_t> *edge_dirs) const {
+  if (dim_ != 2) {
+    Errors::Message mesg("cell_2D_get_edges_and_dirs called on a " +
+                         std::to_string(dim_) + "D mesh");
+    Exceptions::Jali_throw(mesg);
+  }
+  cell_get_faces_and_dirs_internal(cellid, edgeids, edge_dirs);
+}
+
+
+void Mesh_structured::edge_get_nodes_internal(const Entity_ID edgeid,
+                                              Entity_ID *enode0,
+                                              Entity_ID *enode1) const {
+  int n[3];
+  int a = locate_(Entity_kind::EDGE, edgeid, n);
+  if (dim_ == 2) {  // the edges are the faces
+    *enode0 = node_(n[0], n[1], 0);
+    n[1-a]++;
+    *enode1 = node_(n[0], n[1], 0);
+    return;
+  }
+  *enode0 = node_(n[0], n[1], n[2]);
+  n[a]++;
+  *enode1 = node_(n[0], n[1], n[2]);
+}
+
+}  // close namespace Jali
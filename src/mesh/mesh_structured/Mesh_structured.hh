@@ -0,0 +1,328 @@
+/*
+ Copyright (c) 2019, Triad National Security, LLC
+ All rights reserved.
+
+ Copyright 2019. Triad National Security, LLC. This software was
+ produced under U.S. Government contract 89233218CNA000001 for Los
+ Alamos National Laboratory (LANL), which is operated by Triad
+ National Security, LLC for the U.S. Department of Energy. 
+ All rights in the program are reserved by Triad National Security,
+ LLC, and the U.S. Department of Energy/National Nuclear Security
+ Administration. The Government is granted for itself and others acting
+ on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+ in this material to reproduce, prepare derivative works, distribute
+ copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+
+ 
+ This is open source software distributed under the 3-clause BSD license.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of Triad National Security, LLC, Los Alamos
+    National Laboratory, LANL, the U.S. Government, nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ 
+ THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+ BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef _MESH_STRUCTURED_H_
+#define _MESH_STRUCTURED_H_
+
+#include <memory>
+#include <vector>
+#include <string>
+#include "mpi.h"
+
+#include "Mesh.hh"
+#include "MeshBlocks.hh"
+#include "Region.hh"
+
+#include "Geometry.hh"
+#include "GeometricModel.hh"
+#include "errors.hh"
+
+namespace Jali {
+
+// Regular mesh with implicit connectivity
+//
+// Mesh_structured stores no connectivity at all. Every entity is
+// identified by its family (cells, nodes, faces normal to each
+// direction or edges along each direction) and its global (i,j,k)
+// index within the family, and its local and global IDs, owner,
+// adjacent entities and node coordinates are all computed from that
+// index. The topology takes a few integers per family however large
+// the mesh is. The base class still keeps the entity lists, parallel
+// types and geometric quantities, but for this framework it does not
+// cache the cell-face, face-cell, cell-edge, face-edge and edge-node
+// adjacencies.
+//
+// In parallel the ranks hold blocks of cells (see MeshBlocks.hh) with
+// ghost layers around them, and the entities are numbered exactly as
+// in regular meshes generated by Mesh_flat - owned entities first,
+// then ghost entities, each family in (i,j,k) order.
+//
+// Node coordinates are computed from the node coordinates along each
+// axis until a node is moved; from then on the coordinates of all the
+// nodes are stored.
+
+class Mesh_structured : public virtual Mesh {
+ public:
+
+  // Hexahedral mesh of nx*ny*nz cells distributed over the ranks of
+  // the communicator in blocks (the partitioner is not used). Edges
+  // are numbered if edges, sides, wedges or corners are requested
+
+  Mesh_structured(const double x0, const double y0, const double z0,
+                  const double x1, const double y1, const double z1,
+                  const int nx, const int ny, const int nz,
+                  const MPI_Comm& communicator,
+                  const JaliGeometry::GeometricModelPtr& gm =
+                  (JaliGeometry::GeometricModelPtr) NULL,
+                  const bool request_faces = true,
+                  const bool request_edges = false,
+                  const bool request_sides = false,
+                  const bool request_wedges = false,
+                  const bool request_corners = false,
+                  const int num_tiles = 0,
+                  const int num_ghost_layers_tile = 0,
+                  const int num_ghost_layers_distmesh = 1,
+                  const bool request_boundary_ghosts = false,
+                  const Partitioner_type partitioner =
+                  Partitioner_type::BLOCK);
+
+  // Quadrilateral mesh of nx*ny cells distributed over the ranks of
+  // the communicator in blocks
+
+  Mesh_structured(const double x0, const double y0,
+                  const double x1, const double y1,
+                  const int nx, const int ny,
+                  const MPI_Comm& communicator,
+                  const JaliGeometry::GeometricModelPtr& gm =
+                  (JaliGeometry::GeometricModelPtr) NULL,
+                  const bool request_faces = true,
+                  const bool request_edges = false,
+                  const bool request_sides = false,
+                  const bool request_wedges = false,
+                  const bool request_corners = false,
+                  const int num_tiles = 0,
+                  const int num_ghost_layers_tile = 0,
+                  const int num_ghost_layers_distmesh = 1,
+                  const bool request_boundary_ghosts = false,
+                  const Partitioner_type partitioner =
+                  Partitioner_type::BLOCK,
+                  const JaliGeometry::Geom_type geom_type =
+                  JaliGeometry::Geom_type::CARTESIAN);
+
+  // 1D mesh with node coordinates x distributed over the ranks of the
+  // communicator in blocks (edges are not supported)
+
+  Mesh_structured(const std::vector<double>& x,
+                  const MPI_Comm& communicator,
+                  const JaliGeometry::GeometricModelPtr& gm =
+                  (JaliGeometry::GeometricModelPtr) NULL,
+                  const bool request_faces = true,
+                  const bool request_edges = false,
+                  const bool request_sides = false,
+                  const bool request_wedges = false,
+                  const bool request_corners = false,
+                  const int num_tiles = 0,
+                  const int num_ghost_layers_tile = 0,
+                  const int num_ghost_layers_distmesh = 1,
+                  const bool request_boundary_ghosts = false,
+                  const Partitioner_type partitioner =
+                  Partitioner_type::BLOCK,
+                  const JaliGeometry::Geom_type geom_type =
+                  JaliGeometry::Geom_type::CARTESIAN);
+
+  virtual ~Mesh_structured() {}
+
+
+  // Get cell type
+  Cell_type cell_get_type(const Entity_ID cellid) const;
+
+  // Global ID of any entity
+  Entity_ID GID(const Entity_ID lid, const Entity_kind kind) const;
+
+  // Downward Adjacencies
+  //---------------------
+
+  // Get nodes of cell (in standard order)
+  void cell_get_nodes(const Entity_ID cellid,
+                      Entity_ID_List *nodeids) const;
+
+  // Get nodes of face
+  void face_get_nodes(const Entity_ID faceid,
+                      Entity_ID_List *nodeids) const;
+
+  // Upward adjacencies
+  //-------------------
+
+  // Cells of type 'ptype' connected to a node
+  void node_get_cells(const Entity_ID nodeid,
+                      const Entity_type ptype,
+                      Entity_ID_List *cellids) const;
+
+  // Faces of type 'ptype' connected to a node
+  void node_get_faces(const Entity_ID nodeid,
+                      const Entity_type ptype,
+                      Entity_ID_List *faceids) const;
+
+  // Get faces of ptype of a particular cell that are connected to the
+  // given node
+  void node_get_cell_faces(const Entity_ID nodeid,
+                           const Entity_ID cellid,
+                           const Entity_type ptype,
+                           Entity_ID_List *faceids) const;
+
+  // Same level adjacencies
+  //-----------------------
+
+  // Face connected neighboring cells of given cell of a particular ptype
+  void cell_get_face_adj_cells(const Entity_ID cellid,
+                               const Entity_type ptype,
+                               Entity_ID_List *fadj_cellids) const;
+
+  // Node connected neighboring cells of given cell of a particular ptype
+  void cell_get_node_adj_cells(const Entity_ID cellid,
+                               const Entity_type ptype,
+                               Entity_ID_List *nadj_cellids) const;
+
+  // Mesh entity geometry
+  //---------------------
+
+  // Node coordinates
+  void node_get_coordinates(const Entity_ID nodeid,
+                            JaliGeometry::Point *ncoord) const;
+
+  // Face coordinates - conventions same as face_to_nodes call
+  void face_get_coordinates(const Entity_ID faceid,
+                            std::vector<JaliGeometry::Point> *fcoords) const;
+
+  // Coordinates of cells in standard order
+  void cell_get_coordinates(const Entity_ID cellid,
+                            std::vector<JaliGeometry::Point> *ccoords) const;
+
+  // Modify the coordinates of a node (the first call stores the
+  // coordinates of all the nodes)
+
+  void node_set_coordinates(const Entity_ID nodeid,
+                            const JaliGeometry::Point coords);
+
+  void node_set_coordinates(const Entity_ID nodeid, const double *coords);
+
+  // Cache the parallel types, derived entities and geometric
+  // quantities but not the adjacencies
+
+  void cache_extra_variables();
+
+ protected:
+
+  // There are no labeled sets
+
+  void get_labeled_set_entities(const JaliGeometry::LabeledSetRegionPtr r,
+                                const Entity_kind kind,
+                                Entity_ID_List *owned_entities,
+                                Entity_ID_List *ghost_entities) const;
+
+  void cell_get_faces_and_dirs_internal(const Entity_ID cellid,
+                                        Entity_ID_List *faceids,
+                                        std::vector<dir_t> *face_dirs,
+                                        const bool ordered = false) const;
+
+  void face_get_cells_internal(const Entity_ID faceid,
+                               const Entity_type ptype,
+                               Entity_ID_List *cellids) const;
+
+  void face_get_edges_and_dirs_internal(const Entity_ID faceid,
+                                        Entity_ID_List *edgeids,
+                                        std::vector<dir_t> *edge_dirs,
+                                        const bool ordered = true) const;
+
+  void cell_get_edges_internal(const Entity_ID cellid,
+                               Entity_ID_List *edgeids) const;
+
+  void cell_2D_get_edges_and_dirs_internal(const Entity_ID cellid,
+                                           Entity_ID_List *edgeids,
+                                           std::vector<dir_t> *edge_dirs)
+      const;
+
+  void edge_get_nodes_internal(const Entity_ID edgeid,
+                               Entity_ID *enode0, Entity_ID *enode1) const;
+
+ private:
+
+  // A family of entities and the numbering of those in the box of
+  // entities of this rank - the owned entities (which form a box
+  // within it) first, then the others
+
+  struct Family {
+    int nodal[3] = {0, 0, 0};  // indexed by node (1) or by cell (0)
+    int lo[3], ext[3];         // box of entities on this rank
+    int olo[3], oext[3];       // box of owned entities
+    GlobalIndex gext[3];       // global extents
+    GlobalIndex gid0 = 0;      // global ID of the first entity
+    Entity_ID owned0 = 0;      // local ID of the first owned entity
+    Entity_ID ghost0 = 0;      // local ID of the first ghost entity
+
+    int num_owned() const { return oext[0]*oext[1]*oext[2]; }
+    int num_ghost() const { return ext[0]*ext[1]*ext[2] - num_owned(); }
+
+    // Local ID of entity (i,j,k), -1 if it is not on this rank
+    Entity_ID lid(int i, int j, int k) const;
+
+    // Index (i,j,k) of an entity of this family
+    void index(Entity_ID lid, int *ijk) const;
+  };
+
+  void init_(const JaliGeometry::GeometricModelPtr& gm);
+  int number_(std::vector<Family> *families, std::string const& kind);
+
+  // Family and index of an entity
+  int locate_(Entity_kind kind, Entity_ID lid, int *ijk) const;
+
+  Entity_ID node_(int i, int j, int k) const {
+    return families_[NODE][0].lid(i, j, k);
+  }
+  Entity_ID face_(int a, int i, int j, int k) const {
+    return families_[FACE][a].lid(i, j, k);
+  }
+  Entity_ID edge_(int a, int i, int j, int k) const {
+    return families_[EDGE][a].lid(i, j, k);
+  }
+  Entity_ID cell_(int i, int j, int k) const {
+    return families_[CELL][0].lid(i, j, k);
+  }
+
+  enum {NODE, EDGE, FACE, CELL};  // same as Entity_kind
+
+  int dim_;
+  std::vector<double> axes_[3];  // node coordinates along each axis
+  std::vector<Family> families_[4];
+
+  std::vector<double> coords_;   // all node coordinates, once one moves
+};
+
+}  // close namespace Jali
+
+#endif /* _MESH_STRUCTURED_H_ */
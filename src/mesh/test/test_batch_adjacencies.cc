@@ -0,0 +1,184 @@
+/*
+ Copyright (c) 2019, Triad National Security, LLC
+ All rights reserved.
+
+ Copyright 2019. Triad National Security, LLC. This software was
+ produced under U.S. Government contract 89233218CNA000001 for Los
+ Alamos National Laboratory (LANL), which is operated by Triad
+ National Security, LLC for the U.S. Department of Energy. 
+ All rights in the program are reserved by Triad National Security,
+ LLC, and the U.S. Department of Energy/National Nuclear Security
+ Administration. The Government is granted for itself and others acting
+ on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+ in this material to reproduce, prepare derivative works, distribute
+ copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+
+ 
+ This is open source software distributed under the 3-clause BSD license.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of Triad National Security, LLC, Los Alamos
+    National Laboratory, LANL, the U.S. Government, nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ 
+ THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+ BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+// -------------------------------------------------------------
+/**
+ * @file   test_batch_adjacencies.cc
+ *
+ * @brief  Unit tests for the batch (compressed row storage)
+ *         adjacency queries
+ */
+// -------------------------------------------------------------
+// -------------------------------------------------------------
+
+#include <UnitTest++.h>
+
+#include <mpi.h>
+#include <iostream>
+#include <vector>
+
+#include "Mesh.hh"
+#include "MeshFactory.hh"
+
+// Check the batch queries against the per-entity queries
+
+void check_batch_adjacencies(Jali::Mesh const& mesh) {
+  std::vector<int> offsets;
+  Jali::Entity_ID_List ids, ids1;
+  std::vector<Jali::dir_t> dirs, dirs1;
+
+  Jali::Entity_ID_List const& cells = mesh.cells();
+  mesh.cells_get_nodes(cells, &offsets, &ids);
+  CHECK_EQUAL(cells.size()+1, offsets.size());
+  CHECK_EQUAL(ids.size(), offsets.back());
+  for (int i = 0; i < cells.size(); i++) {
+    mesh.cell_get_nodes(cells[i], &ids1);
+    CHECK_EQUAL(ids1.size(), offsets[i+1]-offsets[i]);
+    CHECK_ARRAY_EQUAL(&(ids1[0]), &(ids[offsets[i]]), ids1.size());
+  }
+
+  mesh.cells_get_faces_and_dirs(cells, &offsets, &ids, &dirs);
+  CHECK_EQUAL(cells.size()+1, offsets.size());
+  CHECK_EQUAL(ids.size(), dirs.size());
+  for (int i = 0; i < cells.size(); i++) {
+    mesh.cell_get_faces_and_dirs(cells[i], &ids1, &dirs1);
+    CHECK_EQUAL(ids1.size(), offsets[i+1]-offsets[i]);
+    CHECK_ARRAY_EQUAL(&(ids1[0]), &(ids[offsets[i]]), ids1.size());
+    CHECK_ARRAY_EQUAL(&(dirs1[0]), &(dirs[offsets[i]]), dirs1.size());
+  }
+
+  Jali::Entity_ID_List const& faces = mesh.faces();
+  mesh.faces_get_nodes(faces, &offsets, &ids);
+  CHECK_EQUAL(faces.size()+1, offsets.size());
+  for (int i = 0; i < faces.size(); i++) {
+    mesh.face_get_nodes(faces[i], &ids1);
+    CHECK_EQUAL(ids1.size(), offsets[i+1]-offsets[i]);
+    CHECK_ARRAY_EQUAL(&(ids1[0]), &(ids[offsets[i]]), ids1.size());
+  }
+
+  for (auto ptype : {Jali::Entity_type::ALL,
+          Jali::Entity_type::PARALLEL_OWNED}) {
+    mesh.faces_get_cells(faces, ptype, &offsets, &ids);
+    CHECK_EQUAL(faces.size()+1, offsets.size());
+    for (int i = 0; i < faces.size(); i++) {
+      mesh.face_get_cells(faces[i], ptype, &ids1);
+      CHECK_EQUAL(ids1.size(), offsets[i+1]-offsets[i]);
+      if (ids1.size())
+        CHECK_ARRAY_EQUAL(&(ids1[0]), &(ids[offsets[i]]), ids1.size());
+    }
+
+    Jali::Entity_ID_List const& nodes = mesh.nodes();
+    mesh.nodes_get_cells(nodes, ptype, &offsets, &ids);
+    CHECK_EQUAL(nodes.size()+1, offsets.size());
+    for (int i = 0; i < nodes.size(); i++) {
+      mesh.node_get_cells(nodes[i], ptype, &ids1);
+      CHECK_EQUAL(ids1.size(), offsets[i+1]-offsets[i]);
+      if (ids1.size())
+        CHECK_ARRAY_EQUAL(&(ids1[0]), &(ids[offsets[i]]), ids1.size());
+    }
+  }
+
+  // A subset of entities in arbitrary order
+
+  Jali::Entity_ID_List some_cells;
+  for (int i = cells.size()-1; i >= 0; i -= 2)
+    some_cells.push_back(cells[i]);
+  mesh.cells_get_nodes(some_cells, &offsets, &ids);
+  CHECK_EQUAL(some_cells.size()+1, offsets.size());
+  for (int i = 0; i < some_cells.size(); i++) {
+    mesh.cell_get_nodes(some_cells[i], &ids1);
+    CHECK_EQUAL(ids1.size(), offsets[i+1]-offsets[i]);
+    CHECK_ARRAY_EQUAL(&(ids1[0]), &(ids[offsets[i]]), ids1.size());
+  }
+
+  // An empty list gives just the leading offset
+
+  mesh.cells_get_nodes(Jali::Entity_ID_List(), &offsets, &ids);
+  CHECK_EQUAL(1, offsets.size());
+  CHECK_EQUAL(0, offsets[0]);
+  CHECK_EQUAL(0, ids.size());
+}
+
+
+TEST(BATCH_ADJACENCIES) {
+
+  int nproc;
+  MPI_Comm_size(MPI_COMM_WORLD, &nproc);
+
+  const Jali::MeshFramework_t frameworks[] = {Jali::MSTK, Jali::Simple};
+  const char *framework_names[] = {"MSTK", "Simple"};
+  const int numframeworks = sizeof(frameworks)/sizeof(Jali::MeshFramework_t);
+  for (int i = 0; i < numframeworks; i++) {
+    Jali::MeshFramework_t the_framework = frameworks[i];
+    if (!Jali::framework_available(the_framework)) continue;
+
+    int dim = 3;
+    bool parallel = (nproc > 1);
+    if (!Jali::framework_generates(the_framework, parallel, dim))
+      continue;
+
+    std::cerr << "Testing batch adjacencies with " <<
+        framework_names[i] << std::endl;
+
+    Jali::MeshFactory factory(MPI_COMM_WORLD);
+    factory.framework(the_framework);
+    factory.included_entities(Jali::Entity_kind::FACE);
+
+    std::shared_ptr<Jali::Mesh> mesh =
+        factory(0.0, 0.0, 0.0, 1.0, 1.0, 1.0, 3, 2, 2);
+    check_batch_adjacencies(*mesh);
+
+    // Frozen (flat) meshes answer the batch queries from their arrays
+
+    factory.freeze(true);
+    std::shared_ptr<Jali::Mesh> frozen =
+        factory(0.0, 0.0, 0.0, 1.0, 1.0, 1.0, 3, 2, 2);
+    check_batch_adjacencies(*frozen);
+  }
+}
+
@@ -0,0 +1,214 @@
+/*
+ Copyright (c) 2019, Triad National Security, LLC
+ All rights reserved.
+
+ Copyright 2019. Triad National Security, LLC. This software was
+ produced under U.S. Government contract 89233218CNA000001 for Los
+ Alamos National Laboratory (LANL), which is operated by Triad
+ National Security, LLC for the U.S. Department of Energy. 
+ All rights in the program are reserved by Triad National Security,
+ LLC, and the U.S. Department of Energy/National Nuclear Security
+ Administration. The Government is granted for itself and others acting
+ on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+ in this material to reproduce, prepare derivative works, distribute
+ copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+
+ 
+ This is open source software distributed under the 3-clause BSD license.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of Triad National Security, LLC, Los Alamos
+    National Laboratory, LANL, the U.S. Government, nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ 
+ THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+ BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+// -------------------------------------------------------------
+/**
+ * @file   test_derived_cache.cc
+ *
+ * @brief  Unit tests for persisting derived entities (sides, wedges,
+ *         corners) and geometric quantities in a sidecar file
+ */
+// -------------------------------------------------------------
+// -------------------------------------------------------------
+
+#include <UnitTest++.h>
+
+#include <mpi.h>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Mesh.hh"
+#include "MeshFactory.hh"
+
+// Check that two meshes have identical derived entities and geometry
+
+void compare_derived(Jali::Mesh const& mesh0, Jali::Mesh const& mesh1) {
+  CHECK_EQUAL(mesh0.num_sides(), mesh1.num_sides());
+  CHECK_EQUAL(mesh0.num_wedges(), mesh1.num_wedges());
+  CHECK_EQUAL(mesh0.num_corners(), mesh1.num_corners());
+  CHECK_EQUAL(mesh0.num_sides<Jali::Entity_type::PARALLEL_OWNED>(),
+              mesh1.num_sides<Jali::Entity_type::PARALLEL_OWNED>());
+
+  for (auto const& s : mesh0.sides()) {
+    CHECK_EQUAL(mesh0.side_get_cell(s), mesh1.side_get_cell(s));
+    CHECK_EQUAL(mesh0.side_get_face(s), mesh1.side_get_face(s));
+    CHECK_EQUAL(mesh0.side_get_node(s, 0), mesh1.side_get_node(s, 0));
+    CHECK_EQUAL(mesh0.side_get_node(s, 1), mesh1.side_get_node(s, 1));
+    CHECK_EQUAL(mesh0.side_get_opposite_side(s),
+                mesh1.side_get_opposite_side(s));
+    CHECK_EQUAL(mesh0.side_volume(s), mesh1.side_volume(s));
+  }
+  for (auto const& w : mesh0.wedges())
+    CHECK_EQUAL(mesh0.wedge_get_corner(w), mesh1.wedge_get_corner(w));
+  for (auto const& cn : mesh0.corners()) {
+    Jali::Entity_ID_List cwedges0, cwedges1;
+    mesh0.corner_get_wedges(cn, &cwedges0);
+    mesh1.corner_get_wedges(cn, &cwedges1);
+    CHECK(cwedges0 == cwedges1);
+    CHECK_EQUAL(mesh0.corner_volume(cn), mesh1.corner_volume(cn));
+  }
+  for (auto const& c : mesh0.cells()) {
+    Jali::Entity_ID_List ccorners0, ccorners1;
+    mesh0.cell_get_corners(c, &ccorners0);
+    mesh1.cell_get_corners(c, &ccorners1);
+    CHECK(ccorners0 == ccorners1);
+    CHECK_EQUAL(mesh0.cell_volume(c), mesh1.cell_volume(c));
+  }
+}
+
+
+TEST(MESH_DERIVED_CACHE) {
+
+  int nproc, me;
+  MPI_Comm_size(MPI_COMM_WORLD, &nproc);
+  MPI_Comm_rank(MPI_COMM_WORLD, &me);
+
+  const Jali::MeshFramework_t frameworks[] = {Jali::MSTK, Jali::Simple};
+  const char *framework_names[] = {"MSTK", "Simple"};
+  const int numframeworks = sizeof(frameworks)/sizeof(Jali::MeshFramework_t);
+  for (int i = 0; i < numframeworks; i++) {
+    Jali::MeshFramework_t the_framework = frameworks[i];
+    if (!Jali::framework_available(the_framework)) continue;
+
+    // Simple meshes have edges only in 1D
+
+    int dim = (the_framework == Jali::Simple) ? 1 : 3;
+    bool parallel = (nproc > 1);
+    if (!Jali::framework_generates(the_framework, parallel, dim))
+      continue;
+
+    std::cerr << "Testing derived entity cache with " <<
+        framework_names[i] << std::endl;
+
+    auto make_mesh = [&](Jali::MeshFactory& factory, double xmax) {
+      if (dim == 1)
+        return factory(0.0, xmax, 8);
+      else
+        return factory(0.0, 0.0, 0.0, xmax, 1.0, 1.0, 3, 3, 3);
+    };
+
+    std::string cachefile = "derived_cache_test.jdc";
+    std::stringstream rankfile;
+    rankfile << cachefile;
+    if (nproc > 1) rankfile << "." << nproc << "." << me;
+    std::remove(rankfile.str().c_str());
+
+    // Reference mesh with derived entities computed at construction
+
+    Jali::MeshFactory factory(MPI_COMM_WORLD);
+    factory.framework(the_framework);
+    factory.included_entities({Jali::Entity_kind::EDGE,
+            Jali::Entity_kind::FACE, Jali::Entity_kind::CORNER});
+    std::shared_ptr<Jali::Mesh> refmesh = make_mesh(factory, 1.0);
+
+    // No cache file yet - the factory computes the derived entities
+    // and writes the file
+
+    factory.derived_cache_file(cachefile);
+    std::shared_ptr<Jali::Mesh> mesh1 = make_mesh(factory, 1.0);
+    compare_derived(*refmesh, *mesh1);
+
+    // Now they come from the file
+
+    std::shared_ptr<Jali::Mesh> mesh2 = make_mesh(factory, 1.0);
+    compare_derived(*refmesh, *mesh2);
+
+    Jali::MeshFactory factory2(MPI_COMM_WORLD);
+    factory2.framework(the_framework);
+    factory2.included_entities({Jali::Entity_kind::EDGE,
+            Jali::Entity_kind::FACE});
+    std::shared_ptr<Jali::Mesh> mesh3 = make_mesh(factory2, 1.0);
+    CHECK_EQUAL(refmesh->fingerprint(), mesh3->fingerprint());
+    CHECK(mesh3->cache_derived_entities(true, true, true, cachefile));
+    compare_derived(*refmesh, *mesh3);
+
+    // The file is renamed into place, and a file cut short (as by a
+    // run killed while writing it) is recomputed and rewritten
+
+    std::ifstream tmpfile(rankfile.str() + ".tmp");
+    CHECK(!tmpfile);
+    std::string contents;
+    {
+      std::ifstream file(rankfile.str(), std::ios::binary);
+      contents.assign(std::istreambuf_iterator<char>(file),
+                      std::istreambuf_iterator<char>());
+    }
+    {
+      std::ofstream file(rankfile.str(), std::ios::binary | std::ios::trunc);
+      file.write(contents.data(), contents.size()/2);
+    }
+    std::shared_ptr<Jali::Mesh> mesh3b = make_mesh(factory2, 1.0);
+    CHECK(!mesh3b->read_derived_cache(rankfile.str(), true, true, true));
+    CHECK(!mesh3b->cache_derived_entities(true, true, true, cachefile));
+    compare_derived(*refmesh, *mesh3b);
+    std::shared_ptr<Jali::Mesh> mesh3c = make_mesh(factory2, 1.0);
+    CHECK(mesh3c->cache_derived_entities(true, true, true, cachefile));
+    compare_derived(*refmesh, *mesh3c);
+
+    // A mesh with different node coordinates has a different
+    // fingerprint and must not use the stale file
+
+    std::shared_ptr<Jali::Mesh> mesh4 = make_mesh(factory2, 2.0);
+    CHECK(refmesh->fingerprint() != mesh4->fingerprint());
+    CHECK(!mesh4->read_derived_cache(rankfile.str(), true, true, true));
+    CHECK(!mesh4->cache_derived_entities(true, true, true, cachefile));
+
+    std::shared_ptr<Jali::Mesh> refmesh4 = make_mesh(factory, 2.0);
+    factory.derived_cache_file("");
+    std::shared_ptr<Jali::Mesh> refmesh4b = make_mesh(factory, 2.0);
+    compare_derived(*refmesh4b, *mesh4);
+    compare_derived(*refmesh4b, *refmesh4);
+
+    std::remove(rankfile.str().c_str());
+  }
+}
@@ -0,0 +1,407 @@
+/*
+ Copyright (c) 2019, Triad National Security, LLC
+ All rights reserved.
+
+ Copyright 2019. Triad National Security, LLC. This software was
+ produced under U.S. Government contract 89233218CNA000001 for Los
+ Alamos National Laboratory (LANL), which is operated by Triad
+ National Security, LLC for the U.S. Department of Energy. 
+ All rights in the program are reserved by Triad National Security,
+ LLC, and the U.S. Department of Energy/National Nuclear Security
+ Administration. The Government is granted for itself and others acting
+ on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+ in this material to reproduce, prepare derivative works, distribute
+ copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+
+ 
+ This is open source software distributed under the 3-clause BSD license.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of Triad National Security, LLC, Los Alamos
+    National Laboratory, LANL, the U.S. Government, nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ 
+ THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+ BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+// -------------------------------------------------------------
+/**
+ * @file   test_flat_mesh.cc
+ *
+ * @brief  Unit tests for writing meshes in the Jali flat binary
+ *         format and reading them back
+ */
+// -------------------------------------------------------------
+// -------------------------------------------------------------
+
+#include <UnitTest++.h>
+
+#include <mpi.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "Mesh.hh"
+#include "MeshSet.hh"
+#include "MeshFactory.hh"
+#include "Mesh_flat.hh"
+#include "errors.hh"
+
+TEST(MESH_FLAT_ROUNDTRIP) {
+
+  int nproc, me;
+  MPI_Comm_size(MPI_COMM_WORLD, &nproc);
+  MPI_Comm_rank(MPI_COMM_WORLD, &me);
+
+  const Jali::MeshFramework_t frameworks[] = {Jali::MSTK, Jali::Simple};
+  const char *framework_names[] = {"MSTK", "Simple"};
+  const int numframeworks = sizeof(frameworks)/sizeof(Jali::MeshFramework_t);
+  for (int i = 0; i < numframeworks; i++) {
+    Jali::MeshFramework_t the_framework = frameworks[i];
+    if (!Jali::framework_available(the_framework)) continue;
+
+    int dim = 3;
+    bool parallel = (nproc > 1);
+    if (!Jali::framework_generates(the_framework, parallel, dim))
+      continue;
+
+    std::cerr << "Testing flat mesh round trip with " <<
+        framework_names[i] << std::endl;
+
+    Jali::MeshFactory factory(MPI_COMM_WORLD);
+    factory.framework(the_framework);
+    factory.included_entities(Jali::Entity_kind::FACE);
+    if (the_framework != Jali::Simple)  // Simple meshes have no edges
+      factory.included_entities({Jali::Entity_kind::EDGE,
+              Jali::Entity_kind::SIDE});
+    std::shared_ptr<Jali::Mesh> mesh =
+        factory(0.0, 0.0, 0.0, 1.0, 1.0, 1.0, 4, 3, 2);
+
+    // Add a set to the mesh so that it gets written out
+
+    Jali::Entity_ID_List leftcells;
+    for (auto const& c : mesh->cells<Jali::Entity_type::PARALLEL_OWNED>()) {
+      JaliGeometry::Point cen = mesh->cell_centroid(c);
+      if (cen[0] < 0.5) leftcells.push_back(c);
+    }
+    Jali::make_meshset("leftcells", *mesh, Jali::Entity_kind::CELL,
+                       leftcells, Jali::Entity_ID_List());
+
+    std::string filename = "flatmesh_test.jfm";
+    Jali::write_flat_mesh(*mesh, filename);
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    CHECK(Jali::is_flat_mesh_file(filename, MPI_COMM_WORLD));
+
+    // The factory recognizes the file whatever the framework
+
+    std::shared_ptr<Jali::Mesh> flatmesh = factory(filename);
+    CHECK(flatmesh != nullptr);
+
+    CHECK_EQUAL(mesh->space_dimension(), flatmesh->space_dimension());
+    CHECK_EQUAL(mesh->manifold_dimension(), flatmesh->manifold_dimension());
+    CHECK_EQUAL(mesh->num_nodes<Jali::Entity_type::PARALLEL_OWNED>(),
+                flatmesh->num_nodes<Jali::Entity_type::PARALLEL_OWNED>());
+    CHECK_EQUAL(mesh->num_nodes<Jali::Entity_type::ALL>(),
+                flatmesh->num_nodes<Jali::Entity_type::ALL>());
+    CHECK_EQUAL(mesh->num_edges<Jali::Entity_type::ALL>(),
+                flatmesh->num_edges<Jali::Entity_type::ALL>());
+    CHECK_EQUAL(mesh->num_faces<Jali::Entity_type::PARALLEL_OWNED>(),
+                flatmesh->num_faces<Jali::Entity_type::PARALLEL_OWNED>());
+    CHECK_EQUAL(mesh->num_faces<Jali::Entity_type::ALL>(),
+                flatmesh->num_faces<Jali::Entity_type::ALL>());
+    CHECK_EQUAL(mesh->num_cells<Jali::Entity_type::PARALLEL_OWNED>(),
+                flatmesh->num_cells<Jali::Entity_type::PARALLEL_OWNED>());
+    CHECK_EQUAL(mesh->num_cells<Jali::Entity_type::PARALLEL_GHOST>(),
+                flatmesh->num_cells<Jali::Entity_type::PARALLEL_GHOST>());
+    CHECK_EQUAL(mesh->num_sides<Jali::Entity_type::ALL>(),
+                flatmesh->num_sides<Jali::Entity_type::ALL>());
+
+    for (auto const& n : mesh->nodes()) {
+      CHECK_EQUAL(mesh->GID(n, Jali::Entity_kind::NODE),
+                  flatmesh->GID(n, Jali::Entity_kind::NODE));
+      JaliGeometry::Point p0, p1;
+      mesh->node_get_coordinates(n, &p0);
+      flatmesh->node_get_coordinates(n, &p1);
+      CHECK_ARRAY_EQUAL(&(p0[0]), &(p1[0]), 3);
+
+      Jali::Entity_ID_List ncells0, ncells1;
+      mesh->node_get_cells(n, Jali::Entity_type::PARALLEL_OWNED, &ncells0);
+      flatmesh->node_get_cells(n, Jali::Entity_type::PARALLEL_OWNED,
+                               &ncells1);
+      CHECK(ncells0 == ncells1);
+    }
+
+    for (auto const& f : mesh->faces()) {
+      CHECK_EQUAL(mesh->GID(f, Jali::Entity_kind::FACE),
+                  flatmesh->GID(f, Jali::Entity_kind::FACE));
+      Jali::Entity_ID_List fnodes0, fnodes1, fcells0, fcells1;
+      mesh->face_get_nodes(f, &fnodes0);
+      flatmesh->face_get_nodes(f, &fnodes1);
+      CHECK(fnodes0 == fnodes1);
+      mesh->face_get_cells(f, Jali::Entity_type::ALL, &fcells0);
+      flatmesh->face_get_cells(f, Jali::Entity_type::ALL, &fcells1);
+      CHECK(fcells0 == fcells1);
+      CHECK_CLOSE(mesh->face_area(f), flatmesh->face_area(f), 1.0e-12);
+    }
+
+    for (auto const& e : mesh->edges()) {
+      Jali::Entity_ID n00, n01, n10, n11;
+      mesh->edge_get_nodes(e, &n00, &n01);
+      flatmesh->edge_get_nodes(e, &n10, &n11);
+      CHECK_EQUAL(n00, n10);
+      CHECK_EQUAL(n01, n11);
+    }
+
+    for (auto const& c : mesh->cells()) {
+      CHECK_EQUAL(mesh->GID(c, Jali::Entity_kind::CELL),
+                  flatmesh->GID(c, Jali::Entity_kind::CELL));
+      CHECK(mesh->cell_get_type(c) == flatmesh->cell_get_type(c));
+
+      Jali::Entity_ID_List cfaces0, cfaces1, cnodes0, cnodes1;
+      std::vector<Jali::dir_t> cfdirs0, cfdirs1;
+      mesh->cell_get_faces_and_dirs(c, &cfaces0, &cfdirs0);
+      flatmesh->cell_get_faces_and_dirs(c, &cfaces1, &cfdirs1);
+      CHECK(cfaces0 == cfaces1);
+      CHECK(cfdirs0 == cfdirs1);
+      mesh->cell_get_nodes(c, &cnodes0);
+      flatmesh->cell_get_nodes(c, &cnodes1);
+      CHECK(cnodes0 == cnodes1);
+
+      Jali::Entity_ID_List fadj0, fadj1;
+      mesh->cell_get_face_adj_cells(c, Jali::Entity_type::ALL, &fadj0);
+      flatmesh->cell_get_face_adj_cells(c, Jali::Entity_type::ALL, &fadj1);
+      std::sort(fadj0.begin(), fadj0.end());
+      std::sort(fadj1.begin(), fadj1.end());
+      CHECK(fadj0 == fadj1);
+
+      CHECK_CLOSE(mesh->cell_volume(c), flatmesh->cell_volume(c), 1.0e-12);
+    }
+
+    // Owned cells belong to this rank and ghost cells to some other one
+
+    auto flat = std::dynamic_pointer_cast<Jali::Mesh_flat>(flatmesh);
+    CHECK(flat != nullptr);
+    if (flat) {
+      for (auto const& c : mesh->cells<Jali::Entity_type::PARALLEL_OWNED>())
+        CHECK_EQUAL(me, flat->entity_owner(c, Jali::Entity_kind::CELL));
+      for (auto const& c : mesh->cells<Jali::Entity_type::PARALLEL_GHOST>()) {
+        int owner = flat->entity_owner(c, Jali::Entity_kind::CELL);
+        CHECK(owner != me && owner >= 0 && owner < nproc);
+      }
+    }
+
+    // The set comes back with the same entities
+
+    std::shared_ptr<Jali::MeshSet> set;
+    for (auto const& s : flatmesh->sets())
+      if (s->name() == "leftcells") set = s;
+    CHECK(set != nullptr);
+    if (set) {
+      CHECK(set->kind() == Jali::Entity_kind::CELL);
+      CHECK(set->entities<Jali::Entity_type::PARALLEL_OWNED>() == leftcells);
+    }
+
+    // Coordinates can be modified without touching the file
+
+    JaliGeometry::Point p0, p1;
+    flatmesh->node_get_coordinates(0, &p0);
+    p1 = p0 + JaliGeometry::Point(0.01, 0.0, 0.0);
+    flatmesh->node_set_coordinates(0, p1);
+    flatmesh->node_get_coordinates(0, &p1);
+    CHECK_CLOSE(p0[0] + 0.01, p1[0], 1.0e-12);
+
+    std::shared_ptr<Jali::Mesh> flatmesh2 = factory(filename);
+    flatmesh2->node_get_coordinates(0, &p1);
+    CHECK_CLOSE(p0[0], p1[0], 1.0e-12);
+
+    flatmesh.reset();
+    flatmesh2.reset();
+    MPI_Barrier(MPI_COMM_WORLD);
+    std::remove(Jali::flat_mesh_filename(filename, nproc, me).c_str());
+  }
+}
+
+
+// Damaged flat files are reported instead of being read out of bounds
+
+TEST(MESH_FLAT_DAMAGED) {
+
+  int nproc, me;
+  MPI_Comm_size(MPI_COMM_WORLD, &nproc);
+  MPI_Comm_rank(MPI_COMM_WORLD, &me);
+
+  Jali::MeshFactory factory(MPI_COMM_WORLD);
+  factory.framework(Jali::Flat);
+  std::shared_ptr<Jali::Mesh> mesh =
+      factory(0.0, 0.0, 0.0, 1.0, 1.0, 1.0, 3, 3, 2);
+
+  Jali::Entity_ID_List leftcells;
+  for (auto const& c : mesh->cells<Jali::Entity_type::PARALLEL_OWNED>()) {
+    JaliGeometry::Point cen = mesh->cell_centroid(c);
+    if (cen[0] < 0.5) leftcells.push_back(c);
+  }
+  Jali::make_meshset("leftcells", *mesh, Jali::Entity_kind::CELL,
+                     leftcells, Jali::Entity_ID_List());
+
+  std::string filename = "flatmesh_damaged_test.jfm";
+  Jali::write_flat_mesh(*mesh, filename);
+  std::string rankfile = Jali::flat_mesh_filename(filename, nproc, me);
+  std::ifstream in(rankfile, std::ios::binary);
+  std::string image((std::istreambuf_iterator<char>(in)),
+                    std::istreambuf_iterator<char>());
+  in.close();
+  CHECK(factory(filename) != nullptr);
+
+  // Section table entries (name, element size, reserved, offset,
+  // count) follow the 48 byte header
+
+  struct Section {
+    char name[40];
+    std::uint32_t elem_size, reserved;
+    std::uint64_t offset, count;
+  };
+  std::int32_t nsections;
+  std::memcpy(&nsections, &image[40], sizeof(nsections));
+  auto damage = [&](std::string const& name, bool rename) {
+    std::string damaged(image);
+    Section *sections = reinterpret_cast<Section *>(&damaged[48]);
+    for (int i = 0; i < nsections; i++) {
+      if (name != sections[i].name) continue;
+      if (rename)
+        sections[i].name[0] = 'X';
+      else
+        sections[i].count--;
+    }
+    std::ofstream out(rankfile, std::ios::binary | std::ios::trunc);
+    out.write(damaged.data(), damaged.size());
+  };
+
+  damage("cell_type", true);
+  CHECK_THROW(factory(filename), Errors::Message);
+  damage("cell_node_id", true);
+  CHECK_THROW(factory(filename), Errors::Message);
+  damage("set_names", true);
+  CHECK_THROW(factory(filename), Errors::Message);
+  damage("node_coords", false);
+  CHECK_THROW(factory(filename), Errors::Message);
+  damage("cell_face_id", false);
+  CHECK_THROW(factory(filename), Errors::Message);
+  damage("face_cell", false);
+  CHECK_THROW(factory(filename), Errors::Message);
+  damage("set_num_ghost", false);
+  CHECK_THROW(factory(filename), Errors::Message);
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  std::remove(rankfile.c_str());
+}
+
+
+TEST(MESH_FROZEN) {
+
+  int nproc;
+  MPI_Comm_size(MPI_COMM_WORLD, &nproc);
+
+  const Jali::MeshFramework_t frameworks[] = {Jali::MSTK, Jali::Simple};
+  const char *framework_names[] = {"MSTK", "Simple"};
+  const int numframeworks = sizeof(frameworks)/sizeof(Jali::MeshFramework_t);
+  for (int i = 0; i < numframeworks; i++) {
+    Jali::MeshFramework_t the_framework = frameworks[i];
+    if (!Jali::framework_available(the_framework)) continue;
+
+    int dim = 3;
+    bool parallel = (nproc > 1);
+    if (!Jali::framework_generates(the_framework, parallel, dim))
+      continue;
+
+    std::cerr << "Testing frozen mesh with " << framework_names[i] <<
+        std::endl;
+
+    Jali::MeshFactory factory(MPI_COMM_WORLD);
+    factory.framework(the_framework);
+    factory.included_entities(Jali::Entity_kind::FACE);
+    if (the_framework != Jali::Simple)  // Simple meshes have no edges
+      factory.included_entities({Jali::Entity_kind::EDGE,
+              Jali::Entity_kind::CORNER});
+    std::shared_ptr<Jali::Mesh> mesh =
+        factory(0.0, 0.0, 0.0, 1.0, 1.0, 1.0, 3, 3, 2);
+
+    factory.freeze(true);
+    CHECK(factory.freeze());
+    std::shared_ptr<Jali::Mesh> frozen =
+        factory(0.0, 0.0, 0.0, 1.0, 1.0, 1.0, 3, 3, 2);
+    CHECK(frozen != nullptr);
+    CHECK(std::dynamic_pointer_cast<Jali::Mesh_flat>(frozen) != nullptr);
+
+    // The frozen mesh answers queries just like the original one
+
+    CHECK_EQUAL(mesh->num_nodes<Jali::Entity_type::ALL>(),
+                frozen->num_nodes<Jali::Entity_type::ALL>());
+    CHECK_EQUAL(mesh->num_faces<Jali::Entity_type::PARALLEL_OWNED>(),
+                frozen->num_faces<Jali::Entity_type::PARALLEL_OWNED>());
+    CHECK_EQUAL(mesh->num_cells<Jali::Entity_type::PARALLEL_OWNED>(),
+                frozen->num_cells<Jali::Entity_type::PARALLEL_OWNED>());
+    CHECK_EQUAL(mesh->num_edges<Jali::Entity_type::ALL>(),
+                frozen->num_edges<Jali::Entity_type::ALL>());
+    CHECK_EQUAL(mesh->num_corners<Jali::Entity_type::ALL>(),
+                frozen->num_corners<Jali::Entity_type::ALL>());
+
+    for (auto const& c : mesh->cells()) {
+      CHECK_EQUAL(mesh->GID(c, Jali::Entity_kind::CELL),
+                  frozen->GID(c, Jali::Entity_kind::CELL));
+      Jali::Entity_ID_List cfaces0, cfaces1, cnodes0, cnodes1;
+      std::vector<Jali::dir_t> cfdirs0, cfdirs1;
+      mesh->cell_get_faces_and_dirs(c, &cfaces0, &cfdirs0);
+      frozen->cell_get_faces_and_dirs(c, &cfaces1, &cfdirs1);
+      CHECK(cfaces0 == cfaces1);
+      CHECK(cfdirs0 == cfdirs1);
+      mesh->cell_get_nodes(c, &cnodes0);
+      frozen->cell_get_nodes(c, &cnodes1);
+      CHECK(cnodes0 == cnodes1);
+      CHECK_CLOSE(mesh->cell_volume(c), frozen->cell_volume(c), 1.0e-12);
+    }
+
+    for (auto const& n : mesh->nodes()) {
+      JaliGeometry::Point p0, p1;
+      mesh->node_get_coordinates(n, &p0);
+      frozen->node_get_coordinates(n, &p1);
+      CHECK_ARRAY_EQUAL(&(p0[0]), &(p1[0]), 3);
+    }
+
+    // Freezing with tiles builds the tiles on the frozen mesh
+
+    factory.num_tiles(4);
+    std::shared_ptr<Jali::Mesh> frozen_tiled =
+        factory(0.0, 0.0, 0.0, 1.0, 1.0, 1.0, 3, 3, 2);
+    CHECK_EQUAL(4, frozen_tiled->num_tiles());
+    CHECK_EQUAL(4, factory.num_tiles());
+  }
+}
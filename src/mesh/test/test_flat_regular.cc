@@ -0,0 +1,333 @@
+/*
+ Copyright (c) 2019, Triad National Security, LLC
+ All rights reserved.
+
+ Copyright 2019. Triad National Security, LLC. This software was
+ produced under U.S. Government contract 89233218CNA000001 for Los
+ Alamos National Laboratory (LANL), which is operated by Triad
+ National Security, LLC for the U.S. Department of Energy. 
+ All rights in the program are reserved by Triad National Security,
+ LLC, and the U.S. Department of Energy/National Nuclear Security
+ Administration. The Government is granted for itself and others acting
+ on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+ in this material to reproduce, prepare derivative works, distribute
+ copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+
+ 
+ This is open source software distributed under the 3-clause BSD license.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of Triad National Security, LLC, Los Alamos
+    National Laboratory, LANL, the U.S. Government, nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ 
+ THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+ BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+// -------------------------------------------------------------
+/**
+ * @file   test_flat_regular.cc
+ *
+ * @brief  Unit tests for distributed generation of regular meshes in
+ *         the flat framework
+ */
+// -------------------------------------------------------------
+// -------------------------------------------------------------
+
+#include <UnitTest++.h>
+
+#include <mpi.h>
+#include <cmath>
+#include <iostream>
+#include <functional>
+#include <vector>
+
+#include "Mesh.hh"
+#include "MeshFactory.hh"
+#include "Mesh_flat.hh"
+
+// Check that the partitions of a distributed mesh fit together - each
+// entity is owned by exactly one rank, ghosts have the same global
+// IDs and coordinates as their owned copies and each cell is closed
+
+void check_distributed(Jali::Mesh const& mesh, int nlayers, int ncells,
+                       int nnodes, int nfaces, int nedges) {
+  MPI_Comm comm = mesh.get_comm();
+  int nproc;
+  MPI_Comm_size(comm, &nproc);
+  int dim = mesh.space_dimension();
+
+  auto check_kind = [&](Jali::Entity_kind kind, int nglobal,
+                        std::vector<int> const& owned,
+                        std::vector<int> const& all,
+                        std::function<JaliGeometry::Point(int)> const& pos) {
+    // every global ID is owned exactly once
+
+    std::vector<int> count(nglobal, 0), gcount(nglobal);
+    for (auto const& e : owned) {
+      int gid = mesh.GID(e, kind);
+      CHECK(gid >= 0 && gid < nglobal);
+      count[gid]++;
+    }
+    MPI_Allreduce(&(count[0]), &(gcount[0]), nglobal, MPI_INT, MPI_SUM, comm);
+    for (int g = 0; g < nglobal; g++)
+      CHECK_EQUAL(1, gcount[g]);
+
+    // all copies of an entity are at the same place
+
+    std::vector<double> xyz(3*nglobal, 0.0), gxyz(3*nglobal);
+    for (auto const& e : owned) {
+      JaliGeometry::Point p = pos(e);
+      for (int d = 0; d < dim; d++)
+        xyz[3*mesh.GID(e, kind)+d] = p[d];
+    }
+    MPI_Allreduce(&(xyz[0]), &(gxyz[0]), 3*nglobal, MPI_DOUBLE, MPI_SUM,
+                  comm);
+    for (auto const& e : all) {
+      JaliGeometry::Point p = pos(e);
+      int gid = mesh.GID(e, kind);
+      for (int d = 0; d < dim; d++)
+        CHECK_CLOSE(gxyz[3*gid+d], p[d], 1.0e-12);
+    }
+
+    // flat meshes also record which rank owns each ghost
+
+    auto flatmesh = dynamic_cast<Jali::Mesh_flat const *>(&mesh);
+    if (flatmesh) {
+      int rank;
+      MPI_Comm_rank(comm, &rank);
+      std::vector<int> owner(nglobal, 0), gowner(nglobal);
+      for (auto const& e : owned)
+        owner[mesh.GID(e, kind)] = rank;
+      MPI_Allreduce(&(owner[0]), &(gowner[0]), nglobal, MPI_INT, MPI_SUM,
+                    comm);
+      for (auto const& e : all)
+        CHECK_EQUAL(gowner[mesh.GID(e, kind)], flatmesh->entity_owner(e, kind));
+    }
+  };
+
+  check_kind(Jali::Entity_kind::CELL, ncells,
+             mesh.cells<Jali::Entity_type::PARALLEL_OWNED>(), mesh.cells(),
+             [&](int c) { return mesh.cell_centroid(c); });
+  check_kind(Jali::Entity_kind::NODE, nnodes,
+             mesh.nodes<Jali::Entity_type::PARALLEL_OWNED>(), mesh.nodes(),
+             [&](int n) {
+               JaliGeometry::Point p;
+               mesh.node_get_coordinates(n, &p);
+               return p;
+             });
+  check_kind(Jali::Entity_kind::FACE, nfaces,
+             mesh.faces<Jali::Entity_type::PARALLEL_OWNED>(), mesh.faces(),
+             [&](int f) { return mesh.face_centroid(f); });
+  if (nedges)
+    check_kind(Jali::Entity_kind::EDGE, nedges,
+               mesh.edges<Jali::Entity_type::PARALLEL_OWNED>(), mesh.edges(),
+               [&](int e) {
+                 JaliGeometry::Point p0, p1;
+                 Jali::Entity_ID n0, n1;
+                 mesh.edge_get_nodes(e, &n0, &n1);
+                 mesh.node_get_coordinates(n0, &p0);
+                 mesh.node_get_coordinates(n1, &p1);
+                 return (p0+p1)/2.0;
+               });
+
+  // The outward normals of the faces of each cell sum to zero and the
+  // cells fill the domain
+
+  double volume = 0.0;
+  for (auto const& c : mesh.cells<Jali::Entity_type::PARALLEL_OWNED>()) {
+    Jali::Entity_ID_List cfaces;
+    std::vector<Jali::dir_t> cfdirs;
+    mesh.cell_get_faces_and_dirs(c, &cfaces, &cfdirs);
+    CHECK_EQUAL(2*dim, cfaces.size());
+    JaliGeometry::Point sum(dim);
+    for (int i = 0; i < cfaces.size(); i++) {
+      JaliGeometry::Point normal = mesh.face_normal(cfaces[i], false, c);
+      sum += normal;
+      if (dim > 1) {  // face centroids are not computed in 1D
+        JaliGeometry::Point dx = mesh.face_centroid(cfaces[i]) -
+            mesh.cell_centroid(c);
+        CHECK(dx*normal > 0.0);
+      }
+    }
+    CHECK_CLOSE(0.0, norm(sum), 1.0e-12);
+    volume += mesh.cell_volume(c);
+  }
+  double gvolume;
+  MPI_Allreduce(&volume, &gvolume, 1, MPI_DOUBLE, MPI_SUM, comm);
+  CHECK_CLOSE(1.0, gvolume, 1.0e-10);
+
+  // Ghost cells are the layers of cells around the partition - all
+  // of them are reached by going out nlayers layers of node
+  // connected neighbors from the owned cells
+
+  std::vector<int> layer(mesh.num_cells(), -1);
+  std::vector<int> front = mesh.cells<Jali::Entity_type::PARALLEL_OWNED>();
+  for (auto const& c : front)
+    layer[c] = 0;
+  for (int l = 1; l <= nlayers; l++) {
+    std::vector<int> next;
+    for (auto const& c : front) {
+      Jali::Entity_ID_List nbrs;
+      mesh.cell_get_node_adj_cells(c, Jali::Entity_type::ALL, &nbrs);
+      for (auto const& c2 : nbrs)
+        if (layer[c2] < 0) {
+          layer[c2] = l;
+          next.push_back(c2);
+        }
+    }
+    front.swap(next);
+  }
+  for (auto const& c : mesh.cells<Jali::Entity_type::PARALLEL_GHOST>())
+    CHECK(layer[c] > 0);
+}
+
+
+TEST(FLAT_REGULAR_3D) {
+  Jali::MeshFactory factory(MPI_COMM_WORLD);
+  factory.framework(Jali::Flat);
+  factory.included_entities({Jali::Entity_kind::FACE,
+          Jali::Entity_kind::EDGE});
+
+  std::shared_ptr<Jali::Mesh> mesh =
+      factory(0.0, 0.0, 0.0, 1.0, 1.0, 1.0, 6, 5, 4);
+  CHECK(std::dynamic_pointer_cast<Jali::Mesh_flat>(mesh) != nullptr);
+  CHECK_EQUAL(3, mesh->space_dimension());
+  CHECK_EQUAL(3, mesh->manifold_dimension());
+
+  check_distributed(*mesh, 1, 6*5*4, 7*6*5, 7*5*4 + 6*6*4 + 6*5*5,
+                    6*6*5 + 7*5*5 + 7*6*4);
+
+  // Edges of faces go around the face nodes
+
+  for (auto const& f : mesh->faces()) {
+    Jali::Entity_ID_List fnodes, fedges;
+    std::vector<Jali::dir_t> fedirs;
+    mesh->face_get_nodes(f, &fnodes);
+    mesh->face_get_edges_and_dirs(f, &fedges, &fedirs);
+    CHECK_EQUAL(4, fedges.size());
+    for (int i = 0; i < 4; i++) {
+      Jali::Entity_ID n0, n1;
+      mesh->edge_get_nodes(fedges[i], &n0, &n1);
+      if (fedirs[i] < 0) std::swap(n0, n1);
+      CHECK_EQUAL(fnodes[i], n0);
+      CHECK_EQUAL(fnodes[(i+1)%4], n1);
+    }
+  }
+
+  // In serial the mesh is the same as a simple mesh
+
+  int nproc;
+  MPI_Comm_size(MPI_COMM_WORLD, &nproc);
+  if (nproc == 1) {
+    Jali::MeshFactory simple_factory(MPI_COMM_WORLD);
+    simple_factory.framework(Jali::Simple);
+    simple_factory.included_entities(Jali::Entity_kind::FACE);
+    std::shared_ptr<Jali::Mesh> simple =
+        simple_factory(0.0, 0.0, 0.0, 1.0, 1.0, 1.0, 6, 5, 4);
+    CHECK_EQUAL(simple->num_cells(), mesh->num_cells());
+    CHECK_EQUAL(simple->num_faces(), mesh->num_faces());
+    for (auto const& c : mesh->cells()) {
+      Jali::Entity_ID_List cnodes0, cnodes1;
+      simple->cell_get_nodes(c, &cnodes0);
+      mesh->cell_get_nodes(c, &cnodes1);
+      CHECK_ARRAY_EQUAL(&(cnodes0[0]), &(cnodes1[0]), 8);
+      CHECK_CLOSE(simple->cell_volume(c), mesh->cell_volume(c), 1.0e-12);
+    }
+  }
+}
+
+
+TEST(FLAT_REGULAR_2D) {
+  Jali::MeshFactory factory(MPI_COMM_WORLD);
+  factory.framework(Jali::Flat);
+  factory.included_entities({Jali::Entity_kind::FACE,
+          Jali::Entity_kind::CORNER});
+  factory.num_ghost_layers_distmesh(2);
+
+  std::shared_ptr<Jali::Mesh> mesh = factory(0.0, 0.0, 1.0, 1.0, 7, 6);
+  CHECK_EQUAL(2, mesh->space_dimension());
+
+  check_distributed(*mesh, 2, 7*6, 8*7, 8*6 + 7*7, 8*6 + 7*7);
+
+  // Sides and corners are built on the generated mesh
+
+  double cvolume = 0.0;
+  for (auto const& c : mesh->cells<Jali::Entity_type::PARALLEL_OWNED>()) {
+    Jali::Entity_ID_List ccorners;
+    mesh->cell_get_corners(c, &ccorners);
+    CHECK_EQUAL(4, ccorners.size());
+    for (auto const& cn : ccorners)
+      cvolume += mesh->corner_volume(cn);
+  }
+  double gcvolume;
+  MPI_Allreduce(&cvolume, &gcvolume, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+  CHECK_CLOSE(1.0, gcvolume, 1.0e-10);
+}
+
+
+TEST(FLAT_REGULAR_1D) {
+  Jali::MeshFactory factory(MPI_COMM_WORLD);
+  factory.framework(Jali::Flat);
+  factory.included_entities(Jali::Entity_kind::FACE);
+
+  std::vector<double> x(13);
+  for (int i = 0; i < 13; i++)
+    x[i] = std::pow(i/12.0, 2);
+  std::shared_ptr<Jali::Mesh> mesh = factory(x);
+  CHECK_EQUAL(1, mesh->space_dimension());
+
+  check_distributed(*mesh, 1, 12, 13, 13, 0);
+}
+
+
+TEST(FLAT_REGULAR_LARGE) {
+  // A larger mesh - the cells are evenly spread over the ranks and the
+  // image of each rank stays within a fixed budget per cell
+
+  Jali::MeshFactory factory(MPI_COMM_WORLD);
+  factory.framework(Jali::Flat);
+  factory.included_entities(Jali::Entity_kind::FACE);
+
+  std::shared_ptr<Jali::Mesh> mesh =
+      factory(0.0, 0.0, 0.0, 1.0, 1.0, 1.0, 48, 48, 48);
+
+  int nprocs;
+  MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+  int nowned = mesh->num_cells<Jali::Entity_type::PARALLEL_OWNED>(), ntotal;
+  int nmin, nmax;
+  MPI_Allreduce(&nowned, &ntotal, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+  MPI_Allreduce(&nowned, &nmin, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+  MPI_Allreduce(&nowned, &nmax, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+  CHECK_EQUAL(48*48*48, ntotal);
+  CHECK(nmax <= 2*nmin);
+
+  auto flatmesh = std::dynamic_pointer_cast<Jali::Mesh_flat>(mesh);
+  CHECK(flatmesh != nullptr);
+  if (flatmesh) {
+    int ncells = mesh->num_cells<Jali::Entity_type::ALL>();
+    CHECK(flatmesh->image_size() < 512*static_cast<std::size_t>(ncells));
+  }
+}
@@ -0,0 +1,196 @@
+/*
+ Copyright (c) 2019, Triad National Security, LLC
+ All rights reserved.
+
+ Copyright 2019. Triad National Security, LLC. This software was
+ produced under U.S. Government contract 89233218CNA000001 for Los
+ Alamos National Laboratory (LANL), which is operated by Triad
+ National Security, LLC for the U.S. Department of Energy. 
+ All rights in the program are reserved by Triad National Security,
+ LLC, and the U.S. Department of Energy/National Nuclear Security
+ Administration. The Government is granted for itself and others acting
+ on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+ in this material to reproduce, prepare derivative works, distribute
+ copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+
+ 
+ This is open source software distributed under the 3-clause BSD license.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of Triad National Security, LLC, Los Alamos
+    National Laboratory, LANL, the U.S. Government, nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ 
+ THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+ BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+// -------------------------------------------------------------
+/**
+ * @file   test_interior_boundary_owned.cc
+ *
+ * @brief  Unit tests for splitting owned entities of a mesh and of its
+ *         tiles into interior and parallel boundary entities
+ */
+// -------------------------------------------------------------
+// -------------------------------------------------------------
+
+#include <UnitTest++.h>
+
+#include <mpi.h>
+#include <iostream>
+#include <vector>
+
+#include "Mesh.hh"
+#include "MeshTile.hh"
+#include "MeshFactory.hh"
+
+TEST(MESH_INTERIOR_BOUNDARY_OWNED) {
+
+  int nproc, me;
+  MPI_Comm_size(MPI_COMM_WORLD, &nproc);
+  MPI_Comm_rank(MPI_COMM_WORLD, &me);
+
+  const Jali::MeshFramework_t frameworks[] = {Jali::MSTK, Jali::Simple};
+  const char *framework_names[] = {"MSTK", "Simple"};
+  const int numframeworks = sizeof(frameworks)/sizeof(Jali::MeshFramework_t);
+  for (int i = 0; i < numframeworks; i++) {
+    Jali::MeshFramework_t the_framework = frameworks[i];
+    if (!Jali::framework_available(the_framework)) continue;
+
+    int dim = 3;
+    bool parallel = (nproc > 1);
+    if (!Jali::framework_generates(the_framework, parallel, dim))
+      continue;
+
+    std::cerr << "Testing interior/boundary owned entities with " <<
+        framework_names[i] << std::endl;
+
+    Jali::MeshFactory factory(MPI_COMM_WORLD);
+    std::shared_ptr<Jali::Mesh> mesh;
+
+    int ierr = 0;
+    int aerr = 0;
+    int num_tiles_requested = 4;
+    try {
+      factory.framework(the_framework);
+      factory.partitioner(Jali::Partitioner_type::BLOCK);
+      factory.included_entities(Jali::Entity_kind::FACE);
+      factory.num_tiles(num_tiles_requested);
+      factory.num_ghost_layers_tile(1);
+
+      mesh = factory(0.0, 0.0, 0.0, 1.0, 1.0, 1.0, 6, 6, 6);
+    } catch (const Errors::Message& e) {
+      std::cerr << ": mesh error: " << e.what() << std::endl;
+      ierr++;
+    } catch (const std::exception& e) {
+      std::cerr << ": error: " << e.what() << std::endl;
+      ierr++;
+    }
+
+    MPI_Allreduce(&ierr, &aerr, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    CHECK_EQUAL(aerr, 0);
+
+    // Interior and boundary lists must partition the owned lists
+
+    CHECK_EQUAL(mesh->num_cells<Jali::Entity_type::PARALLEL_OWNED>(),
+                mesh->cells_owned_interior().size() +
+                mesh->cells_owned_boundary().size());
+    CHECK_EQUAL(mesh->num_faces<Jali::Entity_type::PARALLEL_OWNED>(),
+                mesh->faces_owned_interior().size() +
+                mesh->faces_owned_boundary().size());
+    CHECK_EQUAL(mesh->num_nodes<Jali::Entity_type::PARALLEL_OWNED>(),
+                mesh->nodes_owned_interior().size() +
+                mesh->nodes_owned_boundary().size());
+
+    if (nproc == 1) {
+      // Nothing depends on ghost data on a serial mesh
+
+      CHECK_EQUAL(0, mesh->cells_owned_boundary().size());
+      CHECK_EQUAL(0, mesh->faces_owned_boundary().size());
+      CHECK_EQUAL(0, mesh->nodes_owned_boundary().size());
+    } else {
+      CHECK(mesh->cells_owned_boundary().size() > 0);
+    }
+
+    // Interior cells must not be node connected to any ghost cell and
+    // interior faces and nodes must only be connected to interior cells
+
+    for (auto const& c : mesh->cells_owned_interior()) {
+      CHECK(mesh->entity_is_owned_interior(Jali::Entity_kind::CELL, c));
+
+      Jali::Entity_ID_List nbrs;
+      mesh->cell_get_node_adj_cells(c, Jali::Entity_type::ALL, &nbrs);
+      for (auto const& cnbr : nbrs)
+        CHECK(mesh->entity_get_type(Jali::Entity_kind::CELL, cnbr) !=
+              Jali::Entity_type::PARALLEL_GHOST);
+    }
+
+    for (auto const& c : mesh->cells_owned_boundary())
+      CHECK(!mesh->entity_is_owned_interior(Jali::Entity_kind::CELL, c));
+
+    for (auto const& f : mesh->faces_owned_interior()) {
+      Jali::Entity_ID_List fcells;
+      mesh->face_get_cells(f, Jali::Entity_type::ALL, &fcells);
+      for (auto const& c : fcells)
+        CHECK(mesh->entity_is_owned_interior(Jali::Entity_kind::CELL, c));
+    }
+
+    for (auto const& n : mesh->nodes_owned_interior()) {
+      Jali::Entity_ID_List ncells;
+      mesh->node_get_cells(n, Jali::Entity_type::ALL, &ncells);
+      for (auto const& c : ncells)
+        CHECK(mesh->entity_is_owned_interior(Jali::Entity_kind::CELL, c));
+    }
+
+    for (auto const& n : mesh->nodes<Jali::Entity_type::PARALLEL_GHOST>())
+      CHECK(!mesh->entity_is_owned_interior(Jali::Entity_kind::NODE, n));
+
+    // Tile level splits must partition the tile owned lists and agree
+    // with the mesh level splits
+
+    int ncells_interior = 0, ncells_boundary = 0;
+    for (auto const& t : mesh->tiles()) {
+      CHECK_EQUAL(t->num_cells<Jali::Entity_type::PARALLEL_OWNED>(),
+                  t->cells_owned_interior().size() +
+                  t->cells_owned_boundary().size());
+      CHECK_EQUAL(t->num_faces<Jali::Entity_type::PARALLEL_OWNED>(),
+                  t->faces_owned_interior().size() +
+                  t->faces_owned_boundary().size());
+      CHECK_EQUAL(t->num_nodes<Jali::Entity_type::PARALLEL_OWNED>(),
+                  t->nodes_owned_interior().size() +
+                  t->nodes_owned_boundary().size());
+
+      for (auto const& c : t->cells_owned_interior())
+        CHECK(mesh->entity_is_owned_interior(Jali::Entity_kind::CELL, c));
+      for (auto const& n : t->nodes_owned_interior())
+        CHECK(mesh->entity_is_owned_interior(Jali::Entity_kind::NODE, n));
+
+      ncells_interior += t->cells_owned_interior().size();
+      ncells_boundary += t->cells_owned_boundary().size();
+    }
+    CHECK_EQUAL(mesh->cells_owned_interior().size(), ncells_interior);
+    CHECK_EQUAL(mesh->cells_owned_boundary().size(), ncells_boundary);
+  }
+}
@@ -0,0 +1,235 @@
+/*
+ Copyright (c) 2019, Triad National Security, LLC
+ All rights reserved.
+
+ Copyright 2019. Triad National Security, LLC. This software was
+ produced under U.S. Government contract 89233218CNA000001 for Los
+ Alamos National Laboratory (LANL), which is operated by Triad
+ National Security, LLC for the U.S. Department of Energy. 
+ All rights in the program are reserved by Triad National Security,
+ LLC, and the U.S. Department of Energy/National Nuclear Security
+ Administration. The Government is granted for itself and others acting
+ on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+ in this material to reproduce, prepare derivative works, distribute
+ copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+
+ 
+ This is open source software distributed under the 3-clause BSD license.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of Triad National Security, LLC, Los Alamos
+    National Laboratory, LANL, the U.S. Government, nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ 
+ THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+ BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+// -------------------------------------------------------------
+/**
+ * @file   test_overlap.cc
+ *
+ * @brief  Unit tests for overlaps of cells of two meshes
+ */
+// -------------------------------------------------------------
+// -------------------------------------------------------------
+
+#include <UnitTest++.h>
+
+#include <mpi.h>
+#include <cmath>
+#include <vector>
+
+#include "Mesh.hh"
+#include "MeshFactory.hh"
+#include "MeshOverlap.hh"
+
+
+namespace {
+
+// Stretch the mesh along x, keeping the boundary in place; planes of
+// constant x stay planes so the cells stay convex with planar faces
+
+void stretch(Jali::Mesh *mesh) {
+  for (auto const& n : mesh->nodes()) {
+    JaliGeometry::Point xyz;
+    mesh->node_get_coordinates(n, &xyz);
+    xyz[0] += 0.1*std::sin(M_PI*xyz[0]);
+    mesh->node_set_coordinates(n, xyz);
+  }
+  mesh->update_geometric_quantities();
+}
+
+// Check the candidates against brute force and that the overlaps of
+// each cell of either mesh add up to its volume, for meshes covering
+// the same domain
+
+void check_overlaps(Jali::Mesh const& source, Jali::Mesh const& target) {
+  int dim = source.space_dimension();
+  Jali::Entity_ID_List targetcells;
+  for (auto const& c : target.cells()) targetcells.push_back(c);
+
+  std::vector<int> offsets;
+  Jali::Entity_ID_List sourcecells;
+  std::vector<double> volumes;
+  Jali::overlap_candidates(source, target, targetcells, &offsets,
+                           &sourcecells, &volumes);
+  CHECK_EQUAL(targetcells.size()+1, offsets.size());
+  CHECK_EQUAL(offsets.back(), sourcecells.size());
+  CHECK_EQUAL(sourcecells.size(), volumes.size());
+
+  std::vector<double> sourcevolumes(source.num_cells(), 0.0);
+  for (int i = 0; i < targetcells.size(); i++) {
+    std::vector<JaliGeometry::Point> tcoords;
+    target.cell_get_coordinates(targetcells[i], &tcoords);
+    Jali::Entity_ID_List expected;
+    for (auto const& s : source.cells()) {
+      std::vector<JaliGeometry::Point> scoords;
+      source.cell_get_coordinates(s, &scoords);
+      bool overlap = true;
+      for (int d = 0; d < dim; d++) {
+        double smin = scoords[0][d], smax = scoords[0][d];
+        for (auto const& x : scoords) {
+          smin = std::min(smin, x[d]);
+          smax = std::max(smax, x[d]);
+        }
+        double tmin = tcoords[0][d], tmax = tcoords[0][d];
+        for (auto const& x : tcoords) {
+          tmin = std::min(tmin, x[d]);
+          tmax = std::max(tmax, x[d]);
+        }
+        if (smax < tmin || tmax < smin) overlap = false;
+      }
+      if (overlap) expected.push_back(s);
+    }
+    Jali::Entity_ID_List found(sourcecells.begin() + offsets[i],
+                               sourcecells.begin() + offsets[i+1]);
+    CHECK(expected == found);
+
+    double sum = 0.0;
+    for (int j = offsets[i]; j < offsets[i+1]; j++) {
+      CHECK(volumes[j] >= 0.0);
+      sum += volumes[j];
+      sourcevolumes[sourcecells[j]] += volumes[j];
+    }
+    double volume = target.cell_volume(targetcells[i]);
+    CHECK_CLOSE(volume, sum, 1.0e-12*volume);
+  }
+  for (auto const& s : source.cells()) {
+    double volume = source.cell_volume(s);
+    CHECK_CLOSE(volume, sourcevolumes[s], 1.0e-12*volume);
+  }
+}
+
+}  // namespace
+
+
+// Each rank builds both meshes whole so the overlaps do not depend
+// on the partitioning
+
+TEST(OVERLAPS_3D) {
+  Jali::MeshFactory factory(MPI_COMM_SELF);
+  factory.framework(Jali::Flat);
+  std::shared_ptr<Jali::Mesh> source =
+      factory(0.0, 0.0, 0.0, 1.0, 1.0, 1.0, 7, 6, 5);
+  std::shared_ptr<Jali::Mesh> target =
+      factory(0.0, 0.0, 0.0, 1.0, 1.0, 1.0, 4, 5, 3);
+
+  check_overlaps(*source, *target);
+  stretch(source.get());
+  check_overlaps(*source, *target);
+}
+
+
+TEST(OVERLAPS_2D) {
+  Jali::MeshFactory factory(MPI_COMM_SELF);
+  factory.framework(Jali::Flat);
+  std::shared_ptr<Jali::Mesh> source = factory(0.0, 0.0, 2.0, 1.0, 9, 4);
+  std::shared_ptr<Jali::Mesh> target = factory(0.0, 0.0, 2.0, 1.0, 5, 7);
+
+  check_overlaps(*source, *target);
+  stretch(target.get());
+  check_overlaps(*source, *target);
+  check_overlaps(*target, *source);
+}
+
+
+TEST(THREADED_OVERLAPS) {
+  // Enough target cells for several threads, split unevenly or not,
+  // give the same candidates and volumes as a serial search
+
+  Jali::MeshFactory factory(MPI_COMM_SELF);
+  factory.framework(Jali::Flat);
+  std::shared_ptr<Jali::Mesh> source =
+      factory(0.0, 0.0, 0.0, 1.0, 1.0, 1.0, 9, 8, 7);
+  std::shared_ptr<Jali::Mesh> target =
+      factory(0.0, 0.0, 0.0, 1.0, 1.0, 1.0, 12, 10, 9);
+  stretch(source.get());
+
+  Jali::Entity_ID_List targetcells;
+  for (auto const& c : target->cells()) targetcells.push_back(c);
+  CHECK(targetcells.size() > 4*256);
+
+  std::vector<int> offsets;
+  Jali::Entity_ID_List sourcecells;
+  std::vector<double> volumes;
+  Jali::overlap_candidates(*source, *target, targetcells, &offsets,
+                           &sourcecells, &volumes, 1);
+
+  for (int nthreads : {0, 2, 4, 7}) {
+    std::vector<int> toffsets;
+    Jali::Entity_ID_List tsourcecells;
+    std::vector<double> tvolumes;
+    Jali::overlap_candidates(*source, *target, targetcells, &toffsets,
+                             &tsourcecells, &tvolumes, nthreads);
+    CHECK(toffsets == offsets);
+    CHECK(tsourcecells == sourcecells);
+    CHECK(tvolumes == volumes);
+  }
+}
+
+
+TEST(SELF_OVERLAPS) {
+  // A cell overlaps itself fully and its neighbors not at all; with
+  // the same partitioning each rank covers its own cells
+
+  Jali::MeshFactory factory(MPI_COMM_WORLD);
+  factory.framework(Jali::Flat);
+  std::shared_ptr<Jali::Mesh> mesh =
+      factory(0.0, 0.0, 0.0, 1.0, 1.0, 1.0, 6, 6, 6);
+
+  Jali::Entity_ID_List cells;
+  for (auto const& c : mesh->cells()) cells.push_back(c);
+  std::vector<int> offsets;
+  Jali::Entity_ID_List sourcecells;
+  std::vector<double> volumes;
+  Jali::overlap_candidates(*mesh, *mesh, cells, &offsets, &sourcecells,
+                           &volumes);
+
+  for (int i = 0; i < cells.size(); i++)
+    for (int j = offsets[i]; j < offsets[i+1]; j++) {
+      double expected = (sourcecells[j] == cells[i]) ?
+          mesh->cell_volume(cells[i]) : 0.0;
+      CHECK_CLOSE(expected, volumes[j], 1.0e-12);
+    }
+}
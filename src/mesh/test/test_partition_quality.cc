@@ -0,0 +1,186 @@
+/*
+ Copyright (c) 2019, Triad National Security, LLC
+ All rights reserved.
+
+ Copyright 2019. Triad National Security, LLC. This software was
+ produced under U.S. Government contract 89233218CNA000001 for Los
+ Alamos National Laboratory (LANL), which is operated by Triad
+ National Security, LLC for the U.S. Department of Energy. 
+ All rights in the program are reserved by Triad National Security,
+ LLC, and the U.S. Department of Energy/National Nuclear Security
+ Administration. The Government is granted for itself and others acting
+ on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+ in this material to reproduce, prepare derivative works, distribute
+ copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+
+ 
+ This is open source software distributed under the 3-clause BSD license.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of Triad National Security, LLC, Los Alamos
+    National Laboratory, LANL, the U.S. Government, nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ 
+ THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+ BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+// -------------------------------------------------------------
+/**
+ * @file   test_partition_quality.cc
+ *
+ * @brief  Unit tests for the tile and rank partition quality metrics
+ */
+// -------------------------------------------------------------
+// -------------------------------------------------------------
+
+#include <UnitTest++.h>
+
+#include <mpi.h>
+#include <vector>
+
+#include "Mesh.hh"
+#include "MeshFactory.hh"
+#include "MeshPartitionQuality.hh"
+
+
+TEST(TILE_PARTITION_QUALITY) {
+  // An 8x8x8 mesh cut into octants by RCB on every rank
+
+  Jali::MeshFactory factory(MPI_COMM_SELF);
+  factory.framework(Jali::Structured);
+  factory.included_entities({Jali::Entity_kind::FACE});
+  factory.partitioner(Jali::Partitioner_type::RCB);
+  factory.num_tiles(8);
+  factory.num_ghost_layers_tile(1);
+  std::shared_ptr<Jali::Mesh> mesh =
+      factory(0.0, 0.0, 0.0, 1.0, 1.0, 1.0, 8, 8, 8);
+
+  Jali::PartitionQuality q = mesh->tile_partition_quality();
+  CHECK_EQUAL(8, q.num_parts);
+  CHECK_EQUAL(64, q.min_cells);
+  CHECK_EQUAL(64, q.max_cells);
+  CHECK_EQUAL(512, q.total_cells);
+  CHECK_CLOSE(1.0, q.imbalance(), 1.0e-12);
+
+  // Each octant has a one cell halo inside the domain, shares 3x16
+  // faces with its 3 face neighbors and the three cut planes hold
+  // 3x64 faces
+
+  CHECK_EQUAL(8*(5*5*5-64), q.ghost_cells);
+  CHECK_CLOSE(61.0/64.0, q.ghost_ratio(), 1.0e-12);
+  CHECK_EQUAL(8*48, q.shared_faces);
+  CHECK_EQUAL(3*64, q.edge_cut());
+  CHECK_EQUAL(3, q.min_neighbors);
+  CHECK_EQUAL(3, q.max_neighbors);
+
+  // Cells of the first tile cost twice as much
+
+  std::vector<double> weights(512, 1.0);
+  for (auto const& c :
+           mesh->tiles()[0]->cells<Jali::Entity_type::PARALLEL_OWNED>())
+    weights[c] = 2.0;
+  q = mesh->tile_partition_quality(&weights);
+  CHECK_CLOSE(128.0, q.max_weight, 1.0e-12);
+  CHECK_CLOSE(64.0, q.min_weight, 1.0e-12);
+  CHECK_CLOSE(128.0/72.0, q.imbalance(), 1.0e-12);
+
+  // Merged over all ranks, every rank contributes its eight tiles
+
+  int nproc;
+  MPI_Comm_size(MPI_COMM_WORLD, &nproc);
+  Jali::PartitionQuality g =
+      Jali::global_partition_quality(q, MPI_COMM_WORLD);
+  CHECK_EQUAL(8*nproc, g.num_parts);
+  CHECK_EQUAL(512*nproc, g.total_cells);
+  CHECK_CLOSE(128.0/72.0, g.imbalance(), 1.0e-12);
+  CHECK_EQUAL(3*64*nproc, g.edge_cut());
+}
+
+
+TEST(RANK_PARTITION_QUALITY) {
+  int nproc;
+  MPI_Comm_size(MPI_COMM_WORLD, &nproc);
+
+  Jali::MeshFactory factory(MPI_COMM_WORLD);
+  factory.framework(Jali::Structured);
+  factory.included_entities({Jali::Entity_kind::FACE});
+  std::shared_ptr<Jali::Mesh> mesh =
+      factory(0.0, 0.0, 0.0, 1.0, 1.0, 1.0, 8, 8, 8);
+
+  Jali::PartitionQuality q = mesh->rank_partition_quality();
+  CHECK_EQUAL(1, q.num_parts);
+  CHECK_EQUAL(mesh->num_cells<Jali::Entity_type::PARALLEL_OWNED>(),
+              q.total_cells);
+  CHECK_EQUAL(mesh->num_cells<Jali::Entity_type::PARALLEL_GHOST>(),
+              q.ghost_cells);
+
+  Jali::PartitionQuality g = Jali::global_partition_quality(q, MPI_COMM_WORLD);
+  CHECK_EQUAL(nproc, g.num_parts);
+  CHECK_EQUAL(512, g.total_cells);
+  CHECK_EQUAL(0, g.shared_faces % 2);
+
+  if (nproc == 1) {
+    CHECK_EQUAL(0, g.shared_faces);
+    CHECK_EQUAL(0, g.max_neighbors);
+    CHECK_EQUAL(0, g.ghost_cells);
+  } else if (nproc == 4) {
+    // 2x2x1 columns of 4x4x8 cells, each sharing 32 faces with each
+    // of its two face neighbors and with a one cell ghost layer
+
+    CHECK_EQUAL(128, g.min_cells);
+    CHECK_EQUAL(128, g.max_cells);
+    CHECK_CLOSE(1.0, g.imbalance(), 1.0e-12);
+    CHECK_EQUAL(64, q.shared_faces);
+    CHECK_EQUAL(2*64, g.edge_cut());
+    CHECK_EQUAL(2, g.min_neighbors);
+    CHECK_EQUAL(2, g.max_neighbors);
+    CHECK_EQUAL(5*5*8-128, q.ghost_cells);
+  } else {
+    CHECK(g.min_neighbors >= 1);
+    CHECK(g.edge_cut() > 0);
+  }
+
+  // Weights of ranks add up
+
+  std::vector<double> weights(q.total_cells, 0.5);
+  g = Jali::global_partition_quality(mesh->rank_partition_quality(&weights),
+                                     MPI_COMM_WORLD);
+  CHECK_CLOSE(256.0, g.total_weight, 1.0e-12);
+}
+
+
+TEST(PARTITION_QUALITY_BAD_WEIGHTS) {
+  Jali::MeshFactory factory(MPI_COMM_WORLD);
+  factory.framework(Jali::Structured);
+  factory.num_tiles(2);
+  std::shared_ptr<Jali::Mesh> mesh = factory(0.0, 0.0, 1.0, 1.0, 4, 4);
+
+  // Need one weight per owned cell
+
+  std::vector<double> weights(mesh->num_cells(), 1.0);
+  weights.push_back(1.0);
+  CHECK_THROW(mesh->tile_partition_quality(&weights), std::exception);
+  CHECK_THROW(mesh->rank_partition_quality(&weights), std::exception);
+}
@@ -0,0 +1,256 @@
+/*
+ Copyright (c) 2019, Triad National Security, LLC
+ All rights reserved.
+
+ Copyright 2019. Triad National Security, LLC. This software was
+ produced under U.S. Government contract 89233218CNA000001 for Los
+ Alamos National Laboratory (LANL), which is operated by Triad
+ National Security, LLC for the U.S. Department of Energy. 
+ All rights in the program are reserved by Triad National Security,
+ LLC, and the U.S. Department of Energy/National Nuclear Security
+ Administration. The Government is granted for itself and others acting
+ on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+ in this material to reproduce, prepare derivative works, distribute
+ copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+
+ 
+ This is open source software distributed under the 3-clause BSD license.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of Triad National Security, LLC, Los Alamos
+    National Laboratory, LANL, the U.S. Government, nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ 
+ THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+ BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+// -------------------------------------------------------------
+/**
+ * @file   test_partitioners.cc
+ *
+ * @brief  Unit tests for the native space filling curve and recursive
+ *         coordinate bisection partitioners
+ */
+// -------------------------------------------------------------
+// -------------------------------------------------------------
+
+#include <UnitTest++.h>
+
+#include <mpi.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "Mesh.hh"
+#include "MeshTile.hh"
+#include "MeshFactory.hh"
+
+namespace {
+
+Jali::Partitioner_type const native_partitioners[3] =
+{Jali::Partitioner_type::SFC_HILBERT, Jali::Partitioner_type::SFC_MORTON,
+ Jali::Partitioner_type::RCB};
+
+// Every owned cell must be in exactly one part and each part must
+// list its cells in ascending order
+
+void check_cover(Jali::Mesh const& mesh,
+                 std::vector<std::vector<int>> const& partitions) {
+  int ncells = mesh.num_cells<Jali::Entity_type::PARALLEL_OWNED>();
+  std::vector<int> count(ncells, 0);
+  for (auto const& part : partitions) {
+    CHECK(std::is_sorted(part.begin(), part.end()));
+    for (auto const& c : part) {
+      CHECK(c >= 0 && c < ncells);
+      if (c >= 0 && c < ncells) count[c]++;
+    }
+  }
+  for (int c = 0; c < ncells; c++)
+    CHECK_EQUAL(1, count[c]);
+}
+
+// Number of owned cells whose centroids lie in the bounding box of the
+// centroids of a part; equal to the part size if the part is a box
+
+int cells_in_bounding_box(Jali::Mesh const& mesh,
+                          std::vector<int> const& part) {
+  int dim = mesh.space_dimension();
+  std::vector<double> lo(dim, 1e20), hi(dim, -1e20);
+  for (auto const& c : part) {
+    JaliGeometry::Point p = mesh.cell_centroid(c);
+    for (int d = 0; d < dim; d++) {
+      lo[d] = std::min(lo[d], p[d]);
+      hi[d] = std::max(hi[d], p[d]);
+    }
+  }
+  int n = 0;
+  for (auto const& c : mesh.cells<Jali::Entity_type::PARALLEL_OWNED>()) {
+    JaliGeometry::Point p = mesh.cell_centroid(c);
+    bool inside = true;
+    for (int d = 0; d < dim; d++)
+      inside = inside && p[d] >= lo[d] - 1e-12 && p[d] <= hi[d] + 1e-12;
+    if (inside) n++;
+  }
+  return n;
+}
+
+}  // namespace
+
+
+TEST(PARTITIONERS_BALANCE) {
+  Jali::MeshFactory factory(MPI_COMM_WORLD);
+  factory.framework(Jali::Structured);
+  factory.included_entities({Jali::Entity_kind::FACE});
+  std::shared_ptr<Jali::Mesh> mesh =
+      factory(0.0, 0.0, 0.0, 1.0, 1.0, 1.0, 16, 12, 10);
+  int ncells = mesh->num_cells<Jali::Entity_type::PARALLEL_OWNED>();
+
+  for (auto const& ptype : native_partitioners) {
+    for (int nparts : {1, 3, 8, 13}) {
+      std::vector<std::vector<int>> partitions;
+      mesh->get_partitioning(nparts, ptype, &partitions);
+      CHECK_EQUAL(nparts, partitions.size());
+      check_cover(*mesh, partitions);
+
+      // With unit weights the parts differ by at most a cell
+      int nmin = ncells, nmax = 0;
+      for (auto const& part : partitions) {
+        nmin = std::min(nmin, static_cast<int>(part.size()));
+        nmax = std::max(nmax, static_cast<int>(part.size()));
+      }
+      CHECK(nmax - nmin <= 1);
+    }
+  }
+}
+
+
+TEST(PARTITIONERS_COMPACT) {
+  // On a block of 2^k cells per axis every partitioner must cut eight
+  // parts that are boxes. Each rank makes its own mesh so that the
+  // block is the same on any number of ranks
+
+  Jali::MeshFactory factory(MPI_COMM_SELF);
+  factory.framework(Jali::Structured);
+  factory.included_entities({Jali::Entity_kind::FACE});
+  std::shared_ptr<Jali::Mesh> mesh =
+      factory(0.0, 0.0, 0.0, 1.0, 1.0, 1.0, 16, 16, 16);
+
+  for (auto const& ptype : native_partitioners) {
+    std::vector<std::vector<int>> partitions;
+    mesh->get_partitioning(8, ptype, &partitions);
+    check_cover(*mesh, partitions);
+    for (auto const& part : partitions)
+      CHECK_EQUAL(part.size(), cells_in_bounding_box(*mesh, part));
+  }
+
+  // Consecutive Hilbert parts are neighbouring octants, i.e. their
+  // first cells differ along one axis only; Morton parts need not be
+
+  std::vector<std::vector<int>> partitions;
+  mesh->get_partitioning(8, Jali::Partitioner_type::SFC_HILBERT, &partitions);
+  for (int p = 1; p < 8; p++) {
+    JaliGeometry::Point d = mesh->cell_centroid(partitions[p][0]) -
+        mesh->cell_centroid(partitions[p-1][0]);
+    int naxes = 0;
+    for (int i = 0; i < 3; i++)
+      if (std::fabs(d[i]) > 1e-12) naxes++;
+    CHECK_EQUAL(1, naxes);
+  }
+}
+
+
+TEST(PARTITIONERS_WEIGHTED) {
+  // Cells in the left quarter are four times as expensive
+
+  Jali::MeshFactory factory(MPI_COMM_WORLD);
+  factory.framework(Jali::Structured);
+  factory.included_entities({Jali::Entity_kind::FACE});
+  std::shared_ptr<Jali::Mesh> mesh = factory(0.0, 0.0, 1.0, 1.0, 40, 30);
+
+  int ncells = mesh->num_cells<Jali::Entity_type::PARALLEL_OWNED>();
+  std::vector<double> weights(ncells);
+  double total = 0.0;
+  for (int c = 0; c < ncells; c++) {
+    weights[c] = (mesh->cell_centroid(c)[0] < 0.25) ? 4.0 : 1.0;
+    total += weights[c];
+  }
+
+  int const nparts = 5;
+  for (auto const& ptype : native_partitioners) {
+    std::vector<std::vector<int>> partitions;
+    mesh->get_partitioning(nparts, ptype, &partitions, &weights);
+    check_cover(*mesh, partitions);
+    for (auto const& part : partitions) {
+      double w = 0.0;
+      for (auto const& c : part)
+        w += weights[c];
+      CHECK_CLOSE(total/nparts, w, 8.0);
+    }
+  }
+
+  // Need one weight per owned cell
+
+  std::vector<double> short_weights(ncells-1, 1.0);
+  std::vector<std::vector<int>> partitions;
+  CHECK_THROW(mesh->get_partitioning(nparts, Jali::Partitioner_type::RCB,
+                                     &partitions, &short_weights),
+              std::exception);
+}
+
+
+TEST(PARTITIONERS_TILES) {
+  // Tiles made with each native partitioner in 1, 2 and 3 dimensions
+
+  int nproc;
+  MPI_Comm_size(MPI_COMM_WORLD, &nproc);
+
+  for (auto const& ptype : native_partitioners) {
+    Jali::MeshFactory factory(MPI_COMM_WORLD);
+    factory.framework(Jali::Structured);
+    factory.included_entities({Jali::Entity_kind::FACE});
+    factory.partitioner(ptype);
+    factory.num_tiles(6);
+    factory.num_ghost_layers_tile(1);
+
+    std::vector<double> x(12*nproc+1);
+    for (int i = 0; i < x.size(); i++)
+      x[i] = i;
+
+    std::vector<std::shared_ptr<Jali::Mesh>> meshes =
+        {factory(x), factory(0.0, 0.0, 1.0, 1.0, 12, 12),
+         factory(0.0, 0.0, 0.0, 1.0, 1.0, 1.0, 8, 8, 8)};
+
+    for (auto const& mesh : meshes) {
+      CHECK_EQUAL(6, mesh->num_tiles());
+      int ncells = mesh->num_cells<Jali::Entity_type::PARALLEL_OWNED>();
+      std::vector<int> count(ncells, 0);
+      for (auto const& tile : mesh->tiles())
+        for (auto const& c : tile->cells<Jali::Entity_type::PARALLEL_OWNED>())
+          count[c]++;
+      for (int c = 0; c < ncells; c++)
+        CHECK_EQUAL(1, count[c]);
+    }
+  }
+}
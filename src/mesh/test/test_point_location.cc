@@ -0,0 +1,212 @@
+/*
+ Copyright (c) 2019, Triad National Security, LLC
+ All rights reserved.
+
+ Copyright 2019. Triad National Security, LLC. This software was
+ produced under U.S. Government contract 89233218CNA000001 for Los
+ Alamos National Laboratory (LANL), which is operated by Triad
+ National Security, LLC for the U.S. Department of Energy. 
+ All rights in the program are reserved by Triad National Security,
+ LLC, and the U.S. Department of Energy/National Nuclear Security
+ Administration. The Government is granted for itself and others acting
+ on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+ in this material to reproduce, prepare derivative works, distribute
+ copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+
+ 
+ This is open source software distributed under the 3-clause BSD license.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of Triad National Security, LLC, Los Alamos
+    National Laboratory, LANL, the U.S. Government, nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ 
+ THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+ BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+// -------------------------------------------------------------
+/**
+ * @file   test_point_location.cc
+ *
+ * @brief  Unit tests for locating points and boxes in meshes
+ */
+// -------------------------------------------------------------
+// -------------------------------------------------------------
+
+#include <UnitTest++.h>
+
+#include <mpi.h>
+#include <vector>
+
+#include "Mesh.hh"
+#include "MeshFactory.hh"
+#include "PointRegion.hh"
+#include "GeometricModel.hh"
+
+
+namespace {
+
+// Deterministic pseudo-random points in [lo, hi)^dim
+
+JaliGeometry::Point random_point(int dim, double lo, double hi,
+                                 unsigned *seed) {
+  JaliGeometry::Point p(dim);
+  for (int d = 0; d < dim; d++) {
+    *seed = 1664525u*(*seed) + 1013904223u;
+    p[d] = lo + (hi-lo)*((*seed >> 8)/16777216.0);
+  }
+  return p;
+}
+
+// Check the queries against brute force searches over all entities
+
+void check_queries(Jali::Mesh const& mesh, double lo, double hi) {
+  int dim = mesh.space_dimension();
+  int ncells = mesh.num_cells<Jali::Entity_type::ALL>();
+  int nnodes = mesh.num_nodes<Jali::Entity_type::ALL>();
+  unsigned seed = 12345;
+
+  for (int i = 0; i < 200; i++) {
+    JaliGeometry::Point p = random_point(dim, lo, hi, &seed);
+
+    int incell = -1;
+    for (int c = 0; c < ncells && incell < 0; c++)
+      if (mesh.point_in_cell(p, c)) incell = c;
+    CHECK_EQUAL(incell, mesh.locate_point(p));
+
+    double mind2 = 1.0e+300;
+    for (int n = 0; n < nnodes; n++) {
+      JaliGeometry::Point xyz;
+      mesh.node_get_coordinates(n, &xyz);
+      mind2 = std::min(mind2, L22(xyz-p));
+    }
+    JaliGeometry::Point xyz;
+    mesh.node_get_coordinates(mesh.nearest_node(p), &xyz);
+    CHECK_CLOSE(mind2, L22(xyz-p), 1.0e-14);
+
+    // Box around the point
+
+    JaliGeometry::Point q = random_point(dim, lo, hi, &seed);
+    JaliGeometry::Point blo(dim), bhi(dim);
+    for (int d = 0; d < dim; d++) {
+      blo[d] = std::min(p[d], q[d]);
+      bhi[d] = std::max(p[d], q[d]);
+    }
+    Jali::Entity_ID_List found, expected;
+    mesh.cells_intersecting_box(blo, bhi, &found);
+    for (int c = 0; c < ncells; c++) {
+      std::vector<JaliGeometry::Point> ccoords;
+      mesh.cell_get_coordinates(c, &ccoords);
+      bool overlap = true;
+      for (int d = 0; d < dim; d++) {
+        double cmin = ccoords[0][d], cmax = ccoords[0][d];
+        for (auto const& x : ccoords) {
+          cmin = std::min(cmin, x[d]);
+          cmax = std::max(cmax, x[d]);
+        }
+        if (cmax < blo[d] || bhi[d] < cmin) overlap = false;
+      }
+      if (overlap) expected.push_back(c);
+    }
+    CHECK(expected == found);
+  }
+}
+
+}  // namespace
+
+
+TEST(LOCATE_POINTS_3D) {
+  Jali::MeshFactory factory(MPI_COMM_WORLD);
+  factory.framework(Jali::Flat);
+  std::shared_ptr<Jali::Mesh> mesh =
+      factory(0.0, 0.0, 0.0, 1.0, 1.0, 1.0, 7, 6, 5);
+
+  check_queries(*mesh, -0.1, 1.1);
+
+  // Cell centroids are in their cells, points outside are in none
+
+  for (auto const& c : mesh->cells())
+    CHECK_EQUAL(c, mesh->locate_point(mesh->cell_centroid(c)));
+  CHECK_EQUAL(-1, mesh->locate_point(JaliGeometry::Point(2.0, 0.5, 0.5)));
+
+  // The indices follow the nodes when they move
+
+  for (auto const& n : mesh->nodes()) {
+    JaliGeometry::Point xyz;
+    mesh->node_get_coordinates(n, &xyz);
+    xyz[0] = 2.0*xyz[0] + 0.1*xyz[1]*xyz[1];
+    mesh->node_set_coordinates(n, xyz);
+  }
+  mesh->update_geometric_quantities();
+  check_queries(*mesh, -0.1, 2.2);
+}
+
+
+TEST(LOCATE_POINTS_2D) {
+  Jali::MeshFactory factory(MPI_COMM_WORLD);
+  factory.framework(Jali::Flat);
+  std::shared_ptr<Jali::Mesh> mesh = factory(0.0, 0.0, 2.0, 1.0, 9, 4);
+
+  check_queries(*mesh, -0.2, 2.2);
+  for (auto const& c : mesh->cells())
+    CHECK_EQUAL(c, mesh->locate_point(mesh->cell_centroid(c)));
+}
+
+
+TEST(POINT_REGION_SETS) {
+  // A point region at an interior node is in that node and the eight
+  // cells around it
+
+  JaliGeometry::PointRegion point("point", 1,
+                                  JaliGeometry::Point(0.5, 0.5, 0.5));
+  std::vector<JaliGeometry::RegionPtr> regions = {&point};
+  JaliGeometry::GeometricModel gm(3, regions);
+
+  Jali::MeshFactory factory(MPI_COMM_WORLD);
+  factory.framework(Jali::Flat);
+  factory.geometric_model(&gm);
+  std::shared_ptr<Jali::Mesh> mesh =
+      factory(0.0, 0.0, 0.0, 1.0, 1.0, 1.0, 4, 4, 4);
+  mesh->init_sets_from_geometric_model({{"point", {Jali::Entity_kind::CELL,
+                                                   Jali::Entity_kind::NODE}}});
+
+  Jali::Entity_ID_List nodes, cells;
+  mesh->get_set_entities("point", Jali::Entity_kind::NODE,
+                         Jali::Entity_type::PARALLEL_OWNED, &nodes);
+  mesh->get_set_entities("point", Jali::Entity_kind::CELL,
+                         Jali::Entity_type::PARALLEL_OWNED, &cells);
+  for (auto const& n : nodes) {
+    JaliGeometry::Point xyz;
+    mesh->node_get_coordinates(n, &xyz);
+    CHECK_CLOSE(0.0, L22(xyz - point.point()), 1.0e-24);
+  }
+  for (auto const& c : cells)
+    CHECK(mesh->point_in_cell(point.point(), c));
+
+  int counts[2] = {static_cast<int>(nodes.size()),
+                   static_cast<int>(cells.size())}, total[2];
+  MPI_Allreduce(counts, total, 2, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+  CHECK_EQUAL(1, total[0]);
+  CHECK_EQUAL(8, total[1]);
+}
@@ -0,0 +1,299 @@
+/*
+ Copyright (c) 2019, Triad National Security, LLC
+ All rights reserved.
+
+ Copyright 2019. Triad National Security, LLC. This software was
+ produced under U.S. Government contract 89233218CNA000001 for Los
+ Alamos National Laboratory (LANL), which is operated by Triad
+ National Security, LLC for the U.S. Department of Energy. 
+ All rights in the program are reserved by Triad National Security,
+ LLC, and the U.S. Department of Energy/National Nuclear Security
+ Administration. The Government is granted for itself and others acting
+ on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+ in this material to reproduce, prepare derivative works, distribute
+ copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+
+ 
+ This is open source software distributed under the 3-clause BSD license.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of Triad National Security, LLC, Los Alamos
+    National Laboratory, LANL, the U.S. Government, nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ 
+ THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+ BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+// -------------------------------------------------------------
+/**
+ * @file   test_redistribute.cc
+ *
+ * @brief  Unit tests for redistributing meshes and moving data
+ */
+// -------------------------------------------------------------
+// -------------------------------------------------------------
+
+#include <UnitTest++.h>
+
+#include <mpi.h>
+#include <vector>
+
+#include "Mesh.hh"
+#include "MeshFactory.hh"
+#include "MeshMigration.hh"
+#include "MeshSet.hh"
+#include "MeshPartitionQuality.hh"
+#include "Mesh_flat.hh"
+
+
+namespace {
+
+// Move a point per entity from one mesh to the other
+
+std::vector<JaliGeometry::Point>
+move_points(Jali::EntityTransfer const& transfer,
+            std::vector<JaliGeometry::Point> const& points, int dim) {
+  std::vector<double> xyz(dim*points.size()), newxyz;
+  for (int i = 0; i < static_cast<int>(points.size()); i++)
+    for (int d = 0; d < dim; d++)
+      xyz[dim*i+d] = points[i][d];
+  newxyz.resize(dim*transfer.num_destinations());
+  transfer.move(xyz.data(), newxyz.data(), dim*sizeof(double));
+
+  std::vector<JaliGeometry::Point> newpoints(transfer.num_destinations(),
+                                             JaliGeometry::Point(dim));
+  for (int i = 0; i < transfer.num_destinations(); i++)
+    newpoints[i].set(dim, &(newxyz[dim*i]));
+  return newpoints;
+}
+
+int global_sum(int n) {
+  int sum = 0;
+  MPI_Allreduce(&n, &sum, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+  return sum;
+}
+
+}  // namespace
+
+
+TEST(REDISTRIBUTE_MESH) {
+  int nproc;
+  MPI_Comm_size(MPI_COMM_WORLD, &nproc);
+
+  Jali::MeshFactory factory(MPI_COMM_WORLD);
+  factory.framework(Jali::Flat);
+  factory.included_entities({Jali::Entity_kind::FACE,
+                             Jali::Entity_kind::EDGE});
+  std::shared_ptr<Jali::Mesh> mesh =
+      factory(0.0, 0.0, 0.0, 1.0, 1.0, 1.0, 8, 8, 8);
+
+  // A cell set to carry over and the cells of the first rank costing
+  // ten times as much as the others
+
+  int nowned = mesh->num_cells<Jali::Entity_type::PARALLEL_OWNED>();
+  Jali::Entity_ID_List setowned, setghost;
+  for (auto const& c : mesh->cells()) {
+    if (mesh->GID(c, Jali::Entity_kind::CELL) % 3) continue;
+    if (c < nowned)
+      setowned.push_back(c);
+    else
+      setghost.push_back(c);
+  }
+  Jali::make_meshset("every_third", *mesh, Jali::Entity_kind::CELL,
+                     setowned, setghost);
+
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  std::vector<double> weights(nowned, rank ? 1.0 : 10.0);
+
+  std::shared_ptr<Jali::Mesh> newmesh = factory.redistribute(*mesh,
+                                                             &weights);
+  CHECK_EQUAL(3, newmesh->space_dimension());
+  CHECK_EQUAL(512, global_sum(newmesh->num_cells<
+                              Jali::Entity_type::PARALLEL_OWNED>()));
+  CHECK_EQUAL(global_sum(mesh->num_faces<Jali::Entity_type::PARALLEL_OWNED>()),
+              global_sum(newmesh->num_faces<
+                         Jali::Entity_type::PARALLEL_OWNED>()));
+  CHECK_EQUAL(global_sum(mesh->num_edges<Jali::Entity_type::PARALLEL_OWNED>()),
+              global_sum(newmesh->num_edges<
+                         Jali::Entity_type::PARALLEL_OWNED>()));
+  CHECK_EQUAL(global_sum(mesh->num_nodes<Jali::Entity_type::PARALLEL_OWNED>()),
+              global_sum(newmesh->num_nodes<
+                         Jali::Entity_type::PARALLEL_OWNED>()));
+
+  // The new mesh knows which rank owns each of its ghost nodes
+
+  auto flatmesh = std::dynamic_pointer_cast<Jali::Mesh_flat>(newmesh);
+  CHECK(flatmesh != nullptr);
+  if (flatmesh) {
+    std::vector<int> owner(global_sum(newmesh->num_nodes<
+                                      Jali::Entity_type::PARALLEL_OWNED>()),
+                           0);
+    std::vector<int> gowner(owner.size());
+    for (auto const& n : newmesh->nodes<Jali::Entity_type::PARALLEL_OWNED>())
+      owner[newmesh->GID(n, Jali::Entity_kind::NODE)] = rank;
+    MPI_Allreduce(owner.data(), gowner.data(), owner.size(), MPI_INT, MPI_SUM,
+                  MPI_COMM_WORLD);
+    for (auto const& n : newmesh->nodes())
+      CHECK_EQUAL(gowner[newmesh->GID(n, Jali::Entity_kind::NODE)],
+                  flatmesh->entity_owner(n, Jali::Entity_kind::NODE));
+  }
+
+  // Geometry moved over by global ID matches the new mesh, ghosts
+  // included
+
+  std::vector<JaliGeometry::Point> centroids, normals, coords;
+  for (auto const& c : mesh->cells())
+    centroids.push_back(mesh->cell_centroid(c));
+  for (auto const& f : mesh->faces())
+    normals.push_back(mesh->face_normal(f));
+  for (auto const& n : mesh->nodes()) {
+    JaliGeometry::Point xyz;
+    mesh->node_get_coordinates(n, &xyz);
+    coords.push_back(xyz);
+  }
+
+  Jali::EntityTransfer celltransfer(*mesh, *newmesh, Jali::Entity_kind::CELL);
+  CHECK_EQUAL(0, celltransfer.num_missing());
+  std::vector<JaliGeometry::Point> newcentroids =
+      move_points(celltransfer, centroids, 3);
+  for (auto const& c : newmesh->cells())
+    for (int d = 0; d < 3; d++)
+      CHECK_CLOSE(newmesh->cell_centroid(c)[d], newcentroids[c][d], 1.0e-12);
+
+  Jali::EntityTransfer facetransfer(*mesh, *newmesh, Jali::Entity_kind::FACE);
+  CHECK_EQUAL(0, facetransfer.num_missing());
+  std::vector<JaliGeometry::Point> newnormals =
+      move_points(facetransfer, normals, 3);
+  for (auto const& f : newmesh->faces())
+    for (int d = 0; d < 3; d++)
+      CHECK_CLOSE(newmesh->face_normal(f)[d], newnormals[f][d], 1.0e-12);
+
+  Jali::EntityTransfer nodetransfer(*mesh, *newmesh, Jali::Entity_kind::NODE);
+  CHECK_EQUAL(0, nodetransfer.num_missing());
+  std::vector<JaliGeometry::Point> newcoords =
+      move_points(nodetransfer, coords, 3);
+  for (auto const& n : newmesh->nodes()) {
+    JaliGeometry::Point xyz;
+    newmesh->node_get_coordinates(n, &xyz);
+    for (int d = 0; d < 3; d++)
+      CHECK_CLOSE(xyz[d], newcoords[n][d], 1.0e-12);
+  }
+
+  // Faces of every cell still enclose it
+
+  for (auto const& c : newmesh->cells<Jali::Entity_type::PARALLEL_OWNED>()) {
+    Jali::Entity_ID_List cfaces;
+    std::vector<Jali::dir_t> cfdirs;
+    newmesh->cell_get_faces_and_dirs(c, &cfaces, &cfdirs);
+    CHECK_EQUAL(6, cfaces.size());
+    JaliGeometry::Point sum(3);
+    for (int i = 0; i < static_cast<int>(cfaces.size()); i++)
+      sum += cfdirs[i]*newmesh->face_normal(cfaces[i]);
+    CHECK_CLOSE(0.0, L22(sum), 1.0e-20);
+  }
+
+  // The set holds the same cells
+
+  std::shared_ptr<Jali::MeshSet> set =
+      newmesh->find_meshset("every_third", Jali::Entity_kind::CELL);
+  CHECK(set != nullptr);
+  if (set) {
+    for (auto const& c : set->entities())
+      CHECK_EQUAL(0, newmesh->GID(c, Jali::Entity_kind::CELL) % 3);
+    CHECK_EQUAL(global_sum(setowned.size()),
+                global_sum(set->entities<
+                           Jali::Entity_type::PARALLEL_OWNED>().size()));
+  }
+
+  // Weights moved along are balanced on the new mesh
+
+  int newowned = newmesh->num_cells<Jali::Entity_type::PARALLEL_OWNED>();
+  Jali::EntityTransfer weighttransfer(*mesh, *newmesh,
+                                      Jali::Entity_kind::CELL,
+                                      Jali::Entity_type::PARALLEL_OWNED);
+  std::vector<double> newweights;
+  weighttransfer.move(weights, &newweights);
+  CHECK_EQUAL(newowned, newweights.size());
+
+  Jali::PartitionQuality before =
+      Jali::global_partition_quality(mesh->rank_partition_quality(&weights),
+                                     MPI_COMM_WORLD);
+  Jali::PartitionQuality after =
+      Jali::global_partition_quality(newmesh->rank_partition_quality(
+          &newweights), MPI_COMM_WORLD);
+  CHECK_CLOSE(before.total_weight, after.total_weight, 1.0e-9);
+  CHECK(after.imbalance() < 1.05);
+  if (nproc > 1)
+    CHECK(after.imbalance() < before.imbalance());
+}
+
+
+TEST(REDISTRIBUTE_MESH_2D_GHOST_LAYERS) {
+  // Two layers of ghost cells, tiles rebuilt on the new mesh
+
+  Jali::MeshFactory factory(MPI_COMM_WORLD);
+  factory.framework(Jali::Flat);
+  factory.included_entities({Jali::Entity_kind::FACE,
+                             Jali::Entity_kind::EDGE});
+  factory.num_ghost_layers_distmesh(2);
+  std::shared_ptr<Jali::Mesh> mesh = factory(0.0, 0.0, 1.0, 1.0, 12, 12);
+
+  factory.num_tiles(2);
+  std::shared_ptr<Jali::Mesh> newmesh = factory.redistribute(*mesh);
+  CHECK_EQUAL(144, global_sum(newmesh->num_cells<
+                              Jali::Entity_type::PARALLEL_OWNED>()));
+  CHECK_EQUAL(2, newmesh->num_tiles());
+
+  std::vector<JaliGeometry::Point> centroids;
+  for (auto const& c : mesh->cells())
+    centroids.push_back(mesh->cell_centroid(c));
+  Jali::EntityTransfer transfer(*mesh, *newmesh, Jali::Entity_kind::CELL);
+  CHECK_EQUAL(0, transfer.num_missing());
+  std::vector<JaliGeometry::Point> newcentroids =
+      move_points(transfer, centroids, 2);
+  for (auto const& c : newmesh->cells())
+    for (int d = 0; d < 2; d++)
+      CHECK_CLOSE(newmesh->cell_centroid(c)[d], newcentroids[c][d], 1.0e-12);
+
+  // Every owned cell has its complete node neighborhood, two layers
+  // deep through the neighbors
+
+  for (auto const& c : newmesh->cells<Jali::Entity_type::PARALLEL_OWNED>()) {
+    Jali::Entity_ID_List adj;
+    newmesh->cell_get_node_adj_cells(c, Jali::Entity_type::ALL, &adj);
+    JaliGeometry::Point x = newmesh->cell_centroid(c);
+    int nx = (x[0] > 0.05 && x[0] < 0.95) ? 3 : 2;
+    int ny = (x[1] > 0.05 && x[1] < 0.95) ? 3 : 2;
+    CHECK_EQUAL(nx*ny-1, adj.size());
+  }
+
+  // Input mesh with fewer ghost layers than wanted
+
+  factory.num_ghost_layers_distmesh(3);
+  int nproc;
+  MPI_Comm_size(MPI_COMM_WORLD, &nproc);
+  if (nproc > 1)
+    CHECK_THROW(factory.redistribute(*mesh), std::exception);
+}
@@ -0,0 +1,470 @@
+/*
+ Copyright (c) 2019, Triad National Security, LLC
+ All rights reserved.
+
+ Copyright 2019. Triad National Security, LLC. This software was
+ produced under U.S. Government contract 89233218CNA000001 for Los
+ Alamos National Laboratory (LANL), which is operated by Triad
+ National Security, LLC for the U.S. Department of Energy. 
+ All rights in the program are reserved by Triad National Security,
+ LLC, and the U.S. Department of Energy/National Nuclear Security
+ Administration. The Government is granted for itself and others acting
+ on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+ in this material to reproduce, prepare derivative works, distribute
+ copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+
+ 
+ This is open source software distributed under the 3-clause BSD license.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of Triad National Security, LLC, Los Alamos
+    National Laboratory, LANL, the U.S. Government, nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ 
+ THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+ BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+// -------------------------------------------------------------
+/**
+ * @file   test_region_sets.cc
+ *
+ * @brief  Unit tests for building mesh sets from geometric regions
+ */
+// -------------------------------------------------------------
+// -------------------------------------------------------------
+
+#include <UnitTest++.h>
+
+#include <mpi.h>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Mesh.hh"
+#include "MeshFactory.hh"
+#include "BoxRegion.hh"
+#include "PlaneRegion.hh"
+#include "PolygonRegion.hh"
+#include "LogicalRegion.hh"
+#include "GeometricModel.hh"
+
+
+namespace {
+
+// Entities of 'kind' in the region by testing every one of them -
+// centroids for boxes, all the nodes otherwise
+
+Jali::Entity_ID_List expected_entities(Jali::Mesh const& mesh,
+                                       JaliGeometry::RegionPtr region,
+                                       Jali::Entity_kind kind) {
+  bool box = (region->type() == JaliGeometry::Region_type::BOX);
+  Jali::Entity_ID_List entities;
+  int nents = mesh.num_entities(kind, Jali::Entity_type::ALL);
+  for (int i = 0; i < nents; i++) {
+    if (mesh.entity_get_type(kind, i) != Jali::Entity_type::PARALLEL_OWNED &&
+        mesh.entity_get_type(kind, i) != Jali::Entity_type::PARALLEL_GHOST)
+      continue;
+
+    std::vector<JaliGeometry::Point> points(1);
+    if (kind == Jali::Entity_kind::NODE)
+      mesh.node_get_coordinates(i, &points[0]);
+    else if (box && kind == Jali::Entity_kind::CELL)
+      points[0] = mesh.cell_centroid(i);
+    else if (box)
+      points[0] = mesh.face_centroid(i);
+    else if (kind == Jali::Entity_kind::CELL)
+      mesh.cell_get_coordinates(i, &points);
+    else
+      mesh.face_get_coordinates(i, &points);
+
+    bool inside = true;
+    for (auto const& p : points)
+      inside = inside && region->inside(p);
+    if (inside) entities.push_back(i);
+  }
+  return entities;
+}
+
+void check_set(Jali::Mesh *mesh, JaliGeometry::RegionPtr region,
+               Jali::Entity_kind kind) {
+  Jali::Entity_ID_List entities;
+  mesh->get_set_entities(region->name(), kind, Jali::Entity_type::ALL,
+                         &entities);
+  std::sort(entities.begin(), entities.end());
+  CHECK(expected_entities(*mesh, region, kind) == entities);
+}
+
+}  // namespace
+
+
+TEST(REGION_SETS_3D) {
+  JaliGeometry::BoxRegion box("box", 1, JaliGeometry::Point(0.2, 0.3, 0.1),
+                              JaliGeometry::Point(0.7, 0.8, 0.55));
+  JaliGeometry::BoxRegion side("side", 2, JaliGeometry::Point(0.0, 0.0, 0.0),
+                               JaliGeometry::Point(0.0, 1.0, 1.0));
+  JaliGeometry::PlaneRegion plane("plane", 3,
+                                  JaliGeometry::Point(0.5, 0.0, 0.0),
+                                  JaliGeometry::Point(1.0, 0.0, 0.0));
+  std::vector<JaliGeometry::Point> corners = {
+    JaliGeometry::Point(0.0, 0.0, 1.0), JaliGeometry::Point(0.5, 0.0, 1.0),
+    JaliGeometry::Point(0.5, 0.5, 1.0), JaliGeometry::Point(0.0, 0.5, 1.0)};
+  JaliGeometry::PolygonRegion square("square", 4, 4, corners);
+  std::vector<JaliGeometry::RegionPtr> regions = {&box, &side, &plane,
+                                                  &square};
+  JaliGeometry::GeometricModel gm(3, regions);
+
+  Jali::MeshFactory factory(MPI_COMM_WORLD);
+  factory.framework(Jali::Flat);
+  factory.geometric_model(&gm);
+  std::shared_ptr<Jali::Mesh> mesh =
+      factory(0.0, 0.0, 0.0, 1.0, 1.0, 1.0, 6, 6, 6);
+
+  std::vector<Jali::Entity_kind> kinds = {Jali::Entity_kind::CELL,
+                                          Jali::Entity_kind::FACE,
+                                          Jali::Entity_kind::NODE};
+  mesh->init_sets_from_geometric_model(
+      {{"box", kinds}, {"side", kinds},
+       {"square", {Jali::Entity_kind::FACE, Jali::Entity_kind::NODE}}});
+
+  for (auto const& kind : kinds)
+    check_set(mesh.get(), &box, kind);
+  for (auto const& kind : kinds)
+    check_set(mesh.get(), &side, kind);
+  for (auto const& region : {regions[2], regions[3]}) {
+    check_set(mesh.get(), region, Jali::Entity_kind::FACE);
+    check_set(mesh.get(), region, Jali::Entity_kind::NODE);
+  }
+
+  // The plane at x = 0.5 cuts through 6x6 faces and 7x7 nodes
+
+  int counts[2] = {
+    static_cast<int>(mesh->get_set_size("plane", Jali::Entity_kind::FACE,
+                                        Jali::Entity_type::PARALLEL_OWNED)),
+    static_cast<int>(mesh->get_set_size("plane", Jali::Entity_kind::NODE,
+                                        Jali::Entity_type::PARALLEL_OWNED))};
+  int total[2];
+  MPI_Allreduce(counts, total, 2, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+  CHECK_EQUAL(36, total[0]);
+  CHECK_EQUAL(49, total[1]);
+}
+
+
+TEST(REGION_SETS_2D) {
+  JaliGeometry::BoxRegion box("box", 1, JaliGeometry::Point(0.25, 0.1),
+                              JaliGeometry::Point(0.6, 0.9));
+  JaliGeometry::PlaneRegion line("line", 2, JaliGeometry::Point(0.0, 0.5),
+                                 JaliGeometry::Point(0.0, 1.0));
+  std::vector<JaliGeometry::RegionPtr> regions = {&box, &line};
+  JaliGeometry::GeometricModel gm(2, regions);
+
+  Jali::MeshFactory factory(MPI_COMM_WORLD);
+  factory.framework(Jali::Flat);
+  factory.geometric_model(&gm);
+  std::shared_ptr<Jali::Mesh> mesh = factory(0.0, 0.0, 1.0, 1.0, 8, 8);
+
+  std::vector<Jali::Entity_kind> kinds = {Jali::Entity_kind::CELL,
+                                          Jali::Entity_kind::FACE,
+                                          Jali::Entity_kind::NODE};
+  mesh->init_sets_from_geometric_model({{"box", kinds}, {"line", kinds}});
+
+  for (auto const& kind : kinds) {
+    check_set(mesh.get(), &box, kind);
+    check_set(mesh.get(), &line, kind);
+  }
+}
+
+
+TEST(MANY_REGION_SETS) {
+  // Build the sets on many boxes (and a union of two of them) in one
+  // call
+
+  int const nboxes = 40;
+  std::vector<std::unique_ptr<JaliGeometry::BoxRegion>> boxes;
+  std::vector<JaliGeometry::RegionPtr> regions;
+  std::vector<std::string> names;
+  unsigned seed = 4321;
+  for (int i = 0; i < nboxes; i++) {
+    double x[6];
+    for (int j = 0; j < 6; j++) {
+      seed = 1664525u*seed + 1013904223u;
+      x[j] = (seed >> 8)/16777216.0;
+    }
+    names.push_back("box" + std::to_string(i));
+    boxes.emplace_back(new JaliGeometry::BoxRegion(
+        names.back(), i+1, JaliGeometry::Point(x[0], x[1], x[2]),
+        JaliGeometry::Point(x[3], x[4], x[5])));
+    regions.push_back(boxes.back().get());
+  }
+  JaliGeometry::LogicalRegion both("both", nboxes+1, "Union",
+                                   {"box0", "box1"});
+  regions.push_back(&both);
+  JaliGeometry::GeometricModel gm(3, regions);
+
+  Jali::MeshFactory factory(MPI_COMM_WORLD);
+  factory.framework(Jali::Flat);
+  factory.geometric_model(&gm);
+  std::shared_ptr<Jali::Mesh> mesh =
+      factory(0.0, 0.0, 0.0, 1.0, 1.0, 1.0, 5, 6, 7);
+
+  std::vector<std::string> setnames = {"both"};
+  setnames.insert(setnames.end(), names.begin(), names.end());
+  setnames.push_back("box3");
+
+  for (auto const& kind : {Jali::Entity_kind::CELL,
+                           Jali::Entity_kind::NODE}) {
+    std::vector<std::shared_ptr<Jali::MeshSet>> sets =
+        mesh->build_sets_from_regions(setnames, kind);
+    CHECK_EQUAL(setnames.size(), sets.size());
+    for (int i = 0; i < nboxes; i++) {
+      CHECK(sets[i+1] == mesh->find_meshset(names[i], kind));
+      check_set(mesh.get(), boxes[i].get(), kind);
+    }
+    CHECK(sets.back() == sets[4]);
+
+    Jali::Entity_ID_List entities, expected;
+    mesh->get_set_entities("both", kind, Jali::Entity_type::ALL, &entities);
+    std::sort(entities.begin(), entities.end());
+    for (int i = 0; i < 2; i++) {
+      Jali::Entity_ID_List ents = expected_entities(*mesh, boxes[i].get(),
+                                                    kind);
+      expected.insert(expected.end(), ents.begin(), ents.end());
+    }
+    std::sort(expected.begin(), expected.end());
+    expected.erase(std::unique(expected.begin(), expected.end()),
+                   expected.end());
+    CHECK(expected == entities);
+
+    // Sets already on the mesh are returned as they are
+
+    CHECK(sets == mesh->build_sets_from_regions(setnames, kind));
+  }
+}
+
+
+TEST(LAZY_REGION_SETS) {
+  JaliGeometry::BoxRegion lower("lower", 1, JaliGeometry::Point(0.0, 0.0, 0.0),
+                                JaliGeometry::Point(1.0, 1.0, 0.5));
+  JaliGeometry::BoxRegion left("left", 2, JaliGeometry::Point(0.0, 0.0, 0.0),
+                               JaliGeometry::Point(0.5, 1.0, 1.0));
+  JaliGeometry::BoxRegion front("front", 3, JaliGeometry::Point(0.0, 0.0, 0.0),
+                                JaliGeometry::Point(1.0, 0.5, 1.0));
+  JaliGeometry::LogicalRegion corner("corner", 4, "Intersect",
+                                     {"lower", "left"});
+  std::vector<JaliGeometry::RegionPtr> regions = {&lower, &left, &front,
+                                                  &corner};
+  JaliGeometry::GeometricModel gm(3, regions);
+
+  Jali::MeshFactory factory(MPI_COMM_WORLD);
+  factory.framework(Jali::Flat);
+  factory.geometric_model(&gm);
+  std::shared_ptr<Jali::Mesh> mesh =
+      factory(0.0, 0.0, 0.0, 1.0, 1.0, 1.0, 4, 4, 4);
+
+  mesh->register_sets_from_geometric_model();
+  CHECK_EQUAL(0, mesh->num_sets());
+
+  // The first query builds the set and the sets it is made of
+
+  int ncorner = mesh->get_set_size("corner", Jali::Entity_kind::CELL,
+                                   Jali::Entity_type::PARALLEL_OWNED);
+  CHECK_EQUAL(3, mesh->num_sets());
+  int total;
+  MPI_Allreduce(&ncorner, &total, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+  CHECK_EQUAL(16, total);
+
+  // Concurrent first queries all get the same set
+
+  std::vector<std::shared_ptr<Jali::MeshSet>> found(4);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++)
+    threads.emplace_back([&, t]() {
+        found[t] = mesh->find_meshset("front", Jali::Entity_kind::NODE);
+      });
+  for (auto& thread : threads)
+    thread.join();
+  CHECK(found[0] != nullptr);
+  for (int t = 1; t < 4; t++)
+    CHECK(found[t] == found[0]);
+  check_set(mesh.get(), &front, Jali::Entity_kind::NODE);
+
+  // Prefetching builds whatever was not queried
+
+  mesh->prefetch_sets({"lower", "left"}, Jali::Entity_kind::FACE);
+  int nsets = mesh->num_sets();
+  mesh->prefetch_sets();
+  CHECK(mesh->num_sets() > nsets);
+  nsets = mesh->num_sets();
+  for (auto const& region : regions) {
+    if (region == &corner) continue;
+    for (auto const& kind : {Jali::Entity_kind::CELL,
+                             Jali::Entity_kind::FACE,
+                             Jali::Entity_kind::NODE})
+      check_set(mesh.get(), region, kind);
+  }
+  CHECK_EQUAL(nsets, mesh->num_sets());
+  CHECK(mesh->find_meshset("nowhere", Jali::Entity_kind::CELL) == nullptr);
+}
+
+
+TEST(LAZY_SETS_WITH_POINT_QUERIES) {
+  // Sets built on first query (which builds the spatial indices under
+  // the lock on the sets) while other threads locate points and list
+  // the sets without taking that lock
+
+  JaliGeometry::BoxRegion lower("lower", 1, JaliGeometry::Point(0.0, 0.0, 0.0),
+                                JaliGeometry::Point(1.0, 1.0, 0.5));
+  JaliGeometry::BoxRegion left("left", 2, JaliGeometry::Point(0.0, 0.0, 0.0),
+                               JaliGeometry::Point(0.5, 1.0, 1.0));
+  std::vector<JaliGeometry::RegionPtr> regions = {&lower, &left};
+  JaliGeometry::GeometricModel gm(3, regions);
+
+  Jali::MeshFactory factory(MPI_COMM_WORLD);
+  factory.framework(Jali::Flat);
+  factory.geometric_model(&gm);
+  std::shared_ptr<Jali::Mesh> mesh =
+      factory(0.0, 0.0, 0.0, 1.0, 1.0, 1.0, 6, 6, 6);
+  std::shared_ptr<Jali::Mesh> refmesh =
+      factory(0.0, 0.0, 0.0, 1.0, 1.0, 1.0, 6, 6, 6);
+  mesh->register_sets_from_geometric_model();
+
+  std::vector<JaliGeometry::Point> points;
+  for (int i = 0; i < 5; i++)
+    for (int j = 0; j < 5; j++)
+      points.emplace_back(0.1 + 0.2*i, 0.1 + 0.2*j, 0.55);
+  std::vector<Jali::Entity_ID> refcells, refnodes;
+  for (auto const& p : points) {
+    refcells.push_back(refmesh->locate_point(p));
+    refnodes.push_back(refmesh->nearest_node(p));
+  }
+
+  int const nthreads = 6;
+  std::vector<std::vector<Jali::Entity_ID>> cells(nthreads), nodes(nthreads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < nthreads; t++)
+    threads.emplace_back([&, t]() {
+        if (t % 2) {
+          mesh->find_meshset(t % 4 == 1 ? "lower" : "left",
+                             Jali::Entity_kind::NODE);
+          mesh->find_meshset("lower", Jali::Entity_kind::CELL);
+        }
+        for (auto const& p : points) {
+          cells[t].push_back(mesh->locate_point(p));
+          nodes[t].push_back(mesh->nearest_node(p));
+          for (auto const& set : mesh->sets())
+            CHECK(set != nullptr);
+        }
+      });
+  for (auto& thread : threads)
+    thread.join();
+
+  for (int t = 0; t < nthreads; t++) {
+    CHECK(cells[t] == refcells);
+    CHECK(nodes[t] == refnodes);
+  }
+  check_set(mesh.get(), &lower, Jali::Entity_kind::NODE);
+  check_set(mesh.get(), &left, Jali::Entity_kind::NODE);
+  check_set(mesh.get(), &lower, Jali::Entity_kind::CELL);
+}
+
+
+TEST(LOGICAL_REGION_SETS) {
+  // Boolean expressions sharing components - "ba" is the same
+  // expression as "ab" and "inner" is only used in building "deep"
+
+  JaliGeometry::BoxRegion a("a", 1, JaliGeometry::Point(0.0, 0.0, 0.0),
+                            JaliGeometry::Point(0.6, 0.6, 1.0));
+  JaliGeometry::BoxRegion b("b", 2, JaliGeometry::Point(0.4, 0.4, 0.0),
+                            JaliGeometry::Point(1.0, 1.0, 1.0));
+  JaliGeometry::BoxRegion c("c", 3, JaliGeometry::Point(0.0, 0.0, 0.0),
+                            JaliGeometry::Point(1.0, 1.0, 0.5));
+  JaliGeometry::LogicalRegion ab("ab", 4, "Union", {"a", "b"});
+  JaliGeometry::LogicalRegion ba("ba", 5, "Union", {"b", "a", "b"});
+  JaliGeometry::LogicalRegion abc("abc", 6, "Intersect", {"ab", "c"});
+  JaliGeometry::LogicalRegion notab("notab", 7, "Complement", {"ba"});
+  JaliGeometry::LogicalRegion inner("inner", 8, "Subtract", {"c", "a"},
+                                    JaliGeometry::LifeCycle_type::TEMPORARY);
+  JaliGeometry::LogicalRegion deep("deep", 9, "Union", {"abc", "inner"});
+  std::vector<JaliGeometry::RegionPtr> regions = {&a, &b, &c, &ab, &ba, &abc,
+                                                  &notab, &inner, &deep};
+  JaliGeometry::GeometricModel gm(3, regions);
+
+  Jali::MeshFactory factory(MPI_COMM_WORLD);
+  factory.framework(Jali::Flat);
+  factory.geometric_model(&gm);
+  std::shared_ptr<Jali::Mesh> mesh =
+      factory(0.0, 0.0, 0.0, 1.0, 1.0, 1.0, 5, 5, 4);
+
+  std::vector<Jali::Entity_kind> kinds = {Jali::Entity_kind::CELL,
+                                          Jali::Entity_kind::NODE};
+  std::map<std::string, std::vector<Jali::Entity_kind>> kindmap;
+  for (auto const& region : regions)
+    if (region != &inner) kindmap[region->name()] = kinds;
+  mesh->init_sets_from_geometric_model(kindmap);
+
+  for (auto const& kind : kinds) {
+    int nents = mesh->num_entities(kind, Jali::Entity_type::ALL);
+    std::vector<int> in_a(nents), in_b(nents), in_c(nents);
+    for (auto const& e : expected_entities(*mesh, &a, kind)) in_a[e] = 1;
+    for (auto const& e : expected_entities(*mesh, &b, kind)) in_b[e] = 1;
+    for (auto const& e : expected_entities(*mesh, &c, kind)) in_c[e] = 1;
+
+    Jali::Entity_ID_List expected[5];
+    for (int i = 0; i < nents; i++) {
+      Jali::Entity_type type = mesh->entity_get_type(kind, i);
+      if (type != Jali::Entity_type::PARALLEL_OWNED &&
+          type != Jali::Entity_type::PARALLEL_GHOST)
+        continue;
+      bool in_ab = in_a[i] || in_b[i];
+      bool in_abc = in_ab && in_c[i];
+      if (in_ab) expected[0].push_back(i);
+      if (in_ab) expected[1].push_back(i);
+      if (in_abc) expected[2].push_back(i);
+      if (!in_ab) expected[3].push_back(i);
+      if (in_abc || (in_c[i] && !in_a[i])) expected[4].push_back(i);
+    }
+
+    std::string names[5] = {"ab", "ba", "abc", "notab", "deep"};
+    for (int k = 0; k < 5; k++) {
+      Jali::Entity_ID_List entities;
+      mesh->get_set_entities(names[k], kind, Jali::Entity_type::ALL,
+                             &entities);
+      std::sort(entities.begin(), entities.end());
+      CHECK(expected[k] == entities);
+    }
+
+    // The temporary region is not kept but a set on it can be asked for
+
+    CHECK(mesh->find_meshset("inner", kind) == nullptr);
+    std::shared_ptr<Jali::MeshSet> innerset =
+        mesh->build_set_from_region("inner", kind);
+    CHECK(mesh->find_meshset("inner", kind) == nullptr);
+    int ninner = 0;
+    for (int i = 0; i < nents; i++)
+      if (in_c[i] && !in_a[i]) ninner++;
+    CHECK_EQUAL(ninner, innerset->entities<Jali::Entity_type::ALL>().size());
+  }
+}
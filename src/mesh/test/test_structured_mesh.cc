@@ -0,0 +1,293 @@
+/*
+ Copyright (c) 2019, Triad National Security, LLC
+ All rights reserved.
+
+ Copyright 2019. Triad National Security, LLC. This software was
+ produced under U.S. Government contract 89233218CNA000001 for Los
+ Alamos National Laboratory (LANL), which is operated by Triad
+ National Security, LLC for the U.S. Department of Energy. 
+ All rights in the program are reserved by Triad National Security,
+ LLC, and the U.S. Department of Energy/National Nuclear Security
+ Administration. The Government is granted for itself and others acting
+ on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+ in this material to reproduce, prepare derivative works, distribute
+ copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+
+ 
+ This is open source software distributed under the 3-clause BSD license.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of Triad National Security, LLC, Los Alamos
+    National Laboratory, LANL, the U.S. Government, nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ 
+ THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+ BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+// -------------------------------------------------------------
+/**
+ * @file   test_structured_mesh.cc
+ *
+ * @brief  Unit tests for the structured (implicit connectivity) mesh
+ *         framework
+ */
+// -------------------------------------------------------------
+// -------------------------------------------------------------
+
+#include <UnitTest++.h>
+
+#include <mpi.h>
+#include <vector>
+
+#include "Mesh.hh"
+#include "MeshSet.hh"
+#include "MeshFactory.hh"
+#include "Mesh_structured.hh"
+#include "BoxRegion.hh"
+#include "GeometricModel.hh"
+
+// A structured mesh numbers its entities in the same way as the
+// regular meshes generated by the flat framework, so every query must
+// give exactly the same answer on both
+
+void compare_meshes(Jali::Mesh const& mesh, Jali::Mesh const& ref) {
+  using Jali::Entity_kind;
+  using Jali::Entity_type;
+
+  CHECK_EQUAL(ref.space_dimension(), mesh.space_dimension());
+  CHECK(mesh.mesh_type() == Jali::Mesh_type::RECTANGULAR);
+
+  auto check_lists = [](Jali::Entity_ID_List const& a,
+                        Jali::Entity_ID_List const& b) {
+    CHECK_EQUAL(b.size(), a.size());
+    if (a.size() == b.size())
+      CHECK_ARRAY_EQUAL(b, a, a.size());
+  };
+
+  check_lists(mesh.cells<Entity_type::PARALLEL_OWNED>(),
+              ref.cells<Entity_type::PARALLEL_OWNED>());
+  check_lists(mesh.cells<Entity_type::PARALLEL_GHOST>(),
+              ref.cells<Entity_type::PARALLEL_GHOST>());
+  check_lists(mesh.faces<Entity_type::PARALLEL_OWNED>(),
+              ref.faces<Entity_type::PARALLEL_OWNED>());
+  check_lists(mesh.faces<Entity_type::PARALLEL_GHOST>(),
+              ref.faces<Entity_type::PARALLEL_GHOST>());
+  check_lists(mesh.nodes<Entity_type::PARALLEL_OWNED>(),
+              ref.nodes<Entity_type::PARALLEL_OWNED>());
+  check_lists(mesh.nodes<Entity_type::PARALLEL_GHOST>(),
+              ref.nodes<Entity_type::PARALLEL_GHOST>());
+  check_lists(mesh.edges<Entity_type::PARALLEL_OWNED>(),
+              ref.edges<Entity_type::PARALLEL_OWNED>());
+  check_lists(mesh.edges<Entity_type::PARALLEL_GHOST>(),
+              ref.edges<Entity_type::PARALLEL_GHOST>());
+  CHECK_EQUAL(ref.num_sides(), mesh.num_sides());
+  CHECK_EQUAL(ref.num_corners(), mesh.num_corners());
+
+  Jali::Entity_ID_List ids, refids;
+  std::vector<Jali::dir_t> dirs, refdirs;
+
+  for (auto const& c : ref.cells()) {
+    CHECK_EQUAL(ref.GID(c, Entity_kind::CELL),
+                mesh.GID(c, Entity_kind::CELL));
+    CHECK(ref.cell_get_type(c) == mesh.cell_get_type(c));
+    mesh.cell_get_nodes(c, &ids);
+    ref.cell_get_nodes(c, &refids);
+    check_lists(ids, refids);
+    mesh.cell_get_faces_and_dirs(c, &ids, &dirs);
+    ref.cell_get_faces_and_dirs(c, &refids, &refdirs);
+    check_lists(ids, refids);
+    CHECK_ARRAY_EQUAL(refdirs, dirs, refdirs.size());
+    mesh.cell_get_face_adj_cells(c, Entity_type::ALL, &ids);
+    ref.cell_get_face_adj_cells(c, Entity_type::ALL, &refids);
+    check_lists(ids, refids);
+    mesh.cell_get_node_adj_cells(c, Entity_type::PARALLEL_OWNED, &ids);
+    ref.cell_get_node_adj_cells(c, Entity_type::PARALLEL_OWNED, &refids);
+    check_lists(ids, refids);
+    if (ref.num_edges()) {
+      mesh.cell_get_edges(c, &ids);
+      ref.cell_get_edges(c, &refids);
+      check_lists(ids, refids);
+    }
+    CHECK_CLOSE(ref.cell_volume(c), mesh.cell_volume(c), 1.0e-12);
+    if (ref.num_corners()) {
+      mesh.cell_get_corners(c, &ids);
+      ref.cell_get_corners(c, &refids);
+      check_lists(ids, refids);
+    }
+  }
+
+  for (auto const& f : ref.faces()) {
+    CHECK_EQUAL(ref.GID(f, Entity_kind::FACE),
+                mesh.GID(f, Entity_kind::FACE));
+    mesh.face_get_nodes(f, &ids);
+    ref.face_get_nodes(f, &refids);
+    check_lists(ids, refids);
+    mesh.face_get_cells(f, Entity_type::ALL, &ids);
+    ref.face_get_cells(f, Entity_type::ALL, &refids);
+    check_lists(ids, refids);
+    if (ref.num_edges()) {
+      mesh.face_get_edges_and_dirs(f, &ids, &dirs);
+      ref.face_get_edges_and_dirs(f, &refids, &refdirs);
+      check_lists(ids, refids);
+      CHECK_ARRAY_EQUAL(refdirs, dirs, refdirs.size());
+    }
+    CHECK_CLOSE(ref.face_area(f), mesh.face_area(f), 1.0e-12);
+  }
+
+  for (auto const& n : ref.nodes()) {
+    CHECK_EQUAL(ref.GID(n, Entity_kind::NODE),
+                mesh.GID(n, Entity_kind::NODE));
+    mesh.node_get_cells(n, Entity_type::ALL, &ids);
+    ref.node_get_cells(n, Entity_type::ALL, &refids);
+    check_lists(ids, refids);
+    mesh.node_get_faces(n, Entity_type::PARALLEL_GHOST, &ids);
+    ref.node_get_faces(n, Entity_type::PARALLEL_GHOST, &refids);
+    check_lists(ids, refids);
+    JaliGeometry::Point p, refp;
+    mesh.node_get_coordinates(n, &p);
+    ref.node_get_coordinates(n, &refp);
+    CHECK_CLOSE(0.0, norm(p-refp), 1.0e-12);
+  }
+
+  for (auto const& e : ref.edges()) {
+    CHECK_EQUAL(ref.GID(e, Entity_kind::EDGE),
+                mesh.GID(e, Entity_kind::EDGE));
+    Jali::Entity_ID n0, n1, refn0, refn1;
+    mesh.edge_get_nodes(e, &n0, &n1);
+    ref.edge_get_nodes(e, &refn0, &refn1);
+    CHECK_EQUAL(refn0, n0);
+    CHECK_EQUAL(refn1, n1);
+  }
+
+  for (auto const& cn : ref.corners())
+    CHECK_CLOSE(ref.corner_volume(cn), mesh.corner_volume(cn), 1.0e-12);
+}
+
+
+TEST(STRUCTURED_3D) {
+  Jali::MeshFactory factory(MPI_COMM_WORLD);
+  factory.included_entities({Jali::Entity_kind::FACE, Jali::Entity_kind::EDGE,
+          Jali::Entity_kind::CORNER});
+
+  factory.framework(Jali::Structured);
+  std::shared_ptr<Jali::Mesh> mesh =
+      factory(0.0, 0.0, 0.0, 1.0, 1.0, 1.0, 6, 5, 4);
+  CHECK(std::dynamic_pointer_cast<Jali::Mesh_structured>(mesh) != nullptr);
+
+  factory.framework(Jali::Flat);
+  std::shared_ptr<Jali::Mesh> ref =
+      factory(0.0, 0.0, 0.0, 1.0, 1.0, 1.0, 6, 5, 4);
+
+  compare_meshes(*mesh, *ref);
+}
+
+
+TEST(STRUCTURED_2D) {
+  Jali::MeshFactory factory(MPI_COMM_WORLD);
+  factory.included_entities({Jali::Entity_kind::FACE, Jali::Entity_kind::EDGE,
+          Jali::Entity_kind::CORNER});
+  factory.num_ghost_layers_distmesh(2);
+
+  factory.framework(Jali::Structured);
+  std::shared_ptr<Jali::Mesh> mesh = factory(0.0, 0.0, 1.0, 1.0, 9, 7);
+
+  factory.framework(Jali::Flat);
+  std::shared_ptr<Jali::Mesh> ref = factory(0.0, 0.0, 1.0, 1.0, 9, 7);
+
+  compare_meshes(*mesh, *ref);
+}
+
+
+TEST(STRUCTURED_1D) {
+  std::vector<double> x = {0.0, 0.1, 0.3, 0.35, 0.5, 0.7, 0.8, 0.9, 1.0};
+  Jali::MeshFactory factory(MPI_COMM_WORLD);
+  factory.included_entities({Jali::Entity_kind::FACE});
+
+  factory.framework(Jali::Structured);
+  std::shared_ptr<Jali::Mesh> mesh = factory(x);
+
+  factory.framework(Jali::Flat);
+  std::shared_ptr<Jali::Mesh> ref = factory(x);
+
+  compare_meshes(*mesh, *ref);
+}
+
+
+// Tiles and sets are built on top of the queries, and moving a node
+// changes the geometry
+
+TEST(STRUCTURED_TILES_SETS) {
+  int nproc;
+  MPI_Comm_size(MPI_COMM_WORLD, &nproc);
+
+  std::vector<JaliGeometry::RegionPtr> gregions;
+  JaliGeometry::Point boxlo(-0.51, -0.51), boxhi(0.51, 0.51);
+  JaliGeometry::BoxRegion box1("box1", 1, boxlo, boxhi);
+  gregions.push_back(&box1);
+  JaliGeometry::GeometricModel gm(2, gregions);
+
+  Jali::MeshFactory factory(MPI_COMM_WORLD);
+  factory.framework(Jali::Structured);
+  factory.included_entities({Jali::Entity_kind::FACE});
+  factory.num_tiles(16/nproc);
+  factory.num_ghost_layers_tile(1);
+  factory.geometric_model(&gm);
+
+  std::shared_ptr<Jali::Mesh> mesh = factory(-1.0, -1.0, 1.0, 1.0, 8, 8);
+  CHECK_EQUAL(16/nproc, mesh->num_tiles());
+
+  std::shared_ptr<Jali::MeshSet> mset =
+      mesh->find_meshset_from_region("box1", Jali::Entity_kind::CELL, true);
+  CHECK(mset != nullptr);
+
+  Jali::Entity_ID_List boxcells;
+  mesh->get_set_entities("box1", Jali::Entity_kind::CELL,
+                         Jali::Entity_type::PARALLEL_OWNED, &boxcells);
+  int nboxcells = boxcells.size(), gnboxcells;
+  MPI_Allreduce(&nboxcells, &gnboxcells, 1, MPI_INT, MPI_SUM,
+                MPI_COMM_WORLD);
+  CHECK_EQUAL(16, gnboxcells);
+
+  // Move the first node of the first cell and check that its volume
+  // changes as expected once the geometry is recomputed
+
+  Jali::Entity_ID c = 0;
+  Jali::Entity_ID_List cnodes;
+  mesh->cell_get_nodes(c, &cnodes);
+  double volume0 = mesh->cell_volume(c);
+  JaliGeometry::Point p;
+  mesh->node_get_coordinates(cnodes[0], &p);
+  p[0] -= 0.25;
+  mesh->node_set_coordinates(cnodes[0], p);
+
+  JaliGeometry::Point q;
+  mesh->node_get_coordinates(cnodes[0], &q);
+  CHECK_CLOSE(p[0], q[0], 1.0e-12);
+  mesh->node_get_coordinates(cnodes[1], &q);
+  CHECK_CLOSE(p[0] + 0.5, q[0], 1.0e-12);
+
+  mesh->update_geometric_quantities();
+  CHECK_CLOSE(volume0 + 0.25*0.25/2, mesh->cell_volume(c), 1.0e-12);
+}
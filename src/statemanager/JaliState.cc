@@ -47,10 +47,24 @@
 */
 
 #include <cassert>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <map>
 #include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <vector>
 
 #include "JaliState.h"
 #include "JaliStateVector.h"
+#include "JaliStateWriter.h"
+#include "MeshMigration.hh"
+#include "errors.hh"
 
 namespace Jali {
 
@@ -156,6 +170,461 @@ void State::rem_cells_from_material(int m, std::vector<int> const& cells) {
 
 
 
+/// Rotate the time levels of all multi-level state vectors
+
+void State::swap_levels() {
+  for (auto & sv : state_vectors_) {
+    auto mlv = std::dynamic_pointer_cast<MultiLevelStateVectorBase>(sv);
+    if (mlv) mlv->swap_levels();
+  }
+}
+
+
+
+/// Batched global reductions of state vectors over owned entities
+
+std::vector<double>
+State::reduce(std::vector<std::pair<std::string, Reduction_type>> const&
+              requests, bool reproducible, int nthreads) {
+  StateReduction reduction(mymesh_->get_comm(), reproducible, nthreads);
+
+  int nreq = requests.size();
+  std::vector<int> ids(nreq, -1);
+  for (int i = 0; i < nreq; i++) {
+    std::string const& name = requests[i].first;
+    Reduction_type type = requests[i].second;
+
+    auto it = find(name, mymesh_);
+    if (it != end()) {
+      try {
+        if (auto dvec = std::dynamic_pointer_cast<UniStateVector<double>>(*it))
+          ids[i] = reduction.add(*dvec, type);
+        else if (auto ivec =
+                 std::dynamic_pointer_cast<UniStateVector<int>>(*it))
+          ids[i] = reduction.add(*ivec, type);
+      } catch (std::runtime_error const&) {}  // not on owned or all entities
+    }
+    if (ids[i] < 0)
+      std::cerr << "Cannot reduce vector " << name <<
+          " (not found or not an int or double vector on the owned or"
+          " all entities of the mesh)\n";
+  }
+
+  reduction.execute();
+
+  std::vector<double> results(nreq, std::numeric_limits<double>::quiet_NaN());
+  for (int i = 0; i < nreq; i++)
+    if (ids[i] >= 0) results[i] = reduction.result(ids[i]);
+  return results;
+}
+
+
+
+// Binary checkpoint/restart (see StateCheckpointHeader for the layout
+// of the files)
+
+namespace {
+
+int64_t read_value(std::istream& is) {
+  int64_t val = 0;
+  is.read(reinterpret_cast<char *>(&val), sizeof(val));
+  return val;
+}
+
+void checkpoint_error(std::string const& filename, std::string const& what) {
+  Errors::Message mesg("Checkpoint " + filename + ": " + what);
+  Exceptions::Jali_throw(mesg);
+}
+
+// Bytes of the file after the current read position
+
+int64_t bytes_left(std::istream& is, int64_t filesize) {
+  return filesize - static_cast<int64_t>(is.tellg());
+}
+
+// Read a count or length, rejecting values outside [0, maxcount] so
+// that a corrupt file cannot make us allocate arbitrary amounts
+
+int64_t read_count(std::istream& is, int64_t maxcount,
+                   std::string const& filename) {
+  int64_t n = read_value(is);
+  if (!is) checkpoint_error(filename, "truncated");
+  if (n < 0 || n > maxcount)
+    checkpoint_error(filename, "corrupt (count " + std::to_string(n) +
+                     " out of range)");
+  return n;
+}
+
+std::string read_string(std::istream& is, int64_t filesize,
+                        std::string const& filename) {
+  std::string str(read_count(is, bytes_left(is, filesize), filename), '\0');
+  is.read(&(str[0]), str.size());
+  return str;
+}
+
+// Add a state vector of a known data type and class when restoring
+
+template <class T>
+struct is_std_array : std::false_type {};
+
+template <class T, std::size_t N>
+struct is_std_array<std::array<T, N>> : std::true_type {};
+
+template <class T, class DomainType>
+typename std::enable_if<is_std_array<T>::value, bool>::type
+add_soa_vector(State *state, std::string const& name,
+               std::shared_ptr<DomainType> domain, Entity_kind kind,
+               Entity_type type) {
+  state->add<T, DomainType, SoAStateVector>(name, domain, kind, type, T());
+  return true;
+}
+
+template <class T, class DomainType>
+typename std::enable_if<!is_std_array<T>::value, bool>::type
+add_soa_vector(State *state, std::string const& name,
+               std::shared_ptr<DomainType> domain, Entity_kind kind,
+               Entity_type type) {
+  return false;
+}
+
+template <class T, class DomainType>
+bool add_vector_of_class(State *state, std::string const& vclass,
+                         std::string const& name,
+                         std::shared_ptr<DomainType> domain,
+                         Entity_kind kind, Entity_type type, int narrays) {
+  if (vclass == "UniStateVector")
+    state->add<T, DomainType, UniStateVector>(name, domain, kind, type, T());
+  else if (vclass == "MultiLevelStateVector")
+    state->add_multilevel<T, DomainType>(name, domain, kind, type, narrays);
+  else if (vclass == "SoAStateVector")
+    return add_soa_vector<T>(state, name, domain, kind, type);
+  else if (vclass == "MultiStateVector")
+    state->add<T, DomainType, MultiStateVector>(name, domain, kind, type,
+                                                T());
+  else
+    return false;
+  return true;
+}
+
+template <class DomainType>
+bool add_checkpoint_vector(State *state, Checkpoint_data_type dtype,
+                           std::string const& vclass, std::string const& name,
+                           std::shared_ptr<DomainType> domain,
+                           Entity_kind kind, Entity_type type, int narrays) {
+  switch (dtype) {
+    case Checkpoint_data_type::DOUBLE:
+      return add_vector_of_class<double>(state, vclass, name, domain, kind,
+                                         type, narrays);
+    case Checkpoint_data_type::INT:
+      return add_vector_of_class<int>(state, vclass, name, domain, kind,
+                                      type, narrays);
+    case Checkpoint_data_type::FLOAT:
+      return add_vector_of_class<float>(state, vclass, name, domain, kind,
+                                        type, narrays);
+    case Checkpoint_data_type::DOUBLE_ARRAY2:
+      return add_vector_of_class<std::array<double, 2>>(state, vclass, name,
+                                                        domain, kind, type,
+                                                        narrays);
+    case Checkpoint_data_type::DOUBLE_ARRAY3:
+      return add_vector_of_class<std::array<double, 3>>(state, vclass, name,
+                                                        domain, kind, type,
+                                                        narrays);
+    case Checkpoint_data_type::DOUBLE_ARRAY6:
+      return add_vector_of_class<std::array<double, 6>>(state, vclass, name,
+                                                        domain, kind, type,
+                                                        narrays);
+    default:
+      return false;
+  }
+}
+
+}  // namespace
+
+
+/// Write a binary checkpoint of the state
+
+void State::write_checkpoint(std::string const& filename) {
+  MPI_Comm comm = mymesh_->get_comm();
+  int nprocs, rank;
+  MPI_Comm_size(comm, &nprocs);
+  MPI_Comm_rank(comm, &rank);
+
+  StateSnapshot snapshot(*this);
+  int ierr = snapshot.write(checkpoint_filename(filename, nprocs, rank)) ?
+      0 : 1;
+
+  int aerr = 0;
+  MPI_Allreduce(&ierr, &aerr, 1, MPI_INT, MPI_SUM, comm);
+  if (aerr) {
+    Errors::Message mesg("State::write_checkpoint: could not write " +
+                         filename + " on " + std::to_string(aerr) +
+                         " rank(s)");
+    Exceptions::Jali_throw(mesg);
+  }
+}
+
+
+/// Restore the state from a binary checkpoint
+
+void State::read_checkpoint(std::string const& filename) {
+  MPI_Comm comm = mymesh_->get_comm();
+  int nprocs, rank;
+  MPI_Comm_size(comm, &nprocs);
+  MPI_Comm_rank(comm, &rank);
+  std::string rankfile = checkpoint_filename(filename, nprocs, rank);
+
+  int ierr = 0, aerr = 0;
+  std::string errmsg;
+  try {
+    std::ifstream file(rankfile, std::ios::binary | std::ios::ate);
+    if (!file) checkpoint_error(rankfile, "cannot open");
+    int64_t filesize = file.tellg();
+    file.seekg(0);
+
+    StateCheckpointHeader hdr;
+    file.read(reinterpret_cast<char *>(&hdr), sizeof(hdr));
+    if (!file || !hdr.valid_magic())
+      checkpoint_error(rankfile, "not a Jali checkpoint");
+    if (hdr.endian != StateCheckpointHeader::ENDIAN_CHECK)
+      checkpoint_error(rankfile, "written on a machine with different"
+                       " endianness");
+    if (hdr.version != StateCheckpointHeader::VERSION)
+      checkpoint_error(rankfile, "unsupported version");
+    if (hdr.nprocs != nprocs || hdr.rank != rank)
+      checkpoint_error(rankfile, "written from a different number of ranks");
+    for (int k = 0; k < StateCheckpointHeader::NUM_KINDS; k++)
+      if (hdr.num_entities[k] !=
+          mymesh_->num_entities(static_cast<Entity_kind>(k), Entity_type::ALL))
+        checkpoint_error(rankfile, "written from a different mesh");
+    if (hdr.nmaterials < 0 || hdr.nvectors < 0)
+      checkpoint_error(rankfile, "corrupt header");
+    int ncells = hdr.num_entities[static_cast<int>(Entity_kind::CELL)];
+
+    // Materials - added if the state has none, checked otherwise
+
+    bool have_materials = (num_materials() > 0);
+    if (have_materials && num_materials() != hdr.nmaterials)
+      checkpoint_error(rankfile, "has different materials from the state");
+    for (int m = 0; m < hdr.nmaterials; m++) {
+      std::string matname = read_string(file, filesize, rankfile);
+      std::vector<int> matcells(read_count(file, ncells, rankfile));
+      file.read(reinterpret_cast<char *>(matcells.data()),
+                matcells.size()*sizeof(int));
+      if (!file) checkpoint_error(rankfile, "truncated");
+      for (auto const& c : matcells)
+        if (c < 0 || c >= ncells)
+          checkpoint_error(rankfile, "material " + matname +
+                           " has invalid cells");
+
+      if (!have_materials)
+        add_material(matname, matcells);
+      else if (matname != material_name(m) || matcells != material_cells(m))
+        checkpoint_error(rankfile, "material " + matname +
+                         " differs from material of the state");
+    }
+
+    // State vectors
+
+    for (int v = 0; v < hdr.nvectors; v++) {
+      std::string name = read_string(file, filesize, rankfile);
+      Entity_kind kind = static_cast<Entity_kind>(read_value(file));
+      Entity_type type = static_cast<Entity_type>(read_value(file));
+      int domain_id = read_value(file);
+      std::string vclass = read_string(file, filesize, rankfile);
+      auto dtype = static_cast<Checkpoint_data_type>(
+          read_count(file, NUM_CHECKPOINT_DATA_TYPES-1, rankfile));
+      std::size_t elemsize = read_count(file, bytes_left(file, filesize),
+                                        rankfile);
+      int narrays = read_count(file, bytes_left(file, filesize)/
+                               sizeof(int64_t), rankfile);
+      if (elemsize == 0) checkpoint_error(rankfile, "corrupt (element size"
+                                          " of vector " + name + " is 0)");
+
+      // No array of a vector is larger than the number of entities of
+      // its kind or, for kinds not in the header, the rest of the file
+
+      int ikind = static_cast<int>(kind);
+      auto read_array_size = [&]() {
+        int64_t maxn = bytes_left(file, filesize)/elemsize;
+        if (ikind >= 0 && ikind < StateCheckpointHeader::NUM_KINDS)
+          maxn = std::min(maxn, hdr.num_entities[ikind]);
+        return read_count(file, maxn, rankfile);
+      };
+
+      auto find_vector = [&]() {
+        for (auto const& sv : state_vectors_)
+          if (sv->name() == name && sv->entity_kind() == kind &&
+              sv->entity_type() == type && sv->domain_id() == domain_id)
+            return sv;
+        return std::shared_ptr<StateVectorBase>();
+      };
+
+      std::shared_ptr<StateVectorBase> sv = find_vector();
+      if (!sv) {
+        bool added = false;
+        if (domain_id < 0)
+          added = add_checkpoint_vector(this, dtype, vclass, name,
+                                        mymesh_, kind, type, narrays);
+        else if (domain_id < mymesh_->num_tiles())
+          added = add_checkpoint_vector(this, dtype, vclass, name,
+                                        mymesh_->tiles()[domain_id],
+                                        kind, type, narrays);
+        if (added) sv = find_vector();
+      }
+
+      if (!sv) {
+        if (rank == 0)
+          std::cerr << "Cannot restore vector " << name << " of type " <<
+              Checkpoint_data_type_string(dtype) << " - add it to the state"
+              " before restarting\n";
+        for (int i = 0; i < narrays; i++) {
+          std::size_t n = read_array_size();
+          file.seekg(n*elemsize, std::ios::cur);
+        }
+        continue;
+      }
+
+      if (sv->vector_class() != vclass ||
+          checkpoint_data_type(sv->data_type()) != dtype ||
+          sv->raw_element_size() != elemsize ||
+          sv->num_raw_arrays() != narrays)
+        checkpoint_error(rankfile, "vector " + name + " in the state does"
+                         " not match the checkpointed vector");
+
+      for (int i = 0; i < narrays; i++) {
+        std::size_t n = read_array_size();
+        sv->raw_array_resize(i, n);
+        file.read(static_cast<char *>(sv->raw_array(i)), n*elemsize);
+      }
+      if (!file) checkpoint_error(rankfile, "truncated");
+    }
+  } catch (std::exception const& exc) {  // incl. bad_alloc, length_error
+    ierr = 1;
+    errmsg = exc.what();
+  } catch (...) {
+    ierr = 1;
+    errmsg = "unknown error";
+  }
+
+  MPI_Allreduce(&ierr, &aerr, 1, MPI_INT, MPI_SUM, comm);
+  if (aerr) {
+    Errors::Message mesg("State::read_checkpoint: failed on " +
+                         std::to_string(aerr) + " rank(s) " + errmsg);
+    Exceptions::Jali_throw(mesg);
+  }
+}
+
+
+
+/// Move the state to a redistributed mesh
+
+std::shared_ptr<State> State::migrate(std::shared_ptr<Mesh> newmesh) {
+  MPI_Comm comm = newmesh->get_comm();
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+
+  std::shared_ptr<State> newstate = State::create(newmesh, memory_policy_);
+
+  // Materials - move a flag on all cells telling which cells the
+  // material is in
+
+  int nmats = num_materials();
+  if (nmats) {
+    EntityTransfer transfer(*mymesh_, *newmesh, Entity_kind::CELL,
+                            Entity_type::ALL);
+    int ncells_old = mymesh_->num_cells<Entity_type::ALL>();
+    for (int m = 0; m < nmats; m++) {
+      std::vector<std::uint8_t> inmat(ncells_old, 0), newinmat;
+      for (auto const& c : material_cells(m))
+        inmat[c] = 1;
+      transfer.move(inmat, &newinmat);
+
+      std::vector<int> matcells;
+      for (int c = 0; c < static_cast<int>(newinmat.size()); c++)
+        if (newinmat[c]) matcells.push_back(c);
+      newstate->add_material(material_name(m), matcells);
+    }
+  }
+
+  // Transfers are set up once for each kind and type of entity and
+  // each material and shared by all vectors
+
+  std::map<std::pair<Entity_kind, Entity_type>,
+           std::shared_ptr<EntityTransfer>> transfers;
+  std::vector<std::shared_ptr<EntityTransfer>> mattransfers(nmats);
+  auto material_transfer = [&](int m) {
+    if (!mattransfers[m]) {
+      std::vector<int> srcgids, dstgids;
+      for (auto const& c : material_cells(m))
+        srcgids.push_back(mymesh_->entity_get_type(Entity_kind::CELL, c) ==
+                          Entity_type::PARALLEL_OWNED ?
+                          mymesh_->GID(c, Entity_kind::CELL) : -1);
+      for (auto const& c : newstate->material_cells(m))
+        dstgids.push_back(newmesh->GID(c, Entity_kind::CELL));
+      mattransfers[m] = std::make_shared<EntityTransfer>(comm, srcgids,
+                                                         dstgids);
+    }
+    return mattransfers[m];
+  };
+
+  for (auto const& sv : state_vectors_) {
+    std::string const& name = sv->name();
+    Entity_kind kind = sv->entity_kind();
+    Entity_type type = sv->entity_type();
+    std::size_t elemsize = sv->raw_element_size();
+    bool movable = (sv->domain_id() < 0 && elemsize > 0 &&
+                    (kind == Entity_kind::NODE || kind == Entity_kind::EDGE ||
+                     kind == Entity_kind::FACE || kind == Entity_kind::CELL) &&
+                    (type == Entity_type::ALL ||
+                     type == Entity_type::PARALLEL_OWNED));
+    if (movable)
+      movable = add_checkpoint_vector(newstate.get(),
+                                      checkpoint_data_type(sv->data_type()),
+                                      sv->vector_class(), name, newmesh,
+                                      kind, type, sv->num_raw_arrays());
+    if (!movable) {
+      if (rank == 0)
+        std::cerr << "Cannot migrate vector " << name << " of type " <<
+            sv->data_type().name() << " - add it to the new state\n";
+      continue;
+    }
+    std::shared_ptr<StateVectorBase> newsv = newstate->state_vectors_.back();
+
+    if (sv->vector_class() == "MultiStateVector") {
+      for (int m = 0; m < nmats; m++) {
+        std::shared_ptr<EntityTransfer> transfer = material_transfer(m);
+        newsv->raw_array_resize(m, transfer->num_destinations());
+        transfer->move(sv->raw_array(m), newsv->raw_array(m), elemsize);
+      }
+    } else {
+      std::shared_ptr<EntityTransfer>& transfer = transfers[{kind, type}];
+      if (!transfer)
+        transfer = std::make_shared<EntityTransfer>(*mymesh_, *newmesh,
+                                                    kind, type);
+      for (int i = 0; i < sv->num_raw_arrays(); i++) {
+        newsv->raw_array_resize(i, transfer->num_destinations());
+        transfer->move(sv->raw_array(i), newsv->raw_array(i), elemsize);
+      }
+    }
+  }
+
+  return newstate;
+}
+
+
+
+// Add a univalued state vector for a mesh field and read the field
+// data straight into the storage of the vector
+
+template <class T>
+bool State::import_field(std::string const& name, Entity_kind kind) {
+  UniStateVector<T, Mesh>& vec =
+      add<T, Mesh, UniStateVector>(name, mymesh_, kind, Entity_type::ALL,
+                                   T());
+  return mymesh_->get_field(name, kind, vec.get_raw_data());
+}
+
+
 //! \brief Add a state vectors from the mesh
 //! Initialize a state vectors in the statemanager from mesh field data
 
@@ -174,50 +643,58 @@ void State::init_from_mesh() {
 
     int spacedim = mymesh_->space_dimension();
 
-    int nent = mymesh_->num_entities(kind, Entity_type::ALL);
-
     for (int i = 0; i < num; i++) {
+      bool status = true;
       if (vartypes[i] == "INT") {
-        int *data = new int[nent];
-        mymesh_->get_field(varnames[i], kind, data);
-        // UniStateVector<int, Mesh> & sv =
-        add(varnames[i], mymesh_, kind, Entity_type::ALL, data);
+        status = import_field<int>(varnames[i], kind);
       } else if (vartypes[i] == "DOUBLE") {
-        double *data = new double[nent];
-        mymesh_->get_field(varnames[i], kind, data);
-        // UniStateVector<double, Mesh> & sv =
-        add(varnames[i], mymesh_, kind, Entity_type::ALL, data);
+        status = import_field<double>(varnames[i], kind);
       } else if (vartypes[i] == "VECTOR") {
-        if (spacedim == 2) {
-          std::array<double, 2> *data = new std::array<double, 2>[nent];
-          mymesh_->get_field(varnames[i], kind, data);
-          // UniStateVector<std::array<double, 2>, Mesh> & sv =
-          add(varnames[i], mymesh_, kind, Entity_type::ALL, data);
-        } else if (spacedim == 3) {
-          std::array<double, 3> *data = new std::array<double, 3>[nent];
-          mymesh_->get_field(varnames[i], kind, data);
-          // UniStateVector<std::array<double, 3>, Mesh> & sv =
-          add(varnames[i], mymesh_, kind, Entity_type::ALL, data);
-        }
+        if (spacedim == 2)
+          status = import_field<std::array<double, 2>>(varnames[i], kind);
+        else if (spacedim == 3)
+          status = import_field<std::array<double, 3>>(varnames[i], kind);
       } else if (vartypes[i] == "TENSOR") {  // assumes symmetric tensors
-        if (spacedim == 2) {  // lower half & diagonal of 2x2 tensor
-          std::array<double, 3> *data = new std::array<double, 3>[nent];
-          mymesh_->get_field(varnames[i], kind, data);
-          // UniStateVector<std::array<double, 3>, Mesh> & sv =
-          add(varnames[i], mymesh_, kind, Entity_type::ALL, data);
-        } else if (spacedim == 3) {  // lower half & diagonal of 3x3 tensor
-          std::array<double, 6> *data = new std::array<double, 6>[nent];
-          mymesh_->get_field(varnames[i], kind, data);
-          // UniStateVector<std::array<double, 6>, Mesh> & sv =
-          add(varnames[i], mymesh_, kind, Entity_type::ALL, data);
-        }
+        if (spacedim == 2)  // lower half & diagonal of 2x2 tensor
+          status = import_field<std::array<double, 3>>(varnames[i], kind);
+        else if (spacedim == 3)  // lower half & diagonal of 3x3 tensor
+          status = import_field<std::array<double, 6>>(varnames[i], kind);
       }  // TENSOR
+
+      if (!status)
+        std::cerr << "Could not import field " << varnames[i] <<
+            " from mesh\n";
     }  // for each field on entity kind
   }  // for each entity kind
 
 }  // init_from_mesh
 
 
+// Store an array valued state vector with the mesh. The vector may be
+// in array-of-structures (UniStateVector) or structure-of-arrays
+// (SoAStateVector) layout; the latter is converted to the AoS layout
+// that the mesh expects
+
+template <std::size_t N>
+bool State::export_array_field(std::shared_ptr<StateVectorBase> vec) {
+  typedef std::array<double, N> ArrayT;
+
+  auto svec = std::dynamic_pointer_cast<UniStateVector<ArrayT>>(vec);
+  if (svec)
+    return mymesh_->store_field(vec->name(), vec->entity_kind(),
+                                svec->get_raw_data());
+
+  auto soavec = std::dynamic_pointer_cast<SoAStateVector<ArrayT>>(vec);
+  if (soavec) {
+    std::vector<ArrayT> aosdata = soavec->to_aos();
+    return mymesh_->store_field(vec->name(), vec->entity_kind(),
+                                aosdata.data());
+  }
+
+  return false;
+}
+
+
 //! \brief Export field data to mesh
 //! Export data from state vectors to mesh fields - Since the statevector is
 //! templated, we have to go through case by case to see if the type matches
@@ -242,17 +719,11 @@ void State::export_to_mesh() {
         auto svec = std::dynamic_pointer_cast<UniStateVector<int>>(vec);
         status = mymesh_->store_field(name, entity_kind, svec->get_raw_data());
       } else if (vec->data_type() == typeid(std::array<double, 2>)) {
-        auto svec =
-            std::dynamic_pointer_cast<UniStateVector<std::array<double, 2>>>(vec);
-        status = mymesh_->store_field(name, entity_kind, svec->get_raw_data());
+        status = export_array_field<2>(vec);
       } else if (vec->data_type() == typeid(std::array<double, 3>)) {
-        auto svec =
-            std::dynamic_pointer_cast<UniStateVector<std::array<double, 3>>>(vec);
-        status = mymesh_->store_field(name, entity_kind, svec->get_raw_data());
+        status = export_array_field<3>(vec);
       } else if (vec->data_type() == typeid(std::array<double, 6>)) {
-        auto svec =
-            std::dynamic_pointer_cast<UniStateVector<std::array<double, 6>>>(vec);
-        status = mymesh_->store_field(name, entity_kind, svec->get_raw_data());
+        status = export_array_field<6>(vec);
       }
     }
 
@@ -64,6 +64,7 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <utility>
 #include <cassert>
 #include <boost/iterator/permutation_iterator.hpp>
 
@@ -78,17 +79,25 @@ class State : public std::enable_shared_from_this<State> {
   // Constructor is protected - call the static method create instead as:
   // std::shared_ptr<State> mystate = Jali::State::create(mesh)
 
-  static std::shared_ptr<State> create(std::shared_ptr<Mesh> mesh) {
+  //
+  // The memory policy determines how the data of state vectors added
+  // to the state is allocated (see Memory_policy)
+
+  static std::shared_ptr<State> create(std::shared_ptr<Mesh> mesh,
+                                       Memory_policy const policy =
+                                       Memory_policy::DEFAULT) {
     // Make a struct derived from State. Since its derived from State,
     // it can call the protected constructor
 
     struct shared_state_enabler : public State {
-      shared_state_enabler(std::shared_ptr<Mesh> mesh) : State(mesh) {}
+      shared_state_enabler(std::shared_ptr<Mesh> mesh,
+                           Memory_policy const policy) :
+          State(mesh, policy) {}
     };
 
     // Now call make_shared on shared_state_enabler whose constructor is public
 
-    return std::make_shared<shared_state_enabler>(mesh);
+    return std::make_shared<shared_state_enabler>(mesh, policy);
 
 
     // See StackOverflow.com https://stackoverflow.com/questions/8147027/how-do-i-call-stdmake-shared-on-a-class-with-only-protected-or-private-const
@@ -113,6 +122,15 @@ class State : public std::enable_shared_from_this<State> {
 
   std::shared_ptr<Jali::Mesh> mesh() {return mymesh_;}
 
+  /// Memory policy for data of state vectors
+
+  Memory_policy memory_policy() const {return memory_policy_;}
+
+  /// Set the memory policy for data of state vectors added from now on
+  /// (existing vectors keep their storage)
+
+  void memory_policy(Memory_policy const policy) {memory_policy_ = policy;}
+
   /// Number of materials in simulation
 
   int num_materials() const {
@@ -1189,6 +1207,52 @@ class State : public std::enable_shared_from_this<State> {
 
 
 
+  /*!
+    @brief Add a single valued state vector of a specific type (e.g. SoAStateVector) using a string identifier and array data
+    @tparam T            Data type
+    @tparam DomainType   Type of domain data is defined on (Mesh, MeshTile)
+    @tparam StateVecType Type of state vector (UniStateVector, SoAStateVector)
+    @param name          String identifier for vector
+    @param domain        Shared pointer to the domain
+    @param kind          What kind of entity data is defined on (CELL, NODE, etc.)
+    @param type          What type of entity data is defined on (PARALLEL_OWNED, PARALLEL_GHOST, etc.)
+    @param data          Raw pointer to data array (one T per entity)
+
+    The vector type cannot be deduced and must be given explicitly as in
+
+    state->add<std::array<double, 3>, Mesh, SoAStateVector>(name, mesh,
+                                                            kind, type, data)
+  */
+
+  template <class T, class DomainType,
+            template<class /* T */, class /* DomainType */> class StateVecType>
+  StateVecType<T, DomainType>& add(std::string name,
+                                   std::shared_ptr<DomainType> domain,
+                                   Entity_kind kind,
+                                   Entity_type type,
+                                   T const * const data) {
+
+    iterator it = find<T, DomainType, StateVecType>(name, domain, kind, type);
+    if (it == end()) {
+      auto vector =
+          std::make_shared<StateVecType<T, DomainType>>(name, domain,
+                                                        shared_from_this(),
+                                                        kind, type, data);
+      state_vectors_.emplace_back(vector);
+
+      int ikind = static_cast<int>(kind);
+      entity_indexes_[ikind].emplace_back(state_vectors_.size()-1);
+      names_.emplace_back(name);
+
+      return (*vector);
+    } else {  // found a state vector by same name
+      std::cerr << "Attempted to add duplicate state vector. Ignoring\n";
+      return (*(std::dynamic_pointer_cast<StateVecType<T, DomainType>>(*it)));
+    }
+  }
+
+
+
 
   /*!
     @brief Add a multi-valued state vector (class MultiStateVector) using a string identifier and 2D array data
@@ -1373,12 +1437,13 @@ class State : public std::enable_shared_from_this<State> {
 
         std::cerr << "Copying data from one mesh to another???\n";
 
+        std::vector<T> in_data = aos_copy(in_vec);
         vector_copy =
             std::make_shared<StateVecType<T, DomainType>>(in_vec.name(),
                                                           mymesh_,
                                                           shared_from_this(),
                                                           kind, type,
-                                                          &(in_vec[0]));
+                                                          in_data.data());
       } else {
         vector_copy = std::make_shared<StateVecType<T, DomainType>>(in_vec);
       }
@@ -1406,6 +1471,111 @@ class State : public std::enable_shared_from_this<State> {
   }
 
 
+  /*!
+    @brief Add a state vector with several time levels (class MultiLevelStateVector)
+    @tparam T          Data type
+    @tparam DomainType Type of domain data is defined on (Mesh, MeshTile)
+    @param name        String identifier for vector
+    @param domain      Shared pointer to the domain
+    @param kind        What kind of entity data is defined on (CELL, NODE, etc.)
+    @param type        What type of entity data is defined on (PARALLEL_OWNED, PARALLEL_GHOST, etc.)
+    @param nlevels     Number of time levels
+    @param initval     Value to which all levels are initialized
+
+    Lookups of the vector by name (as a MultiLevelStateVector or
+    UniStateVector) return the current time level
+  */
+
+  template <class T, class DomainType>
+  MultiLevelStateVector<T, DomainType>&
+  add_multilevel(std::string name, std::shared_ptr<DomainType> domain,
+                 Entity_kind kind, Entity_type type, int nlevels,
+                 T const& initval = T()) {
+
+    iterator it = find<T, DomainType, MultiLevelStateVector>(name, domain,
+                                                             kind, type);
+    if (it == end()) {
+      auto vector =
+          std::make_shared<MultiLevelStateVector<T, DomainType>>(name, domain,
+                                                                 shared_from_this(),
+                                                                 kind, type,
+                                                                 initval,
+                                                                 nlevels);
+      state_vectors_.emplace_back(vector);
+
+      int ikind = static_cast<int>(kind);
+      entity_indexes_[ikind].emplace_back(state_vectors_.size()-1);
+      names_.emplace_back(name);
+
+      return (*vector);
+    } else {  // found a state vector by same name
+      std::cerr << "Attempted to add duplicate state vector. Ignoring\n";
+      return (*(std::dynamic_pointer_cast<MultiLevelStateVector<T, DomainType>>(*it)));
+    }
+  }
+
+  /// @brief Rotate the time levels of all multi-level state vectors
+  void swap_levels();
+
+
+  /*!
+    @brief Batched global reductions of state vectors over owned entities
+    @param requests      Pairs of vector name and type of reduction
+    @param reproducible  Compute bitwise reproducible sums
+    @param nthreads      Number of threads for the local pass
+    @return              Result of each reduction in the order requested
+
+    Vectors must be univalued int or double vectors on the owned or
+    all entities of the mesh. All reductions are computed in one local
+    pass and a single collective over the communicator of the mesh.
+    Requests for unknown (or other) vectors yield NaN
+  */
+
+  std::vector<double>
+  reduce(std::vector<std::pair<std::string, Reduction_type>> const& requests,
+         bool reproducible = false, int nthreads = 1);
+
+  /*!
+    @brief Write a binary checkpoint of the state (collective)
+    @param filename  Name of checkpoint - on more than one rank, each
+                     rank writes <filename>.<nprocs>.<rank>
+
+    Writes the materials with their cell sets and the raw data of all
+    state vectors (univalued, multi-level, structure-of-arrays and
+    multi-material) whose data can be copied bytewise
+  */
+
+  void write_checkpoint(std::string const& filename);
+
+  /*!
+    @brief Restore the state from a binary checkpoint (collective)
+    @param filename  Name of checkpoint given to write_checkpoint
+
+    Must be called on the same mesh and number of ranks the
+    checkpoint was written from. Materials are added if the state has
+    none (otherwise they must match the checkpoint). Vectors already
+    in the state are filled with the checkpointed data; missing
+    vectors are created if their data type is int, float, double or
+    std::array<double, 2/3/6>. Data is restored bit for bit
+  */
+
+  void read_checkpoint(std::string const& filename);
+
+  /*!
+    @brief Move the state to a redistributed mesh (collective)
+    @param newmesh  Mesh made from the mesh of this state by
+                    MeshFactory::redistribute
+    @return         State on newmesh with the same memory policy
+
+    Materials and all state vectors on the mesh (univalued,
+    multi-level, structure-of-arrays and multi-material) whose data
+    can be copied bytewise are carried over entity by entity through
+    the global IDs, ghost values included. Vectors on tiles or on
+    ghost entities only cannot be moved and are reported
+  */
+
+  std::shared_ptr<State> migrate(std::shared_ptr<Mesh> newmesh);
+
   /// @brief Import field data from mesh
   void init_from_mesh();
 
@@ -1422,7 +1592,9 @@ class State : public std::enable_shared_from_this<State> {
   //  constructors in which case State cannot be created on the stack,
   //  only on the heap
 
-  explicit State(std::shared_ptr<Jali::Mesh> mesh) : mymesh_(mesh) {
+  explicit State(std::shared_ptr<Jali::Mesh> mesh,
+                 Memory_policy const policy = Memory_policy::DEFAULT) :
+      mymesh_(mesh), memory_policy_(policy) {
     Entity_ID_List dummy_owned_cells, dummy_ghost_cells;
     dummy_cellset_ = std::make_shared<MeshSet>("dummy_cellset_",
                                                *mesh, Entity_kind::CELL,
@@ -1436,6 +1608,9 @@ class State : public std::enable_shared_from_this<State> {
   // Constant pointer to the mesh associated with this state
   const std::shared_ptr<Mesh> mymesh_;
 
+  // Memory policy for state vector data
+  Memory_policy memory_policy_;
+
   // Meshsets associated with materials. If there is only one
   // material, there will be no meshset stored because its the whole
   // mesh
@@ -1461,6 +1636,15 @@ class State : public std::enable_shared_from_this<State> {
   // Names of the state vectors
   std::vector<std::string> names_;
 
+  // Add a univalued state vector for a mesh field and read the field
+  // straight into its storage
+  template <class T>
+  bool import_field(std::string const& name, Entity_kind kind);
+
+  // Store an array valued state vector (UniStateVector or
+  // SoAStateVector of std::array<double, N>) with the mesh
+  template <std::size_t N>
+  bool export_array_field(std::shared_ptr<StateVectorBase> vec);
 };
 
 std::ostream & operator<<(std::ostream & os, State const & s);
@@ -0,0 +1,305 @@
+/*
+ Copyright (c) 2019, Triad National Security, LLC
+ All rights reserved.
+
+ Copyright 2019. Triad National Security, LLC. This software was
+ produced under U.S. Government contract 89233218CNA000001 for Los
+ Alamos National Laboratory (LANL), which is operated by Triad
+ National Security, LLC for the U.S. Department of Energy. 
+ All rights in the program are reserved by Triad National Security,
+ LLC, and the U.S. Department of Energy/National Nuclear Security
+ Administration. The Government is granted for itself and others acting
+ on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+ in this material to reproduce, prepare derivative works, distribute
+ copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+
+ 
+ This is open source software distributed under the 3-clause BSD license.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of Triad National Security, LLC, Los Alamos
+    National Laboratory, LANL, the U.S. Government, nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ 
+ THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+ BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef JALI_STATE_ALLOCATOR_H_
+#define JALI_STATE_ALLOCATOR_H_
+
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <limits>
+#include <vector>
+#include <thread>
+#include <string>
+#include <iostream>
+#include <algorithm>
+#include <type_traits>
+
+#include <sys/mman.h>
+
+namespace Jali {
+
+/*!
+  @brief Memory policies for storage of state vector data
+
+  DEFAULT     - Memory is aligned for the largest fundamental type (like
+                std::allocator)
+  ALIGNED     - Memory is aligned to 64 byte (cache line, AVX-512) boundaries
+  HUGE_PAGE   - Large arrays are aligned to 2 MB boundaries and the OS is
+                advised to back them with transparent huge pages. Small
+                arrays are treated as ALIGNED
+  FIRST_TOUCH - Memory is 64 byte aligned and not touched at
+                allocation. State vectors on a tiled mesh then initialize
+                the entries of different tiles from different threads so
+                that the pages end up on the NUMA domain of the thread
+                that first touched them
+*/
+
+enum class Memory_policy : std::uint8_t {
+  DEFAULT,
+  ALIGNED,
+  HUGE_PAGE,
+  FIRST_TOUCH
+};
+constexpr int NUM_MEMORY_POLICIES = 4;
+
+// Return an string description for each memory policy
+inline
+std::string Memory_policy_string(const Memory_policy policy) {
+  static std::string memory_policy_str[NUM_MEMORY_POLICIES] =
+      {"Memory_policy::DEFAULT", "Memory_policy::ALIGNED",
+       "Memory_policy::HUGE_PAGE", "Memory_policy::FIRST_TOUCH"};
+
+  int ipolicy = static_cast<int>(policy);
+  return (ipolicy >= 0 && ipolicy < NUM_MEMORY_POLICIES) ?
+      memory_policy_str[ipolicy] : "";
+}
+
+// Output operator for Memory_policy
+inline
+std::ostream& operator<<(std::ostream& os, const Memory_policy& policy) {
+  os << " " << Memory_policy_string(policy) << " ";
+  return os;
+}
+
+constexpr std::size_t STATE_CACHE_LINE_SIZE = 64;
+constexpr std::size_t STATE_HUGE_PAGE_SIZE = 2*1024*1024;
+
+// Alignment (in bytes) used for an array of nbytes under a given policy
+
+inline
+std::size_t memory_policy_alignment(const Memory_policy policy,
+                                    const std::size_t nbytes) {
+  switch (policy) {
+    case Memory_policy::DEFAULT:
+      return std::max(alignof(std::max_align_t), sizeof(void *));
+    case Memory_policy::HUGE_PAGE:
+      return (nbytes >= STATE_HUGE_PAGE_SIZE) ? STATE_HUGE_PAGE_SIZE :
+          STATE_CACHE_LINE_SIZE;
+    default:
+      return STATE_CACHE_LINE_SIZE;
+  }
+}
+
+
+/*!
+  @class StateAllocator JaliStateAllocator.h
+  @brief Allocator for state vector data that honors a Memory_policy
+
+  All policies allocate with posix_memalign and release with free, so
+  memory allocated under one policy can be released by an allocator
+  with any other policy; therefore, all StateAllocators compare
+  equal. The policy propagates with the container on copy, move and
+  swap.
+
+  @tparam T   Type of data being allocated
+*/
+
+template <class T>
+class StateAllocator {
+ public:
+  typedef T value_type;
+  typedef T* pointer;
+  typedef T const* const_pointer;
+  typedef T& reference;
+  typedef T const& const_reference;
+  typedef std::size_t size_type;
+  typedef std::ptrdiff_t difference_type;
+  typedef std::true_type propagate_on_container_copy_assignment;
+  typedef std::true_type propagate_on_container_move_assignment;
+  typedef std::true_type propagate_on_container_swap;
+
+  template <class U> struct rebind { typedef StateAllocator<U> other; };
+
+  /// Constructor
+
+  StateAllocator() : policy_(Memory_policy::DEFAULT) {}
+
+  /// Constructor with a memory policy
+
+  explicit StateAllocator(Memory_policy policy) : policy_(policy) {}
+
+  /// Converting constructor (needed by containers that rebind)
+
+  template <class U>
+  StateAllocator(StateAllocator<U> const& other) : policy_(other.policy()) {}
+
+  /// Memory policy of the allocator
+
+  Memory_policy policy() const { return policy_; }
+
+  /// Allocate uninitialized storage for n elements
+
+  T* allocate(std::size_t n) {
+    if (n == 0) return nullptr;
+    if (n > max_size()) throw std::bad_alloc();
+
+    std::size_t nbytes = n*sizeof(T);
+    std::size_t alignment =
+        std::max(memory_policy_alignment(policy_, nbytes), alignof(T));
+
+    void *ptr = nullptr;
+    if (posix_memalign(&ptr, alignment, nbytes) != 0)
+      throw std::bad_alloc();
+
+#ifdef MADV_HUGEPAGE
+    // advisory only - ignore failures on systems without THP
+    if (alignment == STATE_HUGE_PAGE_SIZE)
+      madvise(ptr, nbytes - nbytes%STATE_HUGE_PAGE_SIZE, MADV_HUGEPAGE);
+#endif
+
+    return static_cast<T*>(ptr);
+  }
+
+  /// Release storage
+
+  void deallocate(T *ptr, std::size_t n) { free(ptr); }
+
+  /// Maximum number of elements that can be allocated
+
+  std::size_t max_size() const {
+    return std::numeric_limits<std::size_t>::max()/sizeof(T);
+  }
+
+  /// Construct an element with arguments
+
+  template <class U, class... Args>
+  void construct(U *ptr, Args&&... args) {
+    ::new(static_cast<void *>(ptr)) U(std::forward<Args>(args)...);
+  }
+
+  /// Construct an element with no arguments - value initialized
+  /// except for trivial types under the FIRST_TOUCH policy which are
+  /// left alone so that the pages are not touched
+
+  template <class U>
+  void construct(U *ptr) {
+    if (policy_ == Memory_policy::FIRST_TOUCH &&
+        std::is_trivially_default_constructible<U>::value)
+      ::new(static_cast<void *>(ptr)) U;
+    else
+      ::new(static_cast<void *>(ptr)) U();
+  }
+
+  /// Destroy an element
+
+  template <class U>
+  void destroy(U *ptr) { ptr->~U(); }
+
+ private:
+  Memory_policy policy_;
+};
+
+template <class T, class U>
+bool operator==(StateAllocator<T> const&, StateAllocator<U> const&) {
+  return true;
+}
+
+template <class T, class U>
+bool operator!=(StateAllocator<T> const&, StateAllocator<U> const&) {
+  return false;
+}
+
+
+/// Array type used for storing state vector data
+
+template <class T>
+using StateArray = std::vector<T, StateAllocator<T>>;
+
+
+/*!
+  @brief Touch entries of an array from multiple threads, one group of
+  entries at a time
+
+  @param n        Number of entries in the array
+  @param parts    Groups of entry indices (typically one per mesh tile)
+  @param touch    Function called as touch(i) to initialize entry i
+
+  Group p is processed by thread (p mod nthreads) where nthreads is
+  the smaller of the number of groups and the number of hardware
+  threads, so the same group always lands on the same thread. Entries
+  not in any group (or all entries if there are no groups) are
+  touched by the calling thread afterwards. Groups must be disjoint.
+*/
+
+template <class Function>
+void first_touch(std::size_t n, std::vector<std::vector<int>> const& parts,
+                 Function const& touch) {
+  std::vector<char> touched(n, 0);
+
+  int nparts = parts.size();
+  int nthreads = std::min(nparts,
+                          static_cast<int>(std::thread::hardware_concurrency()));
+
+  auto touch_parts = [&](int t, int stride) {
+    for (int p = t; p < nparts; p += stride)
+      for (auto const& i : parts[p])
+        if (i >= 0 && static_cast<std::size_t>(i) < n) {
+          touch(i);
+          touched[i] = 1;
+        }
+  };
+
+  if (nthreads > 1) {
+    std::vector<std::thread> workers;
+    for (int t = 0; t < nthreads; ++t)
+      workers.emplace_back(touch_parts, t, nthreads);
+    for (auto & w : workers)
+      w.join();
+  } else if (nparts) {
+    touch_parts(0, 1);
+  }
+
+  for (std::size_t i = 0; i < n; ++i)
+    if (!touched[i]) touch(i);
+}
+
+}  // namespace Jali
+
+#endif  // JALI_STATE_ALLOCATOR_H_
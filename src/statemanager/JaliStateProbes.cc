@@ -0,0 +1,422 @@
+/*
+ Copyright (c) 2019, Triad National Security, LLC
+ All rights reserved.
+
+ Copyright 2019. Triad National Security, LLC. This software was
+ produced under U.S. Government contract 89233218CNA000001 for Los
+ Alamos National Laboratory (LANL), which is operated by Triad
+ National Security, LLC for the U.S. Department of Energy. 
+ All rights in the program are reserved by Triad National Security,
+ LLC, and the U.S. Department of Energy/National Nuclear Security
+ Administration. The Government is granted for itself and others acting
+ on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+ in this material to reproduce, prepare derivative works, distribute
+ copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+
+ 
+ This is open source software distributed under the 3-clause BSD license.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of Triad National Security, LLC, Los Alamos
+    National Laboratory, LANL, the U.S. Government, nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ 
+ THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+ BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+#include "JaliStateProbes.h"
+#include "JaliState.h"
+#include "JaliStateVector.h"
+#include "JaliStateWriter.h"
+#include "errors.hh"
+#include "Mesh.hh"
+
+namespace Jali {
+
+namespace {
+
+// Weights w of the nodes x_j of a cell that reproduce linear functions
+// at p (sum_j w_j = 1, sum_j w_j x_j = p) with the smallest norm, from
+// the normal equations of the (dim+1) x n system in coordinates
+// centered and scaled to the nodes
+
+std::vector<double> linear_weights(JaliGeometry::Point const& p,
+                                   std::vector<JaliGeometry::Point> const&
+                                   coords) {
+  int dim = p.dim();
+  int n = coords.size();
+  int m = dim+1;
+
+  JaliGeometry::Point center(dim);
+  for (auto const& x : coords) center += x;
+  center /= n;
+  double h = 0.0;
+  for (auto const& x : coords) h = std::max(h, norm(x - center));
+  if (h == 0.0) h = 1.0;
+
+  std::vector<double> a(m*n);
+  for (int j = 0; j < n; j++) {
+    a[j] = 1.0;
+    for (int d = 0; d < dim; d++)
+      a[(d+1)*n+j] = (coords[j][d] - center[d])/h;
+  }
+  std::vector<double> g(m*m, 0.0), y(m);
+  for (int k = 0; k < m; k++)
+    for (int l = 0; l < m; l++)
+      for (int j = 0; j < n; j++)
+        g[k*m+l] += a[k*n+j]*a[l*n+j];
+  y[0] = 1.0;
+  for (int d = 0; d < dim; d++)
+    y[d+1] = (p[d] - center[d])/h;
+
+  // Gaussian elimination with partial pivoting
+
+  for (int k = 0; k < m; k++) {
+    int piv = k;
+    for (int l = k+1; l < m; l++)
+      if (std::fabs(g[l*m+k]) > std::fabs(g[piv*m+k])) piv = l;
+    if (g[piv*m+k] == 0.0) {
+      Errors::Message mesg("StateProbes: degenerate cell");
+      Exceptions::Jali_throw(mesg);
+    }
+    if (piv != k) {
+      for (int l = 0; l < m; l++)
+        std::swap(g[k*m+l], g[piv*m+l]);
+      std::swap(y[k], y[piv]);
+    }
+    for (int l = k+1; l < m; l++) {
+      double f = g[l*m+k]/g[k*m+k];
+      for (int i = k; i < m; i++)
+        g[l*m+i] -= f*g[k*m+i];
+      y[l] -= f*y[k];
+    }
+  }
+  for (int k = m-1; k >= 0; k--) {
+    for (int l = k+1; l < m; l++)
+      y[k] -= g[k*m+l]*y[l];
+    y[k] /= g[k*m+k];
+  }
+
+  std::vector<double> weights(n, 0.0);
+  for (int j = 0; j < n; j++)
+    for (int k = 0; k < m; k++)
+      weights[j] += a[k*n+j]*y[k];
+  return weights;
+}
+
+}  // namespace
+
+
+StateProbes::StateProbes(std::shared_ptr<State> state,
+                         std::vector<std::string> const& fields,
+                         int capacity) :
+    state_(state), mesh_(state->mesh()), fields_(fields),
+    capacity_(capacity) {
+  if (capacity_ < 1) {
+    Errors::Message mesg("StateProbes: capacity must be positive");
+    Exceptions::Jali_throw(mesg);
+  }
+  geometry_version_ = mesh_->geometry_version();
+  MPI_Comm_size(mesh_->get_comm(), &nprocs_);
+  MPI_Comm_rank(mesh_->get_comm(), &rank_);
+  thread_ = std::thread(&StateProbes::run, this);
+}
+
+
+StateProbes::~StateProbes() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    done_ = true;
+  }
+  cv_.notify_all();
+  thread_.join();
+
+  for (auto const& filename : failed_)
+    std::cerr << "StateProbes: could not write " << filename << "\n";
+}
+
+
+int StateProbes::add_probe(JaliGeometry::Point const& p) {
+  if (num_records_ || num_dropped_ || !files_.empty()) {
+    Errors::Message mesg("StateProbes: probes must be added before"
+                         " sampling");
+    Exceptions::Jali_throw(mesg);
+  }
+  Probe probe;
+  probe.point = p;
+  locate(&probe);
+  probes_.push_back(probe);
+  weights_current_ = false;
+  return probes_.size()-1;
+}
+
+
+// Find the cell containing the probe and compute its weights, keeping
+// it only if this rank owns the cell
+
+void StateProbes::locate(Probe *probe) const {
+  probe->cell = -1;
+  probe->nodes.clear();
+  probe->weights.clear();
+  probe->coords.clear();
+
+  Entity_ID_List candidates;
+  mesh_->cells_intersecting_box(probe->point, probe->point, &candidates);
+  Entity_ID mingid = -1;
+  for (auto const& c : candidates)
+    if (mesh_->point_in_cell(probe->point, c)) {
+      Entity_ID gid = mesh_->GID(c, Entity_kind::CELL);
+      if (mingid < 0 || gid < mingid) {
+        mingid = gid;
+        probe->cell = c;
+      }
+    }
+  if (probe->cell < 0) return;
+  if (probe->cell >= mesh_->num_cells<Entity_type::PARALLEL_OWNED>()) {
+    probe->cell = -1;
+    return;
+  }
+
+  mesh_->cell_get_nodes(probe->cell, &probe->nodes);
+  probe->coords.resize(probe->nodes.size());
+  for (int j = 0; j < probe->nodes.size(); j++)
+    mesh_->node_get_coordinates(probe->nodes[j], &probe->coords[j]);
+  probe->weights = linear_weights(probe->point, probe->coords);
+}
+
+
+// Relocate probes whose cells changed since the geometry was last
+// updated and rebuild the weights of all probes if any moved
+
+void StateProbes::update() {
+  if (mesh_->geometry_version() != geometry_version_) {
+    geometry_version_ = mesh_->geometry_version();
+    for (auto& probe : probes_) {
+      bool moved = (probe.cell < 0);
+      for (int j = 0; j < probe.nodes.size() && !moved; j++) {
+        JaliGeometry::Point xyz;
+        mesh_->node_get_coordinates(probe.nodes[j], &xyz);
+        moved = (L22(xyz - probe.coords[j]) > 0.0);
+      }
+      if (moved) {
+        locate(&probe);
+        num_relocations_++;
+        weights_current_ = false;
+      }
+    }
+  }
+
+  if (weights_current_) return;
+  offsets_.assign(1, 0);
+  cells_.clear();
+  nodes_.clear();
+  weights_.clear();
+  probe_ids_.clear();
+  for (int i = 0; i < probes_.size(); i++) {
+    Probe const& probe = probes_[i];
+    if (probe.cell < 0) continue;
+    probe_ids_.push_back(i);
+    cells_.push_back(probe.cell);
+    nodes_.insert(nodes_.end(), probe.nodes.begin(), probe.nodes.end());
+    weights_.insert(weights_.end(), probe.weights.begin(),
+                    probe.weights.end());
+    offsets_.push_back(nodes_.size());
+  }
+  weights_current_ = true;
+}
+
+
+void StateProbes::sample(double time) {
+  update();
+
+  // Data of the fields, checking they can be sampled at the probes
+
+  int nfields = fields_.size();
+  std::vector<double const *> data(nfields);
+  std::vector<bool> onnodes(nfields);
+  int nnodes = mesh_->num_nodes<Entity_type::ALL>();
+  int ncells = mesh_->num_cells<Entity_type::PARALLEL_OWNED>();
+  for (int f = 0; f < nfields; f++) {
+    auto it = state_->find(fields_[f], mesh_);
+    std::shared_ptr<UniStateVector<double>> vec;
+    if (it != state_->end())
+      vec = std::dynamic_pointer_cast<UniStateVector<double>>(*it);
+    if (!vec ||
+        (vec->entity_kind() == Entity_kind::NODE ?
+         vec->size() < nnodes :
+         vec->entity_kind() != Entity_kind::CELL || vec->size() < ncells)) {
+      Errors::Message mesg("StateProbes: cannot sample " + fields_[f] +
+                           " (not a double vector on all nodes or on the"
+                           " owned cells of the mesh)");
+      Exceptions::Jali_throw(mesg);
+    }
+    data[f] = vec->get_raw_data();
+    onnodes[f] = (vec->entity_kind() == Entity_kind::NODE);
+  }
+
+  // Take the slot of the next record, overwriting the oldest if full
+
+  int rowsize = 1 + probes_.size()*nfields;
+  records_.resize(capacity_*rowsize);
+  int slot = (first_ + num_records_) % capacity_;
+  if (num_records_ == capacity_) {
+    first_ = (first_+1) % capacity_;
+    num_dropped_++;
+  } else {
+    num_records_++;
+  }
+
+  double *row = &(records_[slot*rowsize]);
+  row[0] = time;
+  std::fill(row+1, row+rowsize, std::numeric_limits<double>::quiet_NaN());
+  for (int k = 0; k < probe_ids_.size(); k++) {
+    double *vals = row + 1 + probe_ids_[k]*nfields;
+    for (int f = 0; f < nfields; f++) {
+      if (onnodes[f]) {
+        double val = 0.0;
+        for (int j = offsets_[k]; j < offsets_[k+1]; j++)
+          val += weights_[j]*data[f][nodes_[j]];
+        vals[f] = val;
+      } else {
+        vals[f] = data[f][cells_[k]];
+      }
+    }
+  }
+}
+
+
+double StateProbes::time(int r) const {
+  int rowsize = 1 + probes_.size()*fields_.size();
+  return records_[((first_+r) % capacity_)*rowsize];
+}
+
+
+double StateProbes::value(int r, int i, int f) const {
+  int rowsize = 1 + probes_.size()*fields_.size();
+  return records_[((first_+r) % capacity_)*rowsize + 1 +
+                  i*fields_.size() + f];
+}
+
+
+void StateProbes::flush(std::string const& filename) {
+  Job job;
+  job.filename = checkpoint_filename(filename, nprocs_, rank_);
+  bool first = (std::find(files_.begin(), files_.end(), job.filename) ==
+                files_.end());
+  if (!num_records_ && !first) return;
+
+  if (first) {
+    files_.push_back(job.filename);
+    std::ostringstream header;
+    header << std::setprecision(17);
+    for (int i = 0; i < probes_.size(); i++) {
+      header << "# probe " << i << " at";
+      for (int d = 0; d < probes_[i].point.dim(); d++)
+        header << " " << probes_[i].point[d];
+      header << "\n";
+    }
+    header << "# time";
+    for (int i = 0; i < probes_.size(); i++)
+      for (auto const& field : fields_)
+        header << " " << i << ":" << field;
+    header << "\n";
+    job.header = header.str();
+  }
+
+  job.rowsize = 1 + probes_.size()*fields_.size();
+  job.records.resize(num_records_*job.rowsize);
+  for (int r = 0; r < num_records_; r++)
+    std::copy_n(&(records_[((first_+r) % capacity_)*job.rowsize]),
+                job.rowsize, &(job.records[r*job.rowsize]));
+  first_ = 0;
+  num_records_ = 0;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push_back(std::move(job));
+  }
+  cv_.notify_all();
+}
+
+
+void StateProbes::wait() {
+  std::string failed;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [&]() { return queue_.empty() && !busy_; });
+    for (auto const& filename : failed_)
+      failed += " " + filename;
+    failed_.clear();
+  }
+  if (!failed.empty()) {
+    Errors::Message mesg("StateProbes: could not write" + failed);
+    Exceptions::Jali_throw(mesg);
+  }
+}
+
+
+// Background thread - append flushed records to their files in order
+
+void StateProbes::run() {
+  while (true) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [&]() { return !queue_.empty() || done_; });
+      if (queue_.empty()) return;
+      job = std::move(queue_.front());
+      queue_.pop_front();
+      busy_ = true;
+    }
+
+    std::ofstream file(job.filename, job.header.empty() ?
+                       std::ios::app : std::ios::trunc);
+    file << job.header << std::setprecision(17);
+    for (int r = 0; r < job.records.size(); r += job.rowsize) {
+      file << job.records[r];
+      for (int j = 1; j < job.rowsize; j++)
+        file << " " << job.records[r+j];
+      file << "\n";
+    }
+    file.close();
+    bool ok = !file.fail();
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      busy_ = false;
+      if (!ok) failed_.push_back(job.filename);
+    }
+    cv_.notify_all();
+  }
+}
+
+}  // namespace Jali
@@ -0,0 +1,235 @@
+/*
+ Copyright (c) 2019, Triad National Security, LLC
+ All rights reserved.
+
+ Copyright 2019. Triad National Security, LLC. This software was
+ produced under U.S. Government contract 89233218CNA000001 for Los
+ Alamos National Laboratory (LANL), which is operated by Triad
+ National Security, LLC for the U.S. Department of Energy. 
+ All rights in the program are reserved by Triad National Security,
+ LLC, and the U.S. Department of Energy/National Nuclear Security
+ Administration. The Government is granted for itself and others acting
+ on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+ in this material to reproduce, prepare derivative works, distribute
+ copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+
+ 
+ This is open source software distributed under the 3-clause BSD license.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of Triad National Security, LLC, Los Alamos
+    National Laboratory, LANL, the U.S. Government, nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ 
+ THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+ BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#ifndef JALI_STATE_PROBES_H_
+#define JALI_STATE_PROBES_H_
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MeshDefs.hh"
+#include "Point.hh"
+
+namespace Jali {
+
+class Mesh;
+class State;
+
+/*!
+  @class StateProbes JaliStateProbes.h
+  @brief Time histories of state vectors sampled at fixed points
+
+  Probes are located once, when added: each is assigned to the rank
+  owning the cell that contains it (the one with the lowest global ID
+  if it is on the boundary of several cells), and interpolation
+  weights over the nodes of that cell are computed then. The weights
+  reproduce linear functions of the coordinates exactly. Node fields
+  are interpolated with them and cell fields take the value of the
+  containing cell.
+
+  After nodes are moved and update_geometric_quantities is called,
+  the next sample only relocates the probes whose cell has a moved
+  node (and those not in any cell on this rank), reusing the weights
+  of all the others.
+
+  sample() gathers all the fields at all the probes of this rank in
+  one pass into a ring buffer of records holding the time and a value
+  for each probe and field (NaN for probes on other ranks). Once the
+  buffer is full, the oldest record is overwritten. flush() hands the
+  records over to a background thread, which appends them to a text
+  file per rank, and empties the buffer. Nothing here is collective.
+
+  Example:
+
+  StateProbes probes(state, {"pressure", "velocity_x"}, 1000);
+  for (auto const& p : points)
+    probes.add_probe(p);
+  for (int cycle = 0; cycle < ncycles; cycle++) {
+    advance(state);
+    probes.sample(time);
+    if (probes.full())
+      probes.flush("history");
+  }
+  probes.flush("history");
+  probes.wait();
+*/
+
+class StateProbes {
+ public:
+
+  /*!
+    @brief Constructor
+    @param state     State holding the fields sampled
+    @param fields    Names of the fields - univalued double state vectors
+                     on the cells or nodes of the mesh of the state
+    @param capacity  Number of records the ring buffer holds
+  */
+
+  StateProbes(std::shared_ptr<State> state,
+              std::vector<std::string> const& fields,
+              int capacity = 1024);
+
+  /// Destructor - waits for pending flushes (errors are printed)
+  ~StateProbes();
+
+  StateProbes(StateProbes const&) = delete;
+  StateProbes& operator=(StateProbes const&) = delete;
+
+  /// Add a probe at point p before sampling starts; returns its index
+  /// (the same on all ranks if all ranks add the same probes)
+  int add_probe(JaliGeometry::Point const& p);
+
+  /// Number of probes
+  int num_probes() const { return probes_.size(); }
+
+  /// Number of fields sampled
+  int num_fields() const { return fields_.size(); }
+
+  /// Cell containing a probe if it is on this rank, -1 otherwise
+  Entity_ID probe_cell(int i) const { return probes_[i].cell; }
+
+  /// Number of times probes were located after the first time
+  int num_relocations() const { return num_relocations_; }
+
+  /// Sample all the fields at all the probes and record them with time
+  void sample(double time);
+
+  /// Number of records in the buffer
+  int num_records() const { return num_records_; }
+
+  /// Is the buffer full?
+  bool full() const { return num_records_ == capacity_; }
+
+  /// Number of records overwritten before they were flushed
+  int num_dropped() const { return num_dropped_; }
+
+  /// Time of record r (0 being the oldest in the buffer)
+  double time(int r) const;
+
+  /// Value of field f at probe i in record r (NaN if not on this rank)
+  double value(int r, int i, int f) const;
+
+  /*!
+    @brief Append the records to a file in the background and empty
+    the buffer
+    @param filename  Name of file - on more than one rank, each rank
+                     writes <filename>.<nprocs>.<rank>
+
+    The first flush to a file replaces it and writes a header naming
+    the columns. Each record is a line with the time followed by the
+    value of each field at each probe
+  */
+
+  void flush(std::string const& filename);
+
+  /// Wait until all flushed records are written. Throws if any file
+  /// could not be written
+  void wait();
+
+ private:
+
+  struct Probe {
+    JaliGeometry::Point point;
+    Entity_ID cell = -1;
+    Entity_ID_List nodes;
+    std::vector<double> weights;
+    std::vector<JaliGeometry::Point> coords;  // of nodes when located
+  };
+
+  struct Job {
+    std::string filename;
+    std::string header;   // written first if not empty, replacing the file
+    int rowsize;
+    std::vector<double> records;
+  };
+
+  void locate(Probe *probe) const;
+  void update();
+  void run();
+
+  std::shared_ptr<State> state_;
+  std::shared_ptr<Mesh> mesh_;
+  std::vector<std::string> fields_;
+  std::vector<Probe> probes_;
+  unsigned int geometry_version_;
+  int num_relocations_ = 0;
+
+  // Weights of all the probes in compressed row storage, rebuilt
+  // whenever a probe is located
+
+  bool weights_current_ = false;
+  std::vector<int> offsets_;
+  Entity_ID_List cells_, nodes_;
+  std::vector<double> weights_;
+  std::vector<int> probe_ids_;
+
+  // Ring buffer of records (time followed by the values)
+
+  int capacity_, first_ = 0, num_records_ = 0, num_dropped_ = 0;
+  std::vector<double> records_;
+
+  // Background writing
+
+  int nprocs_, rank_;
+  std::vector<std::string> files_;
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<Job> queue_;
+  bool busy_ = false;
+  bool done_ = false;
+  std::vector<std::string> failed_;
+};
+
+}  // namespace Jali
+
+#endif  // JALI_STATE_PROBES_H_
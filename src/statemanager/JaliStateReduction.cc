@@ -0,0 +1,321 @@
+/*
+ Copyright (c) 2019, Triad National Security, LLC
+ All rights reserved.
+
+ Copyright 2019. Triad National Security, LLC. This software was
+ produced under U.S. Government contract 89233218CNA000001 for Los
+ Alamos National Laboratory (LANL), which is operated by Triad
+ National Security, LLC for the U.S. Department of Energy. 
+ All rights in the program are reserved by Triad National Security,
+ LLC, and the U.S. Department of Energy/National Nuclear Security
+ Administration. The Government is granted for itself and others acting
+ on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+ in this material to reproduce, prepare derivative works, distribute
+ copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+
+ 
+ This is open source software distributed under the 3-clause BSD license.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of Triad National Security, LLC, Los Alamos
+    National Laboratory, LANL, the U.S. Government, nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ 
+ THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+ BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <thread>
+#include <stdexcept>
+#include <algorithm>
+
+#include "JaliStateReduction.h"
+#include "Mesh.hh"
+
+namespace Jali {
+
+namespace {
+
+// Reproducible sums split each double into integer pieces of
+// BIN_WIDTH bits that are accumulated in bins, bin b holding a
+// multiple of 2^(BIN_WIDTH*b - 1074) (2^-1074 is the smallest
+// denormal). Every bin stays an exactly representable integer as long
+// as fewer than 2^(53-BIN_WIDTH) pieces are added to it, so the sum is
+// independent of the order of addition.
+
+constexpr int BIN_WIDTH = 20;
+constexpr int MAX_SHIFT = 2045;  // largest exponent of a double above 2^-1074
+constexpr int NUM_PIECES = 4;    // pieces of a 53 bit mantissa shifted by < 20
+constexpr int NUM_BINS = MAX_SHIFT/BIN_WIDTH + NUM_PIECES + 1;
+
+// Add a finite value to the bins
+
+void bin_add(double x, double *bins) {
+  if (x == 0.0) return;
+
+  int e;
+  double mant = std::ldexp(std::fabs(std::frexp(x, &e)), 53);
+  int shift = e + 1021;   // x = mant * 2^(shift - 1074)
+  if (shift < 0) {        // denormals - mant has enough trailing zeros
+    mant = std::ldexp(mant, shift);
+    shift = 0;
+  }
+
+  int b = shift/BIN_WIDTH;
+  double v = std::ldexp(mant, shift % BIN_WIDTH);
+  double sign = (x < 0.0) ? -1.0 : 1.0;
+  double const binsize = std::ldexp(1.0, BIN_WIDTH);
+  for (int k = 0; k < NUM_PIECES; k++) {
+    double piece = std::fmod(std::floor(std::ldexp(v, -BIN_WIDTH*k)),
+                             binsize);
+    bins[b+k] += sign*piece;
+  }
+}
+
+// Convert bins to a double (bins are modified)
+
+double bin_total(double *bins) {
+  for (int b = 0; b < NUM_BINS-1; b++) {
+    double carry = std::floor(std::ldexp(bins[b], -BIN_WIDTH));
+    bins[b] -= std::ldexp(carry, BIN_WIDTH);
+    bins[b+1] += carry;
+  }
+
+  double sum = 0.0;
+  for (int b = NUM_BINS-1; b >= 0; b--)
+    sum += std::ldexp(bins[b], BIN_WIDTH*b - 1074);
+  return sum;
+}
+
+// Number of buffer entries for the partial result of a reduction
+
+int num_slots(Reduction_type type, bool reproducible) {
+  return (type == Reduction_type::SUM && reproducible) ? NUM_BINS + 1 : 1;
+}
+
+// Reduce entries [begin, end) of data (or of data[ids]) into out
+
+template <class T>
+void reduce_range(T const *data, Entity_ID const *ids, int begin, int end,
+                  Reduction_type type, bool reproducible, double *out) {
+  for (int i = begin; i < end; i++) {
+    double val = ids ? data[ids[i]] : data[i];
+    switch (type) {
+      case Reduction_type::MIN:   // stored as max of -val
+        out[0] = std::max(out[0], -val);
+        break;
+      case Reduction_type::MAX:
+        out[0] = std::max(out[0], val);
+        break;
+      case Reduction_type::SUM:
+        if (reproducible) {
+          if (std::isfinite(val))
+            bin_add(val, out);
+          else
+            out[NUM_BINS] += val;   // inf and nan are summed separately
+        } else {
+          out[0] += val;
+        }
+        break;
+    }
+  }
+}
+
+// Combine two reduction buffers. The first entry is the number of max
+// slots that follow it; the remaining entries are sums
+
+void combine_buffer(double const *in, double *inout, int size) {
+  int nmax = static_cast<int>(in[0]);
+  for (int i = 1; i <= nmax; i++)
+    inout[i] = std::max(inout[i], in[i]);
+  for (int i = nmax+1; i < size; i++)
+    inout[i] += in[i];
+}
+
+// MPI user operation combining whole reduction buffers (the buffer is
+// one element of a contiguous datatype so MPI never splits it)
+
+void combine_buffer_op(void *in, void *inout, int *len,
+                       MPI_Datatype *datatype) {
+  int nbytes;
+  MPI_Type_size(*datatype, &nbytes);
+  int size = nbytes/sizeof(double);
+  for (int l = 0; l < *len; l++)
+    combine_buffer(static_cast<double *>(in) + l*size,
+                   static_cast<double *>(inout) + l*size, size);
+}
+
+}  // namespace
+
+
+// Owned entities of a kind in the mesh
+
+const std::vector<Entity_ID>& owned_entities(Mesh const& mesh,
+                                             Entity_kind kind) {
+  switch (kind) {
+    case Entity_kind::NODE:
+      return mesh.nodes<Entity_type::PARALLEL_OWNED>();
+    case Entity_kind::EDGE:
+      return mesh.edges<Entity_type::PARALLEL_OWNED>();
+    case Entity_kind::FACE:
+      return mesh.faces<Entity_type::PARALLEL_OWNED>();
+    case Entity_kind::SIDE:
+      return mesh.sides<Entity_type::PARALLEL_OWNED>();
+    case Entity_kind::WEDGE:
+      return mesh.wedges<Entity_type::PARALLEL_OWNED>();
+    case Entity_kind::CORNER:
+      return mesh.corners<Entity_type::PARALLEL_OWNED>();
+    case Entity_kind::CELL:
+      return mesh.cells<Entity_type::PARALLEL_OWNED>();
+    default:
+      throw std::runtime_error("owned_entities: invalid entity kind");
+  }
+}
+
+
+int StateReduction::add(double const *data, int num, Entity_ID const *ids,
+                        Reduction_type type) {
+  return add_request(data, false, num, ids, type);
+}
+
+int StateReduction::add(int const *data, int num, Entity_ID const *ids,
+                        Reduction_type type) {
+  return add_request(data, true, num, ids, type);
+}
+
+int StateReduction::add_request(void const *data, bool is_int, int num,
+                                Entity_ID const *ids, Reduction_type type) {
+  requests_.push_back({data, is_int, num, ids, type, 0});
+  return requests_.size()-1;
+}
+
+
+// Lay out the reduction buffer - a header with the number of max
+// slots, the max slots (MIN and MAX reductions) and then the sum slots
+
+int StateReduction::buffer_size() const {
+  int size = 1;
+  for (auto const& r : requests_)
+    size += num_slots(r.type, reproducible_);
+  return size;
+}
+
+void StateReduction::local_pass(int ithread, int nthreads,
+                                std::vector<double> *partial) const {
+  for (auto const& r : requests_) {
+    int begin = static_cast<int64_t>(r.num)*ithread/nthreads;
+    int end = static_cast<int64_t>(r.num)*(ithread+1)/nthreads;
+    double *out = partial->data() + r.offset;
+    if (r.is_int)
+      reduce_range(static_cast<int const *>(r.data), r.ids, begin, end,
+                   r.type, reproducible_, out);
+    else
+      reduce_range(static_cast<double const *>(r.data), r.ids, begin, end,
+                   r.type, reproducible_, out);
+  }
+}
+
+
+void StateReduction::execute() {
+  int nreq = requests_.size();
+  int size = buffer_size();
+
+  int nmax = 0;
+  for (auto const& r : requests_)
+    if (r.type != Reduction_type::SUM) nmax++;
+
+  int maxoffset = 1, sumoffset = 1 + nmax;
+  for (auto & r : requests_) {
+    if (r.type == Reduction_type::SUM) {
+      r.offset = sumoffset;
+      sumoffset += num_slots(r.type, reproducible_);
+    } else {
+      r.offset = maxoffset++;
+    }
+  }
+
+  std::vector<double> init(size, 0.0);
+  init[0] = nmax;
+  std::fill(init.begin()+1, init.begin()+1+nmax,
+            -std::numeric_limits<double>::infinity());
+
+  // Local pass, split among threads
+
+  std::vector<std::vector<double>> partials(nthreads_, init);
+  if (nthreads_ > 1) {
+    std::vector<std::thread> workers;
+    for (int t = 1; t < nthreads_; t++)
+      workers.emplace_back(&StateReduction::local_pass, this, t, nthreads_,
+                           &partials[t]);
+    local_pass(0, nthreads_, &partials[0]);
+    for (auto & w : workers)
+      w.join();
+    for (int t = 1; t < nthreads_; t++)
+      combine_buffer(partials[t].data(), partials[0].data(), size);
+  } else {
+    local_pass(0, 1, &partials[0]);
+  }
+  std::vector<double>& buffer = partials[0];
+
+  // One collective for all reductions
+
+  int nprocs = 1;
+  MPI_Comm_size(comm_, &nprocs);
+  if (nprocs > 1) {
+    MPI_Datatype buftype;
+    MPI_Type_contiguous(size, MPI_DOUBLE, &buftype);
+    MPI_Type_commit(&buftype);
+    MPI_Op op;
+    MPI_Op_create(&combine_buffer_op, 1, &op);
+    MPI_Allreduce(MPI_IN_PLACE, buffer.data(), 1, buftype, op, comm_);
+    MPI_Op_free(&op);
+    MPI_Type_free(&buftype);
+  }
+
+  results_.resize(nreq);
+  for (int i = 0; i < nreq; i++) {
+    Request const& r = requests_[i];
+    double *out = buffer.data() + r.offset;
+    switch (r.type) {
+      case Reduction_type::MIN:
+        results_[i] = -out[0];
+        break;
+      case Reduction_type::MAX:
+        results_[i] = out[0];
+        break;
+      case Reduction_type::SUM:
+        if (reproducible_)
+          results_[i] = (out[NUM_BINS] == 0.0) ? bin_total(out) :
+              out[NUM_BINS];
+        else
+          results_[i] = out[0];
+        break;
+    }
+  }
+}
+
+}  // namespace Jali
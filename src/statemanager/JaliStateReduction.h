@@ -0,0 +1,232 @@
+/*
+ Copyright (c) 2019, Triad National Security, LLC
+ All rights reserved.
+
+ Copyright 2019. Triad National Security, LLC. This software was
+ produced under U.S. Government contract 89233218CNA000001 for Los
+ Alamos National Laboratory (LANL), which is operated by Triad
+ National Security, LLC for the U.S. Department of Energy. 
+ All rights in the program are reserved by Triad National Security,
+ LLC, and the U.S. Department of Energy/National Nuclear Security
+ Administration. The Government is granted for itself and others acting
+ on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+ in this material to reproduce, prepare derivative works, distribute
+ copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+
+ 
+ This is open source software distributed under the 3-clause BSD license.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of Triad National Security, LLC, Los Alamos
+    National Laboratory, LANL, the U.S. Government, nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ 
+ THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+ BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef JALI_STATE_REDUCTION_H_
+#define JALI_STATE_REDUCTION_H_
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#include <string>
+#include <iostream>
+
+#include "mpi.h"
+
+#include "MeshDefs.hh"
+
+namespace Jali {
+
+class Mesh;
+
+/*!
+  @brief Types of global reductions over state vector data
+*/
+
+enum class Reduction_type : std::uint8_t {
+  MIN,
+  MAX,
+  SUM
+};
+constexpr int NUM_REDUCTION_TYPES = 3;
+
+// Return an string description for each reduction type
+inline
+std::string Reduction_type_string(const Reduction_type type) {
+  static std::string reduction_type_str[NUM_REDUCTION_TYPES] =
+      {"Reduction_type::MIN", "Reduction_type::MAX", "Reduction_type::SUM"};
+
+  int itype = static_cast<int>(type);
+  return (itype >= 0 && itype < NUM_REDUCTION_TYPES) ?
+      reduction_type_str[itype] : "";
+}
+
+// Output operator for Reduction_type
+inline
+std::ostream& operator<<(std::ostream& os, const Reduction_type& type) {
+  os << " " << Reduction_type_string(type) << " ";
+  return os;
+}
+
+// Owned entities of a kind in the mesh
+const std::vector<Entity_ID>& owned_entities(Mesh const& mesh,
+                                             Entity_kind kind);
+
+
+/*!
+  @class StateReduction JaliStateReduction.h
+  @brief Batch of global reductions (MIN, MAX, SUM) over the owned
+  entities of state vectors
+
+  Reductions are registered with add() and computed together by
+  execute() in one local pass over the data (optionally split among
+  several threads) followed by a single MPI_Allreduce for the whole
+  batch. All ranks must register the same reductions in the same order.
+
+  In reproducible mode, sums are accumulated exactly in integer bins
+  (each a double holding an integer multiple of a power of 2) so that
+  the result is bitwise identical regardless of the number of ranks,
+  the number of threads and the order of summation. Exactness holds for
+  up to 2^33 summed entries.
+
+  Example:
+
+  StateReduction red(mesh->get_comm());
+  int idt = red.add(dt_limit, Reduction_type::MIN);
+  int imass = red.add(mass, Reduction_type::SUM);
+  red.execute();
+  double dt = red.result(idt), total_mass = red.result(imass);
+*/
+
+class StateReduction {
+ public:
+
+  /*!
+    @brief Constructor
+    @param comm          Communicator over which to reduce
+    @param reproducible  Compute bitwise reproducible sums
+    @param nthreads      Number of threads for the local pass
+  */
+
+  explicit StateReduction(MPI_Comm comm = MPI_COMM_WORLD,
+                          bool reproducible = false, int nthreads = 1) :
+      comm_(comm), reproducible_(reproducible),
+      nthreads_(nthreads > 1 ? nthreads : 1) {}
+
+  /*!
+    @brief Add a reduction of a univalued (int or double) state vector
+    on a mesh over its owned entities
+    @param vec   State vector (UniStateVector<int/double, Mesh> or derived)
+    @param type  Type of reduction
+    @return      Index of the reduction for retrieving its result
+
+    Throws std::runtime_error for vectors on other domains (such as
+    mesh tiles, whose entities are not numbered like the mesh's) and
+    for vectors on entity types other than PARALLEL_OWNED and ALL
+  */
+
+  template <class VecType>
+  int add(VecType const& vec, Reduction_type type) {
+    if (!std::is_same<decltype(vec.domain()), std::shared_ptr<Mesh>>::value)
+      throw std::runtime_error("StateReduction: vector " + vec.name() +
+                               " is not on a mesh");
+    Entity_type etype = vec.entity_type();
+    int num = 0;
+    Entity_ID const *ids = nullptr;
+    if (etype == Entity_type::PARALLEL_OWNED) {
+      num = vec.size();
+    } else if (etype == Entity_type::ALL) {
+      std::vector<Entity_ID> const& owned =
+          owned_entities(vec.mesh(), vec.entity_kind());
+      num = owned.size();
+      ids = owned.data();
+    } else {
+      throw std::runtime_error("StateReduction: vector " + vec.name() +
+                               " is not on owned or all entities");
+    }
+    return add(vec.get_raw_data(), num, ids, type);
+  }
+
+  /*!
+    @brief Add a reduction of raw data
+    @param data  Data array
+    @param num   Number of entries to reduce
+    @param ids   Indices of the entries into data (if nullptr,
+                 entries 0 to num-1 are reduced)
+    @param type  Type of reduction
+    @return      Index of the reduction for retrieving its result
+  */
+
+  int add(double const *data, int num, Entity_ID const *ids,
+          Reduction_type type);
+  int add(int const *data, int num, Entity_ID const *ids,
+          Reduction_type type);
+
+  /// Number of reductions in the batch
+  int num_reductions() const { return requests_.size(); }
+
+  /// Are sums bitwise reproducible?
+  bool reproducible() const { return reproducible_; }
+
+  /// Compute all the reductions (collective)
+  void execute();
+
+  /// Result of reduction i (after execute())
+  double result(int i) const { return results_[i]; }
+
+  /// Results of all reductions in the order they were added
+  std::vector<double> const& results() const { return results_; }
+
+ private:
+
+  struct Request {
+    void const *data;
+    bool is_int;
+    int num;
+    Entity_ID const *ids;
+    Reduction_type type;
+    int offset;   // position of partial result in the reduction buffer
+  };
+
+  MPI_Comm comm_;
+  bool reproducible_;
+  int nthreads_;
+  std::vector<Request> requests_;
+  std::vector<double> results_;
+
+  int add_request(void const *data, bool is_int, int num,
+                  Entity_ID const *ids, Reduction_type type);
+  int buffer_size() const;
+  void local_pass(int ithread, int nthreads,
+                  std::vector<double> *partial) const;
+};
+
+}  // namespace Jali
+
+#endif  // JALI_STATE_REDUCTION_H_
@@ -0,0 +1,652 @@
+/*
+ Copyright (c) 2019, Triad National Security, LLC
+ All rights reserved.
+
+ Copyright 2019. Triad National Security, LLC. This software was
+ produced under U.S. Government contract 89233218CNA000001 for Los
+ Alamos National Laboratory (LANL), which is operated by Triad
+ National Security, LLC for the U.S. Department of Energy. 
+ All rights in the program are reserved by Triad National Security,
+ LLC, and the U.S. Department of Energy/National Nuclear Security
+ Administration. The Government is granted for itself and others acting
+ on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+ in this material to reproduce, prepare derivative works, distribute
+ copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+
+ 
+ This is open source software distributed under the 3-clause BSD license.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of Triad National Security, LLC, Los Alamos
+    National Laboratory, LANL, the U.S. Government, nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ 
+ THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+ BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <typeinfo>
+
+#include "mpi.h"
+
+#include "JaliStateVTK.h"
+#include "JaliState.h"
+#include "JaliStateVector.h"
+#include "errors.hh"
+#include "Mesh.hh"
+#include "MeshExchange.hh"
+
+namespace Jali {
+
+namespace {
+
+// VTK cell types used for Jali cells
+
+const uint8_t VTK_LINE = 3;
+const uint8_t VTK_POLYGON = 7;
+const uint8_t VTK_POLYHEDRON = 42;
+
+// Value of vtkGhostType marking a cell as a duplicate of a cell owned
+// by another piece
+
+const uint8_t VTK_DUPLICATECELL = 1;
+
+
+// An array in the appended data section of a VTU file. Arrays either
+// own their data or point to data that outlives the write
+
+struct VTKArray {
+  std::string name;
+  std::string type;  // Int32, Float64 etc.
+  int ncomp = 1;
+  std::vector<char> buffer;
+  char const *data = nullptr;
+  std::size_t nbytes = 0;
+
+  template <class T>
+  void assign(std::vector<T> const& values) {
+    data = reinterpret_cast<char const *>(values.data());
+    nbytes = values.size()*sizeof(T);
+  }
+
+  void use_buffer() {
+    data = buffer.data();
+    nbytes = buffer.size();
+  }
+};
+
+
+// Entities of the mesh written to a piece and the connectivity of the
+// cells in VTK form
+
+struct VTKPiece {
+  std::vector<Entity_ID> cells;
+  std::vector<Entity_ID> nodes;
+
+  std::vector<double> points;
+  std::vector<int64_t> connectivity;
+  std::vector<int64_t> offsets;
+  std::vector<uint8_t> types;
+  std::vector<int64_t> faces;
+  std::vector<int64_t> faceoffsets;
+  std::vector<uint8_t> ghosttype;
+};
+
+
+bool little_endian() {
+  uint16_t one = 1;
+  return *reinterpret_cast<uint8_t *>(&one) == 1;
+}
+
+
+// Collect the cells and nodes of the piece and build the VTK
+// connectivity arrays with nodes renumbered within the piece
+
+void build_piece(Mesh const& mesh, bool owned_only, VTKPiece *piece) {
+  int nowned = mesh.num_entities(Entity_kind::CELL,
+                                 Entity_type::PARALLEL_OWNED);
+  int ncells = owned_only ? nowned :
+      mesh.num_entities(Entity_kind::CELL, Entity_type::ALL);
+  int nallnodes = mesh.num_entities(Entity_kind::NODE, Entity_type::ALL);
+  int celldim = mesh.manifold_dimension();
+  int spacedim = mesh.space_dimension();
+
+  // Owned cells come before ghost cells in the numbering of cells
+
+  piece->cells.resize(ncells);
+  for (int c = 0; c < ncells; c++)
+    piece->cells[c] = c;
+
+  // Nodes used by the cells, in the order of their IDs
+
+  std::vector<int64_t> node_index(nallnodes, -1);
+  Entity_ID_List cnodes;
+  for (auto const& c : piece->cells) {
+    mesh.cell_get_nodes(c, &cnodes);
+    for (auto const& n : cnodes)
+      node_index[n] = 0;
+  }
+  for (int n = 0; n < nallnodes; n++)
+    if (node_index[n] == 0) {
+      node_index[n] = piece->nodes.size();
+      piece->nodes.push_back(n);
+    }
+
+  piece->points.assign(3*piece->nodes.size(), 0.0);
+  for (int i = 0; i < piece->nodes.size(); i++) {
+    JaliGeometry::Point xyz;
+    mesh.node_get_coordinates(piece->nodes[i], &xyz);
+    for (int d = 0; d < spacedim; d++)
+      piece->points[3*i+d] = xyz[d];
+  }
+
+  // Cells - 3D cells are general polyhedra described by their faces
+  // (with outward normals), 2D cells are polygons with their nodes in
+  // order around the cell
+
+  piece->offsets.reserve(ncells);
+  piece->types.reserve(ncells);
+  Entity_ID_List cfaces, fnodes;
+  std::vector<dir_t> fdirs;
+  for (auto const& c : piece->cells) {
+    if (celldim == 3) {
+      mesh.cell_get_nodes(c, &cnodes);
+      for (auto const& n : cnodes)
+        piece->connectivity.push_back(node_index[n]);
+
+      mesh.cell_get_faces_and_dirs(c, &cfaces, &fdirs);
+      piece->faces.push_back(cfaces.size());
+      for (int f = 0; f < cfaces.size(); f++) {
+        mesh.face_get_nodes(cfaces[f], &fnodes);
+        piece->faces.push_back(fnodes.size());
+        if (fdirs[f] > 0)
+          for (auto it = fnodes.begin(); it != fnodes.end(); ++it)
+            piece->faces.push_back(node_index[*it]);
+        else
+          for (auto it = fnodes.rbegin(); it != fnodes.rend(); ++it)
+            piece->faces.push_back(node_index[*it]);
+      }
+      piece->faceoffsets.push_back(piece->faces.size());
+      piece->types.push_back(VTK_POLYHEDRON);
+    } else if (celldim == 2) {
+      // Chain the directed edges of the polygon
+      mesh.cell_get_faces_and_dirs(c, &cfaces, &fdirs);
+      int nf = cfaces.size();
+      std::vector<Entity_ID> from(nf), to(nf);
+      for (int f = 0; f < nf; f++) {
+        mesh.face_get_nodes(cfaces[f], &fnodes);
+        from[f] = (fdirs[f] > 0) ? fnodes[0] : fnodes[1];
+        to[f] = (fdirs[f] > 0) ? fnodes[1] : fnodes[0];
+      }
+      Entity_ID n = from[0];
+      for (int i = 0; i < nf; i++) {
+        piece->connectivity.push_back(node_index[n]);
+        int f = 0;
+        while (f < nf && from[f] != n) f++;
+        if (f == nf) break;
+        n = to[f];
+      }
+      piece->types.push_back(VTK_POLYGON);
+    } else {
+      mesh.cell_get_nodes(c, &cnodes);
+      for (auto const& n : cnodes)
+        piece->connectivity.push_back(node_index[n]);
+      piece->types.push_back(VTK_LINE);
+    }
+    piece->offsets.push_back(piece->connectivity.size());
+  }
+
+  if (!owned_only) {
+    piece->ghosttype.assign(ncells, 0);
+    for (int c = nowned; c < ncells; c++)
+      piece->ghosttype[c] = VTK_DUPLICATECELL;
+  }
+}
+
+
+// Gather the values of a state vector on the given entities into an
+// array. Entities past the end of the vector (ghosts of a vector on
+// owned entities) are listed in 'missing' by their position in
+// 'ids'. Returns false if the vector cannot be written
+
+bool gather_vector(StateVectorBase& sv, std::vector<Entity_ID> const& ids,
+                   VTKArray *arr, std::vector<int> *missing) {
+  std::type_info const& dtype = sv.data_type();
+  std::size_t scalar_size;
+  if (dtype == typeid(double)) {
+    arr->type = "Float64", arr->ncomp = 1, scalar_size = sizeof(double);
+  } else if (dtype == typeid(float)) {
+    arr->type = "Float32", arr->ncomp = 1, scalar_size = sizeof(float);
+  } else if (dtype == typeid(int)) {
+    arr->type = "Int32", arr->ncomp = 1, scalar_size = sizeof(int);
+  } else if (dtype == typeid(std::array<double, 2>)) {
+    arr->type = "Float64", arr->ncomp = 2, scalar_size = sizeof(double);
+  } else if (dtype == typeid(std::array<double, 3>)) {
+    arr->type = "Float64", arr->ncomp = 3, scalar_size = sizeof(double);
+  } else if (dtype == typeid(std::array<double, 6>)) {
+    arr->type = "Float64", arr->ncomp = 6, scalar_size = sizeof(double);
+  } else {
+    return false;
+  }
+  arr->name = sv.name();
+
+  std::string vclass = sv.vector_class();
+  if (sv.domain_id() >= 0) return false;  // vector on a tile
+  if (sv.entity_type() == Entity_type::PARALLEL_GHOST) return false;
+
+  // Univalued vectors (and the current level of multi-level vectors)
+  // are stored as one array of interleaved components, SoA vectors as
+  // one array per component
+
+  std::size_t elemsize = arr->ncomp*scalar_size;
+  arr->buffer.assign(ids.size()*elemsize, 0);
+  char *dst = arr->buffer.data();
+  missing->clear();
+  if (vclass == "UniStateVector" || vclass == "MultiLevelStateVector") {
+    if (sv.raw_element_size() != elemsize) return false;
+    std::size_t n = sv.raw_array_size(0);
+    char const *src = static_cast<char const *>(sv.raw_array(0));
+    for (int i = 0; i < ids.size(); i++, dst += elemsize) {
+      if (ids[i] >= n) {
+        missing->push_back(i);
+        continue;
+      }
+      std::memcpy(dst, src + ids[i]*elemsize, elemsize);
+    }
+  } else if (vclass == "SoAStateVector") {
+    if (sv.num_raw_arrays() != arr->ncomp ||
+        sv.raw_element_size() != scalar_size) return false;
+    std::size_t n = sv.raw_array_size(0);
+    for (int i = 0; i < ids.size(); i++, dst += elemsize) {
+      if (ids[i] >= n) {
+        missing->push_back(i);
+        continue;
+      }
+      for (int k = 0; k < arr->ncomp; k++) {
+        char const *src = static_cast<char const *>(sv.raw_array(k));
+        std::memcpy(dst + k*scalar_size, src + ids[i]*scalar_size,
+                    scalar_size);
+      }
+    }
+  } else {
+    return false;
+  }
+  arr->use_buffer();
+  return true;
+}
+
+
+// Fill in one component of the entities missing from a gathered
+// vector with the values on the ranks that own them (collective)
+
+template <class T>
+void fill_ghost_component(StateVectorBase& sv, int k,
+                          std::vector<int> const& keys,
+                          std::vector<int> const& queries,
+                          std::vector<int> const& missing, VTKArray *arr,
+                          MPI_Comm comm) {
+  bool soa = (sv.vector_class() == "SoAStateVector");
+  char const *src = static_cast<char const *>(sv.raw_array(soa ? k : 0));
+  std::size_t stride = sv.raw_element_size();
+  std::size_t offset = soa ? 0 : k*sizeof(T);
+
+  std::vector<T> values(keys.size());
+  for (int id = 0; id < keys.size(); id++)
+    std::memcpy(&values[id], src + id*stride + offset, sizeof(T));
+  std::vector<T> found = directory_lookup(keys, values, queries, T(), comm);
+
+  char *dst = arr->buffer.data();
+  for (int i = 0; i < missing.size(); i++)
+    std::memcpy(dst + (missing[i]*arr->ncomp + k)*sizeof(T), &found[i],
+                sizeof(T));
+}
+
+
+// Fill in the entities missing from a gathered vector (ghosts of a
+// vector on owned entities) with the values of their owners.
+// Returns false if some of them are not owned by any rank that has
+// values for them (collective)
+
+bool fill_ghost_values(Mesh const& mesh, StateVectorBase& sv,
+                       std::vector<Entity_ID> const& ids,
+                       std::vector<int> const& missing, VTKArray *arr) {
+  MPI_Comm comm = mesh.get_comm();
+  Entity_kind kind = sv.entity_kind();
+  int nowned = mesh.num_entities(kind, Entity_type::PARALLEL_OWNED);
+  int n = std::min(static_cast<int>(sv.raw_array_size(0)), nowned);
+
+  std::vector<int> keys(n), queries(missing.size());
+  for (int id = 0; id < n; id++)
+    keys[id] = mesh.GID(id, kind);
+  for (int i = 0; i < missing.size(); i++)
+    queries[i] = mesh.GID(ids[missing[i]], kind);
+
+  std::vector<int> known(n, 1);
+  std::vector<int> found = directory_lookup(keys, known, queries, 0, comm);
+  int ok = std::all_of(found.begin(), found.end(),
+                       [](int f) { return f == 1; });
+  int allok = ok;
+  MPI_Allreduce(&ok, &allok, 1, MPI_INT, MPI_MIN, comm);
+  if (!allok) return false;
+
+  for (int k = 0; k < arr->ncomp; k++) {
+    if (arr->type == "Float64")
+      fill_ghost_component<double>(sv, k, keys, queries, missing, arr, comm);
+    else if (arr->type == "Float32")
+      fill_ghost_component<float>(sv, k, keys, queries, missing, arr, comm);
+    else
+      fill_ghost_component<int>(sv, k, keys, queries, missing, arr, comm);
+  }
+  return true;
+}
+
+
+// Hash of an ordered list of names, the same on every rank for the
+// same list (FNV-1a)
+
+uint64_t hash_names(std::vector<std::string> const& names) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (auto const& name : names) {
+    for (unsigned char ch : name + '\0')
+      hash = (hash ^ ch)*1099511628211ULL;
+  }
+  return hash;
+}
+
+
+// XML element for an array of the appended data section
+
+void data_array_xml(std::ostream& os, VTKArray const& arr,
+                    std::size_t offset) {
+  os << "        <DataArray type=\"" << arr.type << "\" Name=\"" <<
+      arr.name << "\"";
+  if (arr.ncomp > 1) os << " NumberOfComponents=\"" << arr.ncomp << "\"";
+  os << " format=\"appended\" offset=\"" << offset << "\"/>\n";
+}
+
+
+// Write one piece - the XML header with the offsets of all the arrays
+// in the appended data section followed by the raw arrays, each
+// preceded by its size in bytes
+
+bool write_vtu(std::string const& filename, VTKPiece const& piece,
+               std::vector<VTKArray> const& pointdata,
+               std::vector<VTKArray> const& celldata,
+               std::vector<VTKArray> const& points,
+               std::vector<VTKArray> const& cellarrays) {
+  std::ostringstream xml;
+  std::size_t offset = 0;
+
+  xml << "<?xml version=\"1.0\"?>\n" <<
+      "<VTKFile type=\"UnstructuredGrid\" version=\"1.0\" byte_order=\"" <<
+      (little_endian() ? "LittleEndian" : "BigEndian") <<
+      "\" header_type=\"UInt64\">\n" <<
+      "  <UnstructuredGrid>\n" <<
+      "    <Piece NumberOfPoints=\"" << piece.nodes.size() <<
+      "\" NumberOfCells=\"" << piece.cells.size() << "\">\n";
+
+  std::vector<VTKArray const *> order;
+  auto section = [&](std::string const& tag,
+                     std::vector<VTKArray> const& arrays) {
+    xml << "      <" << tag << ">\n";
+    for (auto const& arr : arrays) {
+      data_array_xml(xml, arr, offset);
+      offset += sizeof(uint64_t) + arr.nbytes;
+      order.push_back(&arr);
+    }
+    xml << "      </" << tag << ">\n";
+  };
+  section("PointData", pointdata);
+  section("CellData", celldata);
+  section("Points", points);
+  section("Cells", cellarrays);
+
+  xml << "    </Piece>\n" <<
+      "  </UnstructuredGrid>\n" <<
+      "  <AppendedData encoding=\"raw\">\n   _";
+
+  std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+  if (!file) return false;
+  std::string header = xml.str();
+  file.write(header.data(), header.size());
+  for (auto const& arr : order) {
+    uint64_t nbytes = arr->nbytes;
+    file.write(reinterpret_cast<char const *>(&nbytes), sizeof(nbytes));
+    file.write(arr->data, arr->nbytes);
+  }
+  std::string footer = "\n  </AppendedData>\n</VTKFile>\n";
+  file.write(footer.data(), footer.size());
+  file.close();
+  return !file.fail();
+}
+
+
+// Write the index of the pieces
+
+bool write_pvtu(std::string const& filename, std::string const& basename,
+                int nprocs, bool owned_only,
+                std::vector<VTKArray> const& pointdata,
+                std::vector<VTKArray> const& celldata) {
+  // pieces are referenced relative to the location of the index
+  std::string piecebase = basename.substr(basename.find_last_of('/') + 1);
+
+  std::ofstream file(filename, std::ios::trunc);
+  if (!file) return false;
+
+  auto pdata_array = [&](VTKArray const& arr) {
+    file << "      <PDataArray type=\"" << arr.type << "\" Name=\"" <<
+        arr.name << "\"";
+    if (arr.ncomp > 1) file << " NumberOfComponents=\"" << arr.ncomp << "\"";
+    file << "/>\n";
+  };
+
+  file << "<?xml version=\"1.0\"?>\n" <<
+      "<VTKFile type=\"PUnstructuredGrid\" version=\"1.0\" byte_order=\"" <<
+      (little_endian() ? "LittleEndian" : "BigEndian") <<
+      "\" header_type=\"UInt64\">\n" <<
+      "  <PUnstructuredGrid GhostLevel=\"" << (owned_only ? 0 : 1) <<
+      "\">\n";
+  file << "    <PPointData>\n";
+  for (auto const& arr : pointdata) pdata_array(arr);
+  file << "    </PPointData>\n";
+  file << "    <PCellData>\n";
+  for (auto const& arr : celldata) pdata_array(arr);
+  file << "    </PCellData>\n";
+  file << "    <PPoints>\n" <<
+      "      <PDataArray type=\"Float64\" NumberOfComponents=\"3\"/>\n" <<
+      "    </PPoints>\n";
+  for (int p = 0; p < nprocs; p++)
+    file << "    <Piece Source=\"" << piecebase << "_" << p << ".vtu\"/>\n";
+  file << "  </PUnstructuredGrid>\n</VTKFile>\n";
+  file.close();
+  return !file.fail();
+}
+
+
+void write_vtk_files(Mesh const& mesh, State *state,
+                     std::string const& basename,
+                     std::vector<std::string> const& names,
+                     bool owned_only) {
+  MPI_Comm comm = mesh.get_comm();
+  int nprocs, rank;
+  MPI_Comm_size(comm, &nprocs);
+  MPI_Comm_rank(comm, &rank);
+
+  VTKPiece piece;
+  build_piece(mesh, owned_only, &piece);
+
+  // Point and cell data from the state vectors. A vector is written
+  // only if it could be gathered on every rank so that the pieces and
+  // the index written by rank 0 list the same arrays
+
+  std::vector<VTKArray> pointdata, celldata;
+  if (state) {
+    std::vector<std::shared_ptr<StateVectorBase>> vecs;
+    for (auto it = state->cbegin(); it != state->cend(); ++it) {
+      std::shared_ptr<StateVectorBase> sv = *it;
+      if (!names.empty() &&
+          std::find(names.begin(), names.end(), sv->name()) == names.end())
+        continue;
+      vecs.push_back(sv);
+    }
+
+    // Every rank must have the same vectors in the same order
+
+    int nvecs = vecs.size();
+    std::vector<std::string> vecnames;
+    for (auto const& sv : vecs)
+      vecnames.push_back(sv->name());
+    unsigned long long id[2] = {static_cast<unsigned long long>(nvecs),
+                                hash_names(vecnames)};
+    unsigned long long minid[2], maxid[2];
+    MPI_Allreduce(id, minid, 2, MPI_UNSIGNED_LONG_LONG, MPI_MIN, comm);
+    MPI_Allreduce(id, maxid, 2, MPI_UNSIGNED_LONG_LONG, MPI_MAX, comm);
+    if (minid[0] != maxid[0] || minid[1] != maxid[1]) {
+      Errors::Message mesg("write_vtk: ranks have different state vectors"
+                           " to write to " + basename);
+      Exceptions::Jali_throw(mesg);
+    }
+
+    std::vector<VTKArray> arrays(nvecs);
+    std::vector<std::vector<int>> missing(nvecs);
+    std::vector<int> ok(nvecs, 0), allok(nvecs, 0);
+    std::vector<int> ghosts(nvecs, 0), anyghosts(nvecs, 0);
+    for (int i = 0; i < nvecs; i++) {
+      std::vector<Entity_ID> const& ids =
+          (vecs[i]->entity_kind() == Entity_kind::NODE) ? piece.nodes :
+          piece.cells;
+      if (vecs[i]->entity_kind() == Entity_kind::NODE ||
+          vecs[i]->entity_kind() == Entity_kind::CELL)
+        ok[i] = gather_vector(*vecs[i], ids, &arrays[i], &missing[i]);
+      ghosts[i] = !missing[i].empty();
+    }
+    if (nvecs) {
+      MPI_Allreduce(ok.data(), allok.data(), nvecs, MPI_INT, MPI_MIN, comm);
+      MPI_Allreduce(ghosts.data(), anyghosts.data(), nvecs, MPI_INT,
+                    MPI_MAX, comm);
+    }
+
+    // Vectors on owned entities get the values of the ghost entities
+    // in the piece (e.g. the nodes of owned cells that are owned by
+    // other ranks) from the ranks that own them
+
+    for (int i = 0; i < nvecs; i++) {
+      if (!allok[i] || !anyghosts[i]) continue;
+      std::vector<Entity_ID> const& ids =
+          (vecs[i]->entity_kind() == Entity_kind::NODE) ? piece.nodes :
+          piece.cells;
+      allok[i] = fill_ghost_values(mesh, *vecs[i], ids, missing[i],
+                                   &arrays[i]);
+    }
+
+    for (int i = 0; i < nvecs; i++) {
+      if (!allok[i]) {
+        if (rank == 0)
+          std::cerr << "Cannot write vector " << vecs[i]->name() <<
+              " to VTK file\n";
+        continue;
+      }
+      if (vecs[i]->entity_kind() == Entity_kind::NODE)
+        pointdata.push_back(std::move(arrays[i]));
+      else
+        celldata.push_back(std::move(arrays[i]));
+    }
+    // moving the arrays may have moved their buffers
+    for (auto& arr : pointdata) arr.use_buffer();
+    for (auto& arr : celldata) arr.use_buffer();
+  }
+
+  if (!owned_only) {
+    VTKArray ghost;
+    ghost.name = "vtkGhostType";
+    ghost.type = "UInt8";
+    ghost.assign(piece.ghosttype);
+    celldata.push_back(ghost);
+  }
+
+  // Mesh arrays point straight to the piece
+
+  std::vector<VTKArray> points(1), cellarrays(3);
+  points[0].name = "Points";
+  points[0].type = "Float64";
+  points[0].ncomp = 3;
+  points[0].assign(piece.points);
+
+  cellarrays[0].name = "connectivity";
+  cellarrays[0].type = "Int64";
+  cellarrays[0].assign(piece.connectivity);
+  cellarrays[1].name = "offsets";
+  cellarrays[1].type = "Int64";
+  cellarrays[1].assign(piece.offsets);
+  cellarrays[2].name = "types";
+  cellarrays[2].type = "UInt8";
+  cellarrays[2].assign(piece.types);
+  if (mesh.manifold_dimension() == 3) {
+    cellarrays.resize(5);
+    cellarrays[3].name = "faces";
+    cellarrays[3].type = "Int64";
+    cellarrays[3].assign(piece.faces);
+    cellarrays[4].name = "faceoffsets";
+    cellarrays[4].type = "Int64";
+    cellarrays[4].assign(piece.faceoffsets);
+  }
+
+  std::stringstream piecename;
+  piecename << basename << "_" << rank << ".vtu";
+  int ierr = write_vtu(piecename.str(), piece, pointdata, celldata, points,
+                       cellarrays) ? 0 : 1;
+  if (rank == 0 && !write_pvtu(basename + ".pvtu", basename, nprocs,
+                               owned_only, pointdata, celldata))
+    ierr = 1;
+
+  int aerr = 0;
+  MPI_Allreduce(&ierr, &aerr, 1, MPI_INT, MPI_SUM, comm);
+  if (aerr) {
+    Errors::Message mesg("write_vtk: could not write " + basename +
+                         " on " + std::to_string(aerr) + " rank(s)");
+    Exceptions::Jali_throw(mesg);
+  }
+}
+
+}  // namespace
+
+
+void write_vtk(State& state, std::string const& basename,
+               std::vector<std::string> const& names, bool owned_only) {
+  write_vtk_files(*(state.mesh()), &state, basename, names, owned_only);
+}
+
+
+void write_vtk(Mesh const& mesh, std::string const& basename,
+               bool owned_only) {
+  write_vtk_files(mesh, nullptr, basename, {}, owned_only);
+}
+
+}  // namespace Jali
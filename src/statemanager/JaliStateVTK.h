@@ -0,0 +1,98 @@
+/*
+ Copyright (c) 2019, Triad National Security, LLC
+ All rights reserved.
+
+ Copyright 2019. Triad National Security, LLC. This software was
+ produced under U.S. Government contract 89233218CNA000001 for Los
+ Alamos National Laboratory (LANL), which is operated by Triad
+ National Security, LLC for the U.S. Department of Energy. 
+ All rights in the program are reserved by Triad National Security,
+ LLC, and the U.S. Department of Energy/National Nuclear Security
+ Administration. The Government is granted for itself and others acting
+ on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+ in this material to reproduce, prepare derivative works, distribute
+ copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+
+ 
+ This is open source software distributed under the 3-clause BSD license.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of Triad National Security, LLC, Los Alamos
+    National Laboratory, LANL, the U.S. Government, nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ 
+ THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+ BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef JALI_STATE_VTK_H_
+#define JALI_STATE_VTK_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Jali {
+
+class Mesh;
+class State;
+
+/*!
+  @brief Write a mesh and state vectors to VTK unstructured grid files
+  (collective)
+  @param state       State whose mesh and vectors are written
+  @param basename    Base name of the files - each rank writes
+                     <basename>_<rank>.vtu and rank 0 writes the
+                     index <basename>.pvtu
+  @param names       Names of the vectors to write (all if empty)
+  @param owned_only  Write only the owned cells of each rank
+
+  The .vtu files store all arrays as raw binary appended data so they
+  are written with one pass over each array. 3D cells are written as
+  general polyhedra, 2D cells as polygons and 1D cells as lines.
+
+  Univalued, multi-level (current level) and structure-of-arrays
+  vectors of int, float, double and std::array<double, 2/3/6> on the
+  cells or nodes of the mesh are written as cell or point data. Other
+  vectors are skipped with a warning. Vectors on owned entities get
+  the values of the ghost entities in a piece (the nodes of owned
+  cells owned by other ranks, or the ghost cells if owned_only is
+  false) from the ranks that own them. Every rank must be asked to
+  write the same vectors in the same order.
+
+  If owned_only is false, ghost cells are written as well and marked
+  in a vtkGhostType array so that VTK readers skip them.
+*/
+
+void write_vtk(State& state, std::string const& basename,
+               std::vector<std::string> const& names = {},
+               bool owned_only = true);
+
+/// Write just the mesh to VTK unstructured grid files (collective)
+void write_vtk(Mesh const& mesh, std::string const& basename,
+               bool owned_only = true);
+
+}  // namespace Jali
+
+#endif  // JALI_STATE_VTK_H_
@@ -78,4 +78,12 @@ std::shared_ptr<MeshSet> state_get_material_set(std::weak_ptr<State> state,
   return nullptr;
 }
 
+Memory_policy state_get_memory_policy(std::weak_ptr<State> state) {
+  if (!state.expired()) {
+    std::shared_ptr<State> state_shared_ptr = state.lock();
+    return state_shared_ptr->memory_policy();
+  }
+  return Memory_policy::DEFAULT;
+}
+
 }  // namespace Jali
@@ -52,12 +52,16 @@
 #include <iostream>
 #include <iterator>
 #include <vector>
+#include <array>
 #include <string>
 #include <algorithm>
 #include <typeinfo>
+#include <type_traits>
 #include <cassert>
 
 #include "Mesh.hh"    // jali mesh header
+#include "JaliStateAllocator.h"
+#include "JaliStateReduction.h"
 
 namespace Jali {
 
@@ -72,6 +76,100 @@ class State;
 int state_get_num_materials(std::weak_ptr<State> state);
 std::shared_ptr<MeshSet> state_get_material_set(std::weak_ptr<State> state,
                                                  int matindex);
+Memory_policy state_get_memory_policy(std::weak_ptr<State> state);
+
+
+// Indices of entities owned by each tile of a mesh, used to decide
+// which thread first touches which entries of a state vector under
+// the FIRST_TOUCH memory policy. Only vectors on all entities or on
+// owned entities of a mesh are indexed by entity ID - for other
+// domains and entity types the list of tiles is left empty
+
+template <class DomainType>
+void get_first_touch_parts(std::shared_ptr<DomainType> domain,
+                           Entity_kind kind, Entity_type type,
+                           std::vector<std::vector<int>> *parts) {
+  parts->clear();
+}
+
+inline
+void get_first_touch_parts(std::shared_ptr<Mesh> mesh,
+                           Entity_kind kind, Entity_type type,
+                           std::vector<std::vector<int>> *parts) {
+  parts->clear();
+  if (type != Entity_type::ALL && type != Entity_type::PARALLEL_OWNED)
+    return;
+
+  for (auto const& t : mesh->tiles()) {
+    switch (kind) {
+      case Entity_kind::NODE:
+        parts->push_back(t->nodes<Entity_type::PARALLEL_OWNED>()); break;
+      case Entity_kind::EDGE:
+        parts->push_back(t->edges<Entity_type::PARALLEL_OWNED>()); break;
+      case Entity_kind::FACE:
+        parts->push_back(t->faces<Entity_type::PARALLEL_OWNED>()); break;
+      case Entity_kind::SIDE:
+        parts->push_back(t->sides<Entity_type::PARALLEL_OWNED>()); break;
+      case Entity_kind::WEDGE:
+        parts->push_back(t->wedges<Entity_type::PARALLEL_OWNED>()); break;
+      case Entity_kind::CORNER:
+        parts->push_back(t->corners<Entity_type::PARALLEL_OWNED>()); break;
+      case Entity_kind::CELL:
+        parts->push_back(t->cells<Entity_type::PARALLEL_OWNED>()); break;
+      default:
+        parts->clear();
+        return;
+    }
+  }
+}
+
+// Same for the entries of a material array of a multi-material state
+// vector (entries are grouped by the master tile of their cell)
+
+template <class DomainType>
+void get_first_touch_parts(std::shared_ptr<DomainType> domain,
+                           std::vector<int> const& matcells,
+                           std::vector<std::vector<int>> *parts) {
+  parts->clear();
+}
+
+inline
+void get_first_touch_parts(std::shared_ptr<Mesh> mesh,
+                           std::vector<int> const& matcells,
+                           std::vector<std::vector<int>> *parts) {
+  parts->clear();
+  parts->resize(mesh->num_tiles());
+  if (parts->empty()) return;
+
+  int nmatcells = matcells.size();
+  for (int i = 0; i < nmatcells; i++) {
+    int tileid = mesh->master_tile_ID_of_cell(matcells[i]);
+    if (tileid >= 0)
+      (*parts)[tileid].push_back(i);
+  }
+}
+
+// ID of the domain of a state vector for checkpoint/restart (-1 for
+// the mesh, the tile ID for a mesh tile)
+
+template <class DomainType>
+int get_domain_id(std::shared_ptr<DomainType> domain) {
+  return -1;
+}
+
+inline
+int get_domain_id(std::shared_ptr<MeshTile> meshtile) {
+  return meshtile ? meshtile->ID() : -1;
+}
+
+// Size of elements of type T stored bytewise in checkpoints (0 for
+// types that cannot be copied bytewise)
+
+template <class T>
+constexpr std::size_t raw_element_size() {
+  return std::is_trivially_copyable<T>::value ? sizeof(T) : 0;
+}
+
 
 /*!
   @class StateVectorBase jali_state_vector.h
@@ -117,6 +215,19 @@ class StateVectorBase {
   virtual const std::type_info& data_type() = 0;
   virtual StateVector_type type() = 0;
 
+  //! Raw storage for checkpoint/restart. The data of a vector is held
+  //! in num_raw_arrays() arrays of elements of raw_element_size()
+  //! bytes each (0 if the data cannot be copied bytewise). Vectors
+  //! without raw storage are not checkpointed
+
+  virtual std::string vector_class() const { return "StateVector"; }
+  virtual int domain_id() const { return -1; }
+  virtual int num_raw_arrays() const { return 0; }
+  virtual std::size_t raw_element_size() const { return 0; }
+  virtual std::size_t raw_array_size(int i) const { return 0; }
+  virtual void * raw_array(int i) { return nullptr; }
+  virtual void raw_array_resize(int i, std::size_t n) {}
+
   //! Query Metadata
 
   std::string name() const { return myname_; }
@@ -229,6 +340,10 @@ class UniStateVectorBase : public StateVectorBase {
 
   Mesh & mesh() const { return get_mesh_of_domain(mydomain_); }
 
+  /// ID of the domain (-1 for a mesh, tile ID for a mesh tile)
+
+  int domain_id() const { return get_domain_id(mydomain_); }
+
   /// Get the type of state vector
 
   StateVector_type type() {return StateVector_type::UNIVAL;}
@@ -298,10 +413,11 @@ class UniStateVector : public UniStateVectorBase<DomainType> {
       UniStateVectorBase<DomainType>(name, domain, state, kind, type) {
 
     int num = domain->num_entities(kind, type);
+    allocate(num, state_get_memory_policy(state));
     if (data == nullptr)
-      mydata_ = std::make_shared<std::vector<T>>(num);
+      assign(T());
     else
-      mydata_ = std::make_shared<std::vector<T>>(data, data+num);
+      assign(data);
   }
 
 
@@ -323,7 +439,8 @@ class UniStateVector : public UniStateVectorBase<DomainType> {
       UniStateVectorBase<DomainType>(name, domain, state, kind, type) {
 
     int num = domain->num_entities(kind, type);
-    mydata_ = std::make_shared<std::vector<T>>(num, initval);
+    allocate(num, state_get_memory_policy(state));
+    assign(initval);
   }
 
 
@@ -346,8 +463,8 @@ class UniStateVector : public UniStateVectorBase<DomainType> {
                                      in_vector.entity_kind_,
                                      in_vector.entity_type_) {
 
-    mydata_ = std::make_shared<std::vector<T>>((in_vector.mydata_)->begin(),
-                                               (in_vector.mydata_)->end());
+    // copy of the data uses the same memory policy as the input vector
+    mydata_ = std::make_shared<StateArray<T>>(*(in_vector.mydata_));
   }
 
   /*!
@@ -374,6 +491,66 @@ class UniStateVector : public UniStateVectorBase<DomainType> {
   
   ~UniStateVector() {}
 
+  /*!
+    @brief Allocate (uninitialized if policy is FIRST_TOUCH) storage
+    @param num     Number of entries
+    @param policy  Memory policy for the storage
+  */
+
+  void allocate(int num, Memory_policy policy) {
+    mydata_ = std::make_shared<StateArray<T>>(StateAllocator<T>(policy));
+    mydata_->resize(num);
+  }
+
+  /*!
+    @brief Assign a value to all entries of the vector
+    @param initval  Value to assign
+
+    Under the FIRST_TOUCH memory policy, entries of each mesh tile
+    are assigned from a different thread
+  */
+
+  void assign(T const& initval) {
+    T *vdata = mydata_->data();
+    touch_entries([&](int i) { vdata[i] = initval; });
+  }
+
+  /*!
+    @brief Copy data from an array into the vector
+    @param data  Array with as many entries as the vector
+  */
+
+  void assign(T const * const data) {
+    T *vdata = mydata_->data();
+    touch_entries([&](int i) { vdata[i] = data[i]; });
+  }
+
+  /// Memory policy of the vector storage
+
+  Memory_policy memory_policy() const {
+    return mydata_->get_allocator().policy();
+  }
+
+  /*!
+    @brief Global reduction of the vector over owned entities
+    @param type          Type of reduction (MIN, MAX, SUM)
+    @param reproducible  Compute a bitwise reproducible sum
+    @param nthreads      Number of threads for the local pass
+
+    Collective over the communicator of the mesh. To compute several
+    reductions with a single collective use StateReduction or
+    State::reduce
+  */
+
+  double reduce(Reduction_type type, bool reproducible = false,
+                int nthreads = 1) const {
+    StateReduction reduction(UniStateVectorBase<DomainType>::mesh().get_comm(),
+                             reproducible, nthreads);
+    int i = reduction.add(*this, type);
+    reduction.execute();
+    return reduction.result(i);
+  }
+
   /// Get the raw data
 
   T *get_raw_data() { return &((*mydata_)[0]); }
@@ -395,8 +572,8 @@ class UniStateVector : public UniStateVectorBase<DomainType> {
 
   //! Subset of std::vector functionality. We can add others as needed
 
-  typedef typename std::vector<T>::iterator iterator;
-  typedef typename std::vector<T>::const_iterator const_iterator;
+  typedef typename StateArray<T>::iterator iterator;
+  typedef typename StateArray<T>::const_iterator const_iterator;
 
   iterator begin() { return mydata_->begin(); }
   iterator end() { return mydata_->end(); }
@@ -409,11 +586,25 @@ class UniStateVector : public UniStateVectorBase<DomainType> {
   const_reference operator[](int i) const { return (*mydata_)[i]; }
 
   size_t size() const { return mydata_->size(); }
-  void resize(size_t newsize) { mydata_->resize(newsize); }
-  void resize(size_t newsize, T val) { mydata_->resize(newsize, val); }
+
+  // resize and clear are virtual (resize(size_t) and clear() through
+  // UniStateVectorBase) so that MultiLevelStateVector can keep all its
+  // levels the same size when called through a UniStateVector
+
+  void resize(size_t newsize) { mydata_->resize(newsize, T()); }
+  virtual void resize(size_t newsize, T val) { mydata_->resize(newsize, val); }
 
   void clear() {mydata_->clear();}
 
+  //! Raw storage for checkpoint/restart
+
+  std::string vector_class() const { return "UniStateVector"; }
+  int num_raw_arrays() const { return 1; }
+  std::size_t raw_element_size() const { return Jali::raw_element_size<T>(); }
+  std::size_t raw_array_size(int i) const { return mydata_->size(); }
+  void * raw_array(int i) { return mydata_->data(); }
+  void raw_array_resize(int i, std::size_t n) { mydata_->resize(n); }
+
   //! Output the data
 
   std::ostream& print(std::ostream& os) const {
@@ -429,8 +620,27 @@ class UniStateVector : public UniStateVectorBase<DomainType> {
     return os;
   }
 
- private:
-  std::shared_ptr<std::vector<T>> mydata_;
+ protected:
+
+  // Call touch(i) for each entry - in a plain loop, or from the thread
+  // that owns the tile of the entry if the memory policy is FIRST_TOUCH
+
+  template <class Function>
+  void touch_entries(Function const& touch) {
+    int num = mydata_->size();
+    if (memory_policy() != Memory_policy::FIRST_TOUCH) {
+      for (int i = 0; i < num; i++) touch(i);
+      return;
+    }
+    std::vector<std::vector<int>> parts;
+    if (UniStateVectorBase<DomainType>::mydomain_)
+      get_first_touch_parts(UniStateVectorBase<DomainType>::mydomain_,
+                            StateVectorBase::entity_kind_,
+                            StateVectorBase::entity_type_, &parts);
+    first_touch(num, parts, touch);
+  }
+
+  std::shared_ptr<StateArray<T>> mydata_;
 };  // UniStateVector
 
 //! Send UniStateVector to output stream
@@ -441,6 +651,198 @@ std::ostream & operator<<(std::ostream & os,
   return sv.print(os);
 }
 
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/*!
+  @class MultiLevelStateVectorBase jali_state_vector.h
+  @brief MultiLevelStateVectorBase Interface for state vectors that
+  keep data for several time levels, so that State can rotate the time
+  levels of all such vectors without knowing their data type
+*/
+
+class MultiLevelStateVectorBase {
+ public:
+  virtual ~MultiLevelStateVectorBase() {}
+
+  /// Number of time levels
+  virtual int num_levels() const = 0;
+
+  /// Rotate the time levels
+  virtual void swap_levels() = 0;
+};
+
+
+/*!
+  @class MultiLevelStateVector jali_state_vector.h
+  @brief MultiLevelStateVector stores univalued state data for
+  several time levels of a field
+
+  Level 0 is the current level and level k is the level k time steps
+  older. The vector behaves exactly like a UniStateVector on the
+  current level so that lookups by name (including lookups of
+  UniStateVector<T, DomainType> types) see the current level.
+  swap_levels() rotates the storage of the levels in constant time -
+  the storage of the oldest level becomes the current level (with
+  stale data, to be overwritten) and all other levels age by one.
+
+  Note that shallow copies of the vector (such as those returned by
+  State::get) share the storage of the level current at the time of
+  the copy; references returned by State::add or obtained through
+  State iterators always see the current level.
+
+  @tparam T           Data type (int, double, some_custom_type)
+  @tparam DomainType  Mesh or Mesh Tile
+*/
+
+template <class T, class DomainType = Mesh>
+class MultiLevelStateVector : public UniStateVector<T, DomainType>,
+                              public MultiLevelStateVectorBase {
+ public:
+
+  //! Default constructor - one empty level
+  MultiLevelStateVector() : UniStateVector<T, DomainType>() {
+    UniStateVector<T, DomainType>::mydata_ =
+        std::make_shared<StateArray<T>>();
+    levels_.push_back(UniStateVector<T, DomainType>::mydata_);
+  }
+
+  /*!
+    @brief Constructor with array data
+    @param name            Name of vector
+    @param state           State manager holding the vector (can be nullptr)
+    @param kind            What kind of entity in the Domain does data live on
+    @param type            What type of entity data lives on (PARALLEL_OWNED, PARALLEL_GHOST, etc)
+    @param data            Pointer to array data to be used to initialize all levels (optional)
+    @param nlevels         Number of time levels (at least 1)
+  */
+
+  MultiLevelStateVector(std::string name,
+                        std::shared_ptr<DomainType> domain,
+                        std::shared_ptr<State> state,
+                        Entity_kind kind,
+                        Entity_type type,
+                        T const * const data = nullptr,
+                        int nlevels = 2) :
+      UniStateVector<T, DomainType>(name, domain, state, kind, type, data) {
+    init_levels(nlevels);
+  }
+
+  /*!
+    @brief Meaningful constructor with uniform initializer
+    @param name            Name of vector
+    @param state           State manager holding the vector (can be nullptr)
+    @param kind            What kind of entity in the Domain does data live on
+    @param type            What type of entity data lives on (PARALLEL_OWNED, PARALLEL_GHOST, etc)
+    @param initval         Value to which all elements of all levels are initialized
+    @param nlevels         Number of time levels (at least 1)
+  */
+
+  MultiLevelStateVector(std::string name,
+                        std::shared_ptr<DomainType> domain,
+                        std::shared_ptr<State> state,
+                        Entity_kind kind,
+                        Entity_type type,
+                        T initval,
+                        int nlevels = 2) :
+      UniStateVector<T, DomainType>(name, domain, state, kind, type,
+                                    initval) {
+    init_levels(nlevels);
+  }
+
+  /*!
+    @brief Copy constructor - DEEP COPY OF DATA OF ALL LEVELS
+  */
+
+  MultiLevelStateVector(MultiLevelStateVector const & in_vector) :
+      UniStateVector<T, DomainType>(in_vector) {
+    levels_.push_back(UniStateVector<T, DomainType>::mydata_);
+    for (int k = 1; k < in_vector.num_levels(); k++)
+      levels_.push_back(std::make_shared<StateArray<T>>(*(in_vector.levels_[k])));
+  }
+
+  /*!
+    @brief Assignment operator
+
+    Shallow copy of the metadata and shared_ptrs to the data of all
+    levels (same semantics as UniStateVector)
+  */
+
+  MultiLevelStateVector & operator=(MultiLevelStateVector const & in_vector) {
+    UniStateVector<T, DomainType>::operator=(in_vector);
+    levels_ = in_vector.levels_;
+    return *this;
+  }
+
+  /// Destructor
+
+  ~MultiLevelStateVector() {}
+
+  /// Number of time levels
+
+  int num_levels() const { return levels_.size(); }
+
+  /// Rotate the time levels without copying any data
+
+  void swap_levels() {
+    std::rotate(levels_.rbegin(), levels_.rbegin()+1, levels_.rend());
+    UniStateVector<T, DomainType>::mydata_ = levels_[0];
+  }
+
+  /// Data of time level k (0 is current)
+
+  StateArray<T>& level(int k) { return *(levels_[k]); }
+
+  /// Data of time level k (0 is current)
+
+  StateArray<T> const& level(int k) const { return *(levels_[k]); }
+
+  /// Resize or clear all the levels (also when called through a
+  /// UniStateVector)
+
+  void resize(size_t newsize) { resize(newsize, T()); }
+  void resize(size_t newsize, T val) {
+    for (auto& lev : levels_)
+      lev->resize(newsize, val);
+  }
+
+  void clear() {
+    for (auto& lev : levels_)
+      lev->clear();
+  }
+
+  //! Raw storage for checkpoint/restart (one array per level)
+
+  std::string vector_class() const { return "MultiLevelStateVector"; }
+  int num_raw_arrays() const { return levels_.size(); }
+  std::size_t raw_array_size(int i) const { return levels_[i]->size(); }
+  void * raw_array(int i) { return levels_[i]->data(); }
+  void raw_array_resize(int i, std::size_t n) { levels_[i]->resize(n); }
+
+ private:
+
+  // Add storage for the older levels and copy the current data into it
+
+  void init_levels(int nlevels) {
+    auto& curdata = UniStateVector<T, DomainType>::mydata_;
+    levels_.push_back(curdata);
+    for (int k = 1; k < nlevels; k++) {
+      auto levdata =
+          std::make_shared<StateArray<T>>(curdata->get_allocator());
+      levdata->resize(curdata->size());
+      T *ldata = levdata->data();
+      T const *cdata = curdata->data();
+      UniStateVector<T, DomainType>::touch_entries([&](int i) {
+          ldata[i] = cdata[i];
+        });
+      levels_.push_back(levdata);
+    }
+  }
+
+  std::vector<std::shared_ptr<StateArray<T>>> levels_;
+};  // MultiLevelStateVector
+
 //! Send a std::array to output stream
 
 template <class T, std::size_t N>
@@ -451,6 +853,329 @@ std::ostream & operator<<(std::ostream & os, const std::array<T, N>& arr) {
 
 
 
+///////////////////////////////////////////////////////////////////////////////
+
+
+
+/*!
+  @class SoAStateVector jali_state_vector.h
+  @brief SoAStateVector stores univalued multi-component state data
+  (vectors, tensors) for entities in a mesh or mesh tile as one
+  contiguous array per component (structure-of-arrays)
+
+  Per-entity access goes through get/set or operator()(entity,
+  component) while the component arrays can be accessed directly for
+  vectorizable loops. Data can be converted to and from the
+  array-of-structures layout of UniStateVector<T> (e.g. for I/O).
+
+  @tparam T           Fixed size array type (e.g. std::array<double, 3>)
+  @tparam DomainType  Mesh or Mesh Tile
+*/
+
+template <class T, class DomainType = Mesh>
+class SoAStateVector : public UniStateVectorBase<DomainType> {
+ public:
+
+  /// Type of each component
+  typedef typename T::value_type component_type;
+
+  /// Number of components
+  static constexpr std::size_t ncomp = std::tuple_size<T>::value;
+
+  /// Storage for one component
+  typedef StateArray<component_type> component_array;
+
+  //! Default constructor - not to be used
+  SoAStateVector() : UniStateVectorBase<DomainType>(), mydata_(nullptr)
+  {}
+
+
+  /*!
+    @brief Constructor with array-of-structures data
+    @param name            Name of vector
+    @param state           State manager holding the vector (can be nullptr)
+    @param kind            What kind of entity in the Domain does data live on
+    @param type            What type of entity data lives on (PARALLEL_OWNED, PARALLEL_GHOST, etc)
+    @param data            Pointer to AoS data to be used to initialize vector (optional)
+  */
+
+  SoAStateVector(std::string name,
+                 std::shared_ptr<DomainType> domain,
+                 std::shared_ptr<State> state,
+                 Entity_kind kind,
+                 Entity_type type,
+                 T const * const data = nullptr) :
+      UniStateVectorBase<DomainType>(name, domain, state, kind, type) {
+
+    int num = domain->num_entities(kind, type);
+    allocate(num, state_get_memory_policy(state));
+    if (data == nullptr)
+      assign(T());
+    else
+      from_aos(data);
+  }
+
+
+  /*!
+    @brief Meaningful constructor with uniform initializer
+    @param name            Name of vector
+    @param state           State manager holding the vector (can be nullptr)
+    @param kind            What kind of entity in the Domain does data live on
+    @param type            What type of entity data lives on (PARALLEL_OWNED, PARALLEL_GHOST, etc)
+    @param initval         Value to which all elements should be initialized to
+  */
+
+  SoAStateVector(std::string name,
+                 std::shared_ptr<DomainType> domain,
+                 std::shared_ptr<State> state,
+                 Entity_kind kind,
+                 Entity_type type,
+                 T initval) :
+      UniStateVectorBase<DomainType>(name, domain, state, kind, type) {
+
+    int num = domain->num_entities(kind, type);
+    allocate(num, state_get_memory_policy(state));
+    assign(initval);
+  }
+
+
+  /*!
+    @brief Copy constructor - DEEP COPY OF DATA
+  */
+
+  SoAStateVector(SoAStateVector const & in_vector) :
+      UniStateVectorBase<DomainType>(in_vector.myname_,
+                                     in_vector.mydomain_,
+                                     in_vector.mystate_.lock(),
+                                     in_vector.entity_kind_,
+                                     in_vector.entity_type_) {
+    mydata_ =
+        std::make_shared<std::array<component_array, ncomp>>(*(in_vector.mydata_));
+  }
+
+  /*!
+    @brief Assignment operator
+
+    Shallow copy of the metadata and a shared_ptr to the data (same
+    semantics as UniStateVector)
+  */
+
+  SoAStateVector & operator=(SoAStateVector const & in_vector) {
+    StateVectorBase::myname_ = in_vector.myname_;
+    StateVectorBase::mystate_ = in_vector.mystate_;
+    StateVectorBase::entity_kind_ = in_vector.entity_kind_;
+    StateVectorBase::entity_type_ = in_vector.entity_type_;
+    UniStateVectorBase<DomainType>::mydomain_ = in_vector.mydomain_;
+
+    mydata_ = in_vector.mydata_;
+
+    return *this;
+  }
+
+  /// Destructor
+
+  ~SoAStateVector() {}
+
+  /*!
+    @brief Allocate (uninitialized if policy is FIRST_TOUCH) storage
+    @param num     Number of entries
+    @param policy  Memory policy for the storage
+  */
+
+  void allocate(int num, Memory_policy policy) {
+    mydata_ = std::make_shared<std::array<component_array, ncomp>>();
+    for (auto& comp : *mydata_) {
+      comp = component_array(StateAllocator<component_type>(policy));
+      comp.resize(num);
+    }
+  }
+
+  /// Assign a value to all entries of the vector
+
+  void assign(T const& initval) {
+    touch_entries([&](int i) { set(i, initval); });
+  }
+
+  /*!
+    @brief Copy data from an array-of-structures into the vector
+    @param data  Array with as many entries as the vector
+  */
+
+  void from_aos(T const * const data) {
+    touch_entries([&](int i) { set(i, data[i]); });
+  }
+
+  /*!
+    @brief Copy data out to an array-of-structures
+    @param data  Array with room for as many entries as the vector
+  */
+
+  void to_aos(T * const data) const {
+    int num = size();
+    for (int i = 0; i < num; i++)
+      data[i] = get(i);
+  }
+
+  /// Copy data out to an array-of-structures vector
+
+  std::vector<T> to_aos() const {
+    std::vector<T> aosdata(size());
+    to_aos(aosdata.data());
+    return aosdata;
+  }
+
+  /// Memory policy of the vector storage
+
+  Memory_policy memory_policy() const {
+    return (*mydata_)[0].get_allocator().policy();
+  }
+
+  /// Number of components per entity
+
+  constexpr int num_components() const { return ncomp; }
+
+  /// Array of all values of component icomp
+
+  component_array& component(int icomp) { return (*mydata_)[icomp]; }
+
+  /// Array of all values of component icomp
+
+  component_array const& component(int icomp) const {
+    return (*mydata_)[icomp];
+  }
+
+  /// Get the raw data of component icomp
+
+  component_type *get_raw_data(int icomp) { return (*mydata_)[icomp].data(); }
+
+  /// Get the raw data of component icomp
+
+  component_type const *get_raw_data(int icomp) const {
+    return (*mydata_)[icomp].data();
+  }
+
+  /// Type of data (same as the equivalent UniStateVector)
+
+  const std::type_info& data_type() {
+    const std::type_info& ti = typeid(T);
+    return ti;
+  }
+
+  /// Component icomp of entity i
+
+  component_type& operator()(int i, int icomp) {
+    return (*mydata_)[icomp][i];
+  }
+
+  /// Component icomp of entity i
+
+  component_type const& operator()(int i, int icomp) const {
+    return (*mydata_)[icomp][i];
+  }
+
+  /// Gather all components of entity i
+
+  T get(int i) const {
+    T val;
+    for (std::size_t c = 0; c < ncomp; c++)
+      val[c] = (*mydata_)[c][i];
+    return val;
+  }
+
+  /// Scatter all components of entity i
+
+  void set(int i, T const& val) {
+    for (std::size_t c = 0; c < ncomp; c++)
+      (*mydata_)[c][i] = val[c];
+  }
+
+  T operator[](int i) const { return get(i); }
+
+  size_t size() const { return (*mydata_)[0].size(); }
+  void resize(size_t newsize) { resize(newsize, T()); }
+  void resize(size_t newsize, T val) {
+    for (std::size_t c = 0; c < ncomp; c++)
+      (*mydata_)[c].resize(newsize, val[c]);
+  }
+
+  void clear() {
+    for (auto& comp : *mydata_)
+      comp.clear();
+  }
+
+  //! Raw storage for checkpoint/restart (one array per component)
+
+  std::string vector_class() const { return "SoAStateVector"; }
+  int num_raw_arrays() const { return ncomp; }
+  std::size_t raw_element_size() const {
+    return Jali::raw_element_size<component_type>();
+  }
+  std::size_t raw_array_size(int i) const { return (*mydata_)[i].size(); }
+  void * raw_array(int i) { return (*mydata_)[i].data(); }
+  void raw_array_resize(int i, std::size_t n) { (*mydata_)[i].resize(n); }
+
+  //! Output the data
+
+  std::ostream& print(std::ostream& os) const {
+    os << "\n";
+    os << "Vector \"" << StateVectorBase::myname_ << "\" on entity kind " <<
+        StateVectorBase::entity_kind_ << " :\n";
+    os << size() << " elements\n";
+
+    int num = size();
+    for (int i = 0; i < num; i++)
+      os << get(i) << "\n";
+    os << std::endl;  // flush the output
+
+    return os;
+  }
+
+ private:
+
+  // Call touch(i) for each entry - in a plain loop, or from the thread
+  // that owns the tile of the entry if the memory policy is FIRST_TOUCH
+
+  template <class Function>
+  void touch_entries(Function const& touch) {
+    int num = size();
+    if (memory_policy() != Memory_policy::FIRST_TOUCH) {
+      for (int i = 0; i < num; i++) touch(i);
+      return;
+    }
+    std::vector<std::vector<int>> parts;
+    if (UniStateVectorBase<DomainType>::mydomain_)
+      get_first_touch_parts(UniStateVectorBase<DomainType>::mydomain_,
+                            StateVectorBase::entity_kind_,
+                            StateVectorBase::entity_type_, &parts);
+    first_touch(num, parts, touch);
+  }
+
+  std::shared_ptr<std::array<component_array, ncomp>> mydata_;
+};  // SoAStateVector
+
+//! Send SoAStateVector to output stream
+
+template <class T, class DomainType>
+std::ostream & operator<<(std::ostream & os,
+                          SoAStateVector<T, DomainType> const & sv) {
+  return sv.print(os);
+}
+
+//! Copy the data of a univalued state vector (of either layout) into a
+//! contiguous array-of-structures
+
+template <class VecType>
+auto aos_copy(VecType const& sv) ->
+    std::vector<typename std::decay<decltype(sv[0])>::type> {
+  int num = sv.size();
+  std::vector<typename std::decay<decltype(sv[0])>::type> aosdata(num);
+  for (int i = 0; i < num; i++)
+    aosdata[i] = sv[i];
+  return aosdata;
+}
+
+
+
 ///////////////////////////////////////////////////////////////////////////////
 
 
@@ -547,6 +1272,10 @@ class MultiStateVectorBase : public StateVectorBase {
 
   Mesh & mesh() const { return get_mesh_of_domain(mydomain_); }
 
+  /// ID of the domain (-1 for a mesh, tile ID for a mesh tile)
+
+  int domain_id() const { return get_domain_id(mydomain_); }
+
   /// Get the type of state vector
 
   StateVector_type type() { return StateVector_type::MULTIVAL; }
@@ -710,9 +1439,10 @@ class MultiStateVector : public MultiStateVectorBase<DomainType> {
                                        in_vector.mystate_.lock(),
                                        in_vector.entity_kind_,
                                        in_vector.entity_type_) {
+    // copy of the data uses the same memory policy as the input vector
     mydata_ =
-    std::make_shared<std::vector<std::vector<T>>>((in_vector.mydata_)->begin(),
-                                                  (in_vector.mydata_)->end());
+        std::make_shared<std::vector<StateArray<T>>>(*(in_vector.mydata_));
+    policy_ = in_vector.policy_;
   }
 
   /*!
@@ -731,6 +1461,7 @@ class MultiStateVector : public MultiStateVectorBase<DomainType> {
     MultiStateVectorBase<DomainType>::mydomain_ = in_vector.mydomain_;
 
     mydata_ = in_vector.mydata_;  // shared_ptr counter will increment
+    policy_ = in_vector.policy_;
 
     return *this;
   }
@@ -742,13 +1473,29 @@ class MultiStateVector : public MultiStateVectorBase<DomainType> {
 
   void allocate() {
     int nummats = state_get_num_materials(StateVectorBase::mystate_);
-    mydata_ = std::make_shared<std::vector<std::vector<T>>>(nummats);
+    policy_ = state_get_memory_policy(StateVectorBase::mystate_);
+    StateAllocator<T> alloc(policy_);
+    mydata_ = std::make_shared<std::vector<StateArray<T>>>(nummats,
+                                                          StateArray<T>(alloc));
     for (int m = 0; m < nummats; m++) {
       // get entities in the material set 'm'
       std::shared_ptr<MeshSet> mset =
           state_get_material_set(StateVectorBase::mystate_, m);
-      int numents = mset->entities().size();
+      std::vector<int> const& entities = mset->entities();
+      int numents = entities.size();
       (*mydata_)[m].resize(numents);
+
+      // Under the FIRST_TOUCH policy, the entries are uninitialized -
+      // initialize them from the threads owning the tiles of the cells
+
+      if (alloc.policy() == Memory_policy::FIRST_TOUCH) {
+        std::vector<std::vector<int>> parts;
+        if (MultiStateVectorBase<DomainType>::mydomain_)
+          get_first_touch_parts(MultiStateVectorBase<DomainType>::mydomain_,
+                                entities, &parts);
+        T *mdata = (*mydata_)[m].data();
+        first_touch(numents, parts, [&](int i) { mdata[i] = T(); });
+      }
     }
   }
 
@@ -832,15 +1579,19 @@ class MultiStateVector : public MultiStateVectorBase<DomainType> {
 
   /// Get a shared ptr to the data
 
-  std::shared_ptr<std::vector<std::vector<T>>> get_data() { return mydata_; }
+  std::shared_ptr<std::vector<StateArray<T>>> get_data() { return mydata_; }
 
   /// Get a reference to the data for one material
 
-  std::vector<T>& get_matdata(int m) { return (*mydata_)[m]; }
+  StateArray<T>& get_matdata(int m) { return (*mydata_)[m]; }
 
   /// Get a reference to the data for one material
 
-  std::vector<T> const& get_matdata(int m) const { return (*mydata_)[m]; }
+  StateArray<T> const& get_matdata(int m) const { return (*mydata_)[m]; }
+
+  /// Memory policy of the vector storage
+
+  Memory_policy memory_policy() const { return policy_; }
 
   /// Type of data
 
@@ -851,8 +1602,8 @@ class MultiStateVector : public MultiStateVectorBase<DomainType> {
 
   //! Subset of std::vector functionality. We can add others as needed
 
-  typedef typename std::vector<T>::iterator iterator;
-  typedef typename std::vector<T>::const_iterator const_iterator;
+  typedef typename StateArray<T>::iterator iterator;
+  typedef typename StateArray<T>::const_iterator const_iterator;
 
   iterator begin(int m) { return (*mydata_)[m].begin(); }
   iterator end(int m) { return (*mydata_)[m].end(); }
@@ -935,7 +1686,7 @@ class MultiStateVector : public MultiStateVectorBase<DomainType> {
   size_t size(int m) const { return (*mydata_)[m].size(); }
 
   /// Resize a particular material array
-  void resize(int m, size_t newsize) { (*mydata_)[m].resize(newsize); }
+  void resize(int m, size_t newsize) { (*mydata_)[m].resize(newsize, T()); }
 
   /// Resize a particular material array and initialize new elements to val
   void resize(int m, size_t newsize, T val) {
@@ -951,8 +1702,9 @@ class MultiStateVector : public MultiStateVectorBase<DomainType> {
   /// Add a material and its entries to the vector
   void add_material(int ncells) {
     size_t nmats = mydata_->size();
-    mydata_->resize(nmats+1);
-    (*mydata_)[nmats].resize(ncells);
+    StateAllocator<T> alloc(policy_);
+    mydata_->resize(nmats+1, StateArray<T>(alloc));
+    (*mydata_)[nmats].resize(ncells, T());
   }
 
   // Remove a material and its entries from the vector
@@ -960,6 +1712,15 @@ class MultiStateVector : public MultiStateVectorBase<DomainType> {
     mydata_->erase(mydata_->begin()+m);
   }
 
+  //! Raw storage for checkpoint/restart (one array per material)
+
+  std::string vector_class() const { return "MultiStateVector"; }
+  int num_raw_arrays() const { return mydata_->size(); }
+  std::size_t raw_element_size() const { return Jali::raw_element_size<T>(); }
+  std::size_t raw_array_size(int i) const { return (*mydata_)[i].size(); }
+  void * raw_array(int i) { return (*mydata_)[i].data(); }
+  void raw_array_resize(int i, std::size_t n) { (*mydata_)[i].resize(n); }
+
   //! Output the data (but only if it is arithmetic type)
   // DISABLED UNTIL WE CAN ENABLE IT ONLY FOR THOSE TYPES THAT CAN BE STREAMED
 
@@ -984,7 +1745,12 @@ class MultiStateVector : public MultiStateVectorBase<DomainType> {
   // state manager adds new cells to material sets (same as adding
   // materials to cells)? May be needed for accelerators
 
-  std::shared_ptr<std::vector<std::vector<T>>> mydata_;
+  std::shared_ptr<std::vector<StateArray<T>>> mydata_;
+
+  // Memory policy of the storage (kept here since there may be no
+  // material arrays to ask)
+
+  Memory_policy policy_ = Memory_policy::DEFAULT;
 };  // MultiStateVector
 
 
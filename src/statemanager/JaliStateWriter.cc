@@ -0,0 +1,345 @@
+/*
+ Copyright (c) 2019, Triad National Security, LLC
+ All rights reserved.
+
+ Copyright 2019. Triad National Security, LLC. This software was
+ produced under U.S. Government contract 89233218CNA000001 for Los
+ Alamos National Laboratory (LANL), which is operated by Triad
+ National Security, LLC for the U.S. Department of Energy. 
+ All rights in the program are reserved by Triad National Security,
+ LLC, and the U.S. Department of Energy/National Nuclear Security
+ Administration. The Government is granted for itself and others acting
+ on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+ in this material to reproduce, prepare derivative works, distribute
+ copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+
+ 
+ This is open source software distributed under the 3-clause BSD license.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of Triad National Security, LLC, Los Alamos
+    National Laboratory, LANL, the U.S. Government, nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ 
+ THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+ BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "JaliStateWriter.h"
+#include "JaliState.h"
+#include "JaliStateVector.h"
+#include "errors.hh"
+#include "Mesh.hh"
+
+namespace Jali {
+
+namespace {
+
+void write_value(std::ostream& os, int64_t val) {
+  os.write(reinterpret_cast<char const *>(&val), sizeof(val));
+}
+
+void write_string(std::ostream& os, std::string const& str) {
+  write_value(os, str.size());
+  os.write(str.data(), str.size());
+}
+
+}  // namespace
+
+
+Checkpoint_data_type checkpoint_data_type(std::type_info const& type) {
+  if (type == typeid(double))
+    return Checkpoint_data_type::DOUBLE;
+  else if (type == typeid(float))
+    return Checkpoint_data_type::FLOAT;
+  else if (type == typeid(int))
+    return Checkpoint_data_type::INT;
+  else if (type == typeid(std::array<double, 2>))
+    return Checkpoint_data_type::DOUBLE_ARRAY2;
+  else if (type == typeid(std::array<double, 3>))
+    return Checkpoint_data_type::DOUBLE_ARRAY3;
+  else if (type == typeid(std::array<double, 6>))
+    return Checkpoint_data_type::DOUBLE_ARRAY6;
+  return Checkpoint_data_type::UNKNOWN;
+}
+
+
+std::string Checkpoint_data_type_string(Checkpoint_data_type const dtype) {
+  static const std::string names[NUM_CHECKPOINT_DATA_TYPES] =
+      {"unknown", "double", "float", "int", "std::array<double, 2>",
+       "std::array<double, 3>", "std::array<double, 6>"};
+  int i = static_cast<int>(dtype);
+  return (i >= 0 && i < NUM_CHECKPOINT_DATA_TYPES) ? names[i] :
+      "invalid (" + std::to_string(i) + ")";
+}
+
+
+std::string checkpoint_filename(std::string const& filename, int nprocs,
+                                int rank) {
+  if (nprocs == 1) return filename;
+  std::stringstream name;
+  name << filename << "." << nprocs << "." << rank;
+  return name.str();
+}
+
+
+// Snapshot of the state, initially referring to the vector data
+
+StateSnapshot::StateSnapshot(State& state,
+                             std::vector<std::string> const& names) {
+  std::shared_ptr<Mesh> mesh = state.mesh();
+  int nprocs, rank;
+  MPI_Comm_size(mesh->get_comm(), &nprocs);
+  MPI_Comm_rank(mesh->get_comm(), &rank);
+
+  for (int m = 0; m < state.num_materials(); m++) {
+    Material mat = {state.material_name(m), state.material_cells(m)};
+    num_bytes_ += mat.cells.size()*sizeof(int);
+    materials_.push_back(mat);
+  }
+
+  for (auto it = state.cbegin(); it != state.cend(); ++it) {
+    std::shared_ptr<StateVectorBase> sv = *it;
+    if (!names.empty() &&
+        std::find(names.begin(), names.end(), sv->name()) == names.end())
+      continue;
+
+    if (sv->num_raw_arrays() == 0 || sv->raw_element_size() == 0) {
+      if (rank == 0)
+        std::cerr << "Cannot checkpoint vector " << sv->name() <<
+            " (data cannot be copied bytewise)\n";
+      continue;
+    }
+    Checkpoint_data_type dtype = checkpoint_data_type(sv->data_type());
+    if (dtype == Checkpoint_data_type::UNKNOWN) {
+      if (rank == 0)
+        std::cerr << "Cannot checkpoint vector " << sv->name() <<
+            " (data type " << sv->data_type().name() << " has no"
+            " checkpoint tag)\n";
+      continue;
+    }
+
+    Vector vec;
+    vec.name = sv->name();
+    vec.kind = sv->entity_kind();
+    vec.type = sv->entity_type();
+    vec.domain_id = sv->domain_id();
+    vec.vector_class = sv->vector_class();
+    vec.data_type = dtype;
+    vec.element_size = sv->raw_element_size();
+    for (int i = 0; i < sv->num_raw_arrays(); i++) {
+      Array arr;
+      arr.data = sv->raw_array(i);
+      arr.num = sv->raw_array_size(i);
+      num_bytes_ += arr.num*vec.element_size;
+      vec.arrays.push_back(arr);
+    }
+    vectors_.push_back(vec);
+  }
+
+  std::memset(&header_, 0, sizeof(header_));
+  header_.set_magic();
+  header_.version = StateCheckpointHeader::VERSION;
+  header_.endian = StateCheckpointHeader::ENDIAN_CHECK;
+  header_.nprocs = nprocs;
+  header_.rank = rank;
+  header_.nmaterials = materials_.size();
+  header_.nvectors = vectors_.size();
+  for (int k = 0; k < StateCheckpointHeader::NUM_KINDS; k++)
+    header_.num_entities[k] =
+        mesh->num_entities(static_cast<Entity_kind>(k), Entity_type::ALL);
+}
+
+
+void StateSnapshot::copy_data() {
+  if (copied_) return;
+  for (auto& vec : vectors_)
+    for (auto& arr : vec.arrays) {
+      char const *data = static_cast<char const *>(arr.data);
+      arr.copy.assign(data, data + arr.num*vec.element_size);
+      arr.data = nullptr;
+    }
+  copied_ = true;
+}
+
+
+bool StateSnapshot::write(std::string const& filename) const {
+  std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+  if (!file) return false;
+
+  file.write(reinterpret_cast<char const *>(&header_), sizeof(header_));
+
+  for (auto const& mat : materials_) {
+    write_string(file, mat.name);
+    write_value(file, mat.cells.size());
+    file.write(reinterpret_cast<char const *>(mat.cells.data()),
+               mat.cells.size()*sizeof(int));
+  }
+
+  for (auto const& vec : vectors_) {
+    write_string(file, vec.name);
+    write_value(file, static_cast<int64_t>(vec.kind));
+    write_value(file, static_cast<int64_t>(vec.type));
+    write_value(file, vec.domain_id);
+    write_string(file, vec.vector_class);
+    write_value(file, static_cast<int64_t>(vec.data_type));
+    write_value(file, vec.element_size);
+    write_value(file, vec.arrays.size());
+    for (auto const& arr : vec.arrays) {
+      write_value(file, arr.num);
+      file.write(copied_ ? arr.copy.data() :
+                 static_cast<char const *>(arr.data),
+                 arr.num*vec.element_size);
+    }
+  }
+
+  file.close();
+  return !file.fail();
+}
+
+
+
+AsyncStateWriter::AsyncStateWriter(MPI_Comm comm, std::size_t max_bytes) :
+    comm_(comm), max_bytes_(max_bytes) {
+  MPI_Comm_size(comm_, &nprocs_);
+  MPI_Comm_rank(comm_, &rank_);
+  thread_ = std::thread(&AsyncStateWriter::run, this);
+}
+
+
+AsyncStateWriter::~AsyncStateWriter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    done_ = true;
+  }
+  cv_.notify_all();
+  thread_.join();
+
+  for (auto const& filename : failed_)
+    std::cerr << "AsyncStateWriter: could not write " << filename << "\n";
+}
+
+
+void AsyncStateWriter::write(State& state, std::string const& filename,
+                             std::vector<std::string> const& names) {
+  std::unique_ptr<StateSnapshot> snapshot(new StateSnapshot(state, names));
+  std::size_t nbytes = snapshot->num_bytes();
+
+  // Reserve room in the staging area, waiting for earlier snapshots
+  // to be written if necessary, and only then copy the data
+
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [&]() {
+        return (max_bytes_ == 0 || pending_bytes_ + nbytes <= max_bytes_ ||
+                (queue_.empty() && !busy_));
+      });
+    pending_bytes_ += nbytes;
+  }
+
+  snapshot->copy_data();
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Job job;
+    job.snapshot = std::move(snapshot);
+    job.filename = checkpoint_filename(filename, nprocs_, rank_);
+    queue_.push_back(std::move(job));
+  }
+  cv_.notify_all();
+}
+
+
+void AsyncStateWriter::wait_local() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [&]() { return queue_.empty() && !busy_; });
+}
+
+
+void AsyncStateWriter::wait() {
+  wait_local();
+
+  std::string failed;
+  int ierr, aerr = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ierr = failed_.size();
+    for (auto const& filename : failed_)
+      failed += " " + filename;
+    failed_.clear();
+  }
+
+  MPI_Allreduce(&ierr, &aerr, 1, MPI_INT, MPI_SUM, comm_);
+  if (aerr) {
+    std::string mesgstr = "AsyncStateWriter: " + std::to_string(aerr) +
+        " checkpoint file(s) could not be written";
+    if (ierr) mesgstr += " -" + failed;
+    Errors::Message mesg(mesgstr);
+    Exceptions::Jali_throw(mesg);
+  }
+}
+
+
+std::size_t AsyncStateWriter::pending_bytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return pending_bytes_;
+}
+
+
+// Background thread - write queued snapshots in order
+
+void AsyncStateWriter::run() {
+  while (true) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [&]() { return !queue_.empty() || done_; });
+      if (queue_.empty()) return;
+      job = std::move(queue_.front());
+      queue_.pop_front();
+      busy_ = true;
+    }
+
+    bool ok = job.snapshot->write(job.filename);
+    std::size_t nbytes = job.snapshot->num_bytes();
+    job.snapshot.reset();
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pending_bytes_ -= nbytes;
+      busy_ = false;
+      if (!ok) failed_.push_back(job.filename);
+    }
+    cv_.notify_all();
+  }
+}
+
+}  // namespace Jali
@@ -0,0 +1,293 @@
+/*
+ Copyright (c) 2019, Triad National Security, LLC
+ All rights reserved.
+
+ Copyright 2019. Triad National Security, LLC. This software was
+ produced under U.S. Government contract 89233218CNA000001 for Los
+ Alamos National Laboratory (LANL), which is operated by Triad
+ National Security, LLC for the U.S. Department of Energy. 
+ All rights in the program are reserved by Triad National Security,
+ LLC, and the U.S. Department of Energy/National Nuclear Security
+ Administration. The Government is granted for itself and others acting
+ on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+ in this material to reproduce, prepare derivative works, distribute
+ copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+
+ 
+ This is open source software distributed under the 3-clause BSD license.
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are
+ met:
+ 
+ 1. Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution.
+ 3. Neither the name of Triad National Security, LLC, Los Alamos
+    National Laboratory, LANL, the U.S. Government, nor the names of its
+    contributors may be used to endorse or promote products derived from this
+    software without specific prior written permission.
+
+ 
+ THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+ CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+ BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+ TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+ IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef JALI_STATE_WRITER_H_
+#define JALI_STATE_WRITER_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <typeinfo>
+#include <vector>
+
+#include "mpi.h"
+
+#include "MeshDefs.hh"
+
+namespace Jali {
+
+class State;
+
+/*!
+  @brief Header at the start of every per-rank binary checkpoint file
+
+  It is followed by the materials (name and cells of each) and then,
+  for each state vector, its metadata and its raw arrays written
+  straight from the vector storage. Integers and sizes are 64-bit,
+  strings are written as a length followed by their characters.
+*/
+
+struct StateCheckpointHeader {
+  static constexpr int NUM_KINDS = 7;  // NODE, EDGE, FACE, CELL, SIDE,
+                                       // WEDGE, CORNER
+  static constexpr uint32_t VERSION = 2;
+  static constexpr uint32_t ENDIAN_CHECK = 0x01020304;
+
+  char magic[8];
+  uint32_t version;
+  uint32_t endian;
+  int32_t nprocs;
+  int32_t rank;
+  int32_t nmaterials;
+  int32_t nvectors;
+  int64_t num_entities[NUM_KINDS];
+
+  void set_magic() { std::memcpy(magic, "JALICKPT", sizeof(magic)); }
+  bool valid_magic() const {
+    return std::memcmp(magic, "JALICKPT", sizeof(magic)) == 0;
+  }
+};
+
+/// Data types of the state vectors that can be checkpointed. They are
+/// written to checkpoints as these fixed tags rather than as the names
+/// of the types, which depend on the compiler and standard library
+
+enum class Checkpoint_data_type : std::int32_t {
+  UNKNOWN = 0,
+  DOUBLE = 1,
+  FLOAT = 2,
+  INT = 3,
+  DOUBLE_ARRAY2 = 4,  // std::array<double, 2>
+  DOUBLE_ARRAY3 = 5,  // std::array<double, 3>
+  DOUBLE_ARRAY6 = 6   // std::array<double, 6>
+};
+constexpr int NUM_CHECKPOINT_DATA_TYPES = 7;
+
+/// Tag of a data type (UNKNOWN if it cannot be checkpointed)
+Checkpoint_data_type checkpoint_data_type(std::type_info const& type);
+
+/// Printable name of a checkpoint data type tag
+std::string Checkpoint_data_type_string(Checkpoint_data_type const dtype);
+
+
+/// Name of the checkpoint file written by a rank - <filename> on one
+/// rank, <filename>.<nprocs>.<rank> otherwise
+std::string checkpoint_filename(std::string const& filename, int nprocs,
+                                int rank);
+
+
+/*!
+  @class StateSnapshot JaliStateWriter.h
+  @brief Materials and state vector data of a State in the form written
+  to a binary checkpoint
+
+  A snapshot initially refers to the data of the state vectors. After
+  copy_data() it holds its own copy of the data and is independent of
+  the state, so it can be written out while the state changes.
+*/
+
+class StateSnapshot {
+ public:
+
+  /*!
+    @brief Constructor
+    @param state  State to take the snapshot of
+    @param names  Names of the vectors to include (all if empty)
+
+    Vectors whose data cannot be copied bytewise or whose data type
+    has no checkpoint tag are left out with a warning
+  */
+
+  explicit StateSnapshot(State& state,
+                         std::vector<std::string> const& names = {});
+
+  /// Number of bytes of vector and material data in the snapshot
+  std::size_t num_bytes() const { return num_bytes_; }
+
+  /// Number of state vectors in the snapshot
+  int num_vectors() const { return vectors_.size(); }
+
+  /// Copy the data into the snapshot
+  void copy_data();
+
+  /// Has the data been copied into the snapshot?
+  bool copied() const { return copied_; }
+
+  /// Write the snapshot to a file (not collective); returns success
+  bool write(std::string const& filename) const;
+
+ private:
+
+  struct Array {
+    void const *data;
+    std::size_t num;
+    std::vector<char> copy;
+  };
+
+  struct Vector {
+    std::string name;
+    Entity_kind kind;
+    Entity_type type;
+    int domain_id;
+    std::string vector_class;
+    Checkpoint_data_type data_type;
+    std::size_t element_size;
+    std::vector<Array> arrays;
+  };
+
+  struct Material {
+    std::string name;
+    std::vector<int> cells;
+  };
+
+  StateCheckpointHeader header_;
+  std::vector<Material> materials_;
+  std::vector<Vector> vectors_;
+  std::size_t num_bytes_ = 0;
+  bool copied_ = false;
+};
+
+
+/*!
+  @class AsyncStateWriter JaliStateWriter.h
+  @brief Writes binary checkpoints of a State in a background thread
+
+  write() snapshots the requested state vectors into a staging area
+  and returns; a background thread then writes the snapshot to disk
+  while the simulation continues. The snapshot is a copy, so the state
+  may be modified as soon as write() returns. The staging area is
+  bounded by a memory budget - write() waits for earlier snapshots to
+  be written out if the new one does not fit.
+
+  The files are the same as those of State::write_checkpoint and are
+  read back with State::read_checkpoint. The background thread makes
+  no MPI calls; errors are reported by wait(), which is collective.
+
+  Example:
+
+  AsyncStateWriter writer(mesh->get_comm(), 1 << 30);
+  for (int cycle = 0; cycle < ncycles; cycle++) {
+    advance(state);
+    if (cycle % 10 == 0)
+      writer.write(*state, "dump" + std::to_string(cycle));
+  }
+  writer.wait();
+*/
+
+class AsyncStateWriter {
+ public:
+
+  /*!
+    @brief Constructor
+    @param comm            Communicator of the mesh of the states written
+    @param max_bytes       Memory budget of the staging area (0 for
+                           unlimited). A single snapshot larger than the
+                           budget is still written, after all earlier ones
+  */
+
+  explicit AsyncStateWriter(MPI_Comm comm = MPI_COMM_WORLD,
+                            std::size_t max_bytes = 0);
+
+  /// Destructor - waits for pending writes (errors are printed)
+  ~AsyncStateWriter();
+
+  AsyncStateWriter(AsyncStateWriter const&) = delete;
+  AsyncStateWriter& operator=(AsyncStateWriter const&) = delete;
+
+  /*!
+    @brief Snapshot state vectors and queue them for writing
+    @param state     State to write
+    @param filename  Name of checkpoint (as for State::write_checkpoint)
+    @param names     Names of the vectors to write (all if empty)
+  */
+
+  void write(State& state, std::string const& filename,
+             std::vector<std::string> const& names = {});
+
+  /// Wait until all queued snapshots are written (collective). Throws
+  /// if any write since the last wait() failed on any rank
+  void wait();
+
+  /// Number of bytes in snapshots not yet written
+  std::size_t pending_bytes() const;
+
+  /// Memory budget of the staging area
+  std::size_t max_bytes() const { return max_bytes_; }
+
+ private:
+
+  struct Job {
+    std::unique_ptr<StateSnapshot> snapshot;
+    std::string filename;
+  };
+
+  void run();
+  void wait_local();
+
+  MPI_Comm comm_;
+  int nprocs_, rank_;
+  std::size_t max_bytes_;
+
+  std::thread thread_;
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<Job> queue_;
+  std::size_t pending_bytes_ = 0;
+  bool busy_ = false;
+  bool done_ = false;
+  std::vector<std::string> failed_;
+};
+
+}  // namespace Jali
+
+#endif  // JALI_STATE_WRITER_H_
@@ -583,8 +583,8 @@ TEST(Jali_MMState_On_Mesh) {
   // Check that the multimaterial vectors created differently are equivalent
 
   for (int m = 0; m < nmats; m++) {
-    std::vector<double>& vfmat = vf.get_matdata(m);
-    std::vector<double>& vfmat_alt = vf_alt.get_matdata(m);
+    Jali::StateArray<double>& vfmat = vf.get_matdata(m);
+    Jali::StateArray<double>& vfmat_alt = vf_alt.get_matdata(m);
     CHECK_EQUAL(vfmat.size(), vfmat_alt.size());
     for (int c = 0; c < vfmat.size(); c++)
       CHECK_EQUAL(vfmat[c], vfmat_alt[c]);
@@ -616,7 +616,7 @@ TEST(Jali_MMState_On_Mesh) {
   mat1cen[2] = Vec2d(2.5, 0.5);
   mat1cen[3].set(2.5, 1.25);  // mix it up
 
-  std::vector<Vec2d>& mat2cen = matcenvec.get_matdata(2);
+  Jali::StateArray<Vec2d>& mat2cen = matcenvec.get_matdata(2);
   mat2cen[0].x = 1.75; mat2cen[0].y = 1.75;
   mat2cen[1].x = 2.5;  mat2cen[1].y = 1.75;
   mat2cen[2].set(1.75, 2.5);
@@ -634,7 +634,7 @@ TEST(Jali_MMState_On_Mesh) {
                    mesh, Jali::Entity_kind::CELL, Jali::Entity_type::ALL);
 
   for (int m = 0; m < nmats; m++) {
-    std::vector<double>& matvec = rhomat.get_matdata(m);
+    Jali::StateArray<double>& matvec = rhomat.get_matdata(m);
     for (int c = 0; c < matvec.size(); c++) matvec[c] = rho_in[m];
   }
 
@@ -663,8 +663,8 @@ TEST(Jali_MMState_On_Mesh) {
 
   for (int c = 0; c < ncells; c++) rhocell[c] = 0.0;
   for (int m = 0; m < nmats; m++) {
-    std::vector<double>& rhomatvec = rhomat.get_matdata(m);
-    std::vector<double>& vfmatvec = vf.get_matdata(m);
+    Jali::StateArray<double>& rhomatvec = rhomat.get_matdata(m);
+    Jali::StateArray<double>& vfmatvec = vf.get_matdata(m);
     std::vector<int> const& matcells = mystate->material_cells(m);
 
     int nmatcells = matcells.size();
@@ -743,7 +743,7 @@ TEST(Jali_MMState_On_Mesh) {
   // Set the density of material 3 to be the same as material 0
   rho_in[3] = rho_in[0];
 
-  std::vector<double>& rhomatvec3 = rhomat.get_matdata(3);
+  Jali::StateArray<double>& rhomatvec3 = rhomat.get_matdata(3);
   for (auto & rho : rhomatvec3)
     rho = rho_in[3];
 
@@ -786,8 +786,8 @@ TEST(Jali_MMState_On_Mesh) {
 
   for (int c = 0; c < ncells; c++) rhocell[c] = 0.0;
   for (int m = 0; m < nmats; m++) {
-    std::vector<double>& rhomatvec = rhomat.get_matdata(m);
-    std::vector<double>& vfmatvec = vf.get_matdata(m);
+    Jali::StateArray<double>& rhomatvec = rhomat.get_matdata(m);
+    Jali::StateArray<double>& vfmatvec = vf.get_matdata(m);
     std::vector<int> const& matcells = mystate->material_cells(m);
 
     int nmatcells = matcells.size();
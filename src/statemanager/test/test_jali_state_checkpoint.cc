@@ -0,0 +1,321 @@
+/*
+Copyright (c) 2019, Triad National Security, LLC
+All rights reserved.
+
+Copyright 2019. Triad National Security, LLC. This software was
+produced under U.S. Government contract 89233218CNA000001 for Los
+Alamos National Laboratory (LANL), which is operated by Triad
+National Security, LLC for the U.S. Department of Energy. 
+All rights in the program are reserved by Triad National Security,
+LLC, and the U.S. Department of Energy/National Nuclear Security
+Administration. The Government is granted for itself and others acting
+on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+in this material to reproduce, prepare derivative works, distribute
+copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+ 
+
+This is open source software distributed under the 3-clause BSD license.
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. Neither the name of Triad National Security, LLC, Los Alamos
+   National Laboratory, LANL, the U.S. Government, nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+ 
+THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+
+#include <mpi.h>
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "JaliState.h"
+#include "JaliStateVector.h"
+#include "JaliStateWriter.h"
+#include "Mesh.hh"
+#include "MeshFactory.hh"
+
+#include "UnitTest++.h"
+
+TEST(Jali_State_Checkpoint) {
+
+  Jali::MeshFactory mf(MPI_COMM_WORLD);
+  std::shared_ptr<Jali::Mesh> mesh = mf(0.0, 0.0, 0.0, 1.0, 1.0, 1.0,
+                                        3, 3, 3);
+  CHECK(mesh);
+
+  int nprocs, rank;
+  MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  int ncells = mesh->num_cells<Jali::Entity_type::ALL>();
+  int nnodes = mesh->num_nodes<Jali::Entity_type::ALL>();
+
+  std::shared_ptr<Jali::State> state = Jali::State::create(mesh);
+
+  // Two materials splitting the cells
+
+  std::vector<int> mat0cells, mat1cells;
+  for (int c = 0; c < ncells; c++)
+    (c % 3 ? mat0cells : mat1cells).push_back(c);
+  state->add_material("steel", mat0cells);
+  state->add_material("copper", mat1cells);
+
+  // Vectors of different classes and data types
+
+  std::vector<double> pressure(ncells);
+  for (int c = 0; c < ncells; c++)
+    pressure[c] = 1.0/(c+3);   // values that don't round trip through text
+  state->add("pressure", mesh, Jali::Entity_kind::CELL,
+             Jali::Entity_type::ALL, &(pressure[0]));
+
+  std::vector<int> nodeids(nnodes);
+  for (int n = 0; n < nnodes; n++)
+    nodeids[n] = 7*n + rank;
+  state->add("nodeids", mesh, Jali::Entity_kind::NODE,
+             Jali::Entity_type::ALL, &(nodeids[0]));
+
+  std::vector<std::array<double, 3>> coords(nnodes);
+  for (int n = 0; n < nnodes; n++) {
+    JaliGeometry::Point xyz;
+    mesh->node_get_coordinates(n, &xyz);
+    for (int i = 0; i < 3; i++)
+      coords[n][i] = xyz[i];
+  }
+  state->add("coords", mesh, Jali::Entity_kind::NODE,
+             Jali::Entity_type::ALL, &(coords[0]));
+
+  Jali::SoAStateVector<std::array<double, 3>>& velocity =
+      state->add<std::array<double, 3>, Jali::Mesh, Jali::SoAStateVector>(
+          "velocity", mesh, Jali::Entity_kind::NODE, Jali::Entity_type::ALL,
+          &(coords[0]));
+  for (int n = 0; n < nnodes; n++)
+    velocity(n, 1) *= -3.0;
+
+  Jali::MultiLevelStateVector<double>& density =
+      state->add_multilevel<double, Jali::Mesh>("density", mesh,
+                                                Jali::Entity_kind::CELL,
+                                                Jali::Entity_type::ALL, 3,
+                                                1.0);
+  for (int step = 1; step <= 2; step++) {
+    state->swap_levels();
+    for (int c = 0; c < ncells; c++)
+      density[c] = density.level(1)[c]/3.0 + c;
+  }
+
+  Jali::MultiStateVector<double>& volfrac =
+      state->add<double, Jali::Mesh, Jali::MultiStateVector>(
+          "volfrac", mesh, Jali::Entity_kind::CELL, Jali::Entity_type::ALL);
+  for (int m = 0; m < 2; m++) {
+    Jali::StateArray<double>& matvf = volfrac.get_matdata(m);
+    for (int i = 0; i < matvf.size(); i++)
+      matvf[i] = 1.0/(m+i+7);
+  }
+
+  std::string filename = "checkpoint_test.jck";
+  state->write_checkpoint(filename);
+
+  // Restart into a fresh state on a new instance of the mesh (material
+  // sets live on the mesh) - everything is recreated
+
+  std::shared_ptr<Jali::Mesh> mesh2 = mf(0.0, 0.0, 0.0, 1.0, 1.0, 1.0,
+                                         3, 3, 3);
+  std::shared_ptr<Jali::State> state2 = Jali::State::create(mesh2);
+  state2->read_checkpoint(filename);
+
+  CHECK_EQUAL(2, state2->num_materials());
+  CHECK_EQUAL("steel", state2->material_name(0));
+  CHECK_EQUAL("copper", state2->material_name(1));
+  CHECK(mat0cells == state2->material_cells(0));
+  CHECK(mat1cells == state2->material_cells(1));
+  CHECK_EQUAL(state->size(), state2->size());
+
+  Jali::UniStateVector<double> pressure2;
+  CHECK(state2->get("pressure", mesh2, Jali::Entity_kind::CELL,
+                    Jali::Entity_type::ALL, &pressure2));
+  for (int c = 0; c < ncells; c++)
+    CHECK_EQUAL(pressure[c], pressure2[c]);
+
+  Jali::UniStateVector<int> nodeids2;
+  CHECK(state2->get("nodeids", mesh2, Jali::Entity_kind::NODE,
+                    Jali::Entity_type::ALL, &nodeids2));
+  for (int n = 0; n < nnodes; n++)
+    CHECK_EQUAL(nodeids[n], nodeids2[n]);
+
+  Jali::UniStateVector<std::array<double, 3>> coords2;
+  CHECK(state2->get("coords", mesh2, Jali::Entity_kind::NODE,
+                    Jali::Entity_type::ALL, &coords2));
+  for (int n = 0; n < nnodes; n++)
+    CHECK(coords[n] == coords2[n]);
+
+  Jali::SoAStateVector<std::array<double, 3>> velocity2;
+  CHECK(state2->get("velocity", mesh2, Jali::Entity_kind::NODE,
+                    Jali::Entity_type::ALL, &velocity2));
+  for (int n = 0; n < nnodes; n++)
+    for (int i = 0; i < 3; i++)
+      CHECK_EQUAL(velocity(n, i), velocity2(n, i));
+
+  Jali::MultiLevelStateVector<double> density2;
+  CHECK(state2->get("density", mesh2, Jali::Entity_kind::CELL,
+                    Jali::Entity_type::ALL, &density2));
+  CHECK_EQUAL(3, density2.num_levels());
+  for (int k = 0; k < 3; k++)
+    for (int c = 0; c < ncells; c++)
+      CHECK_EQUAL(density.level(k)[c], density2.level(k)[c]);
+
+  Jali::MultiStateVector<double> volfrac2;
+  CHECK(state2->get("volfrac", mesh2, Jali::Entity_kind::CELL,
+                    Jali::Entity_type::ALL, &volfrac2));
+  for (int m = 0; m < 2; m++) {
+    Jali::StateArray<double>& matvf = volfrac.get_matdata(m);
+    Jali::StateArray<double>& matvf2 = volfrac2.get_matdata(m);
+    CHECK_EQUAL(matvf.size(), matvf2.size());
+    for (int i = 0; i < matvf.size(); i++)
+      CHECK_EQUAL(matvf[i], matvf2[i]);
+  }
+
+  // Restart into a state with the vector already added - the data is
+  // restored in place
+
+  std::shared_ptr<Jali::Mesh> mesh3 = mf(0.0, 0.0, 0.0, 1.0, 1.0, 1.0,
+                                         3, 3, 3);
+  std::shared_ptr<Jali::State> state3 = Jali::State::create(mesh3);
+  state3->add_material("steel", mat0cells);
+  state3->add_material("copper", mat1cells);
+  Jali::UniStateVector<double>& pressure3 =
+      state3->add<double, Jali::Mesh, Jali::UniStateVector>(
+          "pressure", mesh3, Jali::Entity_kind::CELL, Jali::Entity_type::ALL,
+          0.0);
+  state3->read_checkpoint(filename);
+  for (int c = 0; c < ncells; c++)
+    CHECK_EQUAL(pressure[c], pressure3[c]);
+
+  // Mismatched materials are an error
+
+  std::shared_ptr<Jali::Mesh> mesh4 = mf(0.0, 0.0, 0.0, 1.0, 1.0, 1.0,
+                                         3, 3, 3);
+  std::shared_ptr<Jali::State> state4 = Jali::State::create(mesh4);
+  state4->add_material("steel", mat1cells);
+  state4->add_material("copper", mat0cells);
+  CHECK_THROW(state4->read_checkpoint(filename), Errors::Message);
+
+  // A corrupt cell count of the first material on one rank is caught
+  // before allocating and every rank fails together
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  if (rank == 0) {
+    std::fstream file(Jali::checkpoint_filename(filename, nprocs, rank),
+                      std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(sizeof(Jali::StateCheckpointHeader) + sizeof(int64_t) +
+               std::string("steel").size());
+    int64_t hugecount = int64_t(1) << 60;
+    file.write(reinterpret_cast<char const *>(&hugecount), sizeof(int64_t));
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  std::shared_ptr<Jali::Mesh> mesh5 = mf(0.0, 0.0, 0.0, 1.0, 1.0, 1.0,
+                                         3, 3, 3);
+  std::shared_ptr<Jali::State> state5 = Jali::State::create(mesh5);
+  CHECK_THROW(state5->read_checkpoint(filename), Errors::Message);
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  std::remove(Jali::checkpoint_filename(filename, nprocs, rank).c_str());
+}
+
+
+
+TEST(Jali_Async_State_Writer) {
+
+  Jali::MeshFactory mf(MPI_COMM_WORLD);
+  std::shared_ptr<Jali::Mesh> mesh = mf(0.0, 0.0, 0.0, 1.0, 1.0, 1.0,
+                                        4, 4, 4);
+  CHECK(mesh);
+
+  int nprocs, rank;
+  MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  int ncells = mesh->num_cells<Jali::Entity_type::ALL>();
+
+  std::shared_ptr<Jali::State> state = Jali::State::create(mesh);
+  Jali::UniStateVector<double>& energy =
+      state->add<double, Jali::Mesh, Jali::UniStateVector>(
+          "energy", mesh, Jali::Entity_kind::CELL, Jali::Entity_type::ALL,
+          0.0);
+  state->add<int, Jali::Mesh, Jali::UniStateVector>(
+      "flags", mesh, Jali::Entity_kind::CELL, Jali::Entity_type::ALL, 1);
+
+  // Budget for about two snapshots of "energy" - the writer has to
+  // wait for earlier dumps to be written out
+
+  std::size_t budget = 2*ncells*sizeof(double) + 16;
+  Jali::AsyncStateWriter writer(MPI_COMM_WORLD, budget);
+  CHECK_EQUAL(budget, writer.max_bytes());
+
+  int ndumps = 5;
+  for (int cycle = 0; cycle < ndumps; cycle++) {
+    for (int c = 0; c < ncells; c++)
+      energy[c] = cycle + 1.0/(c+1);
+    writer.write(*state, "async_test_" + std::to_string(cycle), {"energy"});
+    CHECK(writer.pending_bytes() <= budget);
+
+    // Modifying the state right away doesn't affect the dump
+    for (int c = 0; c < ncells; c++)
+      energy[c] = -1.0;
+  }
+  writer.wait();
+  CHECK_EQUAL(0, writer.pending_bytes());
+
+  // Each dump holds the data at the time of the write and only the
+  // requested vector
+
+  for (int cycle = 0; cycle < ndumps; cycle++) {
+    std::shared_ptr<Jali::Mesh> mesh2 = mf(0.0, 0.0, 0.0, 1.0, 1.0, 1.0,
+                                           4, 4, 4);
+    std::shared_ptr<Jali::State> state2 = Jali::State::create(mesh2);
+    std::string filename = "async_test_" + std::to_string(cycle);
+    state2->read_checkpoint(filename);
+    CHECK_EQUAL(1, state2->size());
+
+    Jali::UniStateVector<double> energy2;
+    CHECK(state2->get("energy", mesh2, Jali::Entity_kind::CELL,
+                      Jali::Entity_type::ALL, &energy2));
+    for (int c = 0; c < ncells; c++)
+      CHECK_EQUAL(cycle + 1.0/(c+1), energy2[c]);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    std::remove(Jali::checkpoint_filename(filename, nprocs, rank).c_str());
+  }
+
+  // Failures are reported by wait()
+
+  writer.write(*state, "nonexistent_dir/async_test");
+  CHECK_THROW(writer.wait(), Errors::Message);
+}
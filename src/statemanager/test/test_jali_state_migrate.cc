@@ -0,0 +1,236 @@
+/*
+Copyright (c) 2019, Triad National Security, LLC
+All rights reserved.
+
+Copyright 2019. Triad National Security, LLC. This software was
+produced under U.S. Government contract 89233218CNA000001 for Los
+Alamos National Laboratory (LANL), which is operated by Triad
+National Security, LLC for the U.S. Department of Energy. 
+All rights in the program are reserved by Triad National Security,
+LLC, and the U.S. Department of Energy/National Nuclear Security
+Administration. The Government is granted for itself and others acting
+on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+in this material to reproduce, prepare derivative works, distribute
+copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+ 
+
+This is open source software distributed under the 3-clause BSD license.
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. Neither the name of Triad National Security, LLC, Los Alamos
+   National Laboratory, LANL, the U.S. Government, nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+ 
+THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <mpi.h>
+
+#include <algorithm>
+#include <array>
+#include <string>
+#include <vector>
+
+#include "JaliState.h"
+#include "JaliStateVector.h"
+#include "Mesh.hh"
+#include "MeshFactory.hh"
+
+#include "UnitTest++.h"
+
+TEST(Jali_State_Migrate) {
+
+  int nprocs, rank;
+  MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  Jali::MeshFactory mf(MPI_COMM_WORLD);
+  mf.framework(Jali::Flat);
+  std::shared_ptr<Jali::Mesh> mesh = mf(0.0, 0.0, 0.0, 1.0, 1.0, 1.0,
+                                        6, 6, 6);
+  CHECK(mesh);
+
+  int ncells = mesh->num_cells<Jali::Entity_type::ALL>();
+  int nowned = mesh->num_cells<Jali::Entity_type::PARALLEL_OWNED>();
+  int nnodes = mesh->num_nodes<Jali::Entity_type::ALL>();
+  auto cellgid = [](std::shared_ptr<Jali::Mesh> m, int c) {
+    return m->GID(c, Jali::Entity_kind::CELL);
+  };
+  auto nodegid = [](std::shared_ptr<Jali::Mesh> m, int n) {
+    return m->GID(n, Jali::Entity_kind::NODE);
+  };
+
+  // Every value is a function of the global ID of its entity
+
+  std::shared_ptr<Jali::State> state = Jali::State::create(mesh);
+
+  std::vector<int> mat0cells, mat1cells;
+  for (int c = 0; c < ncells; c++) {
+    if (cellgid(mesh, c) % 2 == 0) mat0cells.push_back(c);
+    if (cellgid(mesh, c) % 3 == 0) mat1cells.push_back(c);
+  }
+  state->add_material("steel", mat0cells);
+  state->add_material("copper", mat1cells);
+
+  std::vector<double> pressure(ncells);
+  for (int c = 0; c < ncells; c++)
+    pressure[c] = cellgid(mesh, c) + 0.5;
+  state->add("pressure", mesh, Jali::Entity_kind::CELL,
+             Jali::Entity_type::ALL, &(pressure[0]));
+
+  int nnodes_owned = mesh->num_nodes<Jali::Entity_type::PARALLEL_OWNED>();
+  std::vector<int> nodeids(nnodes_owned);
+  for (int n = 0; n < nnodes_owned; n++)
+    nodeids[n] = 3*nodegid(mesh, n);
+  state->add("nodeids", mesh, Jali::Entity_kind::NODE,
+             Jali::Entity_type::PARALLEL_OWNED, &(nodeids[0]));
+
+  Jali::SoAStateVector<std::array<double, 3>>& velocity =
+      state->add<std::array<double, 3>, Jali::Mesh, Jali::SoAStateVector>(
+          "velocity", mesh, Jali::Entity_kind::NODE, Jali::Entity_type::ALL,
+          std::array<double, 3>());
+  for (int n = 0; n < nnodes; n++)
+    for (int i = 0; i < 3; i++)
+      velocity(n, i) = (i+1)*nodegid(mesh, n);
+
+  Jali::MultiLevelStateVector<double>& density =
+      state->add_multilevel<double, Jali::Mesh>("density", mesh,
+                                                Jali::Entity_kind::CELL,
+                                                Jali::Entity_type::ALL, 2,
+                                                0.0);
+  for (int k = 0; k < 2; k++)
+    for (int c = 0; c < ncells; c++)
+      density.level(k)[c] = cellgid(mesh, c) + 1000.0*k;
+
+  Jali::MultiStateVector<double>& volfrac =
+      state->add<double, Jali::Mesh, Jali::MultiStateVector>(
+          "volfrac", mesh, Jali::Entity_kind::CELL, Jali::Entity_type::ALL);
+  for (int m = 0; m < 2; m++) {
+    Jali::StateArray<double>& matvf = volfrac.get_matdata(m);
+    std::vector<int> const& matcells = state->material_cells(m);
+    for (int i = 0; i < matvf.size(); i++)
+      matvf[i] = 10.0*cellgid(mesh, matcells[i]) + m;
+  }
+
+  // Move everything to a mesh where the first rank has fewer cells
+
+  std::vector<double> weights(nowned, rank ? 1.0 : 4.0);
+  state->add("cost", mesh, Jali::Entity_kind::CELL,
+             Jali::Entity_type::PARALLEL_OWNED, &(weights[0]));
+  std::shared_ptr<Jali::Mesh> newmesh = mf.redistribute(*mesh, &weights);
+  std::shared_ptr<Jali::State> newstate = state->migrate(newmesh);
+  CHECK_EQUAL(state->size(), newstate->size());
+
+  int newncells = newmesh->num_cells<Jali::Entity_type::ALL>();
+  int newnnodes = newmesh->num_nodes<Jali::Entity_type::ALL>();
+
+  CHECK_EQUAL(2, newstate->num_materials());
+  CHECK_EQUAL("steel", newstate->material_name(0));
+  CHECK_EQUAL("copper", newstate->material_name(1));
+  int nmatcells[2] = {0, 0};
+  for (int c = 0; c < newncells; c++) {
+    int gid = cellgid(newmesh, c);
+    std::vector<int> const& cellmats = newstate->cell_materials(c);
+    CHECK_EQUAL(gid % 2 == 0, std::count(cellmats.begin(), cellmats.end(),
+                                         0) == 1);
+    CHECK_EQUAL(gid % 3 == 0, std::count(cellmats.begin(), cellmats.end(),
+                                         1) == 1);
+    if (c < newmesh->num_cells<Jali::Entity_type::PARALLEL_OWNED>())
+      for (auto const& m : cellmats) nmatcells[m]++;
+  }
+  int totmatcells[2];
+  MPI_Allreduce(nmatcells, totmatcells, 2, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+  CHECK_EQUAL(108, totmatcells[0]);
+  CHECK_EQUAL(72, totmatcells[1]);
+
+  Jali::UniStateVector<double> pressure2;
+  CHECK(newstate->get("pressure", newmesh, Jali::Entity_kind::CELL,
+                      Jali::Entity_type::ALL, &pressure2));
+  CHECK_EQUAL(newncells, pressure2.size());
+  for (int c = 0; c < newncells; c++)
+    CHECK_EQUAL(cellgid(newmesh, c) + 0.5, pressure2[c]);
+
+  Jali::UniStateVector<int> nodeids2;
+  CHECK(newstate->get("nodeids", newmesh, Jali::Entity_kind::NODE,
+                      Jali::Entity_type::PARALLEL_OWNED, &nodeids2));
+  CHECK_EQUAL(newmesh->num_nodes<Jali::Entity_type::PARALLEL_OWNED>(),
+              nodeids2.size());
+  for (int n = 0; n < nodeids2.size(); n++)
+    CHECK_EQUAL(3*nodegid(newmesh, n), nodeids2[n]);
+
+  Jali::SoAStateVector<std::array<double, 3>> velocity2;
+  CHECK(newstate->get("velocity", newmesh, Jali::Entity_kind::NODE,
+                      Jali::Entity_type::ALL, &velocity2));
+  for (int n = 0; n < newnnodes; n++)
+    for (int i = 0; i < 3; i++)
+      CHECK_EQUAL((i+1)*nodegid(newmesh, n), velocity2(n, i));
+
+  Jali::MultiLevelStateVector<double> density2;
+  CHECK(newstate->get("density", newmesh, Jali::Entity_kind::CELL,
+                      Jali::Entity_type::ALL, &density2));
+  CHECK_EQUAL(2, density2.num_levels());
+  for (int k = 0; k < 2; k++)
+    for (int c = 0; c < newncells; c++)
+      CHECK_EQUAL(cellgid(newmesh, c) + 1000.0*k, density2.level(k)[c]);
+
+  Jali::MultiStateVector<double> volfrac2;
+  CHECK(newstate->get("volfrac", newmesh, Jali::Entity_kind::CELL,
+                      Jali::Entity_type::ALL, &volfrac2));
+  for (int m = 0; m < 2; m++) {
+    Jali::StateArray<double>& matvf = volfrac2.get_matdata(m);
+    std::vector<int> const& matcells = newstate->material_cells(m);
+    CHECK_EQUAL(matcells.size(), matvf.size());
+    for (int i = 0; i < matvf.size(); i++)
+      CHECK_EQUAL(10.0*cellgid(newmesh, matcells[i]) + m, matvf[i]);
+  }
+
+  // Owned totals are unchanged
+
+  double sum = 0.0, newsum = 0.0, gsum, gnewsum;
+  for (int c = 0; c < nowned; c++)
+    sum += pressure[c];
+  for (int c = 0; c < newmesh->num_cells<Jali::Entity_type::PARALLEL_OWNED>();
+       c++)
+    newsum += pressure2[c];
+  MPI_Allreduce(&sum, &gsum, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+  MPI_Allreduce(&newsum, &gnewsum, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+  CHECK_CLOSE(gsum, gnewsum, 1.0e-9);
+
+  // The cost is spread more evenly
+
+  Jali::UniStateVector<double> cost2;
+  CHECK(newstate->get("cost", newmesh, Jali::Entity_kind::CELL,
+                      Jali::Entity_type::PARALLEL_OWNED, &cost2));
+  double cost = 0.0, newcost = 0.0, maxcost, newmaxcost;
+  for (auto const& w : weights)
+    cost += w;
+  for (int c = 0; c < cost2.size(); c++)
+    newcost += cost2[c];
+  MPI_Allreduce(&cost, &maxcost, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+  MPI_Allreduce(&newcost, &newmaxcost, 1, MPI_DOUBLE, MPI_MAX,
+                MPI_COMM_WORLD);
+  if (nprocs > 1)
+    CHECK(newmaxcost < maxcost);
+}
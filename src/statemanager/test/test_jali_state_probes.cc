@@ -0,0 +1,239 @@
+/*
+Copyright (c) 2019, Triad National Security, LLC
+All rights reserved.
+
+Copyright 2019. Triad National Security, LLC. This software was
+produced under U.S. Government contract 89233218CNA000001 for Los
+Alamos National Laboratory (LANL), which is operated by Triad
+National Security, LLC for the U.S. Department of Energy. 
+All rights in the program are reserved by Triad National Security,
+LLC, and the U.S. Department of Energy/National Nuclear Security
+Administration. The Government is granted for itself and others acting
+on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+in this material to reproduce, prepare derivative works, distribute
+copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+ 
+
+This is open source software distributed under the 3-clause BSD license.
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. Neither the name of Triad National Security, LLC, Los Alamos
+   National Laboratory, LANL, the U.S. Government, nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+ 
+THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+
+#include <mpi.h>
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "JaliState.h"
+#include "JaliStateVector.h"
+#include "JaliStateProbes.h"
+#include "JaliStateWriter.h"
+#include "Mesh.hh"
+#include "MeshFactory.hh"
+
+#include "UnitTest++.h"
+
+namespace {
+
+double linear(JaliGeometry::Point const& xyz) {
+  return 1.0 + 2.0*xyz[0] + 3.0*xyz[1] - xyz[2];
+}
+
+// Check that every probe in the mesh is on exactly one rank and the
+// sampled cell field against the cell holding the probe
+
+void check_record(Jali::StateProbes const& probes, Jali::Mesh const& mesh,
+                  int r, std::vector<bool> const& inside) {
+  for (int i = 0; i < probes.num_probes(); i++) {
+    Jali::Entity_ID c = probes.probe_cell(i);
+    int found = (c >= 0), total;
+    MPI_Allreduce(&found, &total, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    CHECK_EQUAL(inside[i] ? 1 : 0, total);
+    if (c < 0) {
+      CHECK(std::isnan(probes.value(r, i, 0)));
+      continue;
+    }
+    CHECK(c < mesh.num_cells<Jali::Entity_type::PARALLEL_OWNED>());
+    JaliGeometry::Point cen = mesh.cell_centroid(c);
+    CHECK_CLOSE(cen[0], probes.value(r, i, 1), 1.0e-14);
+  }
+}
+
+}  // namespace
+
+
+TEST(Jali_State_Probes) {
+  Jali::MeshFactory mf(MPI_COMM_WORLD);
+  mf.framework(Jali::Flat);
+  std::shared_ptr<Jali::Mesh> mesh = mf(0.0, 0.0, 0.0, 1.0, 1.0, 1.0,
+                                        6, 6, 6);
+  std::shared_ptr<Jali::State> state = Jali::State::create(mesh);
+
+  int ncells = mesh->num_cells<Jali::Entity_type::ALL>();
+  int nnodes = mesh->num_nodes<Jali::Entity_type::ALL>();
+  std::vector<double> zero(std::max(ncells, nnodes), 0.0);
+  state->add("f", mesh, Jali::Entity_kind::NODE, Jali::Entity_type::ALL,
+             &(zero[0]));
+  state->add("xcen", mesh, Jali::Entity_kind::CELL, Jali::Entity_type::ALL,
+             &(zero[0]));
+  Jali::UniStateVector<double> f, xcen;
+  CHECK(state->get("f", mesh, Jali::Entity_kind::NODE,
+                   Jali::Entity_type::ALL, &f));
+  CHECK(state->get("xcen", mesh, Jali::Entity_kind::CELL,
+                   Jali::Entity_type::ALL, &xcen));
+
+  auto set_fields = [&]() {
+    for (int n = 0; n < nnodes; n++) {
+      JaliGeometry::Point xyz;
+      mesh->node_get_coordinates(n, &xyz);
+      f[n] = linear(xyz);
+    }
+    for (int c = 0; c < ncells; c++)
+      xcen[c] = mesh->cell_centroid(c)[0];
+  };
+  set_fields();
+
+  // Pseudo-random points inside, one at a node shared by eight cells
+  // and one outside the mesh
+
+  Jali::StateProbes probes(state, {"f", "xcen"}, 3);
+  std::vector<JaliGeometry::Point> points;
+  unsigned seed = 4321;
+  for (int i = 0; i < 30; i++) {
+    JaliGeometry::Point p(3);
+    for (int d = 0; d < 3; d++) {
+      seed = 1664525u*seed + 1013904223u;
+      p[d] = 0.02 + 0.96*((seed >> 8)/16777216.0);
+    }
+    points.push_back(p);
+  }
+  points.push_back(JaliGeometry::Point(0.5, 0.5, 0.5));
+  points.push_back(JaliGeometry::Point(1.5, 0.5, 0.5));
+  std::vector<bool> inside(points.size(), true);
+  inside.back() = false;
+  for (int i = 0; i < points.size(); i++)
+    CHECK_EQUAL(i, probes.add_probe(points[i]));
+
+  probes.sample(0.0);
+  CHECK_EQUAL(1, probes.num_records());
+  check_record(probes, *mesh, 0, inside);
+  for (int i = 0; i < points.size(); i++)
+    if (probes.probe_cell(i) >= 0)
+      CHECK_CLOSE(linear(points[i]), probes.value(0, i, 0), 1.0e-12);
+
+  // Stretch the mesh beyond x = 0.5 - only the probes in cells with
+  // moved nodes (and those not on this rank) are relocated
+
+  int expected = 0;
+  for (int i = 0; i < points.size(); i++) {
+    Jali::Entity_ID c = probes.probe_cell(i);
+    bool moved = (c < 0);
+    if (c >= 0) {
+      std::vector<JaliGeometry::Point> ccoords;
+      mesh->cell_get_coordinates(c, &ccoords);
+      for (auto const& xyz : ccoords)
+        if (xyz[0] > 0.5 + 1.0e-12) moved = true;
+    }
+    if (moved) expected++;
+  }
+
+  for (int n = 0; n < nnodes; n++) {
+    JaliGeometry::Point xyz;
+    mesh->node_get_coordinates(n, &xyz);
+    if (xyz[0] > 0.5 + 1.0e-12) {
+      xyz[0] += 0.8*(xyz[0]-0.5)*(xyz[0]-0.5);
+      mesh->node_set_coordinates(n, xyz);
+    }
+  }
+  mesh->update_geometric_quantities();
+  set_fields();
+
+  probes.sample(1.0);
+  CHECK_EQUAL(expected, probes.num_relocations());
+  CHECK_EQUAL(2, probes.num_records());
+  check_record(probes, *mesh, 1, inside);
+  for (int i = 0; i < points.size(); i++)
+    if (probes.probe_cell(i) >= 0) {
+      CHECK(mesh->point_in_cell(points[i], probes.probe_cell(i)));
+      CHECK_CLOSE(linear(points[i]), probes.value(1, i, 0), 1.0e-12);
+    }
+
+  // The ring buffer keeps the latest records
+
+  for (int t = 2; t < 5; t++)
+    probes.sample(t);
+  CHECK(probes.full());
+  CHECK_EQUAL(3, probes.num_records());
+  CHECK_EQUAL(2, probes.num_dropped());
+  CHECK_EQUAL(2.0, probes.time(0));
+  CHECK_EQUAL(4.0, probes.time(2));
+
+  // Flushed records are appended to the file in the background
+
+  probes.flush("probes_history");
+  CHECK_EQUAL(0, probes.num_records());
+  probes.sample(5.0);
+  probes.flush("probes_history");
+  probes.wait();
+
+  int nprocs, rank;
+  MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  std::ifstream file(Jali::checkpoint_filename("probes_history", nprocs,
+                                               rank));
+  CHECK(file.good());
+  std::string line;
+  int nheader = 0;
+  std::vector<double> times;
+  while (std::getline(file, line)) {
+    if (line[0] == '#') {
+      nheader++;
+      continue;
+    }
+    std::istringstream is(line);
+    double t;
+    std::string val;   // nan for the probes on other ranks
+    int ncols = 0;
+    is >> t;
+    while (is >> val) ncols++;
+    CHECK_EQUAL(2*points.size(), ncols);
+    times.push_back(t);
+  }
+  CHECK_EQUAL(points.size()+1, nheader);
+  CHECK(times == std::vector<double>({2.0, 3.0, 4.0, 5.0}));
+  file.close();
+  std::remove(Jali::checkpoint_filename("probes_history", nprocs,
+                                        rank).c_str());
+}
@@ -0,0 +1,189 @@
+/*
+Copyright (c) 2019, Triad National Security, LLC
+All rights reserved.
+
+Copyright 2019. Triad National Security, LLC. This software was
+produced under U.S. Government contract 89233218CNA000001 for Los
+Alamos National Laboratory (LANL), which is operated by Triad
+National Security, LLC for the U.S. Department of Energy. 
+All rights in the program are reserved by Triad National Security,
+LLC, and the U.S. Department of Energy/National Nuclear Security
+Administration. The Government is granted for itself and others acting
+on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+in this material to reproduce, prepare derivative works, distribute
+copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+ 
+
+This is open source software distributed under the 3-clause BSD license.
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. Neither the name of Triad National Security, LLC, Los Alamos
+   National Laboratory, LANL, the U.S. Government, nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+ 
+THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <mpi.h>
+
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+#include <algorithm>
+
+#include "JaliState.h"
+#include "JaliStateVector.h"
+#include "JaliStateReduction.h"
+#include "Mesh.hh"
+#include "MeshFactory.hh"
+
+#include "UnitTest++.h"
+
+TEST(Jali_State_Reductions) {
+
+  Jali::MeshFactory mf(MPI_COMM_WORLD);
+  std::shared_ptr<Jali::Mesh> mesh = mf(0.0, 0.0, 0.0, 1.0, 1.0, 1.0,
+                                        4, 4, 4);
+  CHECK(mesh);
+
+  std::shared_ptr<Jali::State> state = Jali::State::create(mesh);
+
+  int ncells = mesh->num_cells<Jali::Entity_type::ALL>();
+  int nnodes = mesh->num_nodes<Jali::Entity_type::ALL>();
+
+  std::vector<double> xcen(ncells);
+  for (int c = 0; c < ncells; c++)
+    xcen[c] = mesh->cell_centroid(c)[0];
+  state->add("xcen", mesh, Jali::Entity_kind::CELL, Jali::Entity_type::ALL,
+             &(xcen[0]));
+
+  std::vector<int> one(nnodes, 1);
+  state->add("one", mesh, Jali::Entity_kind::NODE, Jali::Entity_type::ALL,
+             &(one[0]));
+
+  std::vector<double> results =
+      state->reduce({{"xcen", Jali::Reduction_type::MIN},
+                     {"xcen", Jali::Reduction_type::MAX},
+                     {"xcen", Jali::Reduction_type::SUM},
+                     {"one", Jali::Reduction_type::SUM},
+                     {"nonexistent", Jali::Reduction_type::SUM}});
+  CHECK_EQUAL(5, results.size());
+  CHECK_CLOSE(0.125, results[0], 1.0e-12);
+  CHECK_CLOSE(0.875, results[1], 1.0e-12);
+  CHECK_CLOSE(32.0, results[2], 1.0e-10);   // 64 cells, mean x = 0.5
+  CHECK_EQUAL(125.0, results[3]);           // 5x5x5 nodes, counted once
+  CHECK(std::isnan(results[4]));
+
+  // Same results from threaded and reproducible reductions and from
+  // the vector itself
+
+  std::vector<double> results2 =
+      state->reduce({{"xcen", Jali::Reduction_type::MIN},
+                     {"xcen", Jali::Reduction_type::MAX},
+                     {"xcen", Jali::Reduction_type::SUM},
+                     {"one", Jali::Reduction_type::SUM}}, true, 4);
+  for (int i = 0; i < 4; i++)
+    CHECK_CLOSE(results[i], results2[i], 1.0e-10);
+
+  Jali::UniStateVector<double> xvec;
+  CHECK(state->get("xcen", mesh, Jali::Entity_kind::CELL,
+                   Jali::Entity_type::ALL, &xvec));
+  CHECK_EQUAL(results[1], xvec.reduce(Jali::Reduction_type::MAX));
+  CHECK_EQUAL(results2[2], xvec.reduce(Jali::Reduction_type::SUM, true, 3));
+
+  // Vectors on ghost entities only cannot be reduced over owned ones
+
+  int nghost = mesh->num_cells<Jali::Entity_type::PARALLEL_GHOST>();
+  std::vector<double> ghostdata(nghost+1, 1.0);
+  Jali::UniStateVector<double>& gvec =
+      state->add("ghost", mesh, Jali::Entity_kind::CELL,
+                 Jali::Entity_type::PARALLEL_GHOST, &(ghostdata[0]));
+  CHECK_THROW(gvec.reduce(Jali::Reduction_type::MIN), std::runtime_error);
+  CHECK(std::isnan(state->reduce({{"ghost",
+            Jali::Reduction_type::MIN}})[0]));
+}
+
+
+TEST(Jali_State_Reproducible_Sum) {
+
+  // Values spanning many orders of magnitude with massive
+  // cancellation - the reproducible sum must not depend on the order
+  // of summation or the number of threads and must be exact here
+
+  int num = 1000;
+  std::vector<double> vals(num);
+  for (int i = 0; i < num; i++) {
+    switch (i % 4) {
+      case 0: vals[i] = 1.0e20*(i+1); break;
+      case 1: vals[i] = 1.0/(1 << (i % 30)); break;
+      case 2: vals[i] = -1.0e20*(i-1); break;
+      case 3: vals[i] = 1.0e-300; break;
+    }
+  }
+
+  // expected sum: the large values cancel exactly
+  double expected_small = 0.0;
+  for (int i = 0; i < num; i++)
+    if (i % 4 == 1) expected_small += vals[i];
+
+  std::vector<Jali::Entity_ID> forward(num), reverse(num), shuffled(num);
+  for (int i = 0; i < num; i++) {
+    forward[i] = i;
+    reverse[i] = num-1-i;
+    shuffled[i] = (i*7919) % num;
+  }
+
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  std::vector<double> sums;
+  for (auto ids : {&forward, &reverse, &shuffled}) {
+    for (int nthreads = 1; nthreads <= 4; nthreads += 3) {
+      // only rank 0 contributes so the result does not depend on the
+      // number of ranks
+      Jali::StateReduction reduction(MPI_COMM_WORLD, true, nthreads);
+      int isum = reduction.add(vals.data(), rank ? 0 : num, ids->data(),
+                               Jali::Reduction_type::SUM);
+      int imin = reduction.add(vals.data(), rank ? 0 : num, ids->data(),
+                               Jali::Reduction_type::MIN);
+      reduction.execute();
+      sums.push_back(reduction.result(isum));
+      CHECK_EQUAL(-1.0e20*997, reduction.result(imin));
+    }
+  }
+
+  for (auto const& s : sums)
+    CHECK_EQUAL(sums[0], s);   // bitwise identical
+  CHECK_CLOSE(expected_small + 250*1.0e-300, sums[0], 1.0e-12);
+
+  // Non-finite values propagate
+
+  vals[3] = std::numeric_limits<double>::infinity();
+  Jali::StateReduction reduction(MPI_COMM_WORLD, true);
+  reduction.add(vals.data(), num, nullptr, Jali::Reduction_type::SUM);
+  reduction.execute();
+  CHECK(std::isinf(reduction.result(0)));
+}
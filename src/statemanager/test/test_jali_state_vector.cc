@@ -343,7 +343,7 @@ TEST(Jali_MultiStateVector_Cells_Mesh) {
   double vol = 0.0;  // sum of material volumes over the mesh
   for (int m = 0; m < 3; m++) {
     double matvol = 0.0;  // material volume
-    std::vector<double> & matvec = myvec1.get_matdata(m);
+    Jali::StateArray<double>& matvec = myvec1.get_matdata(m);
     for (int c = 0; c < matvec.size(); c++) {
       CHECK_EQUAL(matvf[m][c], matvec[c]);
       double cellvol = mesh->cell_volume(matcells_in[m][c]);
@@ -374,7 +374,7 @@ TEST(Jali_MultiStateVector_Cells_Mesh) {
   // If we get the cells of the material we have to use a local
   // indexing scheme to address the entries
 
-  std::vector<double> & matvec = myvec1.get_matdata(0);
+  Jali::StateArray<double>& matvec = myvec1.get_matdata(0);
   matvec[cell_matindex[0][1]] = 1.0/3.0;
   matvec[cell_matindex[0][4]] = 1.0/3.0;
   matvec[cell_matindex[0][7]] = 1.0/3.0;
@@ -390,7 +390,7 @@ TEST(Jali_MultiStateVector_Cells_Mesh) {
   vol = 0.0;  // sum of material volumes over the mesh
   for (int m = 0; m < 3; m++) {
     double matvol = 0.0;  // material volume
-    std::vector<double> & matvec_out = myvec1.get_matdata(m);
+    Jali::StateArray<double>& matvec_out = myvec1.get_matdata(m);
     for (int c = 0; c < matvec_out.size(); c++) {
       CHECK_EQUAL(matvf[m][c], matvec_out[c]);
       double cellvol = mesh->cell_volume(matcells_in[m][c]);
@@ -442,7 +442,7 @@ TEST(Jali_MultiStateVector_Cells_Mesh) {
   for (int m = 0; m < 3; m++) {
     std::vector<int> const& matcells = state->material_cells(m);
 
-    std::vector<Point2> matcen_out = cenvec.get_matdata(m);
+    Jali::StateArray<Point2> matcen_out = cenvec.get_matdata(m);
 
     int nmatcells = matcells.size();
     for (int ic = 0; ic < nmatcells; ic++) {
@@ -457,3 +457,277 @@ TEST(Jali_MultiStateVector_Cells_Mesh) {
   delete [] matcen;
 }
  
+
+
+TEST(Jali_StateVector_Memory_Policy) {
+
+  Jali::MeshFactory mf(MPI_COMM_WORLD);
+  mf.num_tiles(4);
+  mf.partitioner(Jali::Partitioner_type::BLOCK);
+  std::shared_ptr<Jali::Mesh> mesh = mf(0.0, 0.0, 0.0, 1.0, 1.0, 1.0,
+                                        4, 4, 4);
+  CHECK(mesh);
+
+  int ncells = mesh->num_cells<Jali::Entity_type::ALL>();
+  int nnodes = mesh->num_nodes<Jali::Entity_type::ALL>();
+
+  Jali::Memory_policy policies[4] = {Jali::Memory_policy::DEFAULT,
+                                     Jali::Memory_policy::ALIGNED,
+                                     Jali::Memory_policy::HUGE_PAGE,
+                                     Jali::Memory_policy::FIRST_TOUCH};
+
+  for (int ip = 0; ip < 4; ip++) {
+    Jali::Memory_policy policy = policies[ip];
+    std::shared_ptr<Jali::State> state = Jali::State::create(mesh, policy);
+
+    // material sets get created on the mesh, so use different names
+    // for different states
+    std::string suffix = "_" + std::to_string(ip);
+    CHECK(policy == state->memory_policy());
+
+    // Vectors with a uniform initializer and with array data
+
+    Jali::UniStateVector<double>& cvec =
+        state->add<double, Jali::Mesh, Jali::UniStateVector>("cellvec", mesh, Jali::Entity_kind::CELL,
+                   Jali::Entity_type::ALL, 3.5);
+    CHECK(policy == cvec.memory_policy());
+    CHECK_EQUAL(ncells, cvec.size());
+    for (int c = 0; c < ncells; c++)
+      CHECK_EQUAL(3.5, cvec[c]);
+
+    std::vector<int> nodedata(nnodes);
+    for (int n = 0; n < nnodes; n++)
+      nodedata[n] = 2*n;
+    Jali::UniStateVector<int, Jali::Mesh>& nvec =
+        state->add("nodevec", mesh, Jali::Entity_kind::NODE,
+                   Jali::Entity_type::ALL, &(nodedata[0]));
+    for (int n = 0; n < nnodes; n++)
+      CHECK_EQUAL(2*n, nvec[n]);
+
+    if (policy != Jali::Memory_policy::DEFAULT) {
+      CHECK_EQUAL(0, reinterpret_cast<std::uintptr_t>(cvec.get_raw_data()) %
+                  Jali::STATE_CACHE_LINE_SIZE);
+      CHECK_EQUAL(0, reinterpret_cast<std::uintptr_t>(nvec.get_raw_data()) %
+                  Jali::STATE_CACHE_LINE_SIZE);
+    }
+
+    // Deep copies keep the memory policy and uninitialized vectors
+    // are zeroed out
+
+    Jali::UniStateVector<double> cvec_copy(cvec);
+    CHECK(policy == cvec_copy.memory_policy());
+    cvec_copy.resize(ncells+10);
+    CHECK_EQUAL(0.0, cvec_copy[ncells+5]);
+
+    Jali::UniStateVector<std::array<double, 3>>& vvec =
+        state->add<std::array<double, 3>, Jali::Mesh, Jali::UniStateVector>(
+            "vecvec", mesh, Jali::Entity_kind::CELL, Jali::Entity_type::ALL);
+    for (int c = 0; c < ncells; c++)
+      for (int i = 0; i < 3; i++)
+        CHECK_EQUAL(0.0, vvec[c][i]);
+
+    // Per-material arrays of multi-material vectors
+
+    std::vector<int> mat0cells, mat1cells;
+    for (int c = 0; c < ncells; c++) {
+      if (c < ncells/2 + 4) mat0cells.push_back(c);
+      if (c >= ncells/2 - 4) mat1cells.push_back(c);
+    }
+    state->add_material("mat0" + suffix, mat0cells);
+    state->add_material("mat1" + suffix, mat1cells);
+
+    Jali::MultiStateVector<double>& mvec =
+        state->add<double, Jali::Mesh, Jali::MultiStateVector>(
+            "matvec", mesh, Jali::Entity_kind::CELL, Jali::Entity_type::ALL);
+    CHECK(policy == mvec.memory_policy());
+    for (int m = 0; m < 2; m++) {
+      Jali::StateArray<double> const& matdata = mvec.get_matdata(m);
+      CHECK_EQUAL(state->num_material_cells(m), matdata.size());
+      for (auto const& val : matdata)
+        CHECK_EQUAL(0.0, val);
+      if (policy != Jali::Memory_policy::DEFAULT)
+        CHECK_EQUAL(0, reinterpret_cast<std::uintptr_t>(matdata.data()) %
+                    Jali::STATE_CACHE_LINE_SIZE);
+    }
+
+    state->add_material("mat2" + suffix, {0, 1});
+    CHECK_EQUAL(2, mvec.size(2));
+    CHECK_EQUAL(0.0, mvec(2, 1));
+
+    // Vectors keep the policy of their storage when the state's changes
+
+    Jali::Memory_policy other = (policy == Jali::Memory_policy::DEFAULT) ?
+        Jali::Memory_policy::ALIGNED : Jali::Memory_policy::DEFAULT;
+    state->memory_policy(other);
+    CHECK(policy == cvec.memory_policy());
+    CHECK(policy == mvec.memory_policy());
+  }
+}
+
+
+
+TEST(Jali_SoAStateVector) {
+
+  Jali::MeshFactory mf(MPI_COMM_WORLD);
+  std::shared_ptr<Jali::Mesh> mesh = mf(0.0, 0.0, 0.0, 1.0, 1.0, 1.0,
+                                        3, 3, 3);
+  CHECK(mesh);
+
+  std::shared_ptr<Jali::State> state =
+      Jali::State::create(mesh, Jali::Memory_policy::ALIGNED);
+
+  int ncells = mesh->num_cells<Jali::Entity_type::ALL>();
+
+  // Create a vector field in SoA layout from AoS data
+
+  std::vector<std::array<double, 3>> centroids(ncells);
+  for (int c = 0; c < ncells; c++) {
+    JaliGeometry::Point cen = mesh->cell_centroid(c);
+    for (int i = 0; i < 3; i++)
+      centroids[c][i] = cen[i];
+  }
+
+  Jali::SoAStateVector<std::array<double, 3>>& cenvec =
+      state->add<std::array<double, 3>, Jali::Mesh, Jali::SoAStateVector>(
+          "centroids", mesh, Jali::Entity_kind::CELL, Jali::Entity_type::ALL,
+          &(centroids[0]));
+  CHECK_EQUAL(ncells, cenvec.size());
+  CHECK_EQUAL(3, cenvec.num_components());
+  CHECK(Jali::Memory_policy::ALIGNED == cenvec.memory_policy());
+
+  // Component arrays are contiguous and hold the right values
+
+  for (int i = 0; i < 3; i++) {
+    double const *compdata = cenvec.get_raw_data(i);
+    CHECK_EQUAL(0, reinterpret_cast<std::uintptr_t>(compdata) %
+                Jali::STATE_CACHE_LINE_SIZE);
+    CHECK_EQUAL(ncells, cenvec.component(i).size());
+    for (int c = 0; c < ncells; c++) {
+      CHECK_EQUAL(centroids[c][i], compdata[c]);
+      CHECK_EQUAL(centroids[c][i], cenvec(c, i));
+    }
+  }
+
+  // Retrieve it from the state like any other vector
+
+  Jali::SoAStateVector<std::array<double, 3>, Jali::Mesh> cenvec2;
+  bool found = state->get("centroids", mesh, Jali::Entity_kind::CELL,
+                          Jali::Entity_type::ALL, &cenvec2);
+  CHECK(found);
+  CHECK(cenvec2.data_type() == typeid(std::array<double, 3>));
+
+  // Modify through the component arrays and convert back to AoS
+
+  Jali::StateArray<double>& xcomp = cenvec2.component(0);
+  for (auto& x : xcomp)
+    x *= 2.0;
+
+  std::vector<std::array<double, 3>> aosdata = cenvec.to_aos();
+  CHECK_EQUAL(ncells, aosdata.size());
+  for (int c = 0; c < ncells; c++) {
+    CHECK_EQUAL(2.0*centroids[c][0], aosdata[c][0]);
+    CHECK_EQUAL(centroids[c][1], aosdata[c][1]);
+    CHECK_EQUAL(centroids[c][2], cenvec.get(c)[2]);
+  }
+
+  // Uniform initialization and deep copy
+
+  std::array<double, 6> tens = {1.0, 2.0, 3.0, 4.0, 5.0, 6.0};
+  Jali::SoAStateVector<std::array<double, 6>>& tensvec =
+      state->add<std::array<double, 6>, Jali::Mesh, Jali::SoAStateVector>(
+          "tensors", mesh, Jali::Entity_kind::CELL, Jali::Entity_type::ALL,
+          tens);
+  Jali::SoAStateVector<std::array<double, 6>> tensvec_copy(tensvec);
+  tensvec_copy.set(0, {0.0, 0.0, 0.0, 0.0, 0.0, 0.0});
+  for (int i = 0; i < 6; i++) {
+    CHECK_EQUAL(tens[i], tensvec(0, i));
+    CHECK_EQUAL(tens[i], tensvec(ncells-1, i));
+    CHECK_EQUAL(0.0, tensvec_copy(0, i));
+  }
+}
+
+
+
+TEST(Jali_MultiLevelStateVector) {
+
+  Jali::MeshFactory mf(MPI_COMM_WORLD);
+  std::shared_ptr<Jali::Mesh> mesh = mf(0.0, 0.0, 0.0, 1.0, 1.0, 1.0,
+                                        3, 3, 3);
+  CHECK(mesh);
+
+  std::shared_ptr<Jali::State> state = Jali::State::create(mesh);
+
+  int ncells = mesh->num_cells<Jali::Entity_type::ALL>();
+
+  Jali::MultiLevelStateVector<double>& density =
+      state->add_multilevel<double, Jali::Mesh>("density", mesh,
+                                                Jali::Entity_kind::CELL,
+                                                Jali::Entity_type::ALL, 3,
+                                                1.0);
+  CHECK_EQUAL(3, density.num_levels());
+  CHECK_EQUAL(ncells, density.size());
+  for (int k = 0; k < 3; k++)
+    for (int c = 0; c < ncells; c++)
+      CHECK_EQUAL(1.0, density.level(k)[c]);
+
+  // A two level vector added through the generic interface
+
+  Jali::MultiLevelStateVector<double>& energy =
+      state->add<double, Jali::Mesh, Jali::MultiLevelStateVector>(
+          "energy", mesh, Jali::Entity_kind::CELL, Jali::Entity_type::ALL,
+          5.0);
+  CHECK_EQUAL(2, energy.num_levels());
+
+  // Advance a few "time steps" - each step computes the current level
+  // from the previous one after rotating levels
+
+  for (int step = 1; step <= 4; step++) {
+    double const *old_rho = density.level(0).data();
+    state->swap_levels();
+    CHECK_EQUAL(old_rho, density.level(1).data());  // no copies
+
+    for (int c = 0; c < ncells; c++) {
+      density[c] = density.level(1)[c] + 1.0;
+      energy[c] = 2.0*energy.level(1)[c];
+    }
+  }
+
+  // Lookups by name return the current level, even as a UniStateVector
+
+  Jali::UniStateVector<double> rho;
+  CHECK(state->get("density", mesh, Jali::Entity_kind::CELL,
+                   Jali::Entity_type::ALL, &rho));
+  for (int c = 0; c < ncells; c++) {
+    CHECK_EQUAL(5.0, rho[c]);
+    CHECK_EQUAL(4.0, density.level(1)[c]);
+    CHECK_EQUAL(3.0, density.level(2)[c]);
+    CHECK_EQUAL(80.0, energy[c]);
+    CHECK_EQUAL(40.0, energy.level(1)[c]);
+  }
+
+  // Deep copies copy all levels
+
+  Jali::MultiLevelStateVector<double> density_copy(density);
+  CHECK_EQUAL(3, density_copy.num_levels());
+  density_copy.level(2)[0] = -1.0;
+  CHECK_EQUAL(3.0, density.level(2)[0]);
+  CHECK_EQUAL(5.0, density_copy[0]);
+  // Resizing through a UniStateVector resizes all levels
+
+  Jali::UniStateVector<double>& uni = density_copy;
+  uni.resize(ncells+3, 7.0);
+  for (int k = 0; k < 3; k++) {
+    CHECK_EQUAL(ncells+3, density_copy.level(k).size());
+    CHECK_EQUAL(7.0, density_copy.level(k)[ncells+2]);
+  }
+  uni.clear();
+  for (int k = 0; k < 3; k++)
+    CHECK_EQUAL(0, density_copy.level(k).size());
+
+  // A default constructed vector has one empty level
+
+  Jali::MultiLevelStateVector<double> empty;
+  CHECK_EQUAL(1, empty.num_levels());
+  empty.swap_levels();
+  CHECK_EQUAL(0, empty.size());
+}
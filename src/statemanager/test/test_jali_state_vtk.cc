@@ -0,0 +1,289 @@
+/*
+Copyright (c) 2019, Triad National Security, LLC
+All rights reserved.
+
+Copyright 2019. Triad National Security, LLC. This software was
+produced under U.S. Government contract 89233218CNA000001 for Los
+Alamos National Laboratory (LANL), which is operated by Triad
+National Security, LLC for the U.S. Department of Energy. 
+All rights in the program are reserved by Triad National Security,
+LLC, and the U.S. Department of Energy/National Nuclear Security
+Administration. The Government is granted for itself and others acting
+on its behalf a nonexclusive, paid-up, irrevocable worldwide license
+in this material to reproduce, prepare derivative works, distribute
+copies to the public, perform publicly and display publicly, and to
+ permit others to do so
+ 
+
+This is open source software distributed under the 3-clause BSD license.
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1. Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright
+   notice, this list of conditions and the following disclaimer in the
+   documentation and/or other materials provided with the distribution.
+3. Neither the name of Triad National Security, LLC, Los Alamos
+   National Laboratory, LANL, the U.S. Government, nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+ 
+THIS SOFTWARE IS PROVIDED BY TRIAD NATIONAL SECURITY, LLC AND
+CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING,
+BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+TRIAD NATIONAL SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER
+IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+
+#include <mpi.h>
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "JaliState.h"
+#include "JaliStateVector.h"
+#include "JaliStateVTK.h"
+#include "Mesh.hh"
+#include "MeshFactory.hh"
+
+#include "UnitTest++.h"
+
+namespace {
+
+// Read the raw arrays of the appended data section of a VTU file in
+// the order they were written
+
+std::vector<std::vector<char>> read_appended(std::string const& contents) {
+  std::vector<std::vector<char>> arrays;
+  std::size_t pos = contents.find("<AppendedData");
+  pos = contents.find('_', pos) + 1;
+  std::size_t end = contents.rfind("</AppendedData>");
+  while (pos + sizeof(uint64_t) <= end) {
+    uint64_t nbytes;
+    std::memcpy(&nbytes, &contents[pos], sizeof(nbytes));
+    pos += sizeof(nbytes);
+    if (pos + nbytes > end) break;
+    arrays.emplace_back(&contents[pos], &contents[pos] + nbytes);
+    pos += nbytes;
+  }
+  return arrays;
+}
+
+}  // namespace
+
+
+TEST(Jali_State_VTK) {
+
+  Jali::MeshFactory mf(MPI_COMM_WORLD);
+  std::shared_ptr<Jali::Mesh> mesh = mf(0.0, 0.0, 0.0, 1.0, 1.0, 1.0,
+                                        2, 2, 2);
+  CHECK(mesh);
+
+  int nprocs, rank;
+  MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  int ncells = mesh->num_cells<Jali::Entity_type::PARALLEL_OWNED>();
+
+  std::shared_ptr<Jali::State> state = Jali::State::create(mesh);
+
+  std::vector<double> cellid(mesh->num_cells<Jali::Entity_type::ALL>());
+  for (int c = 0; c < cellid.size(); c++)
+    cellid[c] = c + 0.5;
+  state->add("cellid", mesh, Jali::Entity_kind::CELL, Jali::Entity_type::ALL,
+             &(cellid[0]));
+
+  int nnodes = mesh->num_nodes<Jali::Entity_type::ALL>();
+  std::vector<std::array<double, 3>> coords(nnodes);
+  for (int n = 0; n < nnodes; n++) {
+    JaliGeometry::Point xyz;
+    mesh->node_get_coordinates(n, &xyz);
+    coords[n] = {xyz[0], xyz[1], xyz[2]};
+  }
+  state->add<std::array<double, 3>, Jali::Mesh, Jali::SoAStateVector>(
+      "coords", mesh, Jali::Entity_kind::NODE, Jali::Entity_type::ALL,
+      &(coords[0]));
+  state->add<int, Jali::Mesh, Jali::UniStateVector>(
+      "unused", mesh, Jali::Entity_kind::NODE, Jali::Entity_type::ALL, 3);
+
+  Jali::write_vtk(*state, "vtk_test", {"cellid", "coords"});
+
+  std::stringstream piecename;
+  piecename << "vtk_test_" << rank << ".vtu";
+  std::ifstream file(piecename.str(), std::ios::binary);
+  CHECK(file);
+  std::string contents((std::istreambuf_iterator<char>(file)),
+                       std::istreambuf_iterator<char>());
+
+  CHECK(contents.find("NumberOfCells=\"" + std::to_string(ncells) + "\"") !=
+        std::string::npos);
+  CHECK(contents.find("Name=\"cellid\"") != std::string::npos);
+  CHECK(contents.find("Name=\"coords\" NumberOfComponents=\"3\"") !=
+        std::string::npos);
+  CHECK(contents.find("Name=\"unused\"") == std::string::npos);
+  CHECK(contents.find("vtkGhostType") == std::string::npos);
+
+  // Arrays in order: point data (coords), cell data (cellid), points,
+  // connectivity, offsets, types, faces, faceoffsets
+
+  std::vector<std::vector<char>> arrays = read_appended(contents);
+  CHECK_EQUAL(8, arrays.size());
+  if (arrays.size() == 8) {
+    std::vector<char> const& ptcoords = arrays[0];
+    std::vector<char> const& points = arrays[2];
+    CHECK_EQUAL(ptcoords.size(), points.size());
+    CHECK(ptcoords == points);   // coords written as point data
+
+    CHECK_EQUAL(ncells*sizeof(double), arrays[1].size());
+    double const *cdata = reinterpret_cast<double const *>(arrays[1].data());
+    for (int c = 0; c < ncells; c++)
+      CHECK_EQUAL(c + 0.5, cdata[c]);
+
+    // Hexes as polyhedra - 8 nodes and 6 quad faces each
+
+    CHECK_EQUAL(ncells, arrays[5].size());
+    for (int c = 0; c < ncells; c++)
+      CHECK_EQUAL(42, arrays[5][c]);
+    int64_t const *offsets = reinterpret_cast<int64_t const *>(arrays[4].data());
+    int64_t const *faceoffsets =
+        reinterpret_cast<int64_t const *>(arrays[7].data());
+    for (int c = 0; c < ncells; c++) {
+      CHECK_EQUAL(8*(c+1), offsets[c]);
+      CHECK_EQUAL(31*(c+1), faceoffsets[c]);
+    }
+  }
+
+  if (rank == 0) {
+    std::ifstream index("vtk_test.pvtu");
+    CHECK(index);
+    std::string indexstr((std::istreambuf_iterator<char>(index)),
+                         std::istreambuf_iterator<char>());
+    for (int p = 0; p < nprocs; p++)
+      CHECK(indexstr.find("Source=\"vtk_test_" + std::to_string(p) +
+                          ".vtu\"") != std::string::npos);
+    CHECK(indexstr.find("<PDataArray type=\"Float64\" Name=\"cellid\"/>") !=
+          std::string::npos);
+  }
+
+  // Mesh only output with ghost cells
+
+  Jali::write_vtk(*mesh, "vtk_mesh_test", false);
+  std::stringstream meshpiecename;
+  meshpiecename << "vtk_mesh_test_" << rank << ".vtu";
+  std::ifstream meshfile(meshpiecename.str(), std::ios::binary);
+  CHECK(meshfile);
+  std::string meshcontents((std::istreambuf_iterator<char>(meshfile)),
+                           std::istreambuf_iterator<char>());
+  CHECK(meshcontents.find("Name=\"vtkGhostType\"") != std::string::npos);
+
+  // A vector that cannot be written on the last rank (too short) is
+  // left out of every piece and of the index
+
+  Jali::UniStateVector<double>& partial =
+      state->add<double, Jali::Mesh, Jali::UniStateVector>(
+          "partial", mesh, Jali::Entity_kind::CELL, Jali::Entity_type::ALL,
+          1.0);
+  if (rank == nprocs-1) partial.resize(0);
+
+  Jali::write_vtk(*state, "vtk_partial_test", {"cellid", "partial"});
+  std::stringstream partialname;
+  partialname << "vtk_partial_test_" << rank << ".vtu";
+  std::ifstream partialfile(partialname.str(), std::ios::binary);
+  CHECK(partialfile);
+  std::string partialcontents((std::istreambuf_iterator<char>(partialfile)),
+                              std::istreambuf_iterator<char>());
+  CHECK(partialcontents.find("Name=\"cellid\"") != std::string::npos);
+  CHECK(partialcontents.find("Name=\"partial\"") == std::string::npos);
+  if (rank == 0) {
+    std::ifstream index("vtk_partial_test.pvtu");
+    std::string indexstr((std::istreambuf_iterator<char>(index)),
+                         std::istreambuf_iterator<char>());
+    CHECK(indexstr.find("Name=\"cellid\"") != std::string::npos);
+    CHECK(indexstr.find("Name=\"partial\"") == std::string::npos);
+  }
+
+  // Vectors on owned entities get the values of the ghost nodes of
+  // owned cells and of the ghost cells from the ranks owning them
+
+  int nownednodes = mesh->num_nodes<Jali::Entity_type::PARALLEL_OWNED>();
+  std::vector<double> xcoord(nownednodes);
+  for (int n = 0; n < nownednodes; n++)
+    xcoord[n] = coords[n][0];
+  state->add("xcoord", mesh, Jali::Entity_kind::NODE,
+             Jali::Entity_type::PARALLEL_OWNED, &(xcoord[0]));
+  std::vector<int> cellgid(ncells);
+  for (int c = 0; c < ncells; c++)
+    cellgid[c] = mesh->GID(c, Jali::Entity_kind::CELL);
+  state->add("cellgid", mesh, Jali::Entity_kind::CELL,
+             Jali::Entity_type::PARALLEL_OWNED, &(cellgid[0]));
+
+  Jali::write_vtk(*state, "vtk_owned_test", {"xcoord", "cellgid"}, false);
+  std::stringstream ownedname;
+  ownedname << "vtk_owned_test_" << rank << ".vtu";
+  std::ifstream ownedfile(ownedname.str(), std::ios::binary);
+  CHECK(ownedfile);
+  std::string ownedcontents((std::istreambuf_iterator<char>(ownedfile)),
+                            std::istreambuf_iterator<char>());
+  CHECK(ownedcontents.find("Name=\"xcoord\"") != std::string::npos);
+  CHECK(ownedcontents.find("Name=\"cellgid\"") != std::string::npos);
+
+  // Arrays in order: point data (xcoord), cell data (cellgid,
+  // vtkGhostType), points, ...
+
+  std::vector<std::vector<char>> owned = read_appended(ownedcontents);
+  CHECK(owned.size() > 3);
+  if (owned.size() > 3) {
+    CHECK_EQUAL(nnodes*sizeof(double), owned[0].size());
+    CHECK_EQUAL(3*nnodes*sizeof(double), owned[3].size());
+    double const *xdata = reinterpret_cast<double const *>(owned[0].data());
+    double const *points = reinterpret_cast<double const *>(owned[3].data());
+    for (int n = 0; n < nnodes; n++)
+      CHECK_EQUAL(points[3*n], xdata[n]);
+
+    int nallcells = mesh->num_cells<Jali::Entity_type::ALL>();
+    CHECK_EQUAL(nallcells*sizeof(int), owned[1].size());
+    int const *gdata = reinterpret_cast<int const *>(owned[1].data());
+    for (int c = 0; c < nallcells; c++)
+      CHECK_EQUAL(mesh->GID(c, Jali::Entity_kind::CELL), gdata[c]);
+  }
+
+  // Ranks asking for as many vectors but different ones fail together
+
+  if (nprocs > 1) {
+    std::vector<std::string> names = {"cellid", "cellgid"};
+    if (rank == nprocs-1) names[1] = "xcoord";
+    CHECK_THROW(Jali::write_vtk(*state, "vtk_names_test", names),
+                Errors::Message);
+  }
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  std::remove(piecename.str().c_str());
+  std::remove(meshpiecename.str().c_str());
+  std::remove(partialname.str().c_str());
+  std::remove(ownedname.str().c_str());
+  if (rank == 0) {
+    std::remove("vtk_test.pvtu");
+    std::remove("vtk_mesh_test.pvtu");
+    std::remove("vtk_partial_test.pvtu");
+    std::remove("vtk_owned_test.pvtu");
+  }
+}